@@ -19,7 +19,9 @@
  * from the Moteino. There are tight memory constraints (600 byte of RAM for
  * editing and execution, and 1021 bytes of EEPROM for multiple program
  * storage). WIPE program execution speed is on the order of 10,000
- * instructions per second.
+ * instructions per second. If the Moteino Mega has its optional SPI flash
+ * chip, programs are stored there instead of EEPROM (see PROG_FLASH_BASE),
+ * and the programs run by mrun are paged in from flash a line at a time.
  * 
  * WIPE Tutorial:
  * =============
@@ -37,7 +39,7 @@
  *                          Auto-Run is enabled in the command console. To be
  *                          remembered over resets/power-ups, a save command
  *                          must be entered in the command console.
- *   dir                  - List the program's stored in EEPROM.
+ *   dir                  - List the program's stored in EEPROM (or flash).
  *
  *   <statement>          - Immediately execute a WIPE program statement.
  *   <line #> <statement> - Add/edit a WIPE program statement at the given line
@@ -238,11 +240,16 @@
 #include "WASP_defs.h"
 #include <avr/pgmspace.h>
 #include <EEPROM.h>
+#include <SPIFlash.h>
 
 #define COPYRIGHT     "(C)2019, A.J. van Schouwen"
 #define SW_VERSION_c  "5.00 (2019-03-29)"
-#define FW_VERSION_c  7   // Increment (with wraparound) for new F/W;
-                          //   clears EEPROM.
+#define FW_VERSION_c 11   // Increment (with wraparound) for new F/W. EEPROM
+                          //   written by F/W older than FW_KEPT_c (or
+                          //   newer than this) is cleared; otherwise it's
+                          //   kept and converted.
+#define FW_KEPT_c     7   // Oldest F/W whose EEPROM contents are kept
+                          //   (see wipeLegacyLoad()).
 
 #define CONSOLE_ENABLED     // Uncomment to enable the console
 #ifdef CONSOLE_ENABLED
@@ -270,6 +277,17 @@
 #define EEPROM_PROG_DIR_START  (EEPROM_FIRST_OPEN_ADDR + 1)
 #define EEPROM_PROG_LEN        (EEPROM_RESET_COUNT_ADDR - EEPROM_PROG_DIR_START)
 
+// Storage space for WIPE program files in SPI flash, used instead of EEPROM
+// if the chip is fitted. Each program has a slot of its own (see
+// wipeDirFileSave()), clear of any wireless software upgrade image stored
+// from address 0.
+#define FLASH_SS               23     // FLASH SS on D23
+#define PROG_FLASH_BASE   0x40000UL   // Address of program slot #0
+#define PROG_SLOT_SIZE     0x2000UL   // Two 4K erase blocks per slot
+#define PROG_FLASH_SLOTS  MAX_DIR_FILES // One per directory index entry
+#define PROG_FLASH_LEN    (PROG_FLASH_SLOTS * (PROG_SLOT_SIZE - PROG_HDR_LEN))
+#define PROG_MAGIC           0xA5     // Last header byte of a saved program
+
 #define SERIAL_BAUD                9600
 
 #define DEL_CHAR                   0x7F  // ASCII Del character
@@ -291,9 +309,40 @@
 #define PRG_PROMPT        0  // Display command prompt
 #define PRG_INPUT         1  // Scan for complete line of input
 #define PRG_PARSE         2  // Parse the command line
+#define PRG_RUN           3  // Run statements (one per loop() pass)
+
+// What to do when a WIPE run completes
+#define WIPE_RUN_IMMED    0  // Immediate (unnumbered) statement
+#define WIPE_RUN_PROG     1  // 'run' command
+#define WIPE_RUN_AUTO     2  // Autorun program
 
 #define DFLT_AUTORUN_DELAY  10 // Default autorun delay (in seconds)
 
+#define MAX_CANVAS_LEN     150 // # of pixels in the WIPE canvas (Paint())
+
+#define TX_QUEUE_LEN         4 // # of WASP commands queued for transmission
+
+// Radio Tx queue entry states
+#define TXQ_PENDING       0  // Waiting to be sent
+#define TXQ_DONE          1  // Sent
+
+// Commands that leave the slaves' pixels as they are, and so keep the WIPE
+// canvas shadow valid (see radioSendBuf()). A WASPCMD_MCAST command is only
+// ever queued as a resend of one that was checked when first queued.
+#define KEEPS_PIXELS(cmd)  ( ((cmd) == WASPCMD_PING)      || \
+                             ((cmd) == WASPCMD_TMR_STATS) || \
+                             ((cmd) == WASPCMD_TELEMETRY) || \
+                             ((cmd) == WASPCMD_SCRIPT)    || \
+                             ((cmd) == WASPCMD_SYNC)      || \
+                             ((cmd) == WASPCMD_MCAST)     || \
+                             ((cmd) == WASPCMD_NACK) )
+
+// Radio airtime estimate (see radioSendFrame()), for the RFM69 library's
+// default bit rate. Each frame carries a 3-byte preamble, 2 sync bytes, and
+// length, target, sender, CTL and 2 CRC bytes besides the payload.
+#define RADIO_BITRATE     55555  // Bits per second
+#define RADIO_FRAME_OVHD     11  // # of bytes added to the payload
+
 
 // Macro for defining strings that are stored in flash (program) memory rather
 // than in RAM. Arduino defines the non-descript F("string") syntax.
@@ -338,6 +387,8 @@ uint32  m_autoRunStart = 0;  // Auto-run startup time (in milliseconds).
 uint8   m_myNodeId = CONTROLLERID;  // Must be unique for each node 
 
 RFM69   m_radio;
+SPIFlash m_flash(FLASH_SS, 0xEF30);  // EF30 for windbond 4mbit flash
+boolean  m_flashPresent = false;     // WIPE programs are stored in flash
 boolean m_promiscuousMode = true;  // sniff all packets on network iff true
 uint8   m_dstNodeId;
 uint8   m_srcNodeId;
@@ -346,14 +397,148 @@ uint8   m_radioOutBuf[RF69_MAX_DATA_LEN];
 uint8   m_radioOutBufPos = 0;
 uint8   m_radioInBuf[RF69_MAX_DATA_LEN];
 uint8   m_radioInBufPos = 0;
+uint8   m_radioInBufLen = 0;
 
 boolean m_ackRequested = false;
 
+// Outbound WASP command queue, drained by radioTxPoll(). Commands are sent
+// in order for any one slave, but a command for other slaves needn't wait
+// behind one that is being paced.
+typedef struct
+{
+  uint8   state;                       // TXQ_... value
+  uint8   id;                          // Tx id (see radioTxSent())
+  uint8   dst;
+  uint8   len;
+  uint16  busyMs;                      // Time the slaves need once it's sent
+  uint8   payload[RF69_MAX_DATA_LEN];
+} TxEntry_t;
+
+TxEntry_t m_txQueue[TX_QUEUE_LEN];
+uint8   m_txHead = 0;           // Index of the oldest entry
+uint8   m_txCount = 0;          // # of entries in use from m_txHead
+uint8   m_txNextId = 0;         // Tx id of the next command queued
+uint32  m_nodeTxTime[MAX_SLAVES];  // millis() of last command to each slave
+uint16  m_nodeBusyMs[MAX_SLAVES];  // How long the slave is busy after it
+
+uint8   m_batchBuf[RF69_MAX_DATA_LEN];  // Pending WASPCMD_BATCH/AT command
+uint8   m_batchPos = 0;                 // # of bytes pending (0 = none)
+uint8   m_batchDst = BROADCASTID;       // Destination of pending commands
+uint8   m_batchHdrLen = 0;              // Header size; its last byte is the
+                                        //   # of commands
+
+// Reliable multicast (WASPCMD_MCAST). Stream 0 is BROADCASTID; stream i > 0
+// is group (FIRST_GROUP + i - 1).
+#define MCAST_NONE  0xFF                // Not a multicast destination
+#define MCAST_TAIL_BEACONS 3            // # of time-sync beacons sent after
+                                        //   the last MCAST (see syncPoll())
+typedef struct
+{
+  uint8   dst;                          // 0 = unused entry
+  uint8   len;
+  uint32  resendTime;                   // millis() when last resent
+  uint8   payload[RF69_MAX_DATA_LEN];   // The MCAST command
+} McastEntry_t;
+
+boolean m_mcastOn = false;              // Send commands as MCAST commands
+uint8   m_mcastSeq[1 + MAX_GROUPS];     // Next seq of each stream
+uint8   m_mcastStarted = 0;             // Bit i set once stream i is used
+McastEntry_t m_mcastHist[MCAST_HIST_LEN]; // Recently sent MCAST commands
+uint8   m_mcastHistNext = 0;            // Entry to record the next one in
+uint16  m_mcastResends = 0;             // # of MCAST commands resent
+uint8   m_mcastTail = 0;                // # of beacons still due after the
+                                        //   last MCAST
+
+// Statistics of the current (or last) WIPE run (see wipeRunReport())
+uint32  m_runStartMs = 0;       // millis() at the start of the run
+uint32  m_runStmts = 0;         // # of statements executed
+uint32  m_runTxBytes = 0;       // # of payload bytes sent over the radio
+uint32  m_runAirUs = 0;         // Estimated radio airtime (microseconds)
+uint16  m_runTxFrames = 0;      // # of frames sent (including resends)
+
+boolean m_schedOn = false;      // Schedule batchable commands (WASPCMD_AT)
+uint16  m_schedFrame = 0;       // Network frame # to schedule them for
+
 
 /*------------------------------  WASP State ---------------------------------*/
 uint8   m_rxWaspRsp = WASPCMD_NONE;
 uint32  m_cmdExecDelay = 0;
 
+// Latest WASPCMD_TELEMETRY reply from each slave
+typedef struct
+{
+  boolean valid;                     // Replied in the last collection
+  int16   rssi;
+  uint16  freeRam;
+  uint16  txLate;
+  uint16  omet[TELEM_NUM_TIMERS];
+} NodeTelem_t;
+
+NodeTelem_t m_nodeTelem[MAX_SLAVES];
+boolean     m_telemCollecting = false;   // Awaiting replies until m_telemEnd
+uint32      m_telemEnd = 0;
+uint8       m_telemTxId;        // Tx id of the WASPCMD_TELEMETRY query
+uint8       m_telemDst = BROADCASTID;
+uint8       m_telemPeriod = 0;  // Seconds between collections while a WIPE
+                                //   program runs (0 = don't collect)
+uint32      m_telemNext = 0;    // When the next collection is due
+
+// Time-sync beacon (WASPCMD_SYNC)
+uint8       m_syncPeriod = SYNC_DFLT_PERIOD; // 100's of ms (0 = no beacons)
+uint32      m_syncNext = 0;     // When the next beacon is due
+
+// Slaves in indexed colour mode (WASPCMD_PALETTE): bit i = (FIRST_SLAVE + i)
+uint16      m_palNodes = 0;
+
+// SHIFT TDMA schedule of each group: its members (as registered by
+// setGroup()) respond in consecutive slots of m_slotWind[] milliseconds.
+uint8   m_nodeGroup[MAX_SLAVES];   // Group of each slave (NODEID_UNDEF = none)
+uint8   m_slotWind[MAX_GROUPS];    // Slot window (0 = SLAVE_TX_WIND)
+
+// Mirror of each slave's scene, as set by the commands sent to it (see
+// mirrorUpdate()), so that a slave that restarts can be brought back to it
+// with a few commands (see mirrorResync()). Each entry is a command, or
+// WASPCMD_NONE.
+#define MIRROR_CMD_LEN  8               // Longest command (WASPCMD_GRADIENT)
+typedef struct
+{
+  uint32  updTime;                      // millis() of last change (0 = none)
+  boolean detail;                       // Drawn over since base was set
+  uint8   group[4];                     // GROUP
+  uint8   bright[4];                    // BRIGHT
+  uint8   saved[MIRROR_CMD_LEN];        // base, as of the last STATE save
+  uint8   base[MIRROR_CMD_LEN];         // BKGRD or GRADIENT
+  uint8   fx[MIRROR_CMD_LEN];           // Running effect
+  uint8   speed[2];                     // SPEED
+} SceneMirror_t;
+
+SceneMirror_t m_mirror[MAX_SLAVES];
+uint16  m_resyncNodes = 0;     // Slaves to resync: bit i = (FIRST_SLAVE + i)
+
+// WIPE canvas, painted locally and uploaded with WASPCMD_PIXELS. The shadow
+// holds the last upload, so that a repeat upload of the same region to the
+// same destination only sends the pixels that changed.
+uint8   m_canvas[MAX_CANVAS_LEN * 3];     // (r,g,b) per pixel
+uint8   m_canvasShadow[MAX_CANVAS_LEN * 3];
+boolean m_shadowValid = false;  // false once the pixels may have changed
+uint8   m_shadowDst;
+uint8   m_shadowStart;
+uint8   m_shadowLen;
+
+// Upload in progress, sent a packet at a time as the radio Tx queue has
+// room (see pixelsPoll()).
+boolean m_pixPending = false;
+boolean m_pixDelta;             // Skip the pixels unchanged in the shadow
+uint8   m_pixNext;              // Next pixel to send
+uint8   m_pixSeq;               // seq of the next packet
+boolean m_pixResend = false;    // A slave lost part of the last upload
+uint32  m_pixResendTime = 0;    // millis() of the last resend
+
+
+// Effect script being assembled by Code() for upload by Script()
+uint8   m_scriptCode[SCRIPT_MAX_LEN];
+uint8   m_scriptCodeLen = 0;
+
 
 /*--------------------------  Console State  ---------------------------------*/
 char    m_consoleBuffer[MAX_SERIAL_BUF_LEN];
@@ -382,10 +567,15 @@ boolean cmdHdlrAutoRun(void);
 boolean cmdHdlrHelp(void);
 boolean cmdHdlrNetLed(void);
 boolean cmdHdlrNetLedCtrl(void);
+boolean cmdHdlrNetMcast(void);
 boolean cmdHdlrNetNodeId(void);
+boolean cmdHdlrNetPerf(void);
 boolean cmdHdlrNetPing(void);
 boolean cmdHdlrNetReset(void);
 boolean cmdHdlrNetSave(void);
+boolean cmdHdlrNetScene(void);
+boolean cmdHdlrNetStats(void);
+boolean cmdHdlrNetSync(void);
 boolean cmdHdlrWipe(void);
 boolean cmdHdlrQuiet(void);
 boolean cmdHdlrReset(void);
@@ -401,10 +591,15 @@ CmdCtrl_t m_cmdCtrl[] =
       { "h",          cmdHdlrHelp       },
       { "netLed",     cmdHdlrNetLed     },
       { "netLedCtrl", cmdHdlrNetLedCtrl },
+      { "netMcast",   cmdHdlrNetMcast   },
       { "netNodeId",  cmdHdlrNetNodeId  },
+      { "netPerf",    cmdHdlrNetPerf    },
       { "netPing",    cmdHdlrNetPing    },
       { "netReset",   cmdHdlrNetReset   },
       { "netSave",    cmdHdlrNetSave    },
+      { "netScene",   cmdHdlrNetScene   },
+      { "netStats",   cmdHdlrNetStats   },
+      { "netSync",    cmdHdlrNetSync    },
       { "program",    cmdHdlrWipe       },
       { "quiet",      cmdHdlrQuiet      },
       { "reset",      cmdHdlrReset      },
@@ -450,11 +645,17 @@ const uint8 m_numCmds = sizeof(m_cmdCtrl)/sizeof(CmdCtrl_t);
 #define WIPE_CMD_RUN     (WIPE_BASE + 10) // Run current program: RUN
 #define WIPE_CMD_START   (WIPE_BASE + 11) // Define startup program: START
 #define WIPE_CMD_PROF    (WIPE_BASE + 12) // Show profile of current variables.
-#define LAST_WIPE_CMD    WIPE_CMD_PROF
+#define WIPE_CMD_MRUN    (WIPE_BASE + 13) // Run saved programs concurrently:
+                                          //   MRUN <name> <name> ...
+#define LAST_WIPE_CMD    WIPE_CMD_MRUN
 
 
-/* WIPE language keyword token Ids */
-#define KEY_BASE      (LAST_WIPE_CMD + 1)
+/* WIPE language keyword token Ids
+ *  - WASPCMD_... values double as function token Ids, so keywords start
+ *    above both them and the WIPE commands.
+ */
+#define KEY_BASE      ( (LAST_WIPE_CMD > MAX_WASPCMD_VAL ?               \
+                         LAST_WIPE_CMD : MAX_WASPCMD_VAL) + 1 )
 #define WIPE_UNDEF                 0  // Undefined token
 #define WIPE_FUNC     (KEY_BASE +  1) // Function call placeholder.
 #define WIPE_LABEL    (KEY_BASE +  2) // Define a label: LABEL <id>
@@ -466,6 +667,8 @@ const uint8 m_numCmds = sizeof(m_cmdCtrl)/sizeof(CmdCtrl_t);
 
 /* Misc WIPE functions */
 #define WIPE_FN_PAUSE (KEY_BASE +  8) // Pause execution
+#define WIPE_FN_PAINT (KEY_BASE +  9) // Paint a line on the canvas
+#define WIPE_FN_CODE  (KEY_BASE + 10) // Append an effect script instruction
 
 /* WIPE command not-executed flag
  *  - When bit 8 of the line's statement type byte is set, the line hasn't
@@ -507,7 +710,7 @@ const uint8 m_numCmds = sizeof(m_cmdCtrl)/sizeof(CmdCtrl_t);
 
 #define WIPE_OP_DELIM     16   // , or )  expression list delimiter
 
-#define WIPE_MAX_PARMS     7   // Max # of WIPE function parameters needed
+#define WIPE_MAX_PARMS     8   // Max # of WIPE function parameters needed
 
 
 /*---  Operand kinds  ---*/
@@ -515,16 +718,56 @@ const uint8 m_numCmds = sizeof(m_cmdCtrl)/sizeof(CmdCtrl_t);
 #define WIPE_OPRND_LIT     1   // Literal operand
 #define WIPE_OPRND_ID      2   // Variable identifier operand
 
+/*---  Expression bytecode  ---*/
+// Expressions are compiled into postfix (RPN) bytecode when a statement is
+// parsed, so they don't have to be rescanned each time they're executed.
+// Operator bytecodes are the WIPE_OP_* values (binary operators follow
+// their second operand; unary operators follow their only operand).
+#define WIPE_BC_END     0x00   // End of expression
+#define WIPE_BC_INT8    0x20   // Push literal: <op> <uint8>
+#define WIPE_BC_INT32   0x21   // Push literal: <op> <int32>
+#define WIPE_BC_FLOAT   0x22   // Push literal: <op> <float> <# decimals>
+#define WIPE_BC_VAR     0x23   // Push variable: <op> <sym idx> <NAME> \0
+#define WIPE_STACK_SIZE    4   // Expression evaluation operand stack depth
+#define MAX_LIT_LEN       11   // Max # of characters in a numeric literal
+
 /*---  Tokenized line constants  ---*/
 #define TKNZD_LINE_OFFS    0   // Line # offset from start of tokenized line
 #define TKNZD_LEN_OFFS     1   // Line length offset ...
 #define TKNZD_STMT_OFFS    2   // Statement Id offset ...
+#define MAX_TKNZD_LEN    255   // Max # of bytes in a tokenized line
 
 /*---  Program directory constants  ---*/
 #define MAX_PROGNAME_LEN  12
 #define DIR_LEN_OFFS       0   // Program file length directory entry offset
 #define DIR_NAME_OFFS      2   // Program filename directory entry offset
 #define DIR_PROG_OFFS      (DIR_NAME_OFFS + MAX_PROGNAME_LEN + 1)
+#define MAX_DIR_FILES     32   // Max # of programs in the directory index
+#define PROG_CACHE_NUM     2   // # of MRU programs kept in RAM (0 = none)
+#define PROG_CACHE_SIZE 1024   // Max # of bytes of a cached program
+#define PROG_MAGIC_OFFS    DIR_PROG_OFFS // Flash slot header: directory entry
+#define PROG_HDR_LEN       (PROG_MAGIC_OFFS + 1) //   followed by PROG_MAGIC
+
+/*---  Program image constants  ---*/
+// A program is saved as an image (see wipeImgWrite()): this header, then
+// a string table of the program's identifiers (a count, then NAME \0
+// strings) and the tokenized lines, in which each <sym idx> NAME \0
+// identifier is shrunk to the 1-byte string table index of its NAME.
+// Note: The keyword and misc function ids follow the WASP command codes
+//       (see KEY_BASE), so they move up whenever a command is added. An
+//       image holds them relative to IMG_KEY_BASE instead, which doesn't.
+#define IMG_FORMAT      0xB5   // Format/version tag of a program image
+#define IMG_FMT_OFFS       0   // Format tag offset from start of image
+#define IMG_CRC_OFFS       1   // CRC-16 (of the rest of the image) offset
+#define IMG_LEN_OFFS       3   // Program size (loaded in RAM) offset
+#define IMG_BODY_OFFS      5   // String table offset
+#define IMG_KEY_BASE    0xC0   // Image id of KEY_BASE (see wipeImgKeyPut())
+
+// Programs saved by v5.00 builds before images were introduced are an
+// untagged copy of program memory: their keyword ids are relative to
+// LEGACY_KEY_BASE, and expressions are kept as source text. They're
+// converted when loaded (see wipeLegacyLoad()).
+#define LEGACY_KEY_BASE   25   // KEY_BASE of an untagged program
 
 /*---  Misc Parameters  ---*/
 #define MAX_LINE_NUM     255  // Program line number can't exceed this value.
@@ -551,6 +794,29 @@ typedef struct
 } SymTblEntry_t;
 
 SymTblEntry_t m_symTbl[MAX_NUM_SYMBOLS];
+uint8         m_numSymbols = 0;  // # of symbol table entries in use
+uint8         m_symBase = 0;     // First entry of the current variable frame
+
+/*--  Define WIPE task table  ---*/
+#define MAX_WIPE_TASKS     4  // Max # of programs that can run concurrently
+
+typedef struct
+{
+  uint16  runByte;          // Running offset into program buffer.
+  uint16  runEnd;           // Offset at which the task stops running.
+  uint32  resumeTime;       // Deadline of a pause (0 = not pausing)
+  uint32  cmdExecDelay;     // Deadline of a long-running WASP command
+  uint32  progAddr;         // Flash address of a program streamed from
+                            //   flash (see wipeStreamFetch()); 0 = in RAM
+  uint16  schedFrame;       // Network frame # of its scheduled commands
+  boolean schedOn;          // Scheduling its batchable commands (schedAt())
+  uint8   symBase;          // First entry of the task's variable frame
+  uint8   lineGrowth;       // # bytes a streamed line grew when paged in
+} WipeTask_t;
+
+WipeTask_t m_wipeTasks[MAX_WIPE_TASKS];
+uint8      m_numWipeTasks = 0;  // # of task table entries in use
+uint8      m_currWipeTask = 0;  // Task that most recently ran a statement
 
 
 /*---  Define program memory buffer  ---*/
@@ -561,15 +827,61 @@ SymTblEntry_t m_symTbl[MAX_NUM_SYMBOLS];
 
 uint8 m_program[MAX_PROG_SIZE];
 
+// The lines of programs streamed from flash are paged into a window at the
+// top of program memory, one at a time. It leaves room for an if statement
+// to skip over the following line. Line offsets of the programs' labels are
+// flagged by STREAM_LABEL (see wipeTaskSave()).
+#define STREAM_WIN_POS  (MAX_PROG_SIZE - 2 * MAX_TKNZD_LEN - 1)
+#define STREAM_LABEL    0x8000
+
+uint32  m_streamWinAddr = 0; // Flash address of the line in the window
+uint8   m_streamWinBase = 0; //   and its variable frame (0 = no line)
+
 char    m_tokenBuffer[sizeof(m_consoleBuffer)];
 char    m_autorunProg[MAX_PROGNAME_LEN+1] = "\0";
 uint16  m_wipeProgByte = 0;  // Current byte edit position in program buffer.
 uint16  m_wipeLineStart = 0; // Program buffer line start byte position.
 uint16  m_wipeRunByte = 0;   // Running offset into program buffer.
-uint16  m_wipeDirSpace = 0;  // EEPROM WIPE directory space free (bytes)
+uint16  m_wipeRunEnd = 0;    // Offset at which running stops.
+uint32  m_wipeResumeTime = 0; // Deadline of a pause (0 = not pausing)
+uint32  m_wipeDirSpace = 0;  // WIPE directory space free (bytes)
 uint16  m_wipeSaveAddr = 0;  // First free write byte in EEPROM program space
+
+// RAM index of the program directory (see wipeDirIndexBuild())
+typedef struct
+{
+  uint32  addr;             // Directory entry base address in the store
+  uint16  size;             // Program size (bytes)
+  uint8   hash;             // wipeDirNameHash() of the program name
+} DirIndex_t;
+
+DirIndex_t m_dirIndex[MAX_DIR_FILES];
+uint8      m_dirCount = 0;  // # of m_dirIndex[] entries in use
+
+// Position in a program image being put to or got from the store
+typedef struct
+{
+  uint32  addr;             // Store address of the next byte
+  uint16  len;              // # of bytes put or got so far
+  uint16  limit;            // Bytes can be got while len < limit
+  uint16  crc;              // CRC-16 of the bytes so far
+  boolean write;            // Put bytes in the store (or just count them)?
+} ImgCursor_t;
+
+#if PROG_CACHE_NUM > 0
+// Most recently used programs, kept resident in RAM as loaded from the store
+typedef struct
+{
+  char    name[MAX_PROGNAME_LEN+1];  // Program file name ("" = unused)
+  uint16  size;                      // Program size (bytes)
+  uint16  lastUse;                   // m_progCacheTick when last read
+  uint8   prog[PROG_CACHE_SIZE];
+} ProgCache_t;
+
+ProgCache_t m_progCache[PROG_CACHE_NUM];
+uint16      m_progCacheTick = 0;
+#endif
 uint8   m_exprOffs = 0;      // Current offset into an expression.
-boolean m_breakProg = false; // true = 'x' entered; stop running program.
 
 
 /*------------------------  LED Indicator States  ----------------------------*/
@@ -857,6 +1169,28 @@ boolean cmdHdlrNetReset(void)
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrNetMcast
+//   Enable or disable reliable multicast of group and broadcast commands
+//   (see mcastWrap()), and show how many commands have been resent.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_mcastResends:I
+//   m_mcastOn:O
+//-----------------------------------------------------------------------------
+boolean cmdHdlrNetMcast(void)
+{
+  radioBatchFlush();
+  m_mcastOn = (1 == serialParseInt());
+  logPrint(FLASH("Multicast ["));
+  logPrint(m_mcastOn ? FLASH("ON") : FLASH("off"));
+  logPrint(FLASH("] Resent: "));
+  logPrintln(m_mcastResends);
+  return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: cmdHdlrNetNodeId
 //   Change the configured node ID for a WASP slave node.
@@ -894,7 +1228,7 @@ boolean cmdHdlrNetNodeId(void)
   appendRadioOut8('S');
   appendRadioOut8('P');
   appendRadioOut8(newNodeId);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
+  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
   if (m_verboseWasp)
   {
     logPrint(FLASH("CFG_NODE ->"));
@@ -936,7 +1270,7 @@ boolean cmdHdlrNetLedCtrl(void)
   appendRadioOut8('S');
   appendRadioOut8('P');
   appendRadioOut8(newCtrlPin);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
+  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
   if (m_verboseWasp)
   {
     logPrint(FLASH(" ->CFG_CTRL"));
@@ -984,7 +1318,7 @@ boolean cmdHdlrNetLed(void)
   appendRadioOut8(newLen);
   appendRadioOut8(newFreq);
   appendRadioOut8(newWiring);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
+  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
   if (m_verboseWasp)
   {
     logPrint(FLASH(" ->CFG_LED"));
@@ -996,13 +1330,17 @@ boolean cmdHdlrNetLed(void)
 
 //-----------------------------------------------------------------------------
 // Function: cmdHdlrNetPing
-//   Query the status of a WASP slave node, group, or all nodes.
+//   Query the status of a WASP slave node, group, or all nodes. Once the
+//   replies are in, restore the scene of those that have restarted since it
+//   was set (see mirrorCheck()).
 // Parameters: (none)
 // Returns: true iff command processing has completed.
 // Inputs/Outputs:
 //   m_radioInBuf:I
+//   m_radioInBufLen:I
 //   m_srcNodeId:I
 //   m_radioInBufPos:IO
+//   m_resyncNodes:IO
 //   m_rxWaspRsp:IO
 //   m_radioOutBuf:O
 //   m_radioOutBufPos:O
@@ -1011,9 +1349,11 @@ boolean cmdHdlrNetPing(void)
 {
   static boolean pingInProgress = false;
   static uint32  timeout = 0;
+  static uint8   txId;
   float  swVersion;
   uint8 *buf;
   uint8  dst;
+  uint32 upSecs;
 
   if (!pingInProgress)
   {
@@ -1031,7 +1371,7 @@ boolean cmdHdlrNetPing(void)
     pingInProgress = true;
     m_radioOutBufPos = 0;
     appendRadioOut8(WASPCMD_PING);
-    (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
+    txId = radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
     timeout = millis() + PING_TIMEOUT;
     if (m_verboseWasp)
     {
@@ -1043,10 +1383,18 @@ boolean cmdHdlrNetPing(void)
   else
   {
     /* Process responses to previously transmitted WASPCMD_PING */
-    if (millis() >= timeout)
+    if (!radioTxSent(txId))
+      timeout = millis() + PING_TIMEOUT;  // Time the replies from the send
+    if ((int32)(millis() - timeout) >= 0)
     {
       pingInProgress = false;
       logPrintln(FLASH("=> PING done"));
+      for (uint8 i = 0; i < MAX_SLAVES; i++)
+      {
+        if (m_resyncNodes & (1 << i))
+          mirrorResync(i);
+      }
+      m_resyncNodes = 0;
       return true;
     }
     else
@@ -1073,7 +1421,17 @@ boolean cmdHdlrNetPing(void)
           logPrint(*buf++);
           logPrint(FLASH("00kHz, LED order #"));
           logPrint(*buf++);
-          logPrintln(FLASH(")"));
+          logPrint(FLASH(")"));
+          if (m_radioInBufLen >= 12)
+          {
+            upSecs = (uint32)buf[0] | ((uint32)buf[1] << 8) |
+                     ((uint32)buf[2] << 16) | ((uint32)buf[3] << 24);
+            logPrint(FLASH("  Up: "));
+            logPrint(upSecs);
+            logPrint(FLASH("s"));
+            mirrorCheck(m_srcNodeId, upSecs);
+          }
+          logPrintln();
         }
         else
         {
@@ -1090,6 +1448,126 @@ boolean cmdHdlrNetPing(void)
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrNetPerf
+//   Query the execution timing statistics of a timer on a WASP slave node,
+//   group, or all nodes.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_srcNodeId:I
+//   m_radioInBufPos:IO
+//   m_rxWaspRsp:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//-----------------------------------------------------------------------------
+boolean cmdHdlrNetPerf(void)
+{
+  static boolean queryInProgress = false;
+  static uint32  timeout = 0;
+  static uint8   txId;
+  uint8 *buf;
+  uint8  dst;
+  uint8  timerId;
+  uint8  reset;
+  uint16 count;
+  uint32 minTime;
+  uint32 maxTime;
+  uint32 sumTime;
+
+  if (!queryInProgress)
+  {
+    /* Process a new command line */
+    dst     = serialParseInt();
+    timerId = serialParseInt();
+    reset   = serialParseInt();
+
+    if (   (BROADCASTID != dst)
+        && ( (dst < FIRST_SLAVE) || (dst >= (FIRST_SLAVE + MAX_SLAVES)) )
+        && ( (dst < FIRST_GROUP) || (dst >= (FIRST_GROUP + MAX_GROUPS)) )
+       )  {
+      logPrintln(FLASH("***Invalid destination specified"));
+      return true;
+    }
+
+    queryInProgress = true;
+    m_radioOutBufPos = 0;
+    appendRadioOut8(WASPCMD_TMR_STATS);
+    appendRadioOut8(timerId);
+    appendRadioOut8(reset == 1 ? TMR_STATS_RESET : 0);
+    txId = radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
+    timeout = millis() + PING_TIMEOUT;
+    if (m_verboseWasp)
+    {
+      logPrint(FLASH(" ->TMR_STATS"));
+      logPrintln(dst);
+    }
+    logPrintln(FLASH("Node\tTimer\tcount\tmin\tmean\tmax\t"
+                     "histogram (usec: <32, <64, ...)"));
+    return false;
+  }
+
+  /* Process responses to previously transmitted WASPCMD_TMR_STATS */
+  if (!radioTxSent(txId))
+    timeout = millis() + PING_TIMEOUT;  // Time the replies from the send
+  if ((int32)(millis() - timeout) >= 0)
+  {
+    queryInProgress = false;
+    logPrintln(FLASH("=> TMR_STATS done"));
+    return true;
+  }
+  if (WASPCMD_TMR_STATS == m_rxWaspRsp)
+  {
+    buf = &m_radioInBuf[m_radioInBufPos];
+    timerId = *buf++;
+    memcpy(&count, buf, 2);
+    buf += 2;
+    memcpy(&minTime, buf, 4);
+    buf += 4;
+    memcpy(&maxTime, buf, 4);
+    buf += 4;
+    memcpy(&sumTime, buf, 4);
+    buf += 4;
+
+    logPrint(m_srcNodeId);
+    logPrint(FLASH("\t"));
+    logPrint(timerId);
+    logPrint(FLASH("\t"));
+    logPrint(count);
+    logPrint(FLASH("\t"));
+    if (count != 0)
+    {
+      logPrint(minTime);
+      logPrint(FLASH("\t"));
+      logPrint(sumTime / count);
+    }
+    else
+    {
+      logPrint(FLASH("-\t-"));
+    }
+    logPrint(FLASH("\t"));
+    logPrint(maxTime);
+    for (uint8 i = 0; i < TMR_HIST_BUCKETS; i++)
+    {
+      logPrint(i == 0 ? FLASH("\t") : FLASH(","));
+      logPrint(*buf++);
+    }
+    logPrintln();
+  }
+  else if (WASPCMD_NONE != m_rxWaspRsp)
+  {
+    logPrint(FLASH("Node #"));
+    logPrint(m_srcNodeId);
+    logPrint(FLASH("==>  *** bad response ["));
+    logPrint(m_rxWaspRsp);
+    logPrintln(FLASH("]"));
+    m_rxWaspRsp = WASPCMD_NONE;
+  }
+  return false;
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: cmdHdlrNetSave
 //   Request a WASP slave, group, or all slave to save their configuration
@@ -1116,7 +1594,7 @@ boolean cmdHdlrNetSave(void)
 
   m_radioOutBufPos = 0;
   appendRadioOut8(WASPCMD_CFG_SAVE);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
+  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
   if (m_verboseWasp)
   {
     logPrint(FLASH(" ->CFG_SAVE"));
@@ -1126,6 +1604,110 @@ boolean cmdHdlrNetSave(void)
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrNetScene
+//   Show the scene mirrored for a WASP slave, or all slaves (see
+//   mirrorUpdate()). The slaves aren't queried.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_mirror:I
+//-----------------------------------------------------------------------------
+boolean cmdHdlrNetScene(void)
+{
+  SceneMirror_t *pMirror;
+  uint8 dst;
+
+  dst = serialParseInt();
+  if (   (BROADCASTID != dst)
+      && ( (dst < FIRST_SLAVE) || (dst >= (FIRST_SLAVE + MAX_SLAVES)) ) )
+  {
+    logPrintln(FLASH("***Invalid destination specified"));
+    return true;
+  }
+
+  for (uint8 i = 0; i < MAX_SLAVES; i++)
+  {
+    if ( (BROADCASTID != dst) && (dst != (FIRST_SLAVE + i)) )
+      continue;
+    pMirror = &m_mirror[i];
+    logPrint(FLASH("Node #"));
+    logPrint(FIRST_SLAVE + i);
+    if (0 == pMirror->updTime)
+    {
+      logPrintln(FLASH("==>  (no scene)"));
+      continue;
+    }
+    logPrint(FLASH("==>  Set "));
+    logPrint((millis() - pMirror->updTime) / 1000);
+    logPrintln(FLASH("s ago"));
+    mirrorShowCmd(FLASH("  Group:  "), pMirror->group);
+    mirrorShowCmd(FLASH("  Bright: "), pMirror->bright);
+    mirrorShowCmd(FLASH("  Saved:  "), pMirror->saved);
+    mirrorShowCmd(FLASH("  Base:   "), pMirror->base);
+    mirrorShowCmd(FLASH("  FX:     "), pMirror->fx);
+    mirrorShowCmd(FLASH("  Speed:  "), pMirror->speed);
+    if (pMirror->detail)
+      logPrintln(FLASH("  (drawn over since the base was set)"));
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrNetStats
+//   Collect telemetry from a WASP slave, group, or all slaves and,
+//   optionally, keep collecting it periodically while a WIPE program runs.
+//   The replies are shown by telemetryPoll().
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_telemDst:O
+//   m_telemNext:O
+//   m_telemPeriod:O
+//-----------------------------------------------------------------------------
+boolean cmdHdlrNetStats(void)
+{
+  uint8 dst;
+
+  dst = serialParseInt();
+
+  if (   (BROADCASTID != dst)
+      && ( (dst < FIRST_SLAVE) || (dst >= (FIRST_SLAVE + MAX_SLAVES)) )
+      && ( (dst < FIRST_GROUP) || (dst >= (FIRST_GROUP + MAX_GROUPS)) )
+     )  {
+    logPrintln(FLASH("***Invalid destination specified"));
+    return true;
+  }
+
+  m_telemDst    = dst;
+  m_telemPeriod = serialParseInt();
+  m_telemNext   = millis() + (uint32)m_telemPeriod * 1000;
+  telemetryStart();
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrNetSync
+//   Change the time-sync beacon period, sending a beacon now if enabled.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_syncNext:O
+//   m_syncPeriod:O
+//-----------------------------------------------------------------------------
+boolean cmdHdlrNetSync(void)
+{
+  m_syncPeriod = serialParseInt();
+  m_syncNext = millis();
+  logPrint(FLASH("Sync period ["));
+  logPrint((uint16)m_syncPeriod * 100);
+  logPrintln(FLASH("ms]"));
+  return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: cmdHdlrHelp
 //   Display the serial console port command syntax and synopses.
@@ -1174,15 +1756,34 @@ boolean cmdHdlrHelp(void)
   logPrint(FLASH("  netLedCtrl n, m"));
       logPrintln(FLASH("\t- Change the control pin for the LED pixel"));
       logPrintln(FLASH("\t\t\t  strip of slave n to digital output pin #m"));
+  logPrint(FLASH("  netMcast n"));
+      logPrintln(FLASH("\t\t- Send group and broadcast commands in sequence,"));
+      logPrintln(FLASH("\t\t\t  resending those slaves missed (n=1), or"));
+      logPrintln(FLASH("\t\t\t  just once (n=0)."));
   logPrint(FLASH("  netNodeId n, m"));
       logPrintln(FLASH("\t- Change the nodeid for slave n to m"));
+  logPrint(FLASH("  netPerf n, t [,r]"));
+      logPrintln(FLASH("\t- Query the timing statistics of timer t on"));
+      logPrintln(FLASH("\t\t\t  a WASP slave, group, or all. Reset them"));
+      logPrintln(FLASH("\t\t\t  afterward if r=1."));
   logPrint(FLASH("  netPing n"));
-      logPrintln(FLASH("\t\t- Query a WASP slave, group, or all"));
+      logPrintln(FLASH("\t\t- Query a WASP slave, group, or all. Restore"));
+      logPrintln(FLASH("\t\t\t  the scene of any that have restarted."));
   logPrint(FLASH("  netReset n"));
       logPrintln(FLASH("\t\t- Reset WASP slave, group, or all."));
   logPrint(FLASH("  netSave n"));
       logPrintln(FLASH("\t\t- Request a WASP slave, group, or all node to"));
       logPrintln(FLASH("\t\t\t  save their configuration settings to EEPROM"));
+  logPrint(FLASH("  netScene n"));
+      logPrintln(FLASH("\t\t- Show the scene last sent to a WASP slave, or"));
+      logPrintln(FLASH("\t\t\t  all, without querying it."));
+  logPrint(FLASH("  netStats n [,p]"));
+      logPrintln(FLASH("\t- Collect telemetry from a WASP slave, group, or"));
+      logPrintln(FLASH("\t\t\t  all. Repeat every p seconds while a WIPE"));
+      logPrintln(FLASH("\t\t\t  program runs (p=0 to stop)."));
+  logPrint(FLASH("  netSync p"));
+      logPrintln(FLASH("\t\t- Broadcast a time-sync beacon every p*100ms"));
+      logPrintln(FLASH("\t\t\t  (p=0 to stop)."));
 
   CheckRam();
 
@@ -1447,6 +2048,7 @@ void processCommandLine()
 //   m_rxWaspRsp:O
 //   m_radioBuf:O
 //   m_radioBufPos:O
+//   m_radioInBufLen:O
 //   m_srcNodeId:O
 //-----------------------------------------------------------------------------
 void receiveRadioWaspRsp(void)
@@ -1462,6 +2064,7 @@ void receiveRadioWaspRsp(void)
     {
       m_ackRequested = m_radio.ACK_REQUESTED;
       memcpy(m_radioInBuf, (const void *)&m_radio.DATA[0], m_radio.DATALEN);
+      m_radioInBufLen = m_radio.DATALEN;
       m_radioInBufPos = 0;
       waspRsp = m_radioInBuf[m_radioInBufPos++];
       if (waspRsp > MAX_WASPCMD_VAL)
@@ -1470,6 +2073,15 @@ void receiveRadioWaspRsp(void)
         dbgPrintln(waspRsp);
         waspRsp = WASPCMD_NONE;
       }
+      else if (WASPCMD_NACK == waspRsp)
+      {
+        // Not a response to any command; no one waits for it.
+        if ( (m_radio.DATALEN >= 5) && (WASPCMD_PIXELS == m_radioInBuf[4]) )
+          pixelsNacked(m_radioInBuf[1]);
+        else if (m_radio.DATALEN >= 4)
+          mcastNacked(m_radioInBuf[1], m_radioInBuf[2], m_radioInBuf[3]);
+        waspRsp = WASPCMD_NONE;
+      }
       else
       {
         dbgPrint(FLASH("Rx Rsp["));
@@ -1491,3623 +2103,7263 @@ void receiveRadioWaspRsp(void)
 
 
 //-----------------------------------------------------------------------------
-// Function: radioSendBuf
-//   Send a WASP command.
+// Function: radioTxReady
+//   Check whether the radio Tx queue has room for another WASP command.
+// Parameters: (none)
+// Returns: true iff a command can be sent without waiting.
+// Inputs/Outputs:
+//   m_txCount:I
+//-----------------------------------------------------------------------------
+inline boolean radioTxReady(void)
+{
+  return (m_txCount < TX_QUEUE_LEN);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: radioDstSlaves
+//   Determine which slaves are addressed by a WASP destination.
 // Parameters:
-//   dst:I         - Destination node ID; Use BROADCASTID for a broadcast
-//                   command.
-//   pPayload:I    - Pointer to the payload buffer.
-//   payloadLen:I  - Number of bytes to send from the payload buffer.
-//   reqAck:I      - TRUE = an ACK is requested.
-// Returns: ACK value (e.g. ACK_OK); see WASP_defs.h
+//   dst:I  - Destination node ID, group ID, or BROADCASTID.
+// Returns: Bit mask with bit i set iff slave (FIRST_SLAVE + i) is addressed.
+//          A group with no known members (see setGroup()) is taken to
+//          address all slaves.
 // Inputs/Outputs:
-//   m_radio:I
+//   m_nodeGroup:I
 //-----------------------------------------------------------------------------
-uint8 radioSendBuf(uint8 dst, uint8 *pPayload, uint8 payloadLen, boolean reqAck)
+uint16 radioDstSlaves(uint8 dst)
 {
-  static uint32 lastTxTime = 0;
-  
-  // Don't allow transmissions to be too close together.
-  while ( (millis() - lastTxTime) < MIN_UPD_PERIOD )
-    ;
-  
-  dbgPrint(FLASH("TX Dst["));
-  dbgPrint(dst);
-  dbgPrint(FLASH("] Size["));
-  dbgPrint(payloadLen);
-  dbgPrint(FLASH("] Cmd["));
-  dbgPrint(pPayload[0]);
-  dbgPrintln(FLASH("]"));
-  
-  for (uint8 i = TX_NUM_RETRIES + 1; i != 0; i--)
+  uint16 mask = 0;
+
+  if ( (dst >= FIRST_SLAVE) && (dst < (FIRST_SLAVE + MAX_SLAVES)) )
+    return (1 << (dst - FIRST_SLAVE));
+
+  if ( (dst >= FIRST_GROUP) && (dst < (FIRST_GROUP + MAX_GROUPS)) )
   {
-    m_radio.send(dst, pPayload, payloadLen, reqAck);
-    lastTxTime = millis();
-    if (reqAck)
+    for (uint8 i = 0; i < MAX_SLAVES; i++)
     {
-      while ( (millis() - lastTxTime) < ACK_WAIT_TIME )
-      {
-        if (m_radio.ACKReceived(dst))
-        {
-          return m_radio.DATA[0];
-        }
-      }
-    }
-    else
-    {
-      return ACK_OK;
+      if (m_nodeGroup[i] == dst)
+        mask |= (1 << i);
     }
   }
-  
-  return ACK_ETIME;
+  if ( (0 == mask) && (dst != CONTROLLERID) && (dst != PROG_GW_ID) )
+    mask = (1 << MAX_SLAVES) - 1;
+  return mask;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: appendRadioOut8
-//   Append a byte to the radio output buffer.
+// Function: radioSendFrame
+//   Transmit a frame, accounting for it in the WIPE run statistics.
 // Parameters:
-//   value:I  - The byte value to append..
+//   dst:I     - Destination node ID, group ID, or BROADCASTID.
+//   buf:I     - The frame's payload.
+//   len:I     - # of bytes in the payload.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_radio:I
+//   m_runAirUs:IO
+//   m_runTxBytes:IO
+//   m_runTxFrames:IO
 //-----------------------------------------------------------------------------
-inline void appendRadioOut8(uint8 value)
+void radioSendFrame(uint8 dst, const uint8 *buf, uint8 len)
 {
-  m_radioOutBuf[m_radioOutBufPos++] = value;
+  m_radio.send(dst, buf, len, false);
+  m_runTxFrames++;
+  m_runTxBytes += len;
+  m_runAirUs += ((uint32)(len + RADIO_FRAME_OVHD) * 8 * 1000000UL) /
+                RADIO_BITRATE;
 }
 
 
-
-
-/*****************************************************************************
- *  SECTION  *************  WASP Command Handling  ***************************
- *****************************************************************************/
-
 //-----------------------------------------------------------------------------
-// Function: setGroup
-//   Notify a node what are its left and right neighbours.
-// Parameters:
-//   dst:I      - The WASP slave destination. This must be a single WASP
-//                slave node ID.
-//   groupId:I  - Identifies the group of WASP slaves in which the destination
-//                node belongs. The value must be in the range FIRST_GROUP ..
-//                (FIRST_GROUP + MAX_GROUPS - 1). Singleton groups are
-//                permitted. The number of members in a group is limited only
-//                by the number of supported slaves (MAX_SLAVES).
-//   left:I     - Node ID of left neighbour.
-//   right:I    - Node ID of right neighbour.
+// Function: radioTxPoll
+//   Drain the radio Tx queue. Each queued command is sent as soon as the
+//   slaves it addresses have had the time they need (normally
+//   MIN_UPD_PERIOD) since their last command, and no earlier queued command
+//   for any of them is still outstanding. Commands for other slaves can
+//   therefore be sent back-to-back.
+// Parameters: (none)
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_radio:I
+//   m_nodeBusyMs:IO
+//   m_nodeTxTime:IO
+//   m_txCount:IO
+//   m_txHead:IO
+//   m_txQueue:IO
 //-----------------------------------------------------------------------------
-void setGroup(uint8 dst, uint8 groupId, uint8 left, uint8 right)
+void radioTxPoll(void)
 {
-  m_radioOutBufPos = 0;
-  if (BROADCASTID == dst)
-  {
-    logPrint(FLASH("NEIGH: Bad dst="));
-    logPrintln(dst);
-  }
-  else
+  TxEntry_t *pEntry;
+  uint32     now;
+  uint16     blocked = 0;  // Slaves with an earlier command outstanding
+  uint16     mask;
+  boolean    ready;
+  uint8      idx;
+
+  now = millis();
+  for (uint8 k = 0; k < m_txCount; k++)
   {
-    appendRadioOut8(WASPCMD_GROUP);
-    appendRadioOut8(groupId);
-    appendRadioOut8(left);
-    appendRadioOut8(right);
-    (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-    if (m_verboseWasp)
+    idx = (m_txHead + k) % TX_QUEUE_LEN;
+    pEntry = &m_txQueue[idx];
+    if (pEntry->state != TXQ_PENDING)
+      continue;
+
+    mask = radioDstSlaves(pEntry->dst);
+    ready = ((mask & blocked) == 0);
+    for (uint8 i = 0; ready && (i < MAX_SLAVES); i++)
     {
-      logPrint(FLASH("NEIGH ->"));
-      logPrint(dst);
-      logPrint(" ");
-      logPrint(left);
-      logPrint(" ");
-      logPrintln(right);
+      if ( (mask & (1 << i)) &&
+           ((now - m_nodeTxTime[i]) < m_nodeBusyMs[i]) )
+        ready = false;
+    }
+    blocked |= mask;
+    if (!ready)
+      continue;
+
+    dbgPrint(FLASH("TX Dst["));
+    dbgPrint(pEntry->dst);
+    dbgPrint(FLASH("] Size["));
+    dbgPrint(pEntry->len);
+    dbgPrint(FLASH("] Cmd["));
+    dbgPrint(pEntry->payload[0]);
+    dbgPrintln(FLASH("]"));
+
+    if (WASPCMD_SYNC == pEntry->payload[0])
+      syncStamp(pEntry->payload);
+    radioSendFrame(pEntry->dst, pEntry->payload, pEntry->len);
+    now = millis();
+    for (uint8 i = 0; i < MAX_SLAVES; i++)
+    {
+      if (mask & (1 << i))
+      {
+        m_nodeTxTime[i] = now;
+        m_nodeBusyMs[i] = pEntry->busyMs;
+      }
     }
+    pEntry->state = TXQ_DONE;
+  }
+
+  // Retire the entries that are done from the head of the queue.
+  while ( (m_txCount != 0) && (TXQ_DONE == m_txQueue[m_txHead].state) )
+  {
+    m_txHead = (m_txHead + 1) % TX_QUEUE_LEN;
+    m_txCount--;
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: background
-//   Set the colour for all pixels in the strip(s) specified by the WASP
-//   destination address.
+// Function: radioTxSent
+//   Check whether a queued command has been transmitted.
 // Parameters:
-//   dst:I  - The WASP slave destination. This is either a single WASP
-//            slave node ID or BROADCASTID to set the pixel colours
-//            on all LED strips.
-//   r:I    - Amount of red.
-//   g:I    - Amount of green.
-//   b:I    - Amount of blue.
-// Returns: (none)
+//   id:I  - The command's Tx id, as returned by radioSendBuf().
+// Returns: true iff the command is no longer waiting in the Tx queue.
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_txCount:I
+//   m_txHead:I
+//   m_txQueue:I
 //-----------------------------------------------------------------------------
-void background(uint8 dst, uint8 r, uint8 g, uint8 b)
+boolean radioTxSent(uint8 id)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_BKGRD);
-  appendRadioOut8(r);
-  appendRadioOut8(g);
-  appendRadioOut8(b);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
+  TxEntry_t *pEntry;
+
+  for (uint8 k = 0; k < m_txCount; k++)
   {
-    logPrint(FLASH("BKGRD ->"));
-    logPrint(dst);
-    logPrint(" ");
-    logPrint(r);
-    logPrint(" ");
-    logPrint(g);
-    logPrint(" ");
-    logPrintln(b);
+    pEntry = &m_txQueue[(m_txHead + k) % TX_QUEUE_LEN];
+    if ( (pEntry->id == id) && (TXQ_PENDING == pEntry->state) )
+      return false;
   }
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: setState
-//   Send a state operation command to the WASP destination address.
+// Function: mcastStream
+//   Determine the multicast stream of a WASP destination.
 // Parameters:
-//   dst:I  - The WASP slave destination. This is either a single WASP
-//            slave node ID or BROADCASTID to set the pixel colours
-//            on all LED strips.
-//   opt:I  - The state flags value.
-// Returns: (none)
-// Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   dst:I  - Destination node ID, group ID, or BROADCASTID.
+// Returns: The stream index, or MCAST_NONE if dst isn't a group or
+//          BROADCASTID.
+// Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-void setState(uint8 dst, uint8 opt)
+inline uint8 mcastStream(uint8 dst)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_STATE);
-  appendRadioOut8(opt);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
-  {
-    logPrint(FLASH("STATE ->"));
-    logPrint(dst);
-    logPrint(" ");
-    logPrintln(opt);
-  }
+  if (BROADCASTID == dst)
+    return 0;
+  if ( (dst >= FIRST_GROUP) && (dst < (FIRST_GROUP + MAX_GROUPS)) )
+    return (1 + dst - FIRST_GROUP);
+  return MCAST_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: line
-//   Draw a line of pixels in the strip(s) specified by the WASP
-//   destination address.
+// Function: mcastWrap
+//   Wrap a queued command for a group or all slaves in a WASPCMD_MCAST
+//   command, numbered in sequence with the others sent to its destination,
+//   and record it so that it can be resent if a slave misses it (see
+//   mcastNacked()).
 // Parameters:
-//   dst:I    - The WASP slave destination. This is either a single WASP
-//              slave node ID or BROADCASTID to set the pixel colours
-//              on all LED strips.
-//   start:I  - The starting pixel number for the line. (Zero indicates the
-//              first pixel.)
-//   len:I    - The line length (in number of pixels).
-//   r:I      - Amount of red.
-//   g:I      - Amount of green.
-//   b:I      - Amount of blue.
+//   pEntry:IO  - The queued command. It must have room for MCAST_HDR_LEN
+//                more bytes.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_mcastHist:O
+//   m_mcastTail:O
+//   m_mcastHistNext:IO
+//   m_mcastSeq:IO
+//   m_mcastStarted:IO
 //-----------------------------------------------------------------------------
-void line(uint8 dst, uint8 start, uint8 len, uint8 r, uint8 g, uint8 b)
+void mcastWrap(TxEntry_t *pEntry)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_LINE);
-  appendRadioOut8(start);
-  appendRadioOut8(len);
-  appendRadioOut8(r);
-  appendRadioOut8(g);
-  appendRadioOut8(b);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
-  {
-    logPrint(FLASH("LINE ->"));
-    logPrintln(dst);
-  }
+  McastEntry_t *pHist;
+  uint8         stream;
+
+  stream = mcastStream(pEntry->dst);
+  memmove(&pEntry->payload[MCAST_HDR_LEN], pEntry->payload, pEntry->len);
+  pEntry->payload[0] = WASPCMD_MCAST;
+  pEntry->payload[1] = (m_mcastStarted & (1 << stream) ? 0 : MCAST_F_RESYNC);
+  pEntry->payload[2] = m_mcastSeq[stream]++;
+  pEntry->len += MCAST_HDR_LEN;
+  m_mcastStarted |= (1 << stream);
+  m_mcastTail = MCAST_TAIL_BEACONS;
+
+  pHist = &m_mcastHist[m_mcastHistNext];
+  m_mcastHistNext = (m_mcastHistNext + 1) % MCAST_HIST_LEN;
+  pHist->dst = pEntry->dst;
+  pHist->len = pEntry->len;
+  pHist->resendTime = millis() - CMD_TIMEOUT;
+  memcpy(pHist->payload, pEntry->payload, pEntry->len);
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: shift
-//   Shift the pixels in the strip(s) specified by the WASP destination
-//   address.
+// Function: radioSendBuf
+//   Queue a WASP command for transmission by radioTxPoll(), and send it
+//   now if its destination is ready for it.
 // Parameters:
-//   dst:I  - The WASP slave destination. This is either a single WASP
-//            slave node ID or BROADCASTID to set the pixel colours
-//            on all LED strips.
-//   num:I  - Number of pixels to shift. Positive numbers shift right;
-//            begative numbers shift left.
-// Returns: (none)
+//   dst:I         - Destination node ID; Use BROADCASTID for a broadcast
+//                   command.
+//   pPayload:I    - Pointer to the payload buffer.
+//   payloadLen:I  - Number of bytes to send from the payload buffer.
+//   busyMs:I      - Milliseconds before the destination slaves can be sent
+//                   another command (normally MIN_UPD_PERIOD).
+// Returns: The command's Tx id; a reply timeout should be started once
+//          radioTxSent() reports it has been transmitted.
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_cmdExecDelay:0
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_txCount:IO
+//   m_txHead:I
+//   m_txNextId:IO
+//   m_mcastOn:I
+//   m_txQueue:O
+//   m_pixResend:O
+//   m_shadowValid:O
+// Note:
+//   If the queue is full, this waits (without handling any radio input)
+//   until the oldest entry can be retired. While reliable multicast is on,
+//   a command for a group or all slaves that needs no response (see
+//   WASP_MCASTABLE()) is sent as a WASPCMD_MCAST command, if it fits.
 //-----------------------------------------------------------------------------
-void shift(uint8 dst, uint8 num)
+uint8 radioSendBuf(uint8 dst, uint8 *pPayload, uint8 payloadLen, uint16 busyMs)
 {
-  const uint16 k_respDelay = CMD_TIMEOUT + 0;
-  const uint16 k_minDelay = (k_respDelay > MIN_UPD_PERIOD ?
-                             k_respDelay : MIN_UPD_PERIOD);
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_SHIFT);
-  appendRadioOut8(num);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  m_cmdExecDelay = millis() + k_minDelay;
-  if (m_verboseWasp)
+  TxEntry_t *pEntry;
+
+  // A running WIPE program waits for radioTxReady() instead, so this seldom
+  // spins.
+  while (!radioTxReady())
+    radioTxPoll();
+
+  // Other commands may alter the pixels behind the canvas shadow.
+  if ( (pPayload[0] != WASPCMD_PIXELS) && !KEEPS_PIXELS(pPayload[0]) )
   {
-    logPrint(FLASH("SHIFT ->"));
-    logPrint(dst);
-    logPrint("  ");
-    logPrintln(num);
+    m_shadowValid = false;
+    m_pixResend = false;
+  }
+
+  pEntry = &m_txQueue[(m_txHead + m_txCount) % TX_QUEUE_LEN];
+  pEntry->state = TXQ_PENDING;
+  pEntry->id = m_txNextId++;
+  pEntry->dst = dst;
+  pEntry->len = payloadLen;
+  pEntry->busyMs = busyMs;
+  memcpy(pEntry->payload, pPayload, payloadLen);
+  if ( m_mcastOn && WASP_MCASTABLE(pPayload[0]) &&
+       (mcastStream(dst) != MCAST_NONE) &&
+       ((payloadLen + MCAST_HDR_LEN) <= RF69_MAX_DATA_LEN) )
+  {
+    mcastWrap(pEntry);
   }
+  m_txCount++;
+
+  radioTxPoll();
+  return pEntry->id;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: swap
-//   Change the colour of every pixel having a specified colour to a new
-//   colour in the strip(s) specified by the WASP destination
-//   address.
+// Function: mcastNacked
+//   Resend the MCAST commands that a slave reports it has missed. Each is
+//   resent at most once per CMD_TIMEOUT, however many slaves missed it.
 // Parameters:
-//   dst:I    - The WASP slave destination. This is either a single WASP
-//              slave node ID or BROADCASTID to change the pixel colours
-//              on all LED strips.
-//   old_r:I  - Amount of red in colour to be changed.
-//   old_g:I  - Amount of green in colour to be changed.
-//   old_b:I  - Amount of blue in colour to be changed.
-//   r:I      - Amount of red in new colour.
-//   g:I      - Amount of green in new colour.
-//   b:I      - Amount of blue in new colour.
+//   dst:I    - Destination (stream) of the missed commands.
+//   first:I  - seq of the first missed command.
+//   last:I   - seq of the last missed command.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_srcNodeId:I
+//   m_mcastHist:IO
+//   m_mcastResends:IO
 //-----------------------------------------------------------------------------
-void swap( uint8 dst,
-           uint8 old_r, uint8 old_g, uint8 old_b,
-           uint8 r,     uint8 g,     uint8 b )
+void mcastNacked(uint8 dst, uint8 first, uint8 last)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_SWAP);
-  appendRadioOut8(old_r);
-  appendRadioOut8(old_g);
-  appendRadioOut8(old_b);
-  appendRadioOut8(r);
-  appendRadioOut8(g);
-  appendRadioOut8(b);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
+  McastEntry_t *pHist;
+  uint8         seq = first;
+  uint8         i;
+
+  for (uint8 n = 0; n < MCAST_HIST_LEN; n++, seq++)
   {
-    logPrint(FLASH("SWAP ->"));
-    logPrintln(dst);
+    pHist = NULL;
+    for (i = 0; i < MCAST_HIST_LEN; i++)
+    {
+      if ( (m_mcastHist[i].dst == dst) && (m_mcastHist[i].payload[2] == seq) )
+        pHist = &m_mcastHist[i];
+    }
+    if (NULL == pHist)
+    {
+      logPrint(FLASH("***MCAST: Can't resend "));
+      logPrint(seq);
+      logPrint(FLASH(" to "));
+      logPrint(dst);
+      logPrint(FLASH(" for "));
+      logPrintln(m_srcNodeId);
+    }
+    else if ((millis() - pHist->resendTime) >= CMD_TIMEOUT)
+    {
+      // Anyone that gets it after a restart of the sequence has seen the
+      // first of the stream already.
+      pHist->payload[1] &= ~MCAST_F_RESYNC;
+      pHist->resendTime = millis();
+      m_mcastResends++;
+      (void)radioSendBuf(dst, pHist->payload, pHist->len, MIN_UPD_PERIOD);
+    }
+    if (seq == last)
+      break;
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspReset
-//   Reset the destination node(s).
-// Parameters:
-//   dst:I    - The WASP slave destination(s). This is either a single WASP
-//              slave node ID or BROADCASTID.
+// Function: radioBatchFlush
+//   Send the pending batch of WASP commands, if any. An unscheduled batch of
+//   one is sent as a regular command.
+// Parameters: (none)
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_batchBuf:I
+//   m_batchDst:I
+//   m_batchPos:IO
 //-----------------------------------------------------------------------------
-void waspReset(uint8 dst)
+void radioBatchFlush(void)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_RESET);
-  appendRadioOut8('D');
-  appendRadioOut8('E');
-  appendRadioOut8('A');
-  appendRadioOut8('D');
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
-  {
-    logPrint(FLASH("RESET ->"));
-    logPrintln(dst);
-  }
+  if (0 == m_batchPos)
+    return;
+  if ( (WASPCMD_BATCH == m_batchBuf[0]) && (1 == m_batchBuf[1]) )
+    (void)radioSendBuf(m_batchDst, &m_batchBuf[2], m_batchPos - 2,
+                       MIN_UPD_PERIOD);
+  else
+    (void)radioSendBuf(m_batchDst, m_batchBuf, m_batchPos, MIN_UPD_PERIOD);
+  m_batchPos = 0;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: fxSpeed
-//   Adjust the speed of an animated effect that runs on the destination
-//   node(s) without controller intervention (e.g. RAINBOW()).
+// Function: radioSendCmd
+//   Send the WASP command in the radio output buffer. Consecutive commands
+//   for the same destination that can be batched (see WASP_BATCHABLE()) are
+//   coalesced into a single WASPCMD_BATCH command, which is sent once
+//   radioBatchFlush() is called or the batch is full. While scheduling is
+//   on (see schedAt()), they're coalesced into a WASPCMD_AT command for the
+//   scheduled frame instead; other commands are still sent right away.
+//   Each command is recorded in the scene mirror (see mirrorUpdate()).
 // Parameters:
-//   dst:I       - The WASP slave destination. This is either a single WASP
-//                 slave node ID or BROADCASTID to change the pixel colours
-//                 on all LED strips.
-//   delayVal:I  - Relative delay. Smaller values increase the effect's
-//                 speed. However, a value of 0 pauses the effect.
+//   dst:I  - Destination node ID; Use BROADCASTID for a broadcast command.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
-//-----------------------------------------------------------------------------
-void fxSpeed( uint8 dst, uint8 delayVal )
+//   m_radioOutBuf:I
+//   m_radioOutBufPos:I
+//   m_schedFrame:I
+//   m_schedOn:I
+//   m_batchBuf:IO
+//   m_batchDst:IO
+//   m_batchHdrLen:IO
+//   m_batchPos:IO
+//   m_mirror:IO
+//-----------------------------------------------------------------------------
+void radioSendCmd(uint8 dst)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_SPEED);
-  appendRadioOut8(delayVal);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
+  uint8 batchCmd = (m_schedOn ? WASPCMD_AT : WASPCMD_BATCH);
+  uint8 maxLen = (m_schedOn ? SCHED_MAX_LEN + 3 : RF69_MAX_DATA_LEN);
+
+  mirrorUpdate(dst, m_radioOutBuf);
+
+  // Leave room to send the batch as a WASPCMD_MCAST command
+  if ( !m_schedOn && m_mcastOn && (mcastStream(dst) != MCAST_NONE) )
+    maxLen -= MCAST_HDR_LEN;
+
+  if (!WASP_BATCHABLE(m_radioOutBuf[0]))
   {
-    logPrint(FLASH("SPEED ->"));
-    logPrint(dst);
-    logPrint("  ");
-    logPrintln(delayVal);
+    radioBatchFlush();
+    (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, MIN_UPD_PERIOD);
+    return;
+  }
+
+  if ( (m_batchPos != 0) &&
+       ( (dst != m_batchDst) ||
+         (batchCmd != m_batchBuf[0]) ||
+         ( m_schedOn &&
+           ((m_batchBuf[1] | (m_batchBuf[2] << 8)) != m_schedFrame) ) ||
+         ((m_batchPos + m_radioOutBufPos) > maxLen) )
+     )
+  {
+    radioBatchFlush();
+  }
+  if (0 == m_batchPos)
+  {
+    m_batchBuf[m_batchPos++] = batchCmd;
+    if (m_schedOn)
+    {
+      m_batchBuf[m_batchPos++] = m_schedFrame & 0xFF;
+      m_batchBuf[m_batchPos++] = m_schedFrame >> 8;
+    }
+    m_batchBuf[m_batchPos++] = 0;  /* # of commands */
+    m_batchHdrLen = m_batchPos;
+    m_batchDst = dst;
   }
+  memcpy(&m_batchBuf[m_batchPos], m_radioOutBuf, m_radioOutBufPos);
+  m_batchPos += m_radioOutBufPos;
+  m_batchBuf[m_batchHdrLen - 1]++;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: rainbow
-//   Run a rainbow effect on the destination node(s).
+// Function: appendRadioOut8
+//   Append a byte to the radio output buffer.
 // Parameters:
-//   dst:I    - The WASP slave destination. This is either a single WASP
-//              slave node ID or BROADCASTID to change the pixel colours
-//              on all LED strips.
-//   offs:I   - The number of pixel position colours to offset for the
-//              first pixel.
+//   value:I  - The byte value to append..
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
 //   m_radioOutBuf:O
 //   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void rainbow(uint8 dst, uint8 offs)
+inline void appendRadioOut8(uint8 value)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_RAINBOW);
-  appendRadioOut8(offs);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
-  {
-    logPrint(FLASH("RAINBOW ->"));
-    logPrintln(dst);
-  }
+  m_radioOutBuf[m_radioOutBufPos++] = value;
 }
 
 
+
+
+/*****************************************************************************
+ *  SECTION  *************  WASP Command Handling  ***************************
+ *****************************************************************************/
+
 //-----------------------------------------------------------------------------
-// Function: rainbowCycle
-//   Run a rainbow effect on the destination node(s) where the pixels on
-//   each node span the range of rainbow colours all the time.
+// Function: mirrorCmdLen
+//   Determine the length of a command kept in the scene mirror.
 // Parameters:
-//   dst:I    - The WASP slave destination. This is either a single WASP
-//              slave node ID or BROADCASTID to change the pixel colours
-//              on all LED strips.
-// Returns: (none)
-// Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   cmd:I  - The WASP command.
+// Returns: The command's length, including its code; 0 for WASPCMD_NONE.
+// Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-void rainbowCycle(uint8 dst)
+uint8 mirrorCmdLen(WaspCmd_t cmd)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_RAINCYCLE);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
+  switch (cmd)
   {
-    logPrint(FLASH("RAINCYCLE ->"));
-    logPrintln(dst);
-  }
-}
+    case WASPCMD_RAINCYCLE:
+      return 1;
+    case WASPCMD_STATE:
+    case WASPCMD_SPEED:
+    case WASPCMD_RAINBOW:
+    case WASPCMD_SCRIPT_RUN:
+      return 2;
+    case WASPCMD_GROUP:
+    case WASPCMD_BKGRD:
+    case WASPCMD_BRIGHT:
+      return 4;
+    case WASPCMD_TWINKLE:
+      return 5;
+    case WASPCMD_GRADIENT:
+      return MIRROR_CMD_LEN;
+    default:
+      return 0;
+  }
+}
 
 
 //-----------------------------------------------------------------------------
-// Function: twinkle
-//   Run a twinkling effect on the destination node(s).
+// Function: mirrorUpdate
+//   Record the effect of a command on the scene of each slave it's sent to.
+//   Fades are recorded by their end result. Pixel-level drawing isn't
+//   recorded, only noted (see SceneMirror_t::detail).
 // Parameters:
-//   dst:I     - The WASP slave destination. This is either a single WASP
-//               slave node ID or BROADCASTID.
-//   minDly:I  - The minimum delay between twinkles on any given node.
-//   maxDly:I  - The maximum delay between twinkles on any given node.
-//   burst:I   - The maximum number of pixels that can twinkle simultaneously
-//               on any given node.
-//   hold:I    - The duration for which a twinkle lasts.
+//   dst:I   - Destination node ID, group ID, or BROADCASTID.
+//   pCmd:I  - The command.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_verboseWasp:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
+//   m_mirror:IO
 //-----------------------------------------------------------------------------
-void twinkle(uint8 dst, uint8 minDly, uint8 maxDly, uint8 burst, uint8 hold)
+void mirrorUpdate(uint8 dst, const uint8 *pCmd)
 {
-  m_radioOutBufPos = 0;
-  appendRadioOut8(WASPCMD_TWINKLE);
-  appendRadioOut8(minDly);
-  appendRadioOut8(maxDly);
-  appendRadioOut8(burst);
-  appendRadioOut8(hold);
-  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos, false);
-  if (m_verboseWasp)
+  SceneMirror_t *pMirror;
+  uint16 mask;
+
+  mask = radioDstSlaves(dst);
+  for (uint8 i = 0; i < MAX_SLAVES; i++)
   {
-    logPrint(FLASH("TWINKLE ->"));
-    logPrintln(dst);
+    if (0 == (mask & (1 << i)))
+      continue;
+    pMirror = &m_mirror[i];
+
+    switch (pCmd[0])
+    {
+      case WASPCMD_GROUP:
+        memcpy(pMirror->group, pCmd, sizeof(pMirror->group));
+        break;
+      case WASPCMD_BRIGHT:
+        memcpy(pMirror->bright, pCmd, sizeof(pMirror->bright));
+        pMirror->bright[3] = 0;           // No fade
+        break;
+      case WASPCMD_SPEED:
+        memcpy(pMirror->speed, pCmd, sizeof(pMirror->speed));
+        break;
+      case WASPCMD_BKGRD:
+      case WASPCMD_FADE:
+        memcpy(pMirror->base, pCmd, 4);
+        pMirror->base[0] = WASPCMD_BKGRD;
+        pMirror->fx[0] = WASPCMD_NONE;
+        pMirror->detail = false;
+        break;
+      case WASPCMD_GRADIENT:
+        memcpy(pMirror->base, pCmd, MIRROR_CMD_LEN);
+        pMirror->base[MIRROR_CMD_LEN - 1] = 0; // No fade
+        pMirror->fx[0] = WASPCMD_NONE;
+        pMirror->detail = false;
+        break;
+      case WASPCMD_RAINBOW:
+      case WASPCMD_RAINCYCLE:
+      case WASPCMD_TWINKLE:
+      case WASPCMD_SCRIPT_RUN:
+        memcpy(pMirror->fx, pCmd, mirrorCmdLen(pCmd[0]));
+        break;
+      case WASPCMD_STATE:
+        if (pCmd[1] & F_RESTORE)
+        {
+          memcpy(pMirror->base, pMirror->saved, MIRROR_CMD_LEN);
+          pMirror->detail = false;
+        }
+        if (pCmd[1] & F_SAVE)
+          memcpy(pMirror->saved, pMirror->base, MIRROR_CMD_LEN);
+        break;
+      case WASPCMD_LINE:
+      case WASPCMD_SHIFT:
+      case WASPCMD_SWAP:
+      case WASPCMD_PIXELS:
+      case WASPCMD_PALETTE:
+        pMirror->fx[0] = WASPCMD_NONE;
+        pMirror->detail = true;
+        break;
+      case WASPCMD_RESET:
+        memset(pMirror, 0, sizeof(*pMirror));
+        continue;
+      default:
+        continue;
+    }
+    pMirror->updTime = millis() | 1;
   }
 }
 
 
-
-/*****************************************************************************
- *  SECTION  ******  WASP Interactive Programming Environment ****************
- *****************************************************************************/
-
-// Use the following #define and #if definitions to temporarily
-// disable wipeShowHelp() if Flash memory program space is getting short.
-//#define wipeShowHelp()
-//#if 0
 //-----------------------------------------------------------------------------
-// Function: wipeShowHelp
-//   Show help text on the console.
-// Parameters: (none)
+// Function: mirrorShowCmd
+//   Display a command kept in the scene mirror.
+// Parameters:
+//   pLabel:I  - Label to display before it.
+//   pCmd:I    - The command.
 // Returns: (none)
 // Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-void wipeShowHelp(void)
+void mirrorShowCmd(const __FlashStringHelper *pLabel, const uint8 *pCmd)
 {
-  logPrintln(FLASH("\n"));
-  logPrintln(FLASH("** WIPE Help **\n"));
-  logPrintln(FLASH("WIPE is BASIC-like and case sensitive"));
-  logPrintln(FLASH("- To edit a line, use same line #"));
-
-
-  logPrintln(FLASH("\nCOMMANDS"));
-  logPrintln(FLASH("del <m> [- n]\t- Delete line m thru n"));
-  logPrintln(FLASH("dir\t\t- List saved programs"));
-  logPrintln(FLASH("erase <name>\t- Delete program"));
-  logPrintln(FLASH("exit\t\t- Exit WIPE"));
-  logPrintln(FLASH("help\t\t- Show help"));
-  logPrintln(FLASH("load <name>\t- Load program"));
-  logPrintln(FLASH("list m [- n]\t- List lines m thru n"));
-  logPrintln(FLASH("prof\t\t- Show all symbols"));
-  logPrintln(FLASH("renum\t\t- Renumber lines evenly from 5 - 250"));
-  logPrintln(FLASH("run\t\t- Run program; 'x' to quit."));
-  logPrintln(FLASH("save <name>\t- Save program"));
-  logPrintln(FLASH("start <name>\t- Set startup program"));
-
-
-  logPrintln(FLASH("\nSTATEMENTS"));
-  logPrintln(FLASH("if <expr>\t\tSkip next line if <expr> false"));
-  logPrintln(FLASH("label <id>"));
-  logPrintln(FLASH("let <id> = <expr>"));
-  logPrintln(FLASH("goto <label-id>"));
-  logPrintln(FLASH("print <expr>"));
-  logPrintln(FLASH("var <id> : <type>\tin {int, float, bool}"));
-  logPrintln(FLASH("<func>(<params>)  (see FUNCTIONS)"));
-  logPrintln(FLASH("\n  where: <expr> is with no precedence"));
-
-  
-  logPrintln(FLASH("\n... <Enter>"));
-  while (Serial.available() == 0)
-    ;
-  Serial.read();
-
-
-  logPrintln(FLASH("\nFUNCTIONS"));
-
-  logPrintln(FLASH("GENERAL"));
-  logPrintln(FLASH("\tPause(min,sec,100ths)"));
-  
-  logPrintln(FLASH("WASP GENERIC"));
-  logPrintln(FLASH("\tBkgrd(dst,r,g,b)"));
-  logPrintln(FLASH("\tGroup(dst,grp,l,r)"));
-  logPrintln(FLASH("\tLine(dst,r,g,b,start,len)"));
-  logPrintln(FLASH("\tReset(dst)"));
-  logPrintln(FLASH("\tShift(dst,shift)"));
-  logPrintln(FLASH("\tState(dst,opts),\topts is OR'd collection of "));
-  logPrintln(FLASH("\t\t\t\t{SAVE(1), RESTORE(2), RESUME(4), SUSPEND(8)}"));
-  logPrintln(FLASH("\tSwap(dst,r,g,b,r',g',b')"));
+  uint8 len = mirrorCmdLen(pCmd[0]);
 
-  logPrintln(FLASH("\nSPECIAL FX"));
-  logPrintln(FLASH("\tRain(dst,start)"));
-  logPrintln(FLASH("\tCycle(dst)"));
-  logPrintln(FLASH("\tSpeed(dst, dly)\tFX speed"));
-  logPrintln(FLASH("\tTwinkle(dst,minDly,maxDly,burst,hold)"));
+  if (0 == len)
+    return;
+  logPrint(pLabel);
+  for (uint8 i = 0; i < len; i++)
+  {
+    logPrint(i == 0 ? FLASH("") : FLASH(","));
+    logPrint(pCmd[i]);
+  }
   logPrintln();
 }
-//#endif
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDumpProgramHex
-//   Dump program memory to the console.
-// Parameters: (none)
-// Returns:    (none)
+// Function: mirrorCheck
+//   Schedule a slave for a resync of its scene (see mirrorResync()), if its
+//   PING reply shows it has restarted since the scene was last changed.
+// Parameters:
+//   src:I     - The slave's node ID.
+//   upSecs:I  - Seconds since it restarted.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_program:I
-//   m_wipeProgByte:I
-// Notes:
-//   This function is intended for WIPE interpreter debugging purposes.
+//   m_mirror:I
+//   m_resyncNodes:IO
 //-----------------------------------------------------------------------------
-void wipeDumpProgramHex(void)
+void mirrorCheck(uint8 src, uint32 upSecs)
 {
-  uint8  *pCurrByte;
-  uint16  i;
-  uint8   hexByte;
+  uint8 i = src - FIRST_SLAVE;
 
-  pCurrByte = &m_program[0];
-  logPrintln();
-  logPrintln(FLASH("PROG HEX DUMP:"));
-  for (i = 0; i < 10; i++)
+  if ( (src < FIRST_SLAVE) || (src >= (FIRST_SLAVE + MAX_SLAVES)) ||
+       (0 == m_mirror[i].updTime) )
+    return;
+  // Allow for the reply's rounding down to whole seconds.
+  if ( (upSecs + 1) < (millis() - m_mirror[i].updTime) / 1000 )
   {
-    logPrint(FLASH("  "));
-    logPrint(i);
-    logPrint(' ');
+    logPrint(FLASH(" (restarted)"));
+    m_resyncNodes |= (1 << i);
   }
-  logPrintln();
-  
-  for (i = 10; i !=0; i--)
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: mirrorResync
+//   Restore the mirrored scene of a slave that has restarted, by sending it
+//   alone the few commands that set it (see SceneMirror_t). A script it ran
+//   was lost with the restart, so it isn't rerun; it must be uploaded again.
+// Parameters:
+//   i:I  - Index of the slave (node ID - FIRST_SLAVE).
+// Returns: (none)
+// Inputs/Outputs:
+//   m_mirror:IO
+//   m_palNodes:O
+//-----------------------------------------------------------------------------
+void mirrorResync(uint8 i)
+{
+  SceneMirror_t *pMirror = &m_mirror[i];
+  const uint8    state[2] = { WASPCMD_STATE, F_SAVE };
+  const uint8   *cmds[6];
+  uint8          n = 0;
+  uint8          dst = FIRST_SLAVE + i;
+
+  cmds[n++] = pMirror->group;
+  cmds[n++] = pMirror->bright;
+  if (WASPCMD_NONE != pMirror->saved[0])
   {
-    logPrint(FLASH("--- "));
+    cmds[n++] = pMirror->saved;
+    cmds[n++] = state;
   }
-  logPrintln();
+  cmds[n++] = pMirror->base;
+  cmds[n++] = pMirror->fx;
 
-  for (i = 0; i < m_wipeProgByte; i++)
+  logPrint(FLASH("Resyncing node #"));
+  logPrintln(dst);
+  if (WASPCMD_SCRIPT_RUN == pMirror->fx[0])
   {
-    hexByte = *pCurrByte++;
-    if (hexByte < 100)
-      logPrint(FLASH(" "));
-    if (hexByte < 10)
-      logPrint(FLASH(" "));
-    logPrint(hexByte);
-    logPrint(FLASH(" "));
-    if ( (i % 10) == 9 )
-      logPrintln();
+    logPrintln(FLASH("***Its script was lost. Upload it again"));
+    pMirror->fx[0] = WASPCMD_NONE;
   }
-  logPrintln();
+  radioBatchFlush();
+  for (uint8 j = 0; j < n; j++)
+  {
+    if (WASPCMD_NONE != cmds[j][0])
+      (void)radioSendBuf(dst, (uint8 *)cmds[j], mirrorCmdLen(cmds[j][0]),
+                         MIN_UPD_PERIOD);
+  }
+  if (WASPCMD_NONE != pMirror->speed[0])
+    (void)radioSendBuf(dst, pMirror->speed, sizeof(pMirror->speed),
+                       MIN_UPD_PERIOD);
+
+  // It restarted in direct colour mode.
+  m_palNodes &= ~(1 << i);
+  pMirror->updTime = millis() | 1;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirSpaceCheck
-//   Determine the free space (in bytes) available in EEPROM for WIPE
-//   programs.
-// Parameters: (none)
-// Returns:    (none)
+// Function: setGroup
+//   Notify a node what are its left and right neighbours.
+// Parameters:
+//   dst:I      - The WASP slave destination. This must be a single WASP
+//                slave node ID.
+//   groupId:I  - Identifies the group of WASP slaves in which the destination
+//                node belongs. The value must be in the range FIRST_GROUP ..
+//                (FIRST_GROUP + MAX_GROUPS - 1). Singleton groups are
+//                permitted. The number of members in a group is limited only
+//                by the number of supported slaves (MAX_SLAVES).
+//   left:I     - Node ID of left neighbour.
+//   right:I    - Node ID of right neighbour.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeDirSpace:O
-//   m_wipeSaveAddr:O
+//   m_verboseWasp:I
+//   m_nodeGroup:O
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeDirSpaceCheck(void)
+void setGroup(uint8 dst, uint8 groupId, uint8 left, uint8 right)
 {
-  uint16 currFileSize;
-
-  m_wipeSaveAddr = EEPROM_PROG_DIR_START;
-  m_wipeDirSpace = EEPROM_PROG_LEN;
-  currFileSize = (uint16)EEPROM.read(m_wipeSaveAddr) << 8 |
-                 EEPROM.read(m_wipeSaveAddr + 1);
-  while ( (currFileSize != 0) &&
-          (m_wipeSaveAddr < EEPROM_PROG_DIR_START + EEPROM_PROG_LEN)
-        )
+  m_radioOutBufPos = 0;
+  if (BROADCASTID == dst)
   {
-    /* Decrease available space by current file size and directory header */
-    m_wipeDirSpace -= currFileSize + DIR_PROG_OFFS;
-
-    /* Move to the next directory entry */
-    m_wipeSaveAddr += currFileSize + DIR_PROG_OFFS;
-
-    /* Get the next file's size */
-    currFileSize = (uint16)EEPROM.read(m_wipeSaveAddr) << 8 |
-                   EEPROM.read(m_wipeSaveAddr + 1);
+    logPrint(FLASH("NEIGH: Bad dst="));
+    logPrintln(dst);
+  }
+  else
+  {
+    appendRadioOut8(WASPCMD_GROUP);
+    appendRadioOut8(groupId);
+    appendRadioOut8(left);
+    appendRadioOut8(right);
+    radioSendCmd(dst);
+    if ( (dst >= FIRST_SLAVE) && (dst < (FIRST_SLAVE + MAX_SLAVES)) )
+      m_nodeGroup[dst - FIRST_SLAVE] = groupId;
+    if (m_verboseWasp)
+    {
+      logPrint(FLASH("NEIGH ->"));
+      logPrint(dst);
+      logPrint(" ");
+      logPrint(left);
+      logPrint(" ");
+      logPrintln(right);
+    }
   }
-
-  logPrint(FLASH("Free EEPROM: "));
-  logPrintln(m_wipeDirSpace);
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirList
-//   Display a directory listing of WIPE program files.
-// Parameters: (none)
-// Returns:    (none)
+// Function: background
+//   Set the colour for all pixels in the strip(s) specified by the WASP
+//   destination address.
+// Parameters:
+//   dst:I  - The WASP slave destination. This is either a single WASP
+//            slave node ID or BROADCASTID to set the pixel colours
+//            on all LED strips.
+//   r:I    - Amount of red.
+//   g:I    - Amount of green.
+//   b:I    - Amount of blue.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeDirSpace:I
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeDirList(void)
+void background(uint8 dst, uint8 r, uint8 g, uint8 b)
 {
-  uint16  currDirEntry;
-  uint16  currFileSize;
-  uint8   count = 0;
-  boolean endName;
-  boolean startupFound = false;
-  char    tmpChar;
-  char    filename[MAX_PROGNAME_LEN+1];
-
-  currDirEntry = EEPROM_PROG_DIR_START;
-  currFileSize = (uint16)EEPROM.read(currDirEntry) << 8 |
-                 EEPROM.read(currDirEntry + 1);
-  logPrintln();
-  logPrintln(FLASH("Directory:"));
-  while ( (currFileSize != 0) &&
-          (currDirEntry < EEPROM_PROG_DIR_START + EEPROM_PROG_LEN)
-        )
-  {
-    count++;
-    endName = false;
-    for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
-    {
-      /* Print filename */
-      tmpChar = EEPROM.read(currDirEntry + DIR_NAME_OFFS + i);
-      filename[i] = tmpChar;
-      if (tmpChar == '\0')
-      {
-        endName = true;
-        if (strcmp(filename, m_autorunProg) == 0)
-          startupFound = true;
-      }
-      if (!endName)
-      {
-        logPrint(tmpChar);
-      }
-      else
-      {
-        logPrint(' ');
-      }
-    }
-    
-    /* Print file size */
-    logPrint(FLASH("  "));
-    logPrint(currFileSize);
-    logPrintln(FLASH(" bytes"));
-
-    /* Move to the next directory entry */
-    currDirEntry += currFileSize + DIR_PROG_OFFS;
-
-    /* Get the next file's size */
-    currFileSize = (uint16)EEPROM.read(currDirEntry) << 8 |
-                   EEPROM.read(currDirEntry + 1);
-  }
-  logPrint(FLASH("  "));
-  logPrint(count);
-  logPrint(FLASH(" files. "));
-  logPrint(m_wipeDirSpace);
-  logPrint(FLASH(" of "));
-  logPrint(EEPROM_PROG_LEN);
-  logPrintln(FLASH(" bytes free."));
-  if (m_autorunProg[0] != '\0')
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_BKGRD);
+  appendRadioOut8(r);
+  appendRadioOut8(g);
+  appendRadioOut8(b);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    logPrint(FLASH("Startup ["));
-    logPrint(m_autorunProg);
-    if (startupFound)
-      logPrintln(FLASH("]"));
-    else
-      logPrintln(FLASH("] is missing"));
+    logPrint(FLASH("BKGRD ->"));
+    logPrint(dst);
+    logPrint(" ");
+    logPrint(r);
+    logPrint(" ");
+    logPrint(g);
+    logPrint(" ");
+    logPrintln(b);
   }
-  logPrintln(FLASH("-----------------------"));
-  logPrintln();
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirFileSave
-//   Save current program in RAM to EEPROM directory.
+// Function: setState
+//   Send a state operation command to the WASP destination address.
 // Parameters:
-//   progName:I  - Program file name string.
-// Returns:    (none)
+//   dst:I  - The WASP slave destination. This is either a single WASP
+//            slave node ID or BROADCASTID to set the pixel colours
+//            on all LED strips.
+//   opt:I  - The state flags value.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeProgByte:I
-//   m_wipeDirSpace:IO
-//   m_wipeSaveAddr:IO
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeDirFileSave(char *progName)
+void setState(uint8 dst, uint8 opt)
 {
-  uint16  currAddr;
-  uint8  *pProgByte;
-
-  currAddr = m_wipeSaveAddr;
-
-  /* Save file size (in bytes) to the directory entry */
-  EEPROM.write(currAddr++, (uint8)(m_wipeProgByte >> 8));
-  EEPROM.write(currAddr++, (uint8)m_wipeProgByte);
-
-  /* Save the file name */
-  for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
-  {
-    EEPROM.write(currAddr++, *progName++);
-  }
-
-  /* Save the program */
-  pProgByte = &m_program[0];
-  for (uint16 i = m_wipeProgByte; i != 0; i--)
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_STATE);
+  appendRadioOut8(opt);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    EEPROM.write(currAddr++, *pProgByte++);
+    logPrint(FLASH("STATE ->"));
+    logPrint(dst);
+    logPrint(" ");
+    logPrintln(opt);
   }
-
-  /* Update write address and free space */
-  m_wipeSaveAddr += m_wipeProgByte + DIR_PROG_OFFS;
-  m_wipeDirSpace -= m_wipeProgByte + DIR_PROG_OFFS;
-
-  /* Flag end of directory */
-  EEPROM.write(m_wipeSaveAddr, 0);
-  EEPROM.write(m_wipeSaveAddr + 1, 0);
-
-  logPrintln();
-  logPrintln(FLASH("Saved"));
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirFileFind
-//   Locate the specified program in the EEPROM directory.
+// Function: line
+//   Draw a line of pixels in the strip(s) specified by the WASP
+//   destination address.
 // Parameters:
-//   progName:I   - Program file name string.
-//   pFileSize:O  - Address at which to return the located file's size (in
-//                  bytes).
-// Returns:
-//   0, if file not found;
-//   The directory entry base address in EEPROM, otherwise.
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID or BROADCASTID to set the pixel colours
+//              on all LED strips.
+//   start:I  - The starting pixel number for the line. (Zero indicates the
+//              first pixel.)
+//   len:I    - The line length (in number of pixels).
+//   r:I      - Amount of red.
+//   g:I      - Amount of green.
+//   b:I      - Amount of blue.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeDirSpace:IO
-//   m_wipeSaveAddr:IO
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-uint16 wipeDirFileFind(char *progName, uint16 *pFileSize)
+void line(uint8 dst, uint8 start, uint8 len, uint8 r, uint8 g, uint8 b)
 {
-  uint16  currDirEntry;
-  uint16  currFileSize;
-  char   *pChar;
-  char    currChar;
-
-  *pFileSize = 0;
-  
-  currDirEntry = EEPROM_PROG_DIR_START;
-  currFileSize = (uint16)EEPROM.read(currDirEntry) << 8 |
-                 (uint16)EEPROM.read(currDirEntry+1);
-  while ( (currFileSize != 0) &&
-          (currDirEntry < EEPROM_PROG_DIR_START + EEPROM_PROG_LEN)
-        )
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_LINE);
+  appendRadioOut8(start);
+  appendRadioOut8(len);
+  appendRadioOut8(r);
+  appendRadioOut8(g);
+  appendRadioOut8(b);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    pChar = progName;
-    for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
-    {
-      currChar = EEPROM.read(currDirEntry + DIR_NAME_OFFS + i);
-      if (*pChar != currChar)
-        break;
-      if (*pChar == '\0')
-      {
-        *pFileSize = currFileSize;
-        return currDirEntry;
-      }
-      pChar++;
-    }
-
-    currDirEntry += currFileSize + DIR_PROG_OFFS;
-    currFileSize = (uint16)EEPROM.read(currDirEntry) << 8 |
-                   (uint16)EEPROM.read(currDirEntry+1);
+    logPrint(FLASH("LINE ->"));
+    logPrintln(dst);
   }
-
-  return 0;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirFileErase
-//   Erase the specified program from EEPROM directory.
+// Function: paint
+//   Paint a line of pixels on the WIPE canvas. Nothing is sent; see
+//   pixels().
 // Parameters:
-//   progName:I  - Program file name string.
-// Returns:    (none)
+//   start:I  - The starting pixel number for the line. (Zero indicates the
+//              first pixel.)
+//   len:I    - The line length (in number of pixels).
+//   r:I      - Amount of red.
+//   g:I      - Amount of green.
+//   b:I      - Amount of blue.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeDirSpace:IO
-//   m_wipeSaveAddr:IO
+//   m_canvas:O
 //-----------------------------------------------------------------------------
-void wipeDirFileErase(char *progName)
+void paint(uint8 start, uint8 len, uint8 r, uint8 g, uint8 b)
 {
-  uint16  dirEntry;
-  uint16  fileSize;
-  uint16  numBytesToMove;
-  uint16  src;
+  uint8 *pixel;
 
-  dirEntry = wipeDirFileFind(progName, &fileSize);
-  if (0 == dirEntry)
-  {
-    logPrintln(FLASH("Not found"));
+  if (start >= MAX_CANVAS_LEN)
     return;
-  }
-
-  /* Shift all bytes above the directory entry base address down
-   * by the number of bytes occupied by the file and directory header.
-   */
-  numBytesToMove = (EEPROM_PROG_LEN - m_wipeDirSpace) -
-                   (fileSize + DIR_PROG_OFFS);
-  src = dirEntry + fileSize + DIR_PROG_OFFS;
-  while (numBytesToMove-- != 0)
-    EEPROM.write(dirEntry++, (EEPROM.read(src++)));
-
-  /* Update write address and free space */
-  m_wipeSaveAddr -= fileSize + DIR_PROG_OFFS;
-  m_wipeDirSpace += fileSize + DIR_PROG_OFFS;
-
-  /* Flag end of directory */
-  EEPROM.write(m_wipeSaveAddr, 0);
-  EEPROM.write(m_wipeSaveAddr + 1, 0);
+  if (len > (MAX_CANVAS_LEN - start))
+    len = MAX_CANVAS_LEN - start;
 
-  logPrintln();
-  logPrintln(FLASH("Erased"));
+  pixel = &m_canvas[start * 3];
+  for ( ; len != 0; len--)
+  {
+    *pixel++ = r;
+    *pixel++ = g;
+    *pixel++ = b;
+  }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDirFileLoad
-//   Load the specified program from EEPROM to RAM.
+// Function: pixels
+//   Upload a region of the WIPE canvas to the strip(s) specified by the WASP
+//   destination address, as run-length encoded WASPCMD_PIXELS packets. When
+//   the same region was last uploaded to the same destination (and nothing
+//   else has been sent since), unchanged pixels are skipped. The packets
+//   are queued by pixelsPoll() as the radio Tx queue has room for them.
 // Parameters:
-//   progName:I  - Program file name string.
-// Returns: true iff program was found.
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID or BROADCASTID to set the pixel colours
+//              on all LED strips.
+//   start:I  - The starting pixel number of the region.
+//   len:I    - The region length (in number of pixels).
+// Returns: (none)
 // Inputs/Outputs:
-//   m_wipeDirSpace:I
-//   m_wipeSaveAddr:I
-//   m_wipeLineStart:O
-//   m_wipeProgByte:O
-//-----------------------------------------------------------------------------
-boolean wipeDirFileLoad(char *progName)
+//   m_verboseWasp:I
+//   m_shadowDst:IO
+//   m_shadowLen:IO
+//   m_shadowStart:IO
+//   m_shadowValid:IO
+//   m_pixDelta:O
+//   m_pixNext:O
+//   m_pixPending:O
+//   m_pixResend:O
+//   m_pixSeq:O
+//-----------------------------------------------------------------------------
+void pixels(uint8 dst, uint8 start, uint8 len)
 {
-  uint16  currEepromPos;
-  uint16  fileSize;
-  uint16  i;
-
-  currEepromPos = wipeDirFileFind(progName, &fileSize);
-  if (0 == currEepromPos)
-  {
-    logPrintln(FLASH("Not found"));
-    return false;
-  }
+  if (start >= MAX_CANVAS_LEN)
+    return;
+  if (len > (MAX_CANVAS_LEN - start))
+    len = MAX_CANVAS_LEN - start;
+
+  m_pixDelta = ( m_shadowValid && (dst == m_shadowDst) &&
+                 (start == m_shadowStart) && (len == m_shadowLen) );
+  m_shadowValid = false;          // Until the upload has been queued
+  m_shadowDst   = dst;
+  m_shadowStart = start;
+  m_shadowLen   = len;
+  m_pixNext = start;
+  m_pixSeq = 0;
+  m_pixPending = true;
+  m_pixResend = false;
 
-  currEepromPos += DIR_PROG_OFFS;
-  for (i = 0; i < fileSize; i++)
+  if (m_verboseWasp)
   {
-    m_program[i] = EEPROM.read(currEepromPos + i);
+    logPrint(FLASH("PIXELS ->"));
+    logPrintln(dst);
   }
-
-  m_wipeLineStart = i;
-  m_wipeProgByte = i;
-
-  logPrintln();
-  logPrintln(FLASH("Loaded."));
-  return true;
+  pixelsPoll();
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipePrintStatement
-//   Pretty print the tokenized WIPE statement starting at m_program[]
-//   location m_wipeLineStart.
-// Parameters:
-//   lineStart:I  - Starting program memory location of the line.
+// Function: pixelsPoll
+//   Queue the next packets of the pixel upload in progress (see pixels()),
+//   while the radio Tx queue has room for them. Once a slave has reported
+//   that it lost part of the last upload (see pixelsNacked()), the whole
+//   region is uploaded again.
+// Parameters: (none)
 // Returns: (none)
 // Inputs/Outputs:
-//   m_wipeLineStart:I
-//   m_program:I
+//   m_canvas:I
+//   m_shadowDst:I
+//   m_shadowLen:I
+//   m_shadowStart:I
+//   m_canvasShadow:IO
+//   m_pixDelta:IO
+//   m_pixNext:IO
+//   m_pixPending:IO
+//   m_pixResend:IO
+//   m_pixResendTime:IO
+//   m_pixSeq:IO
+//   m_shadowValid:O
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipePrintStatement(void)
+void pixelsPoll(void)
 {
-  uint8  *linePos;
-  char   *identifier;
-  uint8   stmtId;
-  uint8   lineNum;
-  uint8   lineLen;
-  uint8   byteVal;
-  uint8   lineOffs;
+  uint8   *pixel;
+  uint16   pixNum;
+  uint16   endNum = m_shadowStart + m_shadowLen;
+  uint16   first;
+  uint8    count;
 
-  lineNum  = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
-  lineLen  = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
-  stmtId   = m_program[m_wipeLineStart + TKNZD_STMT_OFFS];
-  lineOffs = TKNZD_STMT_OFFS + 1;
-  
-  if (lineNum != 0)
+  if ( !m_pixPending && m_pixResend &&
+       ((millis() - m_pixResendTime) >= CMD_TIMEOUT) )
   {
-    if (lineNum < 100)
-      logPrint(FLASH("0"));
-    if (lineNum < 10)
-      logPrint(FLASH("0"));
-    logPrint(lineNum);
-    logPrint(FLASH(" "));
+    logPrint(FLASH("PIXELS: Resending to "));
+    logPrintln(m_shadowDst);
+    m_pixResendTime = millis();
+    pixels(m_shadowDst, m_shadowStart, m_shadowLen);
+    return;
   }
-  
-  switch (stmtId)
+
+  while (m_pixPending && radioTxReady())
   {
-    case WIPE_FUNC:
-      stmtId = m_program[m_wipeLineStart + lineOffs++];
-      switch (stmtId)
-      {
-        case WASPCMD_GROUP:     logPrint(FLASH("Group"));   break;
-        case WASPCMD_STATE:     logPrint(FLASH("State"));   break;
-        case WASPCMD_BKGRD:     logPrint(FLASH("Bkgrd"));   break;
-        case WASPCMD_LINE:      logPrint(FLASH("Line"));    break;
-        case WASPCMD_SHIFT:     logPrint(FLASH("Shift"));   break;
-        case WASPCMD_SWAP:      logPrint(FLASH("Swap"));    break;
-        case WASPCMD_RESET:     logPrint(FLASH("Reset"));   break;
-        case WASPCMD_SPEED:     logPrint(FLASH("Speed"));   break;
-        case WASPCMD_RAINBOW:   logPrint(FLASH("Rain"));    break;
-        case WASPCMD_RAINCYCLE: logPrint(FLASH("Cycle"));   break;
-        case WASPCMD_TWINKLE:   logPrint(FLASH("Twinkle")); break;
-        case WIPE_FN_PAUSE:     logPrint(FLASH("Pause"));   break;
-        default:
-          logPrint(FLASH("<unknown func: "));
-          logPrint(stmtId);
-          logPrintln(FLASH("?>"));
-          return;
-      }
-      lineOffs++; /* Skip # of parameters */
-      linePos = &m_program[m_wipeLineStart + lineOffs];
-      for (uint8 i = 0; i < (lineLen - lineOffs); i++)
-      {
-        logPrint((char)*linePos++);
-      }
-      logPrintln();
-      break;
-    case WIPE_GOTO:
-      logPrint(FLASH("goto "));
-      identifier = (char *)&m_program[m_wipeLineStart + lineOffs];
-      lineOffs += strlen(identifier) + 1;
-      logPrintln(identifier);
-      break;
-    case WIPE_IF:
-      logPrint(FLASH("if "));
-      linePos = &m_program[m_wipeLineStart + lineOffs];
-      for (uint8 i = 0; i < (lineLen - lineOffs); i++)
-      {
-        logPrint((char)*linePos++);
-      }
-      logPrintln();
-      break;
-    case WIPE_LABEL:
-      logPrint(FLASH("label "));
-      identifier = (char *)&m_program[m_wipeLineStart + lineOffs];
-      lineOffs += strlen(identifier) + 1;
-      logPrintln(identifier);
-      break;
-    case WIPE_LET:
-      logPrint(FLASH("let "));
-      identifier = (char *)&m_program[m_wipeLineStart + lineOffs];
-      lineOffs += strlen(identifier) + 1;
-      logPrint(identifier);
-      logPrint(FLASH(" = "));
-      linePos = &m_program[m_wipeLineStart + lineOffs];
-      for (uint8 i = 0; i < (lineLen - lineOffs); i++)
-      {
-        logPrint((char)*linePos++);
-      }
-      logPrintln();
-      break;
-    case WIPE_PRINT:
-    {
-      char *pChar;
+    pixNum = m_pixNext;
+    first = pixNum;
+    m_radioOutBufPos = 0;
+    appendRadioOut8(WASPCMD_PIXELS);
+    appendRadioOut8(m_pixSeq);
+    appendRadioOut8(0);  /* opts; set below */
+    appendRadioOut8(pixNum);
 
-      logPrint(FLASH("print "));
-      stmtId = m_program[m_wipeLineStart + lineOffs++];
-      if (WIPE_PRT_STR == stmtId)
+    while ( (pixNum < endNum) &&
+            ((m_radioOutBufPos + 4) <= RF69_MAX_DATA_LEN) )
+    {
+      pixel = &m_canvas[pixNum * 3];
+      count = 0;
+      if ( m_pixDelta &&
+           (memcmp(pixel, &m_canvasShadow[pixNum * 3], 3) == 0) )
       {
-        logPrint("\"");
-        logPrint((char *)&m_program[m_wipeLineStart + lineOffs]);
-        logPrintln("\"");
+        /* Skip a run of unchanged pixels */
+        do
+        {
+          count++;
+        } while ( ((pixNum + count) < endNum) && (count < PIXELS_MAX_RUN) &&
+                  (memcmp(&m_canvas[(pixNum + count) * 3],
+                          &m_canvasShadow[(pixNum + count) * 3], 3) == 0) );
+        appendRadioOut8(PIXELS_SKIP | count);
       }
       else
       {
-        identifier = (char *)&m_program[m_wipeLineStart + lineOffs];
-        lineOffs += strlen(identifier) + 1;
-        logPrintln(identifier);
+        /* A run of pixels of the same colour */
+        do
+        {
+          count++;
+        } while ( ((pixNum + count) < endNum) && (count < PIXELS_MAX_RUN) &&
+                  (memcmp(&m_canvas[(pixNum + count) * 3], pixel, 3) == 0) );
+        appendRadioOut8(count);
+        appendRadioOut8(pixel[0]);
+        appendRadioOut8(pixel[1]);
+        appendRadioOut8(pixel[2]);
       }
-      break;
+      pixNum += count;
     }
-    case WIPE_VAR:
-      logPrint(FLASH("var "));
-      identifier = (char *)&m_program[m_wipeLineStart + lineOffs];
-      logPrint(identifier);
-      logPrint(FLASH(" : "));
-      byteVal = m_program[m_wipeLineStart + lineOffs + strlen(identifier) + 1];
-      switch (byteVal)
-      {
-        case WIPE_ID_INT:
-          logPrintln(FLASH("int"));
-          break;
-        case WIPE_ID_FLOAT:
-          logPrintln(FLASH("float"));
-          break;
-        case WIPE_ID_BOOL:
-          logPrintln(FLASH("bool"));
-          break;
-        default:
-          logPrint(FLASH("<type: "));
-          logPrint(byteVal);
-          logPrintln(FLASH("?>"));
-      }
-      break;
-    default:
-      logPrint(FLASH("<WIPE statement: "));
-      logPrint(byteVal);
-      logPrintln(FLASH("?>"));
+    memcpy(&m_canvasShadow[first * 3], &m_canvas[first * 3],
+           (pixNum - first) * 3);
+
+    /* A multi-packet upload is shown only once it has all been received */
+    if ( (m_pixSeq != 0) || (pixNum < endNum) )
+    {
+      if (0 == m_pixSeq)
+        m_radioOutBuf[2] |= F_SUSPEND;
+      if (pixNum >= endNum)
+        m_radioOutBuf[2] |= F_RESUME;
+    }
+    m_pixNext = pixNum;
+    m_pixSeq++;
+    m_pixPending = (pixNum < endNum);
+    radioSendCmd(m_shadowDst);
+    if (!m_pixPending)
+      m_shadowValid = !m_pixResend;
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeShowConsoleLine
-//   Display the current WIPE command line.
-// Parameters: (none)
+// Function: pixelsNacked
+//   Note that a slave has lost part of the last pixel upload (see
+//   WASPCMD_NACK), which pixelsPoll() then sends again in full: the slave's
+//   pixels no longer match the canvas shadow.
+// Parameters:
+//   dst:I  - Destination of the upload.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_consoleBuffer:I
-//   m_consolePos:I
+//   m_shadowDst:I
+//   m_srcNodeId:I
+//   m_pixResend:O
+//   m_shadowValid:O
 //-----------------------------------------------------------------------------
-inline void wipeShowConsoleLine(void)
+void pixelsNacked(uint8 dst)
 {
-    logPrintln(m_consoleBuffer);
+  if (dst != m_shadowDst)
+    return;
+  logPrint(FLASH("***PIXELS: Lost by "));
+  logPrintln(m_srcNodeId);
+  m_shadowValid = false;
+  m_pixResend = true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeShowError
-//   Display WIPE syntax error on console.
+// Function: shift
+//   Shift the pixels in the strip(s) specified by the WASP destination
+//   address.
 // Parameters:
-//   errStr:I  - Error string to display. The argument should be provided
-//               using the FLASH() macro:
-//                 e.g. wipeShowError(FLASH("Error text"));
+//   dst:I  - The WASP slave destination. This is either a single WASP
+//            slave node ID or BROADCASTID to set the pixel colours
+//            on all LED strips.
+//   num:I  - Number of pixels to shift. Positive numbers shift right;
+//            begative numbers shift left.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_consoleBuffer:I
-//   m_consolePos:I
-//   m_wipeRunByte:I
+//   m_nodeGroup:I
+//   m_palNodes:I
+//   m_slotWind:I
+//   m_verboseWasp:I
+//   m_cmdExecDelay:0
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeShowError(const __FlashStringHelper *errStr)
+void shift(uint8 dst, uint8 num)
 {
-  uint8 i;
-  uint8 indent;
+  uint16 respDelay = CMD_TIMEOUT;
+  uint8  wind;
+  uint8  numSlots = 0;
+  uint16 numBytes = abs((int8)num);
+  uint16 dstMask = radioDstSlaves(dst);
 
-  if (m_wipeRunByte > 0)
-  {
-    indent = 0;
-    wipePrintStatement();
-  }
-  else
+  // Each slot is stretched by the # of report frames the slaves send. They
+  // report an (r,g,b) triple per pixel unless all are in indexed colour mode.
+  if ((m_palNodes & dstMask) != dstMask)
+    numBytes *= 3;
+
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_SHIFT);
+  appendRadioOut8(num);
+  if ( (dst >= FIRST_GROUP) && (dst < (FIRST_GROUP + MAX_GROUPS)) )
   {
-    indent = m_consolePos;
-    if (m_consolePos >= 2)
-      indent -= 1;
-    
-    wipeShowConsoleLine();
+    // Append the group's compacted schedule: the slot window followed by
+    // the members in slot order.
+    wind = m_slotWind[dst - FIRST_GROUP];
+    if (0 == wind)
+      wind = SLAVE_TX_WIND;
+    appendRadioOut8(wind);
+    for (uint8 i = 0; i < MAX_SLAVES; i++)
+    {
+      if (m_nodeGroup[i] == dst)
+      {
+        appendRadioOut8(FIRST_SLAVE + i);
+        numSlots++;
+      }
+    }
+    if (numSlots != 0)
+      respDelay = (uint16)numSlots * wind;
+    else
+      m_radioOutBufPos = 2;  // No known members. Use node Id slots.
   }
-  
-  for (i = 1; i < indent; i++)
+  respDelay *= SHIFT_FRAMES(numBytes);
+
+  // Hold back further commands for the slaves until they've responded.
+  radioBatchFlush();
+  mirrorUpdate(dst, m_radioOutBuf);
+  (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos,
+                     (respDelay > MIN_UPD_PERIOD ? respDelay : MIN_UPD_PERIOD));
+  m_cmdExecDelay = millis() + (respDelay > MIN_UPD_PERIOD ?
+                               respDelay : MIN_UPD_PERIOD);
+  if (m_verboseWasp)
   {
-    logPrint(FLASH(" "));
+    logPrint(FLASH("SHIFT ->"));
+    logPrint(dst);
+    logPrint("  ");
+    logPrintln(num);
   }
-  logPrintln(FLASH("^"));
-  logPrint(FLASH("***ERROR: "));
-  logPrintln(errStr);
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSymbolsClear
-//   Initialize the WIPE symbol table.
-// Parameters: (none)
+// Function: swap
+//   Change the colour of every pixel having a specified colour to a new
+//   colour in the strip(s) specified by the WASP destination
+//   address.
+// Parameters:
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID or BROADCASTID to change the pixel colours
+//              on all LED strips.
+//   old_r:I  - Amount of red in colour to be changed.
+//   old_g:I  - Amount of green in colour to be changed.
+//   old_b:I  - Amount of blue in colour to be changed.
+//   r:I      - Amount of red in new colour.
+//   g:I      - Amount of green in new colour.
+//   b:I      - Amount of blue in new colour.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_symTbl:O
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeSymbolsClear(void)
+void swap( uint8 dst,
+           uint8 old_r, uint8 old_g, uint8 old_b,
+           uint8 r,     uint8 g,     uint8 b )
 {
-  uint8 i;
-
-  for (i = 0; i < MAX_NUM_SYMBOLS; i++)
-    m_symTbl[i].typeId = WIPE_ID_UNDEF;
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_SWAP);
+  appendRadioOut8(old_r);
+  appendRadioOut8(old_g);
+  appendRadioOut8(old_b);
+  appendRadioOut8(r);
+  appendRadioOut8(g);
+  appendRadioOut8(b);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
+  {
+    logPrint(FLASH("SWAP ->"));
+    logPrintln(dst);
+  }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSymbolInsert
-//   Insert a new symbol into the WIPE symbol table.
+// Function: palette
+//   Set a palette entry of the strip(s) specified by the WASP destination
+//   address, switching them to indexed colour mode (see WASPCMD_PALETTE), or
+//   switch them back to direct colour mode.
 // Parameters:
-//   identifier:I  - Identifier string.
-//   type:I        - Identifier's type.
-//   idx:O         - Symbol table index at which symbol was inserted. The
-//                   value is valid only if the function returns true.
-// Returns: true iff insertion was successful.
+//   dst:I  - The WASP slave destination. This is either a single WASP
+//            slave node ID, a group ID, or BROADCASTID.
+//   idx:I  - Palette entry # (0 .. PAL_LEN - 1); PAL_LEN or more to switch
+//            to direct colour mode.
+//   r:I    - Amount of red in the entry's colour.
+//   g:I    - Amount of green in the entry's colour.
+//   b:I    - Amount of blue in the entry's colour.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_symTbl:IO
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeSymbolInsert(char *identifier, uint8 type, uint8 *idx)
+void palette(uint8 dst, uint8 idx, uint8 r, uint8 g, uint8 b)
 {
-  uint8 i;
-  uint8 freeIdx = MAX_NUM_SYMBOLS;
-
-  *idx = MAX_NUM_SYMBOLS;
-  for (i = 0; i < MAX_NUM_SYMBOLS; i++)
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_PALETTE);
+  if (idx >= PAL_LEN)
   {
-    if (m_symTbl[i].typeId == WIPE_ID_UNDEF)
-    {
-      /* Found an unused table entry */
-      if (MAX_NUM_SYMBOLS == freeIdx)
-        freeIdx = i;
-    }
-    else
-    {
-      if (strcmp(m_symTbl[i].symbol, identifier) == 0)
-      {
-        *idx = i;
-        return false;
-      }
-    }
+    m_palNodes &= ~radioDstSlaves(dst);
+    appendRadioOut8(0);
+    appendRadioOut8(0);
+  }
+  else
+  {
+    m_palNodes |= radioDstSlaves(dst);
+    appendRadioOut8(idx);
+    appendRadioOut8(1);
+    appendRadioOut8(r);
+    appendRadioOut8(g);
+    appendRadioOut8(b);
   }
-  if (freeIdx != MAX_NUM_SYMBOLS)
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    strncpy(m_symTbl[freeIdx].symbol, identifier, MAX_ID_LEN + 1);
-    m_symTbl[freeIdx].symbol[MAX_ID_LEN] = '\0';
-    m_symTbl[freeIdx].typeId = type;
-    m_symTbl[freeIdx].symValue.intValue = 0;
-    *idx = freeIdx;
-    return true;
+    logPrint(FLASH("PALETTE ->"));
+    logPrintln(dst);
   }
-  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSymbolLookup
-//   Find a symbol in the WIPE symbol table.
+// Function: fade
+//   Crossfade the strip(s) specified by the WASP destination address to a
+//   colour (see WASPCMD_FADE). This leaves indexed colour mode.
 // Parameters:
-//   identifier:I  - Identifier string.
-//   idx:O         - Symbol table index at which symbol was found. Value on
-//                   invocation is unchanged if the function returns false.
-// Returns: true iff the symbol was found.
+//   dst:I   - The WASP slave destination. This is either a single WASP
+//             slave node ID, a group ID, or BROADCASTID.
+//   r:I     - Amount of red in the final colour.
+//   g:I     - Amount of green in the final colour.
+//   b:I     - Amount of blue in the final colour.
+//   time:I  - Duration of the fade (in 100's of milliseconds).
+// Returns: (none)
 // Inputs/Outputs:
-//   m_symTbl:I
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeSymbolLookup(char *identifier, uint8 *idx)
+void fade(uint8 dst, uint8 r, uint8 g, uint8 b, uint8 time)
 {
-  uint8 i;
-
-  for (i = 0; i < MAX_NUM_SYMBOLS; i++)
-  {
-    if (m_symTbl[i].typeId != WIPE_ID_UNDEF)
-    {
-      if (strncmp(m_symTbl[i].symbol, identifier, MAX_ID_LEN) == 0)
-      {
-        *idx = i;
-        return true;
-      }
-    }
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_FADE);
+  appendRadioOut8(r);
+  appendRadioOut8(g);
+  appendRadioOut8(b);
+  appendRadioOut8(time);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
+  {
+    logPrint(FLASH("FADE ->"));
+    logPrintln(dst);
   }
-  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSymbolsShow
-//   Show the known symbols in the symbol table.
-// Parameters: (none)
+// Function: gradient
+//   Crossfade the strip(s) specified by the WASP destination address to a
+//   linear colour gradient (see WASPCMD_GRADIENT). This leaves indexed
+//   colour mode.
+// Parameters:
+//   dst:I   - The WASP slave destination. This is either a single WASP
+//             slave node ID, a group ID, or BROADCASTID.
+//   r:I     - Amount of red in the first pixel's final colour.
+//   g:I     - Amount of green in the first pixel's final colour.
+//   b:I     - Amount of blue in the first pixel's final colour.
+//   r2:I    - Amount of red in the last pixel's final colour.
+//   g2:I    - Amount of green in the last pixel's final colour.
+//   b2:I    - Amount of blue in the last pixel's final colour.
+//   time:I  - Duration of the fade (in 100's of milliseconds).
 // Returns: (none)
 // Inputs/Outputs:
-//   m_symTbl:I
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeSymbolsShow(void)
+void gradient( uint8 dst,
+               uint8 r,  uint8 g,  uint8 b,
+               uint8 r2, uint8 g2, uint8 b2, uint8 time )
 {
-  uint8 i, j;
-  boolean validEntry;
-
-  logPrintln(FLASH("\nSYMBOLS\nName\tType\t\tValue"));
-  logPrintln(FLASH("----\t----\t\t-----"));
-  for (i = 0; i < MAX_NUM_SYMBOLS; i++)
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_GRADIENT);
+  appendRadioOut8(r);
+  appendRadioOut8(g);
+  appendRadioOut8(b);
+  appendRadioOut8(r2);
+  appendRadioOut8(g2);
+  appendRadioOut8(b2);
+  appendRadioOut8(time);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    validEntry = true;
-    if (m_symTbl[i].typeId != WIPE_ID_UNDEF)
-    {
-      logPrint(m_symTbl[i].symbol);
-      for (j = strlen(m_symTbl[i].symbol); j <= MAX_ID_LEN; j++)
-        logPrint(FLASH(" "));
-      logPrint(FLASH("\t"));
-      switch (m_symTbl[i].typeId)
-      {
-        case WIPE_ID_LABEL:
-          logPrint(FLASH("label"));
-          break;
-        case WIPE_ID_INT:
-          logPrint(FLASH("int"));
-          break;
-        case WIPE_ID_FLOAT:
-          logPrint(FLASH("float"));
-          break;
-        case WIPE_ID_BOOL:
-          logPrint(FLASH("bool"));
-          break;
-        default:
-          logPrintln(FLASH("<unknown>"));
-          validEntry = false;
-      }
-      if (validEntry)
-      {
-        logPrint(FLASH("\t\t"));
-        switch (m_symTbl[i].typeId)
-        {
-          case WIPE_ID_LABEL:
-            logPrintln(m_symTbl[i].symValue.intValue);
-            break;
-          case WIPE_ID_INT:
-            logPrintln(m_symTbl[i].symValue.intValue);
-            break;
-          case WIPE_ID_FLOAT:
-            logPrintlnEx(m_symTbl[i].symValue.floatValue,5);
-            break;
-          case WIPE_ID_BOOL:
-            logPrintln(m_symTbl[i].symValue.boolValue);
-            break;
-          default:
-            logPrintln(FLASH("<unknown>"));
-        }
-      }
-    }
+    logPrint(FLASH("GRADIENT ->"));
+    logPrintln(dst);
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeListProgram
-//   Display program statements for a specified range of line numbers.
+// Function: bright
+//   Set the output brightness and gamma correction of the strip(s) specified
+//   by the WASP destination address (see WASPCMD_BRIGHT). This scales what
+//   the strips show, without redrawing them.
 // Parameters:
-//   startLine:I  - First line number to display.
-//   endLine:I    - Last line number to display.
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID, a group ID, or BROADCASTID.
+//   level:I  - Output brightness (BRIGHT_FULL = full).
+//   gamma:I  - Non-zero to gamma-correct the shown colours.
+//   time:I   - Duration of the fade to level (in 100's of milliseconds).
 // Returns: (none)
 // Inputs/Outputs:
-//   m_symTbl:I
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-void wipeListProgram(uint8 startLine, uint8 endLine)
+void bright(uint8 dst, uint8 level, uint8 gamma, uint8 time)
 {
-  uint16 savedWipeLineStart = m_wipeLineStart;
-  uint8  currLineNum;
-  uint8  currLineLen;
-
-  logPrintln();
-  m_wipeLineStart = 0;
-  currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
-  currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
-  while ( (currLineNum < startLine) && (m_wipeLineStart < m_wipeProgByte) )
-  {
-    m_wipeLineStart += currLineLen;
-    currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
-    currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
-  }
-
-  while ( (currLineNum <= endLine) && (m_wipeLineStart < m_wipeProgByte) )
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_BRIGHT);
+  appendRadioOut8(level);
+  appendRadioOut8(gamma);
+  appendRadioOut8(time);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    wipePrintStatement();
-    m_wipeLineStart += currLineLen;
-    currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
-    currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+    logPrint(FLASH("BRIGHT ->"));
+    logPrintln(dst);
   }
-
-  m_wipeLineStart = savedWipeLineStart;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeParseInt
-//   Scan for an integer value in the conole input buffer.
+// Function: waspReset
+//   Reset the destination node(s).
 // Parameters:
-//   intVal:O   - The integer value scanned, if the function returns true;
-//                zero, otherwise.
-//   advance:I  - If true, then advance the m_consolePos value past the
-//                scanned integer.
-// Returns: true iff a valid integer value was scanned.
+//   dst:I    - The WASP slave destination(s). This is either a single WASP
+//              slave node ID or BROADCASTID.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_consoleLen:I
-//   m_consolePos:IO
-//   m_tokenBuffer:IO
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeParseInt(int32 *intVal, boolean advance)
+void waspReset(uint8 dst)
 {
-  char *token = NULL;
-  uint8 tmp;
-
-  *intVal = 0;
-  if (m_consolePos >= m_consoleLen)
-    return false;
-  tmp = strspn(&m_tokenBuffer[m_consolePos], " ,\r\0");
-  token = strtok(&m_tokenBuffer[m_consolePos], " ,\r\0");
-  if (token != NULL)
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_RESET);
+  appendRadioOut8('D');
+  appendRadioOut8('E');
+  appendRadioOut8('A');
+  appendRadioOut8('D');
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    if (strspn(token, "+-0123456789") == strlen(token))
-    {
-      if ( (strlen(token) > 1) ||
-           ( (token[0] != '-') && (token[0] != '+') )
-         )
-      {
-        if (advance)
-          m_consolePos += strlen(token) + tmp + 1;
-        *intVal = atoi(token);
-        return true;
-      }
-    }
+    logPrint(FLASH("RESET ->"));
+    logPrintln(dst);
   }
-  dbgPrintln(FLASH("Couldn't parse integer"));
-  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalIntRelation
-//   Evaluate an integer relation.
-// Parameters:
-//   value1:IO     - The first operand value.
-//   value2:I      - The second operand value.
-//   operation:I   - The operator ID.
-// Returns: The truth of the relation.
-// Inputs/Outputs: (none)
+// Function: telemetryStart
+//   Query the telemetry of the telemetry destination node(s). Replies are
+//   collected by telemetryPoll().
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_telemDst:I
+//   m_verboseWasp:I
+//   m_nodeTelem:O
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//   m_telemCollecting:O
+//   m_telemEnd:O
+//   m_telemTxId:O
 //-----------------------------------------------------------------------------
-boolean wipeEvalIntRelation(int32 value1, int32 value2, uint8 operation)
+void telemetryStart(void)
 {
-  switch (operation)
+  for (uint8 i = 0; i < MAX_SLAVES; i++)
+    m_nodeTelem[i].valid = false;
+
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_TELEMETRY);
+  radioBatchFlush();
+  m_telemTxId = radioSendBuf(m_telemDst, m_radioOutBuf, m_radioOutBufPos,
+                             MIN_UPD_PERIOD);
+  m_telemCollecting = true;
+  m_telemEnd = millis() + PING_TIMEOUT;
+  if (m_verboseWasp)
   {
-    case WIPE_OP_EQ:
-      return (value1 == value2);
-    case WIPE_OP_NE:
-      return (value1 != value2);
-    case WIPE_OP_LT:
-      return (value1 < value2);
-    case WIPE_OP_LE:
-      return (value1 <= value2);
-    case WIPE_OP_GT:
-      return (value1 > value2);
-    case WIPE_OP_GE:
-      return (value1 >= value2);
-    default:
-      return false;
+    logPrint(FLASH("TELEMETRY ->"));
+    logPrintln(m_telemDst);
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalFloatRelation
-//   Evaluate an floating point relation.
-// Parameters:
-//   value1:IO     - The first operand value.
-//   value2:I      - The second operand value.
-//   operation:I   - The operator ID.
-// Returns: The truth of the relation.
-// Inputs/Outputs: (none)
+// Function: telemetryShow
+//   Display the telemetry collected from the slaves as a table.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_nodeTelem:I
+//   m_slotWind:I
 //-----------------------------------------------------------------------------
-boolean wipeEvalFloatRelation(float value1, float value2, uint8 operation)
+void telemetryShow(void)
 {
-  switch (operation)
+  NodeTelem_t *pTelem;
+
+  logPrintln(FLASH("\nNode\tRSSI\tRAM\tLate\tOMET (usec) of timer #1, #2, ..."));
+  for (uint8 i = 0; i < MAX_SLAVES; i++)
   {
-    case WIPE_OP_EQ:
-      return (value1 == value2);
-    case WIPE_OP_NE:
-      return (value1 != value2);
-    case WIPE_OP_LT:
-      return (value1 < value2);
-    case WIPE_OP_LE:
-      return (value1 <= value2);
-    case WIPE_OP_GT:
-      return (value1 > value2);
-    case WIPE_OP_GE:
-      return (value1 >= value2);
-    default:
-      return false;
+    pTelem = &m_nodeTelem[i];
+    if (!pTelem->valid)
+      continue;
+    logPrint(FIRST_SLAVE + i);
+    logPrint(FLASH("\t"));
+    logPrint(pTelem->rssi);
+    logPrint(FLASH("\t"));
+    logPrint(pTelem->freeRam);
+    logPrint(FLASH("\t"));
+    logPrint(pTelem->txLate);
+    for (uint8 j = 0; j < TELEM_NUM_TIMERS; j++)
+    {
+      logPrint(j == 0 ? FLASH("\t") : FLASH(","));
+      logPrint(pTelem->omet[j]);
+    }
+    logPrintln();
   }
+  for (uint8 g = 0; g < MAX_GROUPS; g++)
+  {
+    if (m_slotWind[g] != 0)
+    {
+      logPrint(FLASH("Group "));
+      logPrint(FIRST_GROUP + g);
+      logPrint(FLASH(": SHIFT slot window="));
+      logPrintln(m_slotWind[g]);
+    }
+  }
+  logPrintln(FLASH("=> TELEMETRY done"));
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalBoolRelation
-//   Evaluate an boolean relation.
-// Parameters:
-//   value1:IO     - The first operand value.
-//   value2:I      - The second operand value.
-//   operation:I   - The operator ID.
-// Returns: The truth of the relation.
-// Inputs/Outputs: (none)
+// Function: shiftAdaptSlots
+//   Fit each group's SHIFT slot window to the longest SHIFT response time
+//   (the end of its Tx) reported by the group's members in the latest
+//   telemetry collection.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_nodeGroup:I
+//   m_nodeTelem:I
+//   m_verboseWasp:I
+//   m_slotWind:IO
 //-----------------------------------------------------------------------------
-boolean wipeEvalBoolRelation(boolean value1, boolean value2, uint8 operation)
+void shiftAdaptSlots(void)
 {
-  switch (operation)
+  uint16 maxTx;
+  uint16 wind;
+
+  for (uint8 g = 0; g < MAX_GROUPS; g++)
   {
-    case WIPE_OP_EQ:
-      return (value1 == value2);
-    case WIPE_OP_NE:
-      return (value1 != value2);
-    default:
-      return false;
+    maxTx = 0;
+    for (uint8 i = 0; i < MAX_SLAVES; i++)
+    {
+      if ( (m_nodeGroup[i] == (FIRST_GROUP + g)) && m_nodeTelem[i].valid &&
+           (m_nodeTelem[i].omet[TELEM_SHFT_TX1] > maxTx) )
+        maxTx = m_nodeTelem[i].omet[TELEM_SHFT_TX1];
+    }
+    if (0 == maxTx)
+      continue;  // No member has responded to a SHIFT yet.
+
+    wind = (maxTx + 999) / 1000 + SLOT_GUARD_MS;
+    if (wind < MIN_SLOT_WIND)
+      wind = MIN_SLOT_WIND;
+    else if (wind > MAX_SLOT_WIND)
+      wind = MAX_SLOT_WIND;
+    if (wind != m_slotWind[g])
+    {
+      m_slotWind[g] = wind;
+      if (m_verboseWasp)
+      {
+        logPrint(FLASH("SLOTS: Group "));
+        logPrint(FIRST_GROUP + g);
+        logPrint(FLASH(" window="));
+        logPrintln(wind);
+      }
+    }
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalIntOperation
-//   Evaluate a simple (unary or binary) integer expression.
-// Parameters:
-//   value1:IO     - Address of the first operand value and into which the
-//                   the result is stored upon return.
-//   value2:I      - The second operand value. The value is ignored if
-//                   operation is unary.
-//   operation:I   - The operator ID.
-// Returns: true, iff the operation is valid for this type.
-// Inputs/Outputs: (none)
+// Function: telemetryPoll
+//   Record telemetry replies while a collection is in progress, showing the
+//   results when it ends, and start a new collection when one is due while
+//   a WIPE program runs.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_numWipeTasks:I
+//   m_radioInBuf:I
+//   m_srcNodeId:I
+//   m_telemPeriod:I
+//   m_telemTxId:I
+//   m_nodeTelem:IO
+//   m_telemEnd:IO
+//   m_radioInBufPos:IO
+//   m_rxWaspRsp:IO
+//   m_telemCollecting:IO
+//   m_telemNext:IO
 //-----------------------------------------------------------------------------
-boolean wipeEvalIntOperation(int32 *value1, int32 value2, uint8 operation)
+void telemetryPoll(void)
 {
-  switch (operation)
+  NodeTelem_t *pTelem;
+  uint8       *buf;
+
+  if (m_telemCollecting)
   {
-    case WIPE_OP_NEG:
-      *value1 = -*value1;
-      break;
-    case WIPE_OP_PLUS:
-      *value1 = *value1 + value2;
-      break;
-    case WIPE_OP_MINUS:
-      *value1 = *value1 - value2;
-      break;
-    case WIPE_OP_MULT:
-      *value1 = *value1 * value2;
-      break;
-    case WIPE_OP_DIV:
-      *value1 = *value1 / value2;
-      break;
-    case WIPE_OP_MOD:
-      *value1 = *value1 % value2;
-      break;
-    default:
-      return false;
+    if ( (WASPCMD_TELEMETRY == m_rxWaspRsp) &&
+         (m_srcNodeId >= FIRST_SLAVE) &&
+         (m_srcNodeId < (FIRST_SLAVE + MAX_SLAVES)) )
+    {
+      pTelem = &m_nodeTelem[m_srcNodeId - FIRST_SLAVE];
+      buf = &m_radioInBuf[m_radioInBufPos];
+      pTelem->rssi    = (int16)(buf[0] | ((uint16)buf[1] << 8));
+      pTelem->freeRam = buf[2] | ((uint16)buf[3] << 8);
+      pTelem->txLate  = buf[4] | ((uint16)buf[5] << 8);
+      buf += 6;
+      for (uint8 i = 0; i < TELEM_NUM_TIMERS; i++, buf += 2)
+        pTelem->omet[i] = buf[0] | ((uint16)buf[1] << 8);
+      pTelem->valid = true;
+      m_rxWaspRsp = WASPCMD_NONE;
+    }
+    if (!radioTxSent(m_telemTxId))
+      m_telemEnd = millis() + PING_TIMEOUT;  // Time the replies from the send
+    if ((int32)(millis() - m_telemEnd) >= 0)
+    {
+      m_telemCollecting = false;
+      shiftAdaptSlots();
+      telemetryShow();
+    }
+  }
+  else if ( (m_telemPeriod != 0) && (m_numWipeTasks != 0) &&
+            ((int32)(millis() - m_telemNext) >= 0) && radioTxReady() )
+  {
+    m_telemNext = millis() + (uint32)m_telemPeriod * 1000;
+    telemetryStart();
   }
-  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalFloatOperation
-//   Evaluate a simple (unary or binary) floating point expression.
-// Parameters:
-//   value1:IO     - Address of the first operand value and into which the
-//                   the result is stored upon return.
-//   value2:I      - The second operand value. The value is ignored if
-//                   operation is unary.
-//   operation:I   - The operator ID.
-// Returns: true, iff the operation is valid for this type.
-// Inputs/Outputs: (none)
-//-----------------------------------------------------------------------------
-boolean wipeEvalFloatOperation(float *value1, float value2, uint8 operation)
+// Function: syncPoll
+//   Queue a time-sync beacon for all slaves whenever one is due. Its time is
+//   filled in by syncStamp() when it's actually sent, so time spent in the
+//   Tx queue doesn't count as clock error. Beacons are only sent while a
+//   WIPE program runs or a slave runs an effect, or for MCAST_TAIL_BEACONS
+//   after the last MCAST command, so an idle network stays quiet. Each one
+//   carries the last seq sent on every multicast stream, so that a slave
+//   that missed the last MCAST commands can NACK them.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_mcastSeq:I
+//   m_mcastStarted:I
+//   m_mirror:I
+//   m_numWipeTasks:I
+//   m_syncPeriod:I
+//   m_mcastTail:IO
+//   m_syncNext:IO
+//-----------------------------------------------------------------------------
+void syncPoll(void)
 {
-  switch (operation)
+  uint8   beacon[8 + 2 * (1 + MAX_GROUPS)];
+  uint8   len = 8;
+  boolean active = (m_numWipeTasks != 0) || (m_mcastTail != 0);
+
+  for (uint8 i = 0; !active && (i < MAX_SLAVES); i++)
+    active = (m_mirror[i].fx[0] != WASPCMD_NONE);
+
+  if ( !active || (0 == m_syncPeriod) ||
+       ((int32)(millis() - m_syncNext) < 0) || !radioTxReady() )
+    return;
+
+  m_syncNext = millis() + (uint32)m_syncPeriod * 100;
+  if (m_mcastTail != 0)
+    m_mcastTail--;
+  beacon[0] = WASPCMD_SYNC;
+  for (uint8 stream = 0; stream <= MAX_GROUPS; stream++)
   {
-    case WIPE_OP_NEG:
-      *value1 = -*value1;
-    case WIPE_OP_PLUS:
-      *value1 = *value1 + value2;
-      break;
-    case WIPE_OP_MINUS:
-      *value1 = *value1 - value2;
-      break;
-    case WIPE_OP_MULT:
-      *value1 = *value1 * value2;
-      break;
-    case WIPE_OP_DIV:
-      *value1 = *value1 / value2;
-      break;
-    default:
-      return false;
+    if (m_mcastStarted & (1 << stream))
+    {
+      beacon[len++] = stream;
+      beacon[len++] = m_mcastSeq[stream] - 1;
+    }
   }
-  return true;
+  (void)radioSendBuf(BROADCASTID, beacon, len, MIN_UPD_PERIOD);
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeEvalBoolOperation
-//   Evaluate a simple (unary or binary) boolean point expression.
-// Parameters:
-//   value1:IO     - Address of the first operand value and into which the
-//                   the result is stored upon return.
-//   value2:I      - The second operand value. The value is ignored if
-//                   operation is unary.
-//   operation:I   - The operator ID.
-// Returns: true, iff the operation is valid for this type.
+// Function: syncFrame
+//   Get the current network frame number (which the slaves track from the
+//   time-sync beacons).
+// Parameters: (none)
+// Returns: The network frame # (of SYNC_FRAME_MS each).
 // Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-boolean wipeEvalBoolOperation(boolean *value1, boolean value2, uint8 operation)
+uint16 syncFrame(void)
 {
-  switch (operation)
-  {
-    case WIPE_OP_COMPL:
-      *value1 = !*value1;
-    case WIPE_OP_OR:
-      *value1 = *value1 + value2;
-      break;
-    case WIPE_OP_AND:
-      *value1 = *value1 - value2;
-      break;
-    default:
-      return false;
-  }
-  return true;
+  return (uint16)(millis() / SYNC_FRAME_MS);
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeIsRelational
-//   Determine if an operator is a relational operator.
+// Function: syncStamp
+//   Fill in a time-sync beacon's network frame # and time from my clock.
 // Parameters:
-//   operation:I  - ID of the operator to check.
-// Returns: true, iff operation is a relational operator.
+//   p:O  - The beacon's command buffer (WASPCMD_SYNC command byte first).
+// Returns: (none)
 // Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-boolean wipeIsRelational(uint8 operation)
+void syncStamp(uint8 *p)
 {
-  switch (operation)
-  {
-    case WIPE_OP_EQ:
-    case WIPE_OP_NE:
-    case WIPE_OP_LT:
-    case WIPE_OP_LE:
-    case WIPE_OP_GT:
-    case WIPE_OP_GE:
-      break;
-    default:
-      return false;
-  }
-  return true;
+  uint32 now = millis();
+  uint16 frame = syncFrame();
+
+  p[1] = frame & 0xFF;
+  p[2] = frame >> 8;
+  p[3] = now % SYNC_FRAME_MS;
+  p[4] = now & 0xFF;
+  p[5] = (now >> 8) & 0xFF;
+  p[6] = (now >> 16) & 0xFF;
+  p[7] = now >> 24;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeAssign
-//   Assign a value to a variable with type casting where possible.
+// Function: fxSpeed
+//   Adjust the speed of an animated effect that runs on the destination
+//   node(s) without controller intervention (e.g. RAINBOW()).
 // Parameters:
-//   var:O      - Address of variable to assign.
-//   varType:I  - Assigned variable's type.
-//   value:I    - Value to be assigned.
-//   valType:I  - Value's type.
-// Returns: true, iff the assignment was possible.
-// Inputs/Outputs: (none)
+//   dst:I       - The WASP slave destination. This is either a single WASP
+//                 slave node ID or BROADCASTID to change the pixel colours
+//                 on all LED strips.
+//   delayVal:I  - Relative delay. Smaller values increase the effect's
+//                 speed. However, a value of 0 pauses the effect.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_verboseWasp:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeAssign( SymValue_t *var, uint8 varType, SymValue_t value,
-                    uint8 valType )
-{  
-  if (varType == valType)
-  {
-    *var = value;
-    return true;
-  }
-  else if (WIPE_ID_BOOL == varType)
-  {
-    if ( (WIPE_ID_INT == valType) &&
-         ((0 == value.intValue) || (1 == value.intValue))
-       )
-    {
-      *var = value;
-      return true;
-    }
-  }
-  else if (WIPE_ID_INT == varType)
-  {
-    if (WIPE_ID_BOOL == valType)
-    {
-      *var = value;
-      return true;
-    }
-    else
-    {
-      if (WIPE_ID_FLOAT == valType)
-      {
-        if ( (value.floatValue >= (float)MININT32) &&
-             (value.floatValue <= (float)MAXINT32) )
-        {
-          (*var).intValue = (int)value.floatValue;
-          return true;
-        }
-      }
-    }
-  }
-  else
+void fxSpeed( uint8 dst, uint8 delayVal )
+{
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_SPEED);
+  appendRadioOut8(delayVal);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    if (WIPE_ID_FLOAT == varType)
-    {
-      if (WIPE_ID_INT == valType)
-      {
-        (*var).floatValue = (float)value.intValue;
-        return true;
-      }
-      else
-      {
-        if (WIPE_ID_BOOL == valType)
-        {
-          (*var).floatValue = (float)value.boolValue;
-          return true;
-        }
-      }
-    }
+    logPrint(FLASH("SPEED ->"));
+    logPrint(dst);
+    logPrint("  ");
+    logPrintln(delayVal);
   }
-  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeAreTypesValid
-//   Determine if a given binary operator applied to two operands yields the
-//   specified result type.
+// Function: rainbow
+//   Run a rainbow effect on the destination node(s). This leaves indexed
+//   colour mode.
 // Parameters:
-//   operation:I  - Operator.
-//   type1:I      - First operand's type.
-//   value1:I     - First operand's value.
-//   type2:I      - Second operand's type.
-//   value2:I     - Second operand's value.
-//   resType:I    - Result type expected.
-// Returns: true, iff the operands are type-compatible within the context
-//                of the operator being applied.
-// Inputs/Outputs: (none)
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID or BROADCASTID to change the pixel colours
+//              on all LED strips.
+//   offs:I   - The number of pixel position colours to offset for the
+//              first pixel.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeAreTypesValid( uint8      operation,
-                           uint8      type1,
-                           SymValue_t value1,
-                           uint8      type2,
-                           SymValue_t value2,
-                           uint8      resType ) 
+void rainbow(uint8 dst, uint8 offs)
 {
-  SymValue_t tmpVal;
-
-  if (type1 == type2)
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_RAINBOW);
+  appendRadioOut8(offs);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    if (resType == type1)
-    {
-      return true;
-    }
-    else
-    {
-      if ( (WIPE_ID_BOOL == resType) && wipeIsRelational(operation) )
-        return true;
-    }
+    logPrint(FLASH("RAINBOW ->"));
+    logPrintln(dst);
   }
-  else
-  {
-    /* type1 != type2 */
-    if ( (WIPE_ID_BOOL == type1) || (WIPE_ID_BOOL == type2) )
-    {
-      if (WIPE_ID_BOOL == type1)
-        tmpVal = value2;
-      else
-        tmpVal = value1;
-      if ( (0 == tmpVal.intValue) || (1 == tmpVal.intValue) )
-      {
-        if (WIPE_ID_BOOL == resType)
-          return true;
-      }
-    }
-  }
-  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeScanToken
-//   Scan for the next token in the WIPE command line.
-// Parameters: (none)
-// Returns: WIPE_UNDEF or WIPE token (e.g. WIPE_GOTO, WIPE_LABEL, etc.).
+// Function: rainbowCycle
+//   Run a rainbow effect on the destination node(s) where the pixels on
+//   each node span the range of rainbow colours all the time. This leaves
+//   indexed colour mode.
+// Parameters:
+//   dst:I    - The WASP slave destination. This is either a single WASP
+//              slave node ID or BROADCASTID to change the pixel colours
+//              on all LED strips.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_consoleLen:I
-//   m_consolePos:IO
-//   m_tokenBuffer:IO
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-uint8 wipeScanToken(void)
+void rainbowCycle(uint8 dst)
 {
-  char   *token = NULL;
-  uint8   tmp;
-
-  if (m_consolePos >= m_consoleLen)
-    return WIPE_UNDEF;
-  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
-  token = strtok(&m_tokenBuffer[m_consolePos], " (\n");
-  m_consolePos += tmp;
-    
-  if (token != NULL)
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_RAINCYCLE);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    m_consolePos += strlen(token) + 1;
-    if (strcmp(token, "if") == 0)
-      return WIPE_IF;
-    else if (strcmp(token, "goto") == 0)
-      return WIPE_GOTO;
-    else if (strcmp(token, "label") == 0)
-      return WIPE_LABEL;
-    else if (strcmp(token, "let") == 0)
-      return WIPE_LET;
-    else if (strcmp(token, "var") == 0)
-      return WIPE_VAR;
-    else if (strcmp(token, "print") == 0)
-      return WIPE_PRINT;
-    else
-    {
-      if (m_consoleBuffer[m_consolePos - 1] != '(')
-      {
-        return WIPE_UNDEF;
-      }
-      if (token != NULL)
-      {
-        if (strcmp(token, "Bkgrd") == 0)
-          return WASPCMD_BKGRD;
-        else if (strcmp(token, "Group") == 0)
-          return WASPCMD_GROUP;
-        else if (strcmp(token, "Line") == 0)
-          return WASPCMD_LINE;
-        else if (strcmp(token, "Reset") == 0)
-          return WASPCMD_RESET;
-        else if (strcmp(token, "State") == 0)
-          return WASPCMD_STATE;
-        else if (strcmp(token, "Shift") == 0)
-          return WASPCMD_SHIFT;
-        else if (strcmp(token, "Swap") == 0)
-          return WASPCMD_SWAP;
-        else if (strcmp(token, "Rain") == 0)
-          return WASPCMD_RAINBOW;
-        else if (strcmp(token, "Cycle") == 0)
-          return WASPCMD_RAINCYCLE;
-        else if (strcmp(token, "Speed") == 0)
-          return WASPCMD_SPEED;
-        else if (strcmp(token, "Twinkle") == 0)
-          return WASPCMD_TWINKLE;
-        else if (strcmp(token, "Pause") == 0)
-          return WIPE_FN_PAUSE;
-        else
-          return WIPE_UNDEF;
-      }
-    }
+    logPrint(FLASH("RAINCYCLE ->"));
+    logPrintln(dst);
   }
-  return WIPE_UNDEF;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeScanIdentifier
-//   Scan for an identifier.
+// Function: twinkle
+//   Run a twinkling effect on the destination node(s). This leaves indexed
+//   colour mode.
 // Parameters:
-//   identifier:O  - Pointer to identifier string, if the function returns
-//                   true; NULL, otherwise.
-//   maxLen:I      - Max # of characters allowed in identifier.
-// Returns: Length of identifier, if a valid identifier was scanned; zero,
-//          otherwise.
+//   dst:I     - The WASP slave destination. This is either a single WASP
+//               slave node ID or BROADCASTID.
+//   minDly:I  - The minimum delay between twinkles on any given node.
+//   maxDly:I  - The maximum delay between twinkles on any given node.
+//   burst:I   - The maximum number of pixels that can twinkle simultaneously
+//               on any given node.
+//   hold:I    - The duration for which a twinkle lasts.
+// Returns: (none)
 // Inputs/Outputs:
-//   m_consoleLen:I
-//   m_consolePos:IO
-//   m_tokenBuffer:IO
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-uint8 wipeScanIdentifier(char **identifier, uint8 maxLen)
+void twinkle(uint8 dst, uint8 minDly, uint8 maxDly, uint8 burst, uint8 hold)
 {
-  char    *token = NULL;
-  char     tmpStr[1] = "";
-  uint8    strLen;
-  uint8    tmp;
-  uint8    i;
-
-  *identifier = NULL;
-  if (m_consolePos >= m_consoleLen)
-    return false;
-  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
-  token = strtok(&m_tokenBuffer[m_consolePos], " \n");
-  m_consolePos += tmp;
-  if (token != NULL)
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_TWINKLE);
+  appendRadioOut8(minDly);
+  appendRadioOut8(maxDly);
+  appendRadioOut8(burst);
+  appendRadioOut8(hold);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
   {
-    strLen = strlen(token);
-    m_consolePos += strLen + 1;
-    for (i = 0; i < strLen; i++)
-    {
-      if (!isalnum(token[i]) && (token[i] != '_') )
-      {
-        wipeShowError(FLASH("Bad ID"));
-        return 0;
-      }
-    }
-    if ( isdigit(token[0]) || (0 == strLen) )
-    {
-      wipeShowError(FLASH("Bad ID"));
-      return 0;
-    }
-    if (strLen > maxLen)
-    {
-      wipeShowError(FLASH("ID too long"));
-      return 0;
-    }
-
-    *identifier = token;
-    return strLen;
+    logPrint(FLASH("TWINKLE ->"));
+    logPrintln(dst);
   }
-  return 0;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeShowExprErr
-//   Show detected error in an expression string.
+// Function: scriptCode
+//   Append an instruction to the effect script being assembled. Nothing is
+//   sent; see scriptUpload().
 // Parameters:
-//   expStr:I   - Pointer to the expression string.
-//   errPos:I   - Position at which error is detected within the expression.
-//   eval:I     - An expression is being evaluate, if true. An expression is
-//                just being parsed, if false.
-//   errStr:I   - Error string to display. The argument should be provided
-//                using the FLASH() macro:
-//                  e.g. wipeShowExprErr(FLASH("Error text"));
+//   op:I  - Instruction opcode (SOP_... value).
+//   x:I   - First operand byte.
+//   y:I   - Second operand byte.
+//   z:I   - Third operand byte.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_consolePos:I
-//   m_exprOffs:I
-//   m_wipeRunByte:I
+//   m_scriptCode:O
+//   m_scriptCodeLen:IO
 //-----------------------------------------------------------------------------
-void wipeShowExprErr(char    *exprStr,
-                     uint8    errPos,
-                     boolean  eval,
-                     const __FlashStringHelper *errStr)
+void scriptCode(uint8 op, uint8 x, uint8 y, uint8 z)
 {
-  if (eval)
+  if ((m_scriptCodeLen + SCRIPT_INSTR_LEN) > SCRIPT_MAX_LEN)
   {
-    /* Pretty print the tokenized WIPE statement. */
-    wipePrintStatement();
-    for (uint8 i = 0; i < (m_wipeRunByte + errPos); i++)
-      logPrint(FLASH(" "));
+    logPrintln(FLASH("***ERROR: Script too long"));
+    return;
   }
-  else
+  m_scriptCode[m_scriptCodeLen++] = op;
+  m_scriptCode[m_scriptCodeLen++] = x;
+  m_scriptCode[m_scriptCodeLen++] = y;
+  m_scriptCode[m_scriptCodeLen++] = z;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: scriptUpload
+//   Upload the effect script assembled by scriptCode() to a script slot of
+//   the node(s) specified by the WASP destination address, and start
+//   assembling a new script.
+// Parameters:
+//   dst:I   - The WASP slave destination. This is either a single WASP
+//             slave node ID, a group ID, or BROADCASTID.
+//   slot:I  - Script slot # (0 .. SCRIPT_NUM_SLOTS - 1).
+// Returns: (none)
+// Inputs/Outputs:
+//   m_scriptCode:I
+//   m_verboseWasp:I
+//   m_scriptCodeLen:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//-----------------------------------------------------------------------------
+void scriptUpload(uint8 dst, uint8 slot)
+{
+  uint8 offs = 0;
+  uint8 len;
+
+  radioBatchFlush();
+  do
   {
-    /* Output the raw ASCII console line being that's being parsed */
-    wipeShowConsoleLine();
-    for (uint8 i = 0; i < (m_consolePos + m_exprOffs + errPos); i++)
-      logPrint(FLASH(" "));
-  }
+    len = m_scriptCodeLen - offs;
+    if (len > SCRIPT_CHUNK_LEN)
+      len = SCRIPT_CHUNK_LEN;
 
-  logPrintln(FLASH("^"));
-  logPrintln(errStr);
+    m_radioOutBufPos = 0;
+    appendRadioOut8(WASPCMD_SCRIPT);
+    appendRadioOut8(slot);
+    appendRadioOut8(offs);
+    appendRadioOut8((offs + len) >= m_scriptCodeLen ? SCRIPT_F_LAST : 0);
+    memcpy(&m_radioOutBuf[m_radioOutBufPos], &m_scriptCode[offs], len);
+    m_radioOutBufPos += len;
+
+    // The first packet erases the slot, which holds up the slave(s).
+    (void)radioSendBuf(dst, m_radioOutBuf, m_radioOutBufPos,
+                       (0 == offs ? SCRIPT_ERASE_MS : MIN_UPD_PERIOD));
+    offs += len;
+  } while (offs < m_scriptCodeLen);
+
+  if (m_verboseWasp)
+  {
+    logPrint(FLASH("SCRIPT ->"));
+    logPrint(dst);
+    logPrint(" ");
+    logPrintln(m_scriptCodeLen);
+  }
+  m_scriptCodeLen = 0;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeScanOperator
-//   Scan for an operator in an expression.
+// Function: scriptRun
+//   Run an uploaded effect script on the node(s) specified by the WASP
+//   destination address. This leaves indexed colour mode.
 // Parameters:
-//   ppPos:IO   - Address of a pointer to the current character in the
-//                expression string. Upon invocation, this should point to a
-//                string position preceding a presumed operand. Upon
-//                return this points to the first white space character
-//                following the operand, if the function returns false;
-//                otherwise it points to the position at which the error
-//                was detected.
-//   pKind:O    - Address at which to return the kind of operator (e.g.
-//                WIPE_OP_PLUS).
-//   pOpLen:O   - Number of characters in the operator.
-//   pScanLen:O - Address at which to return the total number of characters
-//                scanned.
-// Returns: true, iff a valid operator was successfully scanned or the end
-//                of line was reached.
-// Inputs/Outputs: (none)
+//   dst:I   - The WASP slave destination. This is either a single WASP
+//             slave node ID, a group ID, or BROADCASTID.
+//   slot:I  - Script slot # (0 .. SCRIPT_NUM_SLOTS - 1).
+// Returns: (none)
+// Inputs/Outputs:
+//   m_verboseWasp:I
+//   m_palNodes:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
 //-----------------------------------------------------------------------------
-boolean wipeScanOperator( char **ppPos, uint8 *pKind, uint8 *pOpLen,
-                          uint8 *pScanLen )
+void scriptRun(uint8 dst, uint8 slot)
 {
-  char     c;
-  char    *pChar;
-  boolean  ret;
-  
-  *pKind = WIPE_OP_UNDEF;
-  pChar = *ppPos;
-  *pScanLen = 0;
+  m_palNodes &= ~radioDstSlaves(dst);
+  m_radioOutBufPos = 0;
+  appendRadioOut8(WASPCMD_SCRIPT_RUN);
+  appendRadioOut8(slot);
+  radioSendCmd(dst);
+  if (m_verboseWasp)
+  {
+    logPrint(FLASH("SCRIPT_RUN ->"));
+    logPrintln(dst);
+  }
+}
 
-  /* Skip white space */
-  c = *pChar++;
-  while (c == ' ')
-    c = *pChar++;
 
-  if ( ('\r' == c) || ('\0' == c) )
+
+//-----------------------------------------------------------------------------
+// Function: schedAt
+//   Schedule the batchable WASP commands that follow (see WASP_BATCHABLE())
+//   for execution by the slaves at the start of the network frame that's a
+//   given number of frames from now, so that a whole scene can be sent ahead
+//   of time and shown on all the nodes at once.
+// Parameters:
+//   frames:I  - # of network frames (of SYNC_FRAME_MS each) from now;
+//               0 to turn scheduling off.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_verboseWasp:I
+//   m_schedFrame:O
+//   m_schedOn:O
+//-----------------------------------------------------------------------------
+void schedAt(uint8 frames)
+{
+  radioBatchFlush();
+  m_schedOn = (frames != 0);
+  m_schedFrame = syncFrame() + frames;
+  if (m_verboseWasp)
   {
-    return true;
+    logPrint(FLASH("AT frame "));
+    logPrintln(m_schedOn ? m_schedFrame : 0);
   }
+}
 
-  *pScanLen = pChar - *ppPos;
-  *ppPos = pChar;
+
+/*****************************************************************************
+ *  SECTION  ******  WASP Interactive Programming Environment ****************
+ *****************************************************************************/
+
+// Use the following #define and #if definitions to temporarily
+// disable wipeShowHelp() if Flash memory program space is getting short.
+//#define wipeShowHelp()
+//#if 0
+//-----------------------------------------------------------------------------
+// Function: wipeShowHelp
+//   Show help text on the console.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+void wipeShowHelp(void)
+{
+  logPrintln(FLASH("\n"));
+  logPrintln(FLASH("** WIPE Help **\n"));
+  logPrintln(FLASH("WIPE is BASIC-like and case sensitive"));
+  logPrintln(FLASH("- To edit a line, use same line #"));
+
+
+  logPrintln(FLASH("\nCOMMANDS"));
+  logPrintln(FLASH("del <m> [- n]\t- Delete line m thru n"));
+  logPrintln(FLASH("dir\t\t- List saved programs"));
+  logPrintln(FLASH("erase <name>\t- Delete program"));
+  logPrintln(FLASH("exit\t\t- Exit WIPE"));
+  logPrintln(FLASH("help\t\t- Show help"));
+  logPrintln(FLASH("load <name>\t- Load program"));
+  logPrintln(FLASH("list m [- n]\t- List lines m thru n"));
+  logPrintln(FLASH("mrun <names>\t- Run saved programs together"));
+  logPrintln(FLASH("prof\t\t- Show all symbols"));
+  logPrintln(FLASH("renum\t\t- Renumber lines evenly from 5 - 250"));
+  logPrintln(FLASH("run\t\t- Run program; 'x' to quit."));
+  logPrintln(FLASH("save <name>\t- Save program"));
+  logPrintln(FLASH("start <name>\t- Set startup program"));
+
+
+  logPrintln(FLASH("\nSTATEMENTS"));
+  logPrintln(FLASH("if <expr>\t\tSkip next line if <expr> false"));
+  logPrintln(FLASH("label <id>"));
+  logPrintln(FLASH("let <id> = <expr>"));
+  logPrintln(FLASH("goto <label-id>"));
+  logPrintln(FLASH("print <expr>"));
+  logPrintln(FLASH("var <id> : <type>\tin {int, float, bool}"));
+  logPrintln(FLASH("<func>(<params>)  (see FUNCTIONS)"));
+  logPrintln(FLASH("\n  where: <expr> is with no precedence"));
+
+  
+  logPrintln(FLASH("\n... <Enter>"));
+  while (Serial.available() == 0)
+    ;
+  Serial.read();
+
+
+  logPrintln(FLASH("\nFUNCTIONS"));
+
+  logPrintln(FLASH("GENERAL"));
+  logPrintln(FLASH("\tPause(min,sec,100ths)"));
+  logPrintln(FLASH("\tAt(n)\t\tApply batchable cmds that follow n"));
+  logPrintln(FLASH("\t\t\tframes (20ms) from now (n=0: on receipt)"));
+  
+  logPrintln(FLASH("WASP GENERIC"));
+  logPrintln(FLASH("\tBkgrd(dst,r,g,b)"));
+  logPrintln(FLASH("\tGroup(dst,grp,l,r)"));
+  logPrintln(FLASH("\tLine(dst,r,g,b,start,len)"));
+  logPrintln(FLASH("\tReset(dst)"));
+  logPrintln(FLASH("\tShift(dst,shift)"));
+  logPrintln(FLASH("\tState(dst,opts),\topts is OR'd collection of "));
+  logPrintln(FLASH("\t\t\t\t{SAVE(1), RESTORE(2), RESUME(4), SUSPEND(8)}"));
+  logPrintln(FLASH("\tSwap(dst,r,g,b,r',g',b')"));
+  logPrintln(FLASH("\tPalette(dst,i,r,g,b)\tSet palette entry (0-15) for"));
+  logPrintln(FLASH("\t\t\t\tindexed colour; i=16: direct colour"));
+  logPrintln(FLASH("\tFade(dst,r,g,b,t)\tCrossfade to colour over t 10ths"));
+  logPrintln(FLASH("\t\t\t\tof a second"));
+  logPrintln(FLASH("\tGradient(dst,r,g,b,r',g',b',t)"));
+  logPrintln(FLASH("\t\t\t\tCrossfade to gradient from r,g,b"));
+  logPrintln(FLASH("\t\t\t\tto r',g',b' over t 10ths of a second"));
+  logPrintln(FLASH("\tBright(dst,lvl,gam,t)\tFade output brightness (255 ="));
+  logPrintln(FLASH("\t\t\t\tfull) over t 10ths; gam=1: gamma"));
+  logPrintln(FLASH("\t\t\t\tcorrected output"));
+
+  logPrintln(FLASH("\nCANVAS"));
+  logPrintln(FLASH("\tPaint(r,g,b,start,len)\tDraw on canvas (not sent)"));
+  logPrintln(FLASH("\tPixels(dst,start,len)\tUpload canvas region"));
+
+  logPrintln(FLASH("\nSCRIPTS"));
+  logPrintln(FLASH("\tCode(op,x,y,z)\tAdd script instruction (not sent)"));
+  logPrintln(FLASH("\tScript(dst,slot)\tUpload script"));
+  logPrintln(FLASH("\tRunFx(dst,slot)\tRun script as FX (see Speed)"));
+
+  logPrintln(FLASH("\nSPECIAL FX"));
+  logPrintln(FLASH("\tRain(dst,start)"));
+  logPrintln(FLASH("\tCycle(dst)"));
+  logPrintln(FLASH("\tSpeed(dst, dly)\tFX speed"));
+  logPrintln(FLASH("\tTwinkle(dst,minDly,maxDly,burst,hold)"));
+  logPrintln();
+}
+//#endif
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDumpProgramHex
+//   Dump program memory to the console.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_program:I
+//   m_wipeProgByte:I
+// Notes:
+//   This function is intended for WIPE interpreter debugging purposes.
+//-----------------------------------------------------------------------------
+void wipeDumpProgramHex(void)
+{
+  uint8  *pCurrByte;
+  uint16  i;
+  uint8   hexByte;
+
+  pCurrByte = &m_program[0];
+  logPrintln();
+  logPrintln(FLASH("PROG HEX DUMP:"));
+  for (i = 0; i < 10; i++)
+  {
+    logPrint(FLASH("  "));
+    logPrint(i);
+    logPrint(' ');
+  }
+  logPrintln();
+  
+  for (i = 10; i !=0; i--)
+  {
+    logPrint(FLASH("--- "));
+  }
+  logPrintln();
+
+  for (i = 0; i < m_wipeProgByte; i++)
+  {
+    hexByte = *pCurrByte++;
+    if (hexByte < 100)
+      logPrint(FLASH(" "));
+    if (hexByte < 10)
+      logPrint(FLASH(" "));
+    logPrint(hexByte);
+    logPrint(FLASH(" "));
+    if ( (i % 10) == 9 )
+      logPrintln();
+  }
+  logPrintln();
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirNameHash
+//   Hash a program file name for the RAM directory index.
+// Parameters:
+//   progName:I  - Program file name string.
+// Returns: The 8-bit hash of the name.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+uint8 wipeDirNameHash(const char *progName)
+{
+  uint8 hash = 0;
+
+  for (uint8 i = 0; (i < MAX_PROGNAME_LEN) && (progName[i] != '\0'); i++)
+    hash = (uint8)((hash << 1) | (hash >> 7)) ^ (uint8)progName[i];
+  return hash;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirReadByte
+//   Read a byte from the WIPE program store: SPI flash, if fitted, or
+//   EEPROM.
+// Parameters:
+//   addr:I  - Address of the byte in the store.
+// Returns: The byte's value.
+// Inputs/Outputs:
+//   m_flashPresent:I
+//-----------------------------------------------------------------------------
+uint8 wipeDirReadByte(uint32 addr)
+{
+  if (m_flashPresent)
+    return m_flash.readByte(addr);
+  return EEPROM.read((uint16)addr);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgCrc
+//   Add a byte to a CRC-16/CCITT (polynomial 0x1021) checksum.
+// Parameters:
+//   crc:I   - Checksum of the preceding bytes.
+//   data:I  - The byte.
+// Returns: The updated checksum.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+uint16 wipeImgCrc(uint16 crc, uint8 data)
+{
+  crc ^= (uint16)data << 8;
+  for (uint8 i = 0; i < 8; i++)
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  return crc;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgCursorInit
+//   Set up to put or get the bytes of a program image.
+// Parameters:
+//   pCur:O    - Image cursor.
+//   addr:I    - Store address of the first byte.
+//   limit:I   - # of bytes that can be got.
+//   write:I   - true, to put bytes in the store; false, to just count them.
+// Returns: (none)
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+void wipeImgCursorInit(ImgCursor_t *pCur, uint32 addr, uint16 limit,
+                       boolean write)
+{
+  pCur->addr = addr;
+  pCur->len = 0;
+  pCur->limit = limit;
+  pCur->crc = 0xFFFF;
+  pCur->write = write;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgPut
+//   Put the next byte of a program image in the store: SPI flash, if fitted,
+//   or EEPROM.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   data:I   - The byte.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//-----------------------------------------------------------------------------
+void wipeImgPut(ImgCursor_t *pCur, uint8 data)
+{
+  if (pCur->write)
+  {
+    if (m_flashPresent)
+      m_flash.writeByte(pCur->addr, data);
+    else
+      EEPROM.write((uint16)pCur->addr, data);
+  }
+  pCur->addr++;
+  pCur->len++;
+  pCur->crc = wipeImgCrc(pCur->crc, data);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGet
+//   Get the next byte of a program image from the store.
+// Parameters:
+//   pCur:IO  - Image cursor.
+// Returns: The byte's value; zero, once the cursor's limit is reached.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+uint8 wipeImgGet(ImgCursor_t *pCur)
+{
+  uint8 data = 0;
+
+  if (pCur->len < pCur->limit)
+  {
+    data = wipeDirReadByte(pCur->addr++);
+    pCur->crc = wipeImgCrc(pCur->crc, data);
+  }
+  pCur->len++;
+  return data;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgPutIdent
+//   Put an identifier in a program image as its string table index.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   pos:I    - m_program[] index of the identifier's symbol table index,
+//              which is followed by the identifier string.
+// Returns: The m_program[] index following the identifier string.
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+uint16 wipeImgPutIdent(ImgCursor_t *pCur, uint16 pos)
+{
+  wipeImgPut(pCur, m_program[pos]);
+  return pos + 2 + strlen((char *)&m_program[pos + 1]);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgPutExpr
+//   Put an expression's bytecode in a program image.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   pos:I    - m_program[] index of the expression's first bytecode.
+// Returns: The m_program[] index following the expression.
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+uint16 wipeImgPutExpr(ImgCursor_t *pCur, uint16 pos)
+{
+  uint16 next;
+
+  while (m_program[pos] != WIPE_BC_END)
+  {
+    if (WIPE_BC_VAR == m_program[pos])
+    {
+      wipeImgPut(pCur, WIPE_BC_VAR);
+      pos = wipeImgPutIdent(pCur, pos + 1);
+      continue;
+    }
+    for (next = wipeExprNextCode(pos); pos < next; pos++)
+      wipeImgPut(pCur, m_program[pos]);
+  }
+  wipeImgPut(pCur, WIPE_BC_END);
+  return pos + 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgKeyPut
+//   Map a statement or function id in program memory to its id in a
+//   program image.
+// Parameters:
+//   id:I  - Statement id (e.g. WIPE_LET) or function id (e.g. WASPCMD_LINE).
+// Returns: The id in the image.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+uint8 wipeImgKeyPut(uint8 id)
+{
+  return (id >= KEY_BASE) ? (uint8)(id - KEY_BASE + IMG_KEY_BASE) : id;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgKeyGet
+//   Map a statement or function id in a program image back to its id in
+//   program memory.
+// Parameters:
+//   id:I  - The id in the image.
+// Returns: Statement id (e.g. WIPE_LET) or function id (e.g. WASPCMD_LINE).
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+uint8 wipeImgKeyGet(uint8 id)
+{
+  return (id >= IMG_KEY_BASE) ? (uint8)(id - IMG_KEY_BASE + KEY_BASE) : id;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgPutStmt
+//   Put the statement of a tokenized line in a program image.
+// Parameters:
+//   pCur:IO      - Image cursor.
+//   lineStart:I  - m_program[] index of the line.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+void wipeImgPutStmt(ImgCursor_t *pCur, uint16 lineStart)
+{
+  uint16 lineEnd = lineStart + m_program[lineStart + TKNZD_LEN_OFFS];
+  uint16 pos = lineStart + TKNZD_STMT_OFFS + 1;
+  uint8  numParms;
+
+  wipeImgPut(pCur, wipeImgKeyPut(m_program[lineStart + TKNZD_STMT_OFFS]));
+  switch (m_program[lineStart + TKNZD_STMT_OFFS])
+  {
+    case WIPE_LET:
+      pos = wipeImgPutIdent(pCur, pos);
+      pos = wipeImgPutExpr(pCur, pos);
+      break;
+    case WIPE_IF:
+      pos = wipeImgPutExpr(pCur, pos);
+      break;
+    case WIPE_GOTO:
+    case WIPE_VAR:
+    case WIPE_LABEL:
+      pos = wipeImgPutIdent(pCur, pos);
+      break;
+    case WIPE_PRINT:
+      if (WIPE_PRT_VAR == m_program[pos])
+      {
+        wipeImgPut(pCur, WIPE_PRT_VAR);
+        pos = wipeImgPutIdent(pCur, pos + 1);
+      }
+      break;
+    case WIPE_FUNC:
+      numParms = m_program[pos + 1];
+      wipeImgPut(pCur, wipeImgKeyPut(m_program[pos++]));
+      wipeImgPut(pCur, m_program[pos++]);
+      for ( ; numParms > 0; numParms--)
+        pos = wipeImgPutExpr(pCur, pos);
+      break;
+    default:
+      break;
+  }
+
+  /* The rest of the statement has no identifiers */
+  for ( ; pos < lineEnd; pos++)
+    wipeImgPut(pCur, m_program[pos]);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgPutBody
+//   Put the size, string table and lines of the program in RAM in a program
+//   image.
+// Parameters:
+//   pCur:IO  - Image cursor.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_numSymbols:I
+//   m_program:I
+//   m_symTbl:I
+//   m_wipeProgByte:I
+// Note:
+//   The program must have just been resolved (see wipeResolveProgram()),
+//   so that the symbol table holds exactly its identifiers.
+//-----------------------------------------------------------------------------
+void wipeImgPutBody(ImgCursor_t *pCur)
+{
+  ImgCursor_t  stmt;
+  uint16       currLine;
+  uint8        j;
+
+  wipeImgPut(pCur, (uint8)(m_wipeProgByte >> 8));
+  wipeImgPut(pCur, (uint8)m_wipeProgByte);
+  wipeImgPut(pCur, m_numSymbols);
+  for (uint8 i = 0; i < m_numSymbols; i++)
+  {
+    j = 0;
+    do
+      wipeImgPut(pCur, m_symTbl[i].symbol[j]);
+    while (m_symTbl[i].symbol[j++] != '\0');
+  }
+
+  for ( currLine = 0;
+        currLine < m_wipeProgByte;
+        currLine += m_program[currLine + TKNZD_LEN_OFFS]
+      )
+  {
+    /* Measure the statement first, for the line's length */
+    wipeImgCursorInit(&stmt, 0, 0, false);
+    wipeImgPutStmt(&stmt, currLine);
+    wipeImgPut(pCur, m_program[currLine + TKNZD_LINE_OFFS]);
+    wipeImgPut(pCur, (uint8)(TKNZD_STMT_OFFS + stmt.len));
+    wipeImgPutStmt(pCur, currLine);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgWrite
+//   Write the program in RAM to the store as a program image, or just
+//   determine the image's size.
+// Parameters:
+//   addr:I   - Store address of the image.
+//   write:I  - true, to write the image; false, to just measure it.
+// Returns: The image's size (in bytes).
+// Inputs/Outputs:
+//   m_program:I
+//   m_symTbl:I
+//   m_wipeProgByte:I
+// Note:
+//   See wipeImgPutBody().
+//-----------------------------------------------------------------------------
+uint16 wipeImgWrite(uint32 addr, boolean write)
+{
+  ImgCursor_t cur;
+  ImgCursor_t hdr;
+
+  /* Measure the image, and checksum all of it past the CRC */
+  wipeImgCursorInit(&cur, addr + IMG_LEN_OFFS, 0, false);
+  wipeImgPutBody(&cur);
+  if (write)
+  {
+    wipeImgCursorInit(&hdr, addr, 0, true);
+    wipeImgPut(&hdr, IMG_FORMAT);
+    wipeImgPut(&hdr, (uint8)(cur.crc >> 8));
+    wipeImgPut(&hdr, (uint8)cur.crc);
+    wipeImgCursorInit(&cur, addr + IMG_LEN_OFFS, 0, true);
+    wipeImgPutBody(&cur);
+  }
+  return IMG_LEN_OFFS + cur.len;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgCheck
+//   Validate the format tag and CRC of a program image in the store.
+// Parameters:
+//   addr:I       - Store address of the image.
+//   imgSize:I    - The image's size (in bytes).
+//   progSize:O   - Size (in bytes) of the program, once loaded in RAM.
+// Returns: true iff the image is valid.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeImgCheck(uint32 addr, uint16 imgSize, uint16 *progSize)
+{
+  ImgCursor_t cur;
+  uint16      crc;
+
+  if ( (imgSize <= IMG_BODY_OFFS) ||
+       (wipeDirReadByte(addr + IMG_FMT_OFFS) != IMG_FORMAT) )
+    return false;
+  crc = (uint16)wipeDirReadByte(addr + IMG_CRC_OFFS) << 8 |
+        wipeDirReadByte(addr + IMG_CRC_OFFS + 1);
+  *progSize = (uint16)wipeDirReadByte(addr + IMG_LEN_OFFS) << 8 |
+              wipeDirReadByte(addr + IMG_LEN_OFFS + 1);
+
+  wipeImgCursorInit(&cur, addr + IMG_LEN_OFFS, imgSize - IMG_LEN_OFFS, false);
+  while (cur.len < cur.limit)
+    (void)wipeImgGet(&cur);
+  return (cur.crc == crc);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGetStrings
+//   Enter the string table of a program image in the current variable
+//   frame, which must be empty, so that each string's symbol table index
+//   is m_symBase plus its string table index.
+// Parameters:
+//   pCur:IO  - Image cursor, at the string table.
+// Returns: true iff the string table is valid and there was room for it in
+//          the symbol table.
+// Inputs/Outputs:
+//   m_symBase:I
+//   m_numSymbols:IO
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+boolean wipeImgGetStrings(ImgCursor_t *pCur)
+{
+  char   identifier[MAX_ID_LEN + 1];
+  uint8  numStrs;
+  uint8  symIdx;
+  uint8  i;
+
+  numStrs = wipeImgGet(pCur);
+  for (uint8 n = 0; n < numStrs; n++)
+  {
+    for (i = 0; (identifier[i] = wipeImgGet(pCur)) != '\0'; )
+    {
+      if (++i > MAX_ID_LEN)
+        return false;
+    }
+    if (!wipeSymbolIntern(identifier, &symIdx))
+    {
+      logPrintln(FLASH("***ERROR: No room in sym table"));
+      return false;
+    }
+    if (symIdx != m_symBase + n)
+      return false;  /* Duplicate string */
+  }
+  return (pCur->len <= pCur->limit);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGetBytes
+//   Copy bytes of a program image to program memory.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   pPos:IO  - m_program[] index at which to store the bytes.
+//   num:I    - # of bytes.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_program:O
+//-----------------------------------------------------------------------------
+void wipeImgGetBytes(ImgCursor_t *pCur, uint16 *pPos, uint8 num)
+{
+  for ( ; num > 0; num--)
+    m_program[(*pPos)++] = wipeImgGet(pCur);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGetIdent
+//   Expand an identifier's string table index from a program image to its
+//   symbol table index and identifier string, in program memory.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   pPos:IO  - m_program[] index at which to store the identifier.
+// Returns: true iff the string table index is valid.
+// Inputs/Outputs:
+//   m_numSymbols:I
+//   m_symBase:I
+//   m_symTbl:I
+//   m_program:O
+//-----------------------------------------------------------------------------
+boolean wipeImgGetIdent(ImgCursor_t *pCur, uint16 *pPos)
+{
+  uint16 symIdx = m_symBase + wipeImgGet(pCur);
+
+  if (symIdx >= m_numSymbols)
+    return false;
+  m_program[(*pPos)++] = (uint8)symIdx;
+  strcpy((char *)&m_program[*pPos], m_symTbl[symIdx].symbol);
+  *pPos += strlen(m_symTbl[symIdx].symbol) + 1;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGetExpr
+//   Copy an expression's bytecode from a program image to program memory.
+// Parameters:
+//   pCur:IO  - Image cursor.
+//   pPos:IO  - m_program[] index at which to store the expression.
+// Returns: true iff the expression's identifiers are valid.
+// Inputs/Outputs:
+//   m_program:O
+//-----------------------------------------------------------------------------
+boolean wipeImgGetExpr(ImgCursor_t *pCur, uint16 *pPos)
+{
+  uint8 code;
+
+  do
+  {
+    code = wipeImgGet(pCur);
+    m_program[(*pPos)++] = code;
+    switch (code)
+    {
+      case WIPE_BC_INT8:
+        wipeImgGetBytes(pCur, pPos, 1);
+        break;
+      case WIPE_BC_INT32:
+        wipeImgGetBytes(pCur, pPos, sizeof(int32));
+        break;
+      case WIPE_BC_FLOAT:
+        wipeImgGetBytes(pCur, pPos, 1 + sizeof(float));
+        break;
+      case WIPE_BC_VAR:
+        if (!wipeImgGetIdent(pCur, pPos))
+          return false;
+        break;
+      default:
+        break;  /* Operators and WIPE_BC_END */
+    }
+  } while (code != WIPE_BC_END);
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgGetLine
+//   Expand the next line of a program image into a tokenized line in
+//   program memory, its identifiers resolved within the current variable
+//   frame (see wipeImgGetStrings()).
+// Parameters:
+//   pCur:IO      - Image cursor.
+//   lineStart:I  - m_program[] index at which to store the line.
+// Returns: The line's length in the image, if it's valid; zero, otherwise.
+// Inputs/Outputs:
+//   m_symBase:I
+//   m_symTbl:I
+//   m_program:O
+//-----------------------------------------------------------------------------
+uint8 wipeImgGetLine(ImgCursor_t *pCur, uint16 lineStart)
+{
+  uint16   pos = lineStart;
+  uint16   start = pCur->len;
+  uint16   limit = pCur->limit;
+  uint8    len;
+  uint8    numParms;
+  boolean  valid = true;
+
+  wipeImgGetBytes(pCur, &pos, 1);  /* Line # */
+  len = wipeImgGet(pCur);
+  if ( (len <= TKNZD_STMT_OFFS) || (len > limit - start) )
+    return 0;
+  pCur->limit = start + len;
+  pos++;
+  m_program[pos++] = wipeImgKeyGet(wipeImgGet(pCur));  /* Statement Id */
+
+  switch (m_program[lineStart + TKNZD_STMT_OFFS])
+  {
+    case WIPE_LET:
+      valid = wipeImgGetIdent(pCur, &pos) && wipeImgGetExpr(pCur, &pos);
+      break;
+    case WIPE_IF:
+      valid = wipeImgGetExpr(pCur, &pos);
+      break;
+    case WIPE_GOTO:
+    case WIPE_VAR:
+    case WIPE_LABEL:
+      valid = wipeImgGetIdent(pCur, &pos);
+      break;
+    case WIPE_PRINT:
+      wipeImgGetBytes(pCur, &pos, 1);
+      if (WIPE_PRT_VAR == m_program[pos - 1])
+        valid = wipeImgGetIdent(pCur, &pos);
+      break;
+    case WIPE_FUNC:
+      m_program[pos++] = wipeImgKeyGet(wipeImgGet(pCur));
+      wipeImgGetBytes(pCur, &pos, 1);
+      for (numParms = m_program[pos - 1]; valid && (numParms > 0); numParms--)
+        valid = wipeImgGetExpr(pCur, &pos);
+      break;
+    default:
+      break;
+  }
+
+  /* The rest of the statement has no identifiers */
+  while (pCur->len < pCur->limit)
+    wipeImgGetBytes(pCur, &pos, 1);
+
+  valid = valid && (pCur->len == pCur->limit) &&
+          (pos - lineStart <= MAX_TKNZD_LEN);
+  pCur->limit = limit;
+  if (!valid)
+    return 0;
+  m_program[lineStart + TKNZD_LEN_OFFS] = (uint8)(pos - lineStart);
+  return len;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirIndexBuild
+//   Walk the program directory once, building its RAM index and determining
+//   the free space (in bytes) available for WIPE programs. In flash, each
+//   slot holding a saved program (see wipeDirFileSave()) is a directory
+//   entry, and any programs saved in EEPROM before the chip was fitted are
+//   moved to flash (see wipeDirMigrate()).
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_dirCount:O
+//   m_dirIndex:O
+//   m_wipeDirSpace:O
+//   m_wipeSaveAddr:O
+//-----------------------------------------------------------------------------
+void wipeDirIndexBuild(void)
+{
+  uint32  addr;
+  uint16  currFileSize;
+  char    filename[MAX_PROGNAME_LEN+1];
+
+  m_dirCount = 0;
+  if (m_flashPresent)
+  {
+    m_wipeDirSpace = PROG_FLASH_LEN;
+    for (uint8 slot = 0; slot < PROG_FLASH_SLOTS; slot++)
+    {
+      addr = PROG_FLASH_BASE + slot * PROG_SLOT_SIZE;
+      if ( (m_flash.readByte(addr + PROG_MAGIC_OFFS) != PROG_MAGIC) ||
+           (m_dirCount >= MAX_DIR_FILES) )
+        continue;
+      m_flash.readBytes(addr + DIR_NAME_OFFS, filename, MAX_PROGNAME_LEN+1);
+      m_dirIndex[m_dirCount].addr = addr;
+      m_dirIndex[m_dirCount].size = (uint16)m_flash.readByte(addr) << 8 |
+                                    m_flash.readByte(addr + 1);
+      m_dirIndex[m_dirCount].hash = wipeDirNameHash(filename);
+      m_dirCount++;
+      m_wipeDirSpace -= PROG_SLOT_SIZE - PROG_HDR_LEN;
+    }
+    wipeDirMigrate();
+    return;
+  }
+
+  m_wipeSaveAddr = EEPROM_PROG_DIR_START;
+  m_wipeDirSpace = EEPROM_PROG_LEN;
+  currFileSize = (uint16)EEPROM.read(m_wipeSaveAddr) << 8 |
+                 EEPROM.read(m_wipeSaveAddr + 1);
+  while ( (currFileSize != 0) &&
+          (m_wipeSaveAddr < EEPROM_PROG_DIR_START + EEPROM_PROG_LEN)
+        )
+  {
+    if (m_dirCount < MAX_DIR_FILES)
+    {
+      for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
+        filename[i] = EEPROM.read(m_wipeSaveAddr + DIR_NAME_OFFS + i);
+      m_dirIndex[m_dirCount].addr = m_wipeSaveAddr;
+      m_dirIndex[m_dirCount].size = currFileSize;
+      m_dirIndex[m_dirCount].hash = wipeDirNameHash(filename);
+      m_dirCount++;
+    }
+    else
+    {
+      logPrint(FLASH("***Directory index full. Skipped file at "));
+      logPrintln(m_wipeSaveAddr);
+    }
+
+    /* Decrease available space by current file size and directory header */
+    m_wipeDirSpace -= currFileSize + DIR_PROG_OFFS;
+
+    /* Move to the next directory entry */
+    m_wipeSaveAddr += currFileSize + DIR_PROG_OFFS;
+
+    /* Get the next file's size */
+    currFileSize = (uint16)EEPROM.read(m_wipeSaveAddr) << 8 |
+                   EEPROM.read(m_wipeSaveAddr + 1);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirMigrate
+//   Move the programs saved in the EEPROM directory to free flash slots,
+//   then empty the EEPROM directory once they've all been moved. A program
+//   already in flash under the same name is kept, and the EEPROM copy is
+//   dropped.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_dirCount:IO
+//   m_dirIndex:IO
+//   m_wipeDirSpace:IO
+//-----------------------------------------------------------------------------
+void wipeDirMigrate(void)
+{
+  uint16  entry = EEPROM_PROG_DIR_START;
+  uint16  fileSize;
+  uint32  addr;
+  char    filename[MAX_PROGNAME_LEN+1];
+
+  fileSize = (uint16)EEPROM.read(entry) << 8 | EEPROM.read(entry + 1);
+  if (0 == fileSize)
+    return;
+
+  while ( (fileSize != 0) &&
+          (entry < EEPROM_PROG_DIR_START + EEPROM_PROG_LEN) )
+  {
+    for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
+      filename[i] = EEPROM.read(entry + DIR_NAME_OFFS + i);
+    filename[MAX_PROGNAME_LEN] = '\0';
+
+    if (wipeDirIndexFind(filename) < MAX_DIR_FILES)
+    {
+      logPrint(FLASH("***Already in flash. Dropped EEPROM file "));
+      logPrintln(filename);
+    }
+    else if (m_dirCount >= MAX_DIR_FILES)
+    {
+      logPrintln(FLASH("***Directory index full. EEPROM files kept"));
+      return;
+    }
+    else
+    {
+      /* The image is the same in either store */
+      addr = wipeFlashSlotOpen(filename, fileSize);
+      for (uint16 i = 0; i < fileSize; i++)
+        m_flash.writeByte(addr + PROG_HDR_LEN + i,
+                          EEPROM.read(entry + DIR_PROG_OFFS + i));
+      m_flash.writeByte(addr + PROG_MAGIC_OFFS, PROG_MAGIC);
+
+      m_dirIndex[m_dirCount].addr = addr;
+      m_dirIndex[m_dirCount].size = fileSize;
+      m_dirIndex[m_dirCount].hash = wipeDirNameHash(filename);
+      m_dirCount++;
+      m_wipeDirSpace -= PROG_SLOT_SIZE - PROG_HDR_LEN;
+      logPrint(FLASH("Moved to flash: "));
+      logPrintln(filename);
+    }
+
+    entry += fileSize + DIR_PROG_OFFS;
+    fileSize = (uint16)EEPROM.read(entry) << 8 | EEPROM.read(entry + 1);
+  }
+
+  /* Flag end of directory */
+  EEPROM.write(EEPROM_PROG_DIR_START, 0);
+  EEPROM.write(EEPROM_PROG_DIR_START + 1, 0);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirSpaceCheck
+//   Report the free space (in bytes) available in the store for WIPE
+//   programs.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_wipeDirSpace:I
+//-----------------------------------------------------------------------------
+void wipeDirSpaceCheck(void)
+{
+  if (m_flashPresent)
+    logPrint(FLASH("Free flash: "));
+  else
+    logPrint(FLASH("Free EEPROM: "));
+  logPrintln(m_wipeDirSpace);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirList
+//   Display a directory listing of WIPE program files.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_dirCount:I
+//   m_dirIndex:I
+//   m_flashPresent:I
+//   m_wipeDirSpace:I
+//-----------------------------------------------------------------------------
+void wipeDirList(void)
+{
+  uint32  currDirEntry;
+  boolean endName;
+  boolean startupFound = false;
+  char    tmpChar;
+  char    filename[MAX_PROGNAME_LEN+1];
+
+  logPrintln();
+  logPrintln(FLASH("Directory:"));
+  for (uint8 n = 0; n < m_dirCount; n++)
+  {
+    currDirEntry = m_dirIndex[n].addr;
+    endName = false;
+    for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
+    {
+      /* Print filename */
+      tmpChar = wipeDirReadByte(currDirEntry + DIR_NAME_OFFS + i);
+      filename[i] = tmpChar;
+      if (tmpChar == '\0')
+      {
+        endName = true;
+        if (strcmp(filename, m_autorunProg) == 0)
+          startupFound = true;
+      }
+      if (!endName)
+      {
+        logPrint(tmpChar);
+      }
+      else
+      {
+        logPrint(' ');
+      }
+    }
+
+    /* Print file size */
+    logPrint(FLASH("  "));
+    logPrint(m_dirIndex[n].size);
+    logPrintln(FLASH(" bytes"));
+  }
+  logPrint(FLASH("  "));
+  logPrint(m_dirCount);
+  logPrint(FLASH(" files. "));
+  logPrint(m_wipeDirSpace);
+  logPrint(FLASH(" of "));
+  logPrint(m_flashPresent ? PROG_FLASH_LEN : EEPROM_PROG_LEN);
+  logPrintln(FLASH(" bytes free."));
+  if (m_autorunProg[0] != '\0')
+  {
+    logPrint(FLASH("Startup ["));
+    logPrint(m_autorunProg);
+    if (startupFound)
+      logPrintln(FLASH("]"));
+    else
+      logPrintln(FLASH("] is missing"));
+  }
+  logPrintln(FLASH("-----------------------"));
+  logPrintln();
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeFlashSlotOpen
+//   Erase a free flash slot and write the directory entry of its header.
+//   The caller then writes the program's image, and PROG_MAGIC last, so
+//   that a partly written slot doesn't appear in the directory.
+// Parameters:
+//   progName:I  - Program file name string.
+//   imgSize:I   - Size (in bytes) of the program's image.
+// Returns: The slot's address.
+// Inputs/Outputs:
+//   m_dirCount:I
+//   m_dirIndex:I
+//-----------------------------------------------------------------------------
+uint32 wipeFlashSlotOpen(char *progName, uint16 imgSize)
+{
+  uint32  addr;
+  uint16  pos;
+  uint8   n;
+  uint8   hdr[DIR_PROG_OFFS];
+
+  /* Find a slot that isn't in the directory */
+  for (addr = PROG_FLASH_BASE; ; addr += PROG_SLOT_SIZE)
+  {
+    for (n = 0; (n < m_dirCount) && (m_dirIndex[n].addr != addr); n++)
+      ;
+    if (n == m_dirCount)
+      break;
+  }
+
+  for (pos = 0; pos < PROG_SLOT_SIZE; pos += 0x1000)
+    m_flash.blockErase4K(addr + pos);
+
+  hdr[DIR_LEN_OFFS] = (uint8)(imgSize >> 8);
+  hdr[DIR_LEN_OFFS + 1] = (uint8)imgSize;
+  strncpy((char *)&hdr[DIR_NAME_OFFS], progName, MAX_PROGNAME_LEN);
+  hdr[DIR_NAME_OFFS + MAX_PROGNAME_LEN] = '\0';
+  m_flash.writeBytes(addr, hdr, DIR_PROG_OFFS);
+  return addr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeFlashFileSave
+//   Save current program in RAM to a free flash slot.
+// Parameters:
+//   progName:I  - Program file name string.
+//   imgSize:I   - Size (in bytes) of the program's image.
+// Returns: The slot's address.
+// Inputs/Outputs:
+//   m_dirCount:I
+//   m_dirIndex:I
+//   m_program:I
+//   m_wipeProgByte:I
+//-----------------------------------------------------------------------------
+uint32 wipeFlashFileSave(char *progName, uint16 imgSize)
+{
+  uint32 addr = wipeFlashSlotOpen(progName, imgSize);
+
+  (void)wipeImgWrite(addr + PROG_HDR_LEN, true);
+  m_flash.writeByte(addr + PROG_MAGIC_OFFS, PROG_MAGIC);
+  return addr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirFileSave
+//   Save current program in RAM to the program directory, as a program
+//   image (see wipeImgWrite()).
+// Parameters:
+//   progName:I  - Program file name string.
+//   imgSize:I   - Size (in bytes) of the program's image.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_program:I
+//   m_wipeProgByte:I
+//   m_dirCount:IO
+//   m_wipeDirSpace:IO
+//   m_wipeSaveAddr:IO
+//   m_dirIndex:O
+// Note:
+//   The caller must check that there's room in the directory index
+//   (m_dirCount < MAX_DIR_FILES) and in the store.
+//-----------------------------------------------------------------------------
+void wipeDirFileSave(char *progName, uint16 imgSize)
+{
+  uint16  currAddr;
+
+  if (m_flashPresent)
+  {
+    m_dirIndex[m_dirCount].addr = wipeFlashFileSave(progName, imgSize);
+    m_dirIndex[m_dirCount].size = imgSize;
+    m_dirIndex[m_dirCount].hash = wipeDirNameHash(progName);
+    m_dirCount++;
+    m_wipeDirSpace -= PROG_SLOT_SIZE - PROG_HDR_LEN;
+    logPrintln();
+    logPrintln(FLASH("Saved"));
+    return;
+  }
+
+  currAddr = m_wipeSaveAddr;
+  m_dirIndex[m_dirCount].addr = currAddr;
+  m_dirIndex[m_dirCount].size = imgSize;
+  m_dirIndex[m_dirCount].hash = wipeDirNameHash(progName);
+  m_dirCount++;
+
+  /* Save file size (in bytes) to the directory entry */
+  EEPROM.write(currAddr++, (uint8)(imgSize >> 8));
+  EEPROM.write(currAddr++, (uint8)imgSize);
+
+  /* Save the file name */
+  for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
+  {
+    EEPROM.write(currAddr++, *progName++);
+  }
+
+  /* Save the program */
+  (void)wipeImgWrite(currAddr, true);
+
+  /* Update write address and free space */
+  m_wipeSaveAddr += imgSize + DIR_PROG_OFFS;
+  m_wipeDirSpace -= imgSize + DIR_PROG_OFFS;
+
+  /* Flag end of directory */
+  EEPROM.write(m_wipeSaveAddr, 0);
+  EEPROM.write(m_wipeSaveAddr + 1, 0);
+
+  logPrintln();
+  logPrintln(FLASH("Saved"));
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirIndexFind
+//   Locate the specified program in the RAM directory index.
+// Parameters:
+//   progName:I   - Program file name string.
+// Returns:
+//   MAX_DIR_FILES, if file not found;
+//   The program's m_dirIndex[] entry #, otherwise.
+// Inputs/Outputs:
+//   m_dirCount:I
+//   m_dirIndex:I
+//-----------------------------------------------------------------------------
+uint8 wipeDirIndexFind(char *progName)
+{
+  uint8   hash = wipeDirNameHash(progName);
+  uint32  currDirEntry;
+  char   *pChar;
+
+  for (uint8 n = 0; n < m_dirCount; n++)
+  {
+    if (m_dirIndex[n].hash != hash)
+      continue;
+
+    /* Confirm the name, in case of a hash collision */
+    currDirEntry = m_dirIndex[n].addr;
+    pChar = progName;
+    for (uint8 i = 0; i <= MAX_PROGNAME_LEN; i++)
+    {
+      if (*pChar != wipeDirReadByte(currDirEntry + DIR_NAME_OFFS + i))
+        break;
+      if (*pChar == '\0')
+        return n;
+      pChar++;
+    }
+  }
+
+  return MAX_DIR_FILES;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirFileFind
+//   Locate the specified program in the program directory.
+// Parameters:
+//   progName:I   - Program file name string.
+//   pFileSize:O  - Address at which to return the located file's size (in
+//                  bytes).
+// Returns:
+//   0, if file not found;
+//   The directory entry base address in the store, otherwise.
+// Inputs/Outputs:
+//   m_dirIndex:I
+//-----------------------------------------------------------------------------
+uint32 wipeDirFileFind(char *progName, uint16 *pFileSize)
+{
+  uint8 n = wipeDirIndexFind(progName);
+
+  if (n >= MAX_DIR_FILES)
+  {
+    *pFileSize = 0;
+    return 0;
+  }
+  *pFileSize = m_dirIndex[n].size;
+  return m_dirIndex[n].addr;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirFileErase
+//   Erase the specified program from the program directory.
+// Parameters:
+//   progName:I  - Program file name string.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_dirCount:IO
+//   m_dirIndex:IO
+//   m_wipeDirSpace:IO
+//   m_wipeSaveAddr:IO
+//   m_progCache:O
+//-----------------------------------------------------------------------------
+void wipeDirFileErase(char *progName)
+{
+  uint16  dirEntry;
+  uint16  fileSize;
+  uint16  numBytesToMove;
+  uint16  src;
+  uint8   n;
+
+  n = wipeDirIndexFind(progName);
+  if (n >= MAX_DIR_FILES)
+  {
+    logPrintln(FLASH("Not found"));
+    return;
+  }
+  dirEntry = m_dirIndex[n].addr;
+  fileSize = m_dirIndex[n].size;
+
+  if (m_flashPresent)
+  {
+    /* Erasing the slot's first block clears its header */
+    m_flash.blockErase4K(m_dirIndex[n].addr);
+    m_dirCount--;
+    for ( ; n < m_dirCount; n++)
+      m_dirIndex[n] = m_dirIndex[n + 1];
+    wipeProgCacheDrop(progName);
+    m_wipeDirSpace += PROG_SLOT_SIZE - PROG_HDR_LEN;
+    logPrintln();
+    logPrintln(FLASH("Erased"));
+    return;
+  }
+
+  /* Shift all bytes above the directory entry base address down
+   * by the number of bytes occupied by the file and directory header.
+   */
+  numBytesToMove = (EEPROM_PROG_LEN - m_wipeDirSpace) -
+                   (fileSize + DIR_PROG_OFFS);
+  src = dirEntry + fileSize + DIR_PROG_OFFS;
+  while (numBytesToMove-- != 0)
+    EEPROM.write(dirEntry++, (EEPROM.read(src++)));
+
+  /* Drop the entry from the index, and from the cache */
+  m_dirCount--;
+  for ( ; n < m_dirCount; n++)
+  {
+    m_dirIndex[n] = m_dirIndex[n + 1];
+    m_dirIndex[n].addr -= fileSize + DIR_PROG_OFFS;
+  }
+  wipeProgCacheDrop(progName);
+
+  /* Update write address and free space */
+  m_wipeSaveAddr -= fileSize + DIR_PROG_OFFS;
+  m_wipeDirSpace += fileSize + DIR_PROG_OFFS;
+
+  /* Flag end of directory */
+  EEPROM.write(m_wipeSaveAddr, 0);
+  EEPROM.write(m_wipeSaveAddr + 1, 0);
+
+  logPrintln();
+  logPrintln(FLASH("Erased"));
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeProgCacheDrop
+//   Remove the specified program from the RAM program cache, if present.
+// Parameters:
+//   progName:I  - Program file name string.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_progCache:IO
+//-----------------------------------------------------------------------------
+void wipeProgCacheDrop(char *progName)
+{
+#if PROG_CACHE_NUM > 0
+  for (uint8 n = 0; n < PROG_CACHE_NUM; n++)
+  {
+    if (strncmp(m_progCache[n].name, progName, MAX_PROGNAME_LEN) == 0)
+      m_progCache[n].name[0] = '\0';
+  }
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeProgCacheRead
+//   Copy the specified program from the RAM program cache, if it's resident,
+//   into program memory.
+// Parameters:
+//   progName:I  - Program file name string.
+//   dstPos:I    - m_program[] index at which to store the program.
+// Returns: The program's size (in bytes), if it was resident and fits in
+//          program memory; zero, otherwise.
+// Inputs/Outputs:
+//   m_progCacheTick:IO
+//   m_progCache:IO
+//   m_program:O
+//-----------------------------------------------------------------------------
+uint16 wipeProgCacheRead(char *progName, uint16 dstPos)
+{
+#if PROG_CACHE_NUM > 0
+  ProgCache_t *pEntry;
+
+  for (uint8 n = 0; n < PROG_CACHE_NUM; n++)
+  {
+    pEntry = &m_progCache[n];
+    if ( (pEntry->name[0] != '\0') &&
+         (strncmp(pEntry->name, progName, MAX_PROGNAME_LEN) == 0) &&
+         (pEntry->size <= (MAX_PROG_SIZE - dstPos)) )
+    {
+      memcpy(&m_program[dstPos], pEntry->prog, pEntry->size);
+      pEntry->lastUse = ++m_progCacheTick;
+      return pEntry->size;
+    }
+  }
+#endif
+  return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeProgCacheAdd
+//   Make a program that has just been read into program memory resident in
+//   the RAM program cache, replacing the least recently used program.
+// Parameters:
+//   progName:I  - Program file name string.
+//   srcPos:I    - m_program[] index of the program.
+//   fileSize:I  - The program's size (in bytes).
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_program:I
+//   m_progCacheTick:IO
+//   m_progCache:O
+//-----------------------------------------------------------------------------
+void wipeProgCacheAdd(char *progName, uint16 srcPos, uint16 fileSize)
+{
+#if PROG_CACHE_NUM > 0
+  ProgCache_t *pEntry = &m_progCache[0];
+
+  if (fileSize > PROG_CACHE_SIZE)
+    return;
+  for (uint8 n = 1; n < PROG_CACHE_NUM; n++)
+  {
+    if ('\0' == pEntry->name[0])
+      break;  /* Use the unused entry */
+    if ( ('\0' == m_progCache[n].name[0]) ||
+         (m_progCache[n].lastUse < pEntry->lastUse) )
+      pEntry = &m_progCache[n];
+  }
+  strncpy(pEntry->name, progName, MAX_PROGNAME_LEN);
+  pEntry->name[MAX_PROGNAME_LEN] = '\0';
+  pEntry->size = fileSize;
+  pEntry->lastUse = ++m_progCacheTick;
+  memcpy(pEntry->prog, &m_program[srcPos], fileSize);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirFileRead
+//   Copy the specified program from the RAM program cache or the store to
+//   program memory. A program image read from the store is validated, and
+//   its identifiers are entered in the current variable frame. An untagged
+//   program is converted, if asked (see wipeLegacyLoad()).
+// Parameters:
+//   progName:I  - Program file name string.
+//   dstPos:I    - m_program[] index at which to store the program.
+//   pLegacy:O   - Address at which to return whether it was an untagged
+//                 program; NULL, to not convert untagged programs.
+// Returns: The program's size (in bytes), if it was found and valid and
+//          fits in program memory; zero, otherwise.
+// Inputs/Outputs:
+//   m_dirIndex:I
+//   m_flashPresent:I
+//   m_progCache:IO
+//   m_symTbl:IO
+//   m_program:O
+// Note:
+//   The current variable frame must be empty (see wipeImgGetStrings()).
+//-----------------------------------------------------------------------------
+uint16 wipeDirFileRead(char *progName, uint16 dstPos, boolean *pLegacy)
+{
+  ImgCursor_t  cur;
+  uint32       currEepromPos;
+  uint16       fileSize;
+  uint16       progSize;
+  uint16       pos;
+  boolean      valid;
+
+  progSize = wipeProgCacheRead(progName, dstPos);
+  if (progSize != 0)
+    return progSize;
+
+  currEepromPos = wipeDirFileFind(progName, &fileSize);
+  if (0 == currEepromPos)
+  {
+    logPrint(FLASH("Not found: "));
+    logPrintln(progName);
+    return 0;
+  }
+  currEepromPos += m_flashPresent ? PROG_HDR_LEN : DIR_PROG_OFFS;
+  valid = wipeImgCheck(currEepromPos, fileSize, &progSize);
+  if (!valid && (pLegacy != NULL))
+  {
+    progSize = wipeLegacyLoad(currEepromPos, fileSize);
+    *pLegacy = (progSize != 0);
+    if (*pLegacy)
+      return progSize;
+  }
+  if (valid && (progSize > (MAX_PROG_SIZE - dstPos)))
+  {
+    logPrint(FLASH("***Out of RAM: "));
+    logPrintln(progName);
+    return 0;
+  }
+
+  if (valid)
+  {
+    wipeImgCursorInit(&cur, currEepromPos + IMG_BODY_OFFS,
+                      fileSize - IMG_BODY_OFFS, false);
+    valid = wipeImgGetStrings(&cur);
+    for (pos = dstPos; valid && (pos < dstPos + progSize); )
+    {
+      valid = (wipeImgGetLine(&cur, pos) != 0);
+      pos += m_program[pos + TKNZD_LEN_OFFS];
+    }
+    valid = valid && (pos == dstPos + progSize) && (cur.len == cur.limit);
+  }
+  if (!valid)
+  {
+    wipeImgShowBad(progName, currEepromPos);
+    return 0;
+  }
+  wipeProgCacheAdd(progName, dstPos, progSize);
+  return progSize;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeDirFileLoad
+//   Load the specified program from the store to RAM.
+// Parameters:
+//   progName:I  - Program file name string.
+// Returns: true iff program was found and its identifiers could be
+//          entered in the symbol table.
+// Inputs/Outputs:
+//   m_wipeLineStart:O
+//   m_wipeProgByte:O
+//   m_symTbl:O
+// Note:
+//   An untagged program is converted, and saved again as an image.
+//-----------------------------------------------------------------------------
+boolean wipeDirFileLoad(char *progName)
+{
+  uint16  fileSize;
+  uint16  oldSize;
+  boolean legacy = false;
+  char    filename[MAX_PROGNAME_LEN+1];
+
+  /* Converting an untagged program reuses the console line buffers */
+  strncpy(filename, progName, MAX_PROGNAME_LEN);
+  filename[MAX_PROGNAME_LEN] = '\0';
+  progName = filename;
+
+  wipeSymbolsClear();
+  fileSize = wipeDirFileRead(progName, 0, &legacy);
+  if (0 == fileSize)
+    return false;
+
+  m_wipeLineStart = fileSize;
+  m_wipeProgByte = fileSize;
+
+  logPrintln();
+  if (!wipeResolveProgram())
+    return false;
+  if (legacy)
+  {
+    /* Replace it, if the image fits where the untagged program was */
+    (void)wipeDirFileFind(progName, &oldSize);
+    fileSize = wipeImgWrite(0, false);
+    if (!m_flashPresent && (fileSize > m_wipeDirSpace + oldSize))
+    {
+      logPrintln(FLASH("***Out of file space. Not converted"));
+    }
+    else
+    {
+      wipeDirFileErase(progName);
+      wipeDirFileSave(progName, fileSize);
+      logPrint(FLASH("Converted: "));
+      logPrintln(progName);
+    }
+  }
+  logPrintln(FLASH("Loaded."));
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeImgShowBad
+//   Report a program file that couldn't be read.
+// Parameters:
+//   progName:I  - Program file name string.
+//   addr:I      - Store address of its image.
+// Returns: (none)
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+void wipeImgShowBad(char *progName, uint32 addr)
+{
+  logPrint(FLASH("***ERROR: Bad program file: "));
+  logPrintln(progName);
+  if (wipeDirReadByte(addr + IMG_FMT_OFFS) != IMG_FORMAT)
+    logPrintln(FLASH("***Old format? Load it once to convert it"));
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeLegacyPutChar
+//   Append a character to the console line rebuilt from a line of an
+//   untagged program.
+// Parameters:
+//   pPos:IO  - m_consoleBuffer[] index of the next character.
+//   c:I      - The character.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consoleBuffer:O
+// Note:
+//   Once the buffer is full, *pPos is left at MAX_SERIAL_BUF_LEN.
+//-----------------------------------------------------------------------------
+void wipeLegacyPutChar(uint8 *pPos, char c)
+{
+  if (*pPos < MAX_SERIAL_BUF_LEN)
+    m_consoleBuffer[(*pPos)++] = c;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeLegacyPutStr
+//   Append a string to the console line rebuilt from a line of an untagged
+//   program (see wipeLegacyPutChar()).
+// Parameters:
+//   pPos:IO  - m_consoleBuffer[] index of the next character.
+//   str:I    - The string.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consoleBuffer:O
+//-----------------------------------------------------------------------------
+void wipeLegacyPutStr(uint8 *pPos, const __FlashStringHelper *str)
+{
+  PGM_P pChar = (PGM_P)str;
+  char  c;
+
+  while ((c = pgm_read_byte(pChar++)) != '\0')
+    wipeLegacyPutChar(pPos, c);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeLegacyCopy
+//   Append a string of an untagged program's line, in the store, to the
+//   console line rebuilt from it (see wipeLegacyPutChar()).
+// Parameters:
+//   pPos:IO    - m_consoleBuffer[] index of the next character.
+//   pAddr:IO   - Store address of the string; returned past its \0.
+//   end:I      - Store address of the end of the line.
+//   escape:I   - true, to escape newlines as in a quoted string.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consoleBuffer:O
+//-----------------------------------------------------------------------------
+void wipeLegacyCopy(uint8 *pPos, uint32 *pAddr, uint32 end, boolean escape)
+{
+  char c;
+
+  while (*pAddr < end)
+  {
+    c = (char)wipeDirReadByte((*pAddr)++);
+    if ('\0' == c)
+      break;
+    if (escape && ('\n' == c))
+    {
+      wipeLegacyPutChar(pPos, '\\');
+      c = 'n';
+    }
+    wipeLegacyPutChar(pPos, c);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeLegacyGetLine
+//   Rebuild the source of a statement of an untagged program in the console
+//   line, as it stands once its statement (or function) name is scanned.
+// Parameters:
+//   addr:I  - Store address of the line.
+//   len:I   - The line's length.
+// Returns: The statement's token id (e.g. WIPE_LET or WASPCMD_LINE), if it's
+//          valid; WIPE_UNDEF, otherwise.
+// Inputs/Outputs:
+//   m_consoleBuffer:O
+//   m_consoleLen:O
+//   m_consolePos:O
+//   m_tokenBuffer:O
+//-----------------------------------------------------------------------------
+uint8 wipeLegacyGetLine(uint32 addr, uint8 len)
+{
+  uint32   end = addr + len;
+  uint8    pos = 0;
+  uint8    id;
+  boolean  quote = false;
+
+  addr += TKNZD_STMT_OFFS;
+  id = wipeDirReadByte(addr++);
+  if (id < LEGACY_KEY_BASE)
+    return WIPE_UNDEF;
+  id += KEY_BASE - LEGACY_KEY_BASE;
+
+  switch (id)
+  {
+    case WIPE_FUNC:
+      /* WASP command ids are unchanged */
+      id = wipeDirReadByte(addr);
+      if (id >= LEGACY_KEY_BASE)
+        id += KEY_BASE - LEGACY_KEY_BASE;
+      addr += 3;  /* Function id, # of parameters and '(' */
+      break;
+    case WIPE_LET:
+      wipeLegacyCopy(&pos, &addr, end, false);
+      wipeLegacyPutStr(&pos, FLASH(" = "));
+      break;
+    case WIPE_PRINT:
+      quote = (WIPE_PRT_STR == wipeDirReadByte(addr++));
+      break;
+    case WIPE_VAR:
+      wipeLegacyCopy(&pos, &addr, end, false);
+      wipeLegacyPutStr(&pos, FLASH(" : "));
+      switch (wipeDirReadByte(addr))
+      {
+        case WIPE_ID_LABEL: wipeLegacyPutStr(&pos, FLASH("label")); break;
+        case WIPE_ID_INT:   wipeLegacyPutStr(&pos, FLASH("int"));   break;
+        case WIPE_ID_FLOAT: wipeLegacyPutStr(&pos, FLASH("float")); break;
+        case WIPE_ID_BOOL:  wipeLegacyPutStr(&pos, FLASH("bool"));  break;
+        default:
+          return WIPE_UNDEF;
+      }
+      addr = end;
+      break;
+    case WIPE_GOTO:
+    case WIPE_IF:
+    case WIPE_LABEL:
+      break;
+    default:
+      return WIPE_UNDEF;
+  }
+
+  if (quote)
+    wipeLegacyPutChar(&pos, '"');
+  wipeLegacyCopy(&pos, &addr, end, quote);
+  if (quote)
+    wipeLegacyPutChar(&pos, '"');
+  if (pos >= MAX_SERIAL_BUF_LEN)
+    return WIPE_UNDEF;
+
+  m_consoleBuffer[pos] = '\0';
+  m_consoleLen = pos;
+  strncpy(m_tokenBuffer, m_consoleBuffer, sizeof(m_consoleBuffer));
+  m_consolePos = 0;
+  return id;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeLegacyLoad
+//   Convert an untagged program (see LEGACY_KEY_BASE) to a tokenized
+//   program at the start of program memory. The source of each line is
+//   rebuilt and parsed again, as if it had been entered at the console.
+// Parameters:
+//   addr:I      - Store address of the program.
+//   fileSize:I  - The program's size in the store (in bytes).
+// Returns: The program's size (in bytes) in program memory, if it
+//          converted; zero, otherwise.
+// Inputs/Outputs:
+//   m_consoleBuffer:O
+//   m_program:O
+//   m_symTbl:IO
+//   m_tokenBuffer:O
+//   m_wipeLineStart:IO
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+uint16 wipeLegacyLoad(uint32 addr, uint16 fileSize)
+{
+  uint16   lineStart = m_wipeLineStart;
+  uint16   progByte = m_wipeProgByte;
+  uint16   offs;
+  uint8    len;
+  uint8    token;
+  boolean  stmtErr;
+  boolean  valid = true;
+
+  m_wipeProgByte = 0;
+  for (offs = 0; valid && (offs < fileSize); offs += len)
+  {
+    len = wipeDirReadByte(addr + offs + TKNZD_LEN_OFFS);
+    if ( (len <= TKNZD_STMT_OFFS) || (len > fileSize - offs) ||
+         (m_wipeProgByte + TKNZD_STMT_OFFS >= MAX_PROG_SIZE) )
+    {
+      valid = false;
+      break;
+    }
+    token = wipeLegacyGetLine(addr + offs, len);
+    m_wipeLineStart = m_wipeProgByte;
+    valid = (token != WIPE_UNDEF) &&
+            wipeParseStatement(wipeDirReadByte(addr + offs), token,
+                               &stmtErr);
+    m_wipeProgByte = m_wipeLineStart +
+                     m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+  }
+
+  offs = m_wipeProgByte;
+  m_wipeLineStart = lineStart;
+  m_wipeProgByte = progByte;
+  return valid ? offs : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipePrintOperator
+//   Print a WIPE expression operator.
+// Parameters:
+//   operation:I  - The operator ID.
+// Returns: (none)
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+void wipePrintOperator(uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_PLUS:   logPrint(FLASH("+"));    break;
+    case WIPE_OP_MINUS:  logPrint(FLASH("-"));    break;
+    case WIPE_OP_MULT:   logPrint(FLASH("*"));    break;
+    case WIPE_OP_DIV:    logPrint(FLASH("/"));    break;
+    case WIPE_OP_MOD:    logPrint(FLASH("%"));    break;
+    case WIPE_OP_NEG:    logPrint(FLASH("-"));    break;
+    case WIPE_OP_COMPL:  logPrint(FLASH("!"));    break;
+    case WIPE_OP_OR:     logPrint(FLASH("||"));   break;
+    case WIPE_OP_AND:    logPrint(FLASH("&&"));   break;
+    case WIPE_OP_EQ:     logPrint(FLASH("="));    break;
+    case WIPE_OP_NE:     logPrint(FLASH("!="));   break;
+    case WIPE_OP_LT:     logPrint(FLASH("<"));    break;
+    case WIPE_OP_LE:     logPrint(FLASH("<="));   break;
+    case WIPE_OP_GT:     logPrint(FLASH(">"));    break;
+    case WIPE_OP_GE:     logPrint(FLASH(">="));   break;
+    default:
+      logPrint(FLASH("<op: "));
+      logPrint(operation);
+      logPrint(FLASH("?>"));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipePrintOperand
+//   Print a WIPE expression operand from its bytecode.
+// Parameters:
+//   pos:I  - m_program[] index of the operand's bytecode.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+void wipePrintOperand(uint16 pos)
+{
+  int32  intVal;
+  float  floatVal;
+
+  switch (m_program[pos])
+  {
+    case WIPE_BC_INT8:
+      logPrint(m_program[pos + 1]);
+      break;
+    case WIPE_BC_INT32:
+      memcpy(&intVal, &m_program[pos + 1], sizeof(int32));
+      logPrint(intVal);
+      break;
+    case WIPE_BC_FLOAT:
+      memcpy(&floatVal, &m_program[pos + 1], sizeof(float));
+      logPrintEx(floatVal, m_program[pos + 1 + sizeof(float)]);
+      break;
+    case WIPE_BC_VAR:
+      logPrint((char *)&m_program[pos + 2]);
+      break;
+    default:
+      logPrint(FLASH("<operand: "));
+      logPrint(m_program[pos]);
+      logPrint(FLASH("?>"));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipePrintExpression
+//   Print a compiled WIPE expression in its source (infix) form.
+// Parameters:
+//   pPos:IO  - Address of the m_program[] index of the expression's first
+//              bytecode. Upon return, it is the index of the byte
+//              following the expression.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+void wipePrintExpression(uint16 *pPos)
+{
+  uint16   pos = *pPos;
+  uint16   nextPos;
+  uint8    unary;
+  boolean  firstOprnd = true;
+
+  while (m_program[pos] != WIPE_BC_END)
+  {
+    /* Code following an operand is its unary operator, if any, and (except
+     * for the first operand) the binary operator that precedes it.
+     */
+    nextPos = wipeExprNextCode(pos);
+    unary = m_program[nextPos];
+    if ( (WIPE_OP_NEG == unary) || (WIPE_OP_COMPL == unary) )
+      nextPos++;
+    else
+      unary = WIPE_OP_UNDEF;
+
+    if (!firstOprnd)
+    {
+      logPrint(FLASH(" "));
+      wipePrintOperator(m_program[nextPos++]);
+      logPrint(FLASH(" "));
+    }
+    if (unary != WIPE_OP_UNDEF)
+      wipePrintOperator(unary);
+    wipePrintOperand(pos);
+
+    pos = nextPos;
+    firstOprnd = false;
+  }
+  *pPos = pos + 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipePrintStatement
+//   Pretty print the tokenized WIPE statement starting at m_program[]
+//   location m_wipeLineStart.
+// Parameters:
+//   lineStart:I  - Starting program memory location of the line.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_wipeLineStart:I
+//   m_program:I
+//-----------------------------------------------------------------------------
+void wipePrintStatement(void)
+{
+  char   *identifier;
+  uint16  exprPos;
+  uint8   stmtId;
+  uint8   lineNum;
+  uint8   byteVal;
+  uint8   lineOffs;
+
+  lineNum  = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
+  stmtId   = m_program[m_wipeLineStart + TKNZD_STMT_OFFS];
+  lineOffs = TKNZD_STMT_OFFS + 1;
+  
+  if (lineNum != 0)
+  {
+    if (lineNum < 100)
+      logPrint(FLASH("0"));
+    if (lineNum < 10)
+      logPrint(FLASH("0"));
+    logPrint(lineNum);
+    logPrint(FLASH(" "));
+  }
+  
+  switch (stmtId)
+  {
+    case WIPE_FUNC:
+      stmtId = m_program[m_wipeLineStart + lineOffs++];
+      switch (stmtId)
+      {
+        case WASPCMD_GROUP:     logPrint(FLASH("Group"));   break;
+        case WASPCMD_STATE:     logPrint(FLASH("State"));   break;
+        case WASPCMD_BKGRD:     logPrint(FLASH("Bkgrd"));   break;
+        case WASPCMD_LINE:      logPrint(FLASH("Line"));    break;
+        case WASPCMD_SHIFT:     logPrint(FLASH("Shift"));   break;
+        case WASPCMD_SWAP:      logPrint(FLASH("Swap"));    break;
+        case WASPCMD_RESET:     logPrint(FLASH("Reset"));   break;
+        case WASPCMD_SPEED:     logPrint(FLASH("Speed"));   break;
+        case WASPCMD_RAINBOW:   logPrint(FLASH("Rain"));    break;
+        case WASPCMD_RAINCYCLE: logPrint(FLASH("Cycle"));   break;
+        case WASPCMD_TWINKLE:   logPrint(FLASH("Twinkle")); break;
+        case WASPCMD_PIXELS:    logPrint(FLASH("Pixels"));  break;
+        case WIPE_FN_PAUSE:     logPrint(FLASH("Pause"));   break;
+        case WIPE_FN_PAINT:     logPrint(FLASH("Paint"));   break;
+        case WIPE_FN_CODE:      logPrint(FLASH("Code"));    break;
+        case WASPCMD_SCRIPT:    logPrint(FLASH("Script"));  break;
+        case WASPCMD_SCRIPT_RUN: logPrint(FLASH("RunFx"));  break;
+        case WASPCMD_AT:        logPrint(FLASH("At"));      break;
+        case WASPCMD_PALETTE:   logPrint(FLASH("Palette")); break;
+        case WASPCMD_FADE:      logPrint(FLASH("Fade"));    break;
+        case WASPCMD_GRADIENT:  logPrint(FLASH("Gradient")); break;
+        case WASPCMD_BRIGHT:    logPrint(FLASH("Bright"));  break;
+        default:
+          logPrint(FLASH("<unknown func: "));
+          logPrint(stmtId);
+          logPrintln(FLASH("?>"));
+          return;
+      }
+      byteVal = m_program[m_wipeLineStart + lineOffs++]; /* # of parms */
+      exprPos = m_wipeLineStart + lineOffs;
+      logPrint(FLASH("("));
+      for (uint8 i = 0; i < byteVal; i++)
+      {
+        if (i > 0)
+          logPrint(FLASH(","));
+        wipePrintExpression(&exprPos);
+      }
+      logPrintln(FLASH(")"));
+      break;
+    case WIPE_GOTO:
+      logPrint(FLASH("goto "));
+      identifier = (char *)&m_program[m_wipeLineStart + lineOffs + 1];
+      lineOffs += strlen(identifier) + 1;
+      logPrintln(identifier);
+      break;
+    case WIPE_IF:
+      logPrint(FLASH("if "));
+      exprPos = m_wipeLineStart + lineOffs;
+      wipePrintExpression(&exprPos);
+      logPrintln();
+      break;
+    case WIPE_LABEL:
+      logPrint(FLASH("label "));
+      identifier = (char *)&m_program[m_wipeLineStart + lineOffs + 1];
+      lineOffs += strlen(identifier) + 1;
+      logPrintln(identifier);
+      break;
+    case WIPE_LET:
+      logPrint(FLASH("let "));
+      identifier = (char *)&m_program[m_wipeLineStart + lineOffs + 1];
+      lineOffs += strlen(identifier) + 2;
+      logPrint(identifier);
+      logPrint(FLASH(" = "));
+      exprPos = m_wipeLineStart + lineOffs;
+      wipePrintExpression(&exprPos);
+      logPrintln();
+      break;
+    case WIPE_PRINT:
+    {
+      char *pChar;
+
+      logPrint(FLASH("print "));
+      stmtId = m_program[m_wipeLineStart + lineOffs++];
+      if (WIPE_PRT_STR == stmtId)
+      {
+        logPrint("\"");
+        logPrint((char *)&m_program[m_wipeLineStart + lineOffs]);
+        logPrintln("\"");
+      }
+      else
+      {
+        identifier = (char *)&m_program[m_wipeLineStart + lineOffs + 1];
+        logPrintln(identifier);
+      }
+      break;
+    }
+    case WIPE_VAR:
+      logPrint(FLASH("var "));
+      identifier = (char *)&m_program[m_wipeLineStart + lineOffs + 1];
+      logPrint(identifier);
+      logPrint(FLASH(" : "));
+      byteVal = m_program[m_wipeLineStart + lineOffs + strlen(identifier) + 2];
+      switch (byteVal)
+      {
+        case WIPE_ID_INT:
+          logPrintln(FLASH("int"));
+          break;
+        case WIPE_ID_FLOAT:
+          logPrintln(FLASH("float"));
+          break;
+        case WIPE_ID_BOOL:
+          logPrintln(FLASH("bool"));
+          break;
+        default:
+          logPrint(FLASH("<type: "));
+          logPrint(byteVal);
+          logPrintln(FLASH("?>"));
+      }
+      break;
+    default:
+      logPrint(FLASH("<WIPE statement: "));
+      logPrint(stmtId);
+      logPrintln(FLASH("?>"));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeShowConsoleLine
+//   Display the current WIPE command line.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consoleBuffer:I
+//   m_consolePos:I
+//-----------------------------------------------------------------------------
+inline void wipeShowConsoleLine(void)
+{
+    logPrintln(m_consoleBuffer);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeShowError
+//   Display WIPE syntax error on console.
+// Parameters:
+//   errStr:I  - Error string to display. The argument should be provided
+//               using the FLASH() macro:
+//                 e.g. wipeShowError(FLASH("Error text"));
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consoleBuffer:I
+//   m_consolePos:I
+//   m_wipeRunByte:I
+//-----------------------------------------------------------------------------
+void wipeShowError(const __FlashStringHelper *errStr)
+{
+  uint8 i;
+  uint8 indent;
+
+  if (m_wipeRunByte > 0)
+  {
+    indent = 0;
+    wipePrintStatement();
+  }
+  else
+  {
+    indent = m_consolePos;
+    if (m_consolePos >= 2)
+      indent -= 1;
+    
+    wipeShowConsoleLine();
+  }
+  
+  for (i = 1; i < indent; i++)
+  {
+    logPrint(FLASH(" "));
+  }
+  logPrintln(FLASH("^"));
+  logPrint(FLASH("***ERROR: "));
+  logPrintln(errStr);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeSymbolsClear
+//   Initialize the WIPE symbol table.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_numSymbols:O
+//   m_symBase:O
+//-----------------------------------------------------------------------------
+void wipeSymbolsClear(void)
+{
+  m_numSymbols = 0;
+  m_symBase = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeSymbolIntern
+//   Find the symbol table entry reserved for an identifier, reserving a new
+//   one if the identifier hasn't been seen yet. A reserved entry remains
+//   undefined (WIPE_ID_UNDEF) until its var statement executes. Entries are
+//   allocated in order, so only the entries in use are searched. Only the
+//   current variable frame (from m_symBase on) is searched, so that
+//   concurrently running programs don't share variables.
+// Parameters:
+//   identifier:I  - Identifier string.
+//   idx:O         - Symbol table index reserved for the identifier. The
+//                   value is MAX_NUM_SYMBOLS if the function returns false.
+// Returns: true iff the identifier has a symbol table entry.
+// Inputs/Outputs:
+//   m_numSymbols:IO
+//   m_symBase:I
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+boolean wipeSymbolIntern(char *identifier, uint8 *idx)
+{
+  uint8 i;
+
+  for (i = m_symBase; i < m_numSymbols; i++)
+  {
+    if ( (m_symTbl[i].symbol[0] == identifier[0]) &&
+         (strncmp(m_symTbl[i].symbol, identifier, MAX_ID_LEN) == 0) )
+    {
+      *idx = i;
+      return true;
+    }
+  }
+  if (m_numSymbols < MAX_NUM_SYMBOLS)
+  {
+    strncpy(m_symTbl[i].symbol, identifier, MAX_ID_LEN + 1);
+    m_symTbl[i].symbol[MAX_ID_LEN] = '\0';
+    m_symTbl[i].typeId = WIPE_ID_UNDEF;
+    m_symTbl[i].symValue.intValue = 0;
+    m_numSymbols++;
+    *idx = i;
+    return true;
+  }
+  *idx = MAX_NUM_SYMBOLS;
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeSymbolInsert
+//   Insert a new symbol into the WIPE symbol table.
+// Parameters:
+//   identifier:I  - Identifier string.
+//   type:I        - Identifier's type.
+//   idx:O         - Symbol table index at which symbol was inserted. The
+//                   value is valid only if the function returns true, or
+//                   if the symbol is already defined.
+// Returns: true iff insertion was successful.
+// Inputs/Outputs:
+//   m_numSymbols:IO
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+boolean wipeSymbolInsert(char *identifier, uint8 type, uint8 *idx)
+{
+  if (!wipeSymbolIntern(identifier, idx))
+    return false;
+
+  if (m_symTbl[*idx].typeId != WIPE_ID_UNDEF)
+    return false;  /* Already defined */
+
+  m_symTbl[*idx].typeId = type;
+  m_symTbl[*idx].symValue.intValue = 0;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeSymbolsShow
+//   Show the known symbols in the symbol table.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_numSymbols:I
+//   m_symTbl:I
+//-----------------------------------------------------------------------------
+void wipeSymbolsShow(void)
+{
+  uint8 i, j;
+  boolean validEntry;
+
+  logPrintln(FLASH("\nSYMBOLS\nName\tType\t\tValue"));
+  logPrintln(FLASH("----\t----\t\t-----"));
+  for (i = 0; i < m_numSymbols; i++)
+  {
+    validEntry = true;
+    if (m_symTbl[i].typeId != WIPE_ID_UNDEF)
+    {
+      logPrint(m_symTbl[i].symbol);
+      for (j = strlen(m_symTbl[i].symbol); j <= MAX_ID_LEN; j++)
+        logPrint(FLASH(" "));
+      logPrint(FLASH("\t"));
+      switch (m_symTbl[i].typeId)
+      {
+        case WIPE_ID_LABEL:
+          logPrint(FLASH("label"));
+          break;
+        case WIPE_ID_INT:
+          logPrint(FLASH("int"));
+          break;
+        case WIPE_ID_FLOAT:
+          logPrint(FLASH("float"));
+          break;
+        case WIPE_ID_BOOL:
+          logPrint(FLASH("bool"));
+          break;
+        default:
+          logPrintln(FLASH("<unknown>"));
+          validEntry = false;
+      }
+      if (validEntry)
+      {
+        logPrint(FLASH("\t\t"));
+        switch (m_symTbl[i].typeId)
+        {
+          case WIPE_ID_LABEL:
+            logPrintln(m_symTbl[i].symValue.intValue);
+            break;
+          case WIPE_ID_INT:
+            logPrintln(m_symTbl[i].symValue.intValue);
+            break;
+          case WIPE_ID_FLOAT:
+            logPrintlnEx(m_symTbl[i].symValue.floatValue,5);
+            break;
+          case WIPE_ID_BOOL:
+            logPrintln(m_symTbl[i].symValue.boolValue);
+            break;
+          default:
+            logPrintln(FLASH("<unknown>"));
+        }
+      }
+    }
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeListProgram
+//   Display program statements for a specified range of line numbers.
+// Parameters:
+//   startLine:I  - First line number to display.
+//   endLine:I    - Last line number to display.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_symTbl:I
+//-----------------------------------------------------------------------------
+void wipeListProgram(uint8 startLine, uint8 endLine)
+{
+  uint16 savedWipeLineStart = m_wipeLineStart;
+  uint8  currLineNum;
+  uint8  currLineLen;
+
+  logPrintln();
+  m_wipeLineStart = 0;
+  currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
+  currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+  while ( (currLineNum < startLine) && (m_wipeLineStart < m_wipeProgByte) )
+  {
+    m_wipeLineStart += currLineLen;
+    currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
+    currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+  }
+
+  while ( (currLineNum <= endLine) && (m_wipeLineStart < m_wipeProgByte) )
+  {
+    wipePrintStatement();
+    m_wipeLineStart += currLineLen;
+    currLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
+    currLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+  }
+
+  m_wipeLineStart = savedWipeLineStart;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeParseInt
+//   Scan for an integer value in the conole input buffer.
+// Parameters:
+//   intVal:O   - The integer value scanned, if the function returns true;
+//                zero, otherwise.
+//   advance:I  - If true, then advance the m_consolePos value past the
+//                scanned integer.
+// Returns: true iff a valid integer value was scanned.
+// Inputs/Outputs:
+//   m_consoleLen:I
+//   m_consolePos:IO
+//   m_tokenBuffer:IO
+//-----------------------------------------------------------------------------
+boolean wipeParseInt(int32 *intVal, boolean advance)
+{
+  char *token = NULL;
+  uint8 tmp;
+
+  *intVal = 0;
+  if (m_consolePos >= m_consoleLen)
+    return false;
+  tmp = strspn(&m_tokenBuffer[m_consolePos], " ,\r\0");
+  token = strtok(&m_tokenBuffer[m_consolePos], " ,\r\0");
+  if (token != NULL)
+  {
+    if (strspn(token, "+-0123456789") == strlen(token))
+    {
+      if ( (strlen(token) > 1) ||
+           ( (token[0] != '-') && (token[0] != '+') )
+         )
+      {
+        if (advance)
+          m_consolePos += strlen(token) + tmp + 1;
+        *intVal = atoi(token);
+        return true;
+      }
+    }
+  }
+  dbgPrintln(FLASH("Couldn't parse integer"));
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalIntRelation
+//   Evaluate an integer relation.
+// Parameters:
+//   value1:IO     - The first operand value.
+//   value2:I      - The second operand value.
+//   operation:I   - The operator ID.
+// Returns: The truth of the relation.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalIntRelation(int32 value1, int32 value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_EQ:
+      return (value1 == value2);
+    case WIPE_OP_NE:
+      return (value1 != value2);
+    case WIPE_OP_LT:
+      return (value1 < value2);
+    case WIPE_OP_LE:
+      return (value1 <= value2);
+    case WIPE_OP_GT:
+      return (value1 > value2);
+    case WIPE_OP_GE:
+      return (value1 >= value2);
+    default:
+      return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalFloatRelation
+//   Evaluate an floating point relation.
+// Parameters:
+//   value1:IO     - The first operand value.
+//   value2:I      - The second operand value.
+//   operation:I   - The operator ID.
+// Returns: The truth of the relation.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalFloatRelation(float value1, float value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_EQ:
+      return (value1 == value2);
+    case WIPE_OP_NE:
+      return (value1 != value2);
+    case WIPE_OP_LT:
+      return (value1 < value2);
+    case WIPE_OP_LE:
+      return (value1 <= value2);
+    case WIPE_OP_GT:
+      return (value1 > value2);
+    case WIPE_OP_GE:
+      return (value1 >= value2);
+    default:
+      return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalBoolRelation
+//   Evaluate an boolean relation.
+// Parameters:
+//   value1:IO     - The first operand value.
+//   value2:I      - The second operand value.
+//   operation:I   - The operator ID.
+// Returns: The truth of the relation.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalBoolRelation(boolean value1, boolean value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_EQ:
+      return (value1 == value2);
+    case WIPE_OP_NE:
+      return (value1 != value2);
+    default:
+      return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalIntOperation
+//   Evaluate a simple (unary or binary) integer expression.
+// Parameters:
+//   value1:IO     - Address of the first operand value and into which the
+//                   the result is stored upon return.
+//   value2:I      - The second operand value. The value is ignored if
+//                   operation is unary.
+//   operation:I   - The operator ID.
+// Returns: true, iff the operation is valid for this type and there is no
+//          division by zero.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalIntOperation(int32 *value1, int32 value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_NEG:
+      *value1 = -*value1;
+      break;
+    case WIPE_OP_PLUS:
+      *value1 = *value1 + value2;
+      break;
+    case WIPE_OP_MINUS:
+      *value1 = *value1 - value2;
+      break;
+    case WIPE_OP_MULT:
+      *value1 = *value1 * value2;
+      break;
+    case WIPE_OP_DIV:
+      if (0 == value2)
+        return false;
+      *value1 = *value1 / value2;
+      break;
+    case WIPE_OP_MOD:
+      if (0 == value2)
+        return false;
+      *value1 = *value1 % value2;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalFloatOperation
+//   Evaluate a simple (unary or binary) floating point expression.
+// Parameters:
+//   value1:IO     - Address of the first operand value and into which the
+//                   the result is stored upon return.
+//   value2:I      - The second operand value. The value is ignored if
+//                   operation is unary.
+//   operation:I   - The operator ID.
+// Returns: true, iff the operation is valid for this type.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalFloatOperation(float *value1, float value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_NEG:
+      *value1 = -*value1;
+      break;
+    case WIPE_OP_PLUS:
+      *value1 = *value1 + value2;
+      break;
+    case WIPE_OP_MINUS:
+      *value1 = *value1 - value2;
+      break;
+    case WIPE_OP_MULT:
+      *value1 = *value1 * value2;
+      break;
+    case WIPE_OP_DIV:
+      *value1 = *value1 / value2;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalBoolOperation
+//   Evaluate a simple (unary or binary) boolean point expression.
+// Parameters:
+//   value1:IO     - Address of the first operand value and into which the
+//                   the result is stored upon return.
+//   value2:I      - The second operand value. The value is ignored if
+//                   operation is unary.
+//   operation:I   - The operator ID.
+// Returns: true, iff the operation is valid for this type.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalBoolOperation(boolean *value1, boolean value2, uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_COMPL:
+      *value1 = !*value1;
+      break;
+    case WIPE_OP_OR:
+      *value1 = *value1 || value2;
+      break;
+    case WIPE_OP_AND:
+      *value1 = *value1 && value2;
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeIsRelational
+//   Determine if an operator is a relational operator.
+// Parameters:
+//   operation:I  - ID of the operator to check.
+// Returns: true, iff operation is a relational operator.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeIsRelational(uint8 operation)
+{
+  switch (operation)
+  {
+    case WIPE_OP_EQ:
+    case WIPE_OP_NE:
+    case WIPE_OP_LT:
+    case WIPE_OP_LE:
+    case WIPE_OP_GT:
+    case WIPE_OP_GE:
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeAssign
+//   Assign a value to a variable with type casting where possible.
+// Parameters:
+//   var:O      - Address of variable to assign.
+//   varType:I  - Assigned variable's type.
+//   value:I    - Value to be assigned.
+//   valType:I  - Value's type.
+// Returns: true, iff the assignment was possible.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeAssign( SymValue_t *var, uint8 varType, SymValue_t value,
+                    uint8 valType )
+{  
+  if (varType == valType)
+  {
+    *var = value;
+    return true;
+  }
+  else if (WIPE_ID_BOOL == varType)
+  {
+    if ( (WIPE_ID_INT == valType) &&
+         ((0 == value.intValue) || (1 == value.intValue))
+       )
+    {
+      *var = value;
+      return true;
+    }
+  }
+  else if (WIPE_ID_INT == varType)
+  {
+    if (WIPE_ID_BOOL == valType)
+    {
+      *var = value;
+      return true;
+    }
+    else
+    {
+      if (WIPE_ID_FLOAT == valType)
+      {
+        if ( (value.floatValue >= (float)MININT32) &&
+             (value.floatValue <= (float)MAXINT32) )
+        {
+          (*var).intValue = (int)value.floatValue;
+          return true;
+        }
+      }
+    }
+  }
+  else
+  {
+    if (WIPE_ID_FLOAT == varType)
+    {
+      if (WIPE_ID_INT == valType)
+      {
+        (*var).floatValue = (float)value.intValue;
+        return true;
+      }
+      else
+      {
+        if (WIPE_ID_BOOL == valType)
+        {
+          (*var).floatValue = (float)value.boolValue;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalBinaryOperation
+//   Apply a binary operator to two typed operands.
+// Parameters:
+//   value1:IO     - Address of the first operand value and into which the
+//                   the result is stored upon return.
+//   type1:IO      - Address of the first operand's type and into which the
+//                   result's type is stored upon return.
+//   value2:I      - The second operand value.
+//   type2:I       - The second operand's type.
+//   operation:I   - The operator ID.
+// Returns: true, iff the operands are type-compatible within the context
+//                of the operator being applied and the operation is valid.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeEvalBinaryOperation( SymValue_t *value1, uint8 *type1,
+                                 SymValue_t  value2, uint8  type2,
+                                 uint8 operation )
+{
+  boolean truth;
+
+  if (wipeIsRelational(operation))
+  {
+    if (*type1 == type2)
+    {
+      switch (type2)
+      {
+        case WIPE_ID_INT:
+          truth = wipeEvalIntRelation( value1->intValue, value2.intValue,
+                                       operation );
+          break;
+        case WIPE_ID_FLOAT:
+          truth = wipeEvalFloatRelation( value1->floatValue,
+                                         value2.floatValue, operation );
+          break;
+        case WIPE_ID_BOOL:
+          truth = wipeEvalBoolRelation( value1->boolValue, value2.boolValue,
+                                        operation );
+          break;
+        default:
+          return false;
+      }
+    }
+    else if ( ((WIPE_ID_BOOL == *type1) && (WIPE_ID_INT == type2)) ||
+              ((WIPE_ID_INT == *type1) && (WIPE_ID_BOOL == type2))
+            )
+    {
+      /* Boolean values are held as 0 or 1 */
+      truth = wipeEvalIntRelation( value1->intValue, value2.intValue,
+                                   operation );
+    }
+    else
+    {
+      return false;
+    }
+    value1->intValue = (int32)truth;
+    *type1 = WIPE_ID_BOOL;
+    return true;
+  }
+
+  if (*type1 != type2)
+    return false;
+
+  switch (type2)
+  {
+    case WIPE_ID_INT:
+      return wipeEvalIntOperation(&value1->intValue, value2.intValue,
+                                  operation);
+    case WIPE_ID_FLOAT:
+      return wipeEvalFloatOperation(&value1->floatValue, value2.floatValue,
+                                    operation);
+    case WIPE_ID_BOOL:
+      truth = value1->boolValue;
+      if (!wipeEvalBoolOperation(&truth, value2.boolValue, operation))
+        return false;
+      value1->intValue = (int32)truth;
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeScanToken
+//   Scan for the next token in the WIPE command line.
+// Parameters: (none)
+// Returns: WIPE_UNDEF or WIPE token (e.g. WIPE_GOTO, WIPE_LABEL, etc.).
+// Inputs/Outputs:
+//   m_consoleLen:I
+//   m_consolePos:IO
+//   m_tokenBuffer:IO
+//-----------------------------------------------------------------------------
+uint8 wipeScanToken(void)
+{
+  char   *token = NULL;
+  uint8   tmp;
+
+  if (m_consolePos >= m_consoleLen)
+    return WIPE_UNDEF;
+  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
+  token = strtok(&m_tokenBuffer[m_consolePos], " (\n");
+  m_consolePos += tmp;
+    
+  if (token != NULL)
+  {
+    m_consolePos += strlen(token) + 1;
+    if (strcmp(token, "if") == 0)
+      return WIPE_IF;
+    else if (strcmp(token, "goto") == 0)
+      return WIPE_GOTO;
+    else if (strcmp(token, "label") == 0)
+      return WIPE_LABEL;
+    else if (strcmp(token, "let") == 0)
+      return WIPE_LET;
+    else if (strcmp(token, "var") == 0)
+      return WIPE_VAR;
+    else if (strcmp(token, "print") == 0)
+      return WIPE_PRINT;
+    else
+    {
+      if (m_consoleBuffer[m_consolePos - 1] != '(')
+      {
+        return WIPE_UNDEF;
+      }
+      if (token != NULL)
+      {
+        if (strcmp(token, "Bkgrd") == 0)
+          return WASPCMD_BKGRD;
+        else if (strcmp(token, "Group") == 0)
+          return WASPCMD_GROUP;
+        else if (strcmp(token, "Line") == 0)
+          return WASPCMD_LINE;
+        else if (strcmp(token, "Reset") == 0)
+          return WASPCMD_RESET;
+        else if (strcmp(token, "State") == 0)
+          return WASPCMD_STATE;
+        else if (strcmp(token, "Shift") == 0)
+          return WASPCMD_SHIFT;
+        else if (strcmp(token, "Swap") == 0)
+          return WASPCMD_SWAP;
+        else if (strcmp(token, "Rain") == 0)
+          return WASPCMD_RAINBOW;
+        else if (strcmp(token, "Cycle") == 0)
+          return WASPCMD_RAINCYCLE;
+        else if (strcmp(token, "Speed") == 0)
+          return WASPCMD_SPEED;
+        else if (strcmp(token, "Twinkle") == 0)
+          return WASPCMD_TWINKLE;
+        else if (strcmp(token, "Pixels") == 0)
+          return WASPCMD_PIXELS;
+        else if (strcmp(token, "Pause") == 0)
+          return WIPE_FN_PAUSE;
+        else if (strcmp(token, "Paint") == 0)
+          return WIPE_FN_PAINT;
+        else if (strcmp(token, "Code") == 0)
+          return WIPE_FN_CODE;
+        else if (strcmp(token, "Script") == 0)
+          return WASPCMD_SCRIPT;
+        else if (strcmp(token, "RunFx") == 0)
+          return WASPCMD_SCRIPT_RUN;
+        else if (strcmp(token, "At") == 0)
+          return WASPCMD_AT;
+        else if (strcmp(token, "Palette") == 0)
+          return WASPCMD_PALETTE;
+        else if (strcmp(token, "Fade") == 0)
+          return WASPCMD_FADE;
+        else if (strcmp(token, "Gradient") == 0)
+          return WASPCMD_GRADIENT;
+        else if (strcmp(token, "Bright") == 0)
+          return WASPCMD_BRIGHT;
+        else
+          return WIPE_UNDEF;
+      }
+    }
+  }
+  return WIPE_UNDEF;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeScanIdentifier
+//   Scan for an identifier.
+// Parameters:
+//   identifier:O  - Pointer to identifier string, if the function returns
+//                   true; NULL, otherwise.
+//   maxLen:I      - Max # of characters allowed in identifier.
+// Returns: Length of identifier, if a valid identifier was scanned; zero,
+//          otherwise.
+// Inputs/Outputs:
+//   m_consoleLen:I
+//   m_consolePos:IO
+//   m_tokenBuffer:IO
+//-----------------------------------------------------------------------------
+uint8 wipeScanIdentifier(char **identifier, uint8 maxLen)
+{
+  char    *token = NULL;
+  char     tmpStr[1] = "";
+  uint8    strLen;
+  uint8    tmp;
+  uint8    i;
+
+  *identifier = NULL;
+  if (m_consolePos >= m_consoleLen)
+    return false;
+  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
+  token = strtok(&m_tokenBuffer[m_consolePos], " \n");
+  m_consolePos += tmp;
+  if (token != NULL)
+  {
+    strLen = strlen(token);
+    m_consolePos += strLen + 1;
+    for (i = 0; i < strLen; i++)
+    {
+      if (!isalnum(token[i]) && (token[i] != '_') )
+      {
+        wipeShowError(FLASH("Bad ID"));
+        return 0;
+      }
+    }
+    if ( isdigit(token[0]) || (0 == strLen) )
+    {
+      wipeShowError(FLASH("Bad ID"));
+      return 0;
+    }
+    if (strLen > maxLen)
+    {
+      wipeShowError(FLASH("ID too long"));
+      return 0;
+    }
+
+    *identifier = token;
+    return strLen;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeShowExprErr
+//   Show detected error in an expression string being parsed.
+// Parameters:
+//   expStr:I   - Pointer to the expression string.
+//   errPos:I   - Position at which error is detected within the expression.
+//   errStr:I   - Error string to display. The argument should be provided
+//                using the FLASH() macro:
+//                  e.g. wipeShowExprErr(FLASH("Error text"));
+// Returns: (none)
+// Inputs/Outputs:
+//   m_consolePos:I
+//   m_exprOffs:I
+//-----------------------------------------------------------------------------
+void wipeShowExprErr(char    *exprStr,
+                     uint8    errPos,
+                     const __FlashStringHelper *errStr)
+{
+  /* Output the raw ASCII console line being that's being parsed */
+  wipeShowConsoleLine();
+  for (uint8 i = 0; i < (m_consolePos + m_exprOffs + errPos); i++)
+    logPrint(FLASH(" "));
+
+  logPrintln(FLASH("^"));
+  logPrintln(errStr);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeScanOperator
+//   Scan for an operator in an expression.
+// Parameters:
+//   ppPos:IO   - Address of a pointer to the current character in the
+//                expression string. Upon invocation, this should point to a
+//                string position preceding a presumed operand. Upon
+//                return this points to the first white space character
+//                following the operand, if the function returns false;
+//                otherwise it points to the position at which the error
+//                was detected.
+//   pKind:O    - Address at which to return the kind of operator (e.g.
+//                WIPE_OP_PLUS).
+//   pOpLen:O   - Number of characters in the operator.
+//   pScanLen:O - Address at which to return the total number of characters
+//                scanned.
+// Returns: true, iff a valid operator was successfully scanned or the end
+//                of line was reached.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeScanOperator( char **ppPos, uint8 *pKind, uint8 *pOpLen,
+                          uint8 *pScanLen )
+{
+  char     c;
+  char    *pChar;
+  boolean  ret;
+  
+  *pKind = WIPE_OP_UNDEF;
+  pChar = *ppPos;
+  *pScanLen = 0;
+
+  /* Skip white space */
+  c = *pChar++;
+  while (c == ' ')
+    c = *pChar++;
+
+  if ( ('\r' == c) || ('\0' == c) )
+  {
+    return true;
+  }
+
+  *pScanLen = pChar - *ppPos;
+  *ppPos = pChar;
   *pOpLen = 1;
   switch (c)
   {
-    case '+':
-      *pKind = WIPE_OP_PLUS;
-      return true;
-    case '-':
-      *pKind = WIPE_OP_MINUS;
-      return true;
-    case '*':
-      *pKind = WIPE_OP_MULT;
-      return true;
-    case '/':
-      *pKind = WIPE_OP_DIV;
-      return true;
-    case '%':
-      *pKind = WIPE_OP_MOD;
-      return true;
-    case '=':
-      *pKind = WIPE_OP_EQ;
-      return true;
-    case ',':
-    case ')':
-      *pKind = WIPE_OP_DELIM;
-      return true;
-    case '|':
-      if ('|' == *pChar)
+    case '+':
+      *pKind = WIPE_OP_PLUS;
+      return true;
+    case '-':
+      *pKind = WIPE_OP_MINUS;
+      return true;
+    case '*':
+      *pKind = WIPE_OP_MULT;
+      return true;
+    case '/':
+      *pKind = WIPE_OP_DIV;
+      return true;
+    case '%':
+      *pKind = WIPE_OP_MOD;
+      return true;
+    case '=':
+      *pKind = WIPE_OP_EQ;
+      return true;
+    case ',':
+    case ')':
+      *pKind = WIPE_OP_DELIM;
+      return true;
+    case '|':
+      if ('|' == *pChar)
+      {
+        if (' ' == *(pChar+1))
+        {
+          (*ppPos)++;
+          (*pOpLen)++;
+          (*pScanLen)++;
+          *pKind = WIPE_OP_OR;
+          return true;
+        }
+        else
+          return false;
+      }
+      else
+        return false;
+    case '&':
+      if ('&' == *pChar)
+      {
+        if (' ' == *(pChar+1))
+        {
+          (*ppPos)++;
+          (*pOpLen)++;
+          (*pScanLen)++;
+          *pKind = WIPE_OP_AND;
+          return true;
+        }
+        else
+          return false;
+      }
+      else
+        return false;
+    case '!':
+      if ('=' == *pChar)
+      {
+        (*ppPos)++;
+        (*pOpLen)++;
+        (*pScanLen)++;
+        *pKind = WIPE_OP_NE;
+        return true;
+      }
+      else
+        return false;
+    case '<':
+      if (' ' == *pChar)
+      {
+        *pKind = WIPE_OP_LT;
+        return true;
+      }
+      else if ('=' == *pChar)
+      {
+        if (' ' == *(pChar+1))
+        {
+          (*ppPos)++;
+          (*pOpLen)++;
+          (*pScanLen)++;
+          *pKind = WIPE_OP_LE;
+          return true;
+        }
+        else
+          return false;
+      }
+      else
+        return false;
+    case '>':
+      if (' ' == *pChar)
+      {
+        *pKind = WIPE_OP_GT;
+        return true;
+      }
+      else if ('=' == *pChar)
+      {
+        if (' ' == *(pChar+1))
+        {
+          (*ppPos)++;
+          (*pOpLen)++;
+          (*pScanLen)++;
+          *pKind = WIPE_OP_GE;
+          return true;
+        }
+        else
+          return false;
+      }
+      else
+        return false;
+    default:
+      return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeScanOperand
+//   Scan for the next operand in an expression. It also scan unary operators.
+// Parameters:
+//   ppPos:IO   - Address of a pointer to the current character in the
+//                expression string. Upon invocation, this should point to a
+//                string position preceding a presumed operand. Upon
+//                return this points to the first white space character
+//                following the operand, if the function returns false;
+//                otherwise it points to the position at which the error
+//                was detected.
+//   pKind:O    - Address at which to return the kind of operand (e.g.
+//                WIPE_OPRND_LIT).
+//   ppStart:O  - Address at which to return the pointer to the first
+//                character of the operand.
+//   pLen:O     - Address at which to return the number of characters in
+//                the operand.
+//   pScanLen:O - Address at which to return the total number of characters
+//                scanned.
+//   pUnary:O   - Address at which to return the unary operator (e.g.
+//                WIPE_OP_NEG). The output value is WIPE_OP_UNDEF if
+//                there wasn't one.
+// Returns: true, iff an operand was successfully scanned.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeScanOperand( char    **ppPos,
+                         uint8    *pKind,
+                         char    **ppStart,
+                         uint8    *pLen,
+                         uint8    *pScanLen,
+                         uint8    *pUnary)
+{
+  char     c;
+  char    *pChar;
+  uint8    strLen;
+  uint8    tmp;
+  boolean  foundDecPoint = false;
+
+  *pKind = WIPE_OPRND_UNDEF;
+  *pUnary = WIPE_OP_UNDEF;
+  pChar = *ppPos;
+  *ppStart = pChar;
+  *pLen = 0;
+  *pScanLen = 0;
+  
+  /* Skip white space */
+  c = *pChar++;
+  while (c == ' ')
+    c = *pChar++;
+    
+  if ('\0' == c)
+  {
+    return false;
+  }
+
+  /* Scan for a negation/complement */
+  if ( (c == '-') || (c == '!') )
+  {
+    if (c == '-')
+      *pUnary = WIPE_OP_NEG;
+    else
+      *pUnary = WIPE_OP_COMPL;
+    c = *pChar++;
+    if (' ' == c)
+    {
+      wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs,
+                       FLASH("Invalid unary operation"));
+    }
+  }
+
+  *ppStart = (pChar - 1);
+
+
+  /*---  scan the operand  ---*/
+
+  /* Determine if operand is a literal */
+  if (isdigit(c))
+  {
+    *pKind = WIPE_OPRND_LIT;
+    c = *pChar++;
+  }
+  else
+  {
+    *pKind = WIPE_OPRND_ID;
+  }
+
+  while ( (c != ' ') && (c != '\0') && (c != ',') && (c != ')') )
+  {
+    if (WIPE_OPRND_LIT == *pKind)
+    {
+      if (!isdigit(c) && (c != '.'))
       {
-        if (' ' == *(pChar+1))
+        wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs,
+                         FLASH("Invalid literal value") );
+        return false;
+      }
+      if ('.' == c)
+      {
+        if (!foundDecPoint)
+        {
+          foundDecPoint = true;
+        }
+        else
+        {
+          wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs,
+                           FLASH("Invalid floating point number") );
+          return false;
+        }
+      }
+    }
+    else
+    {
+      /* (WIPE_OPRND_ID == *pKind) */
+      if (!isalnum(c) && (c != '_'))
+      {
+        wipeShowExprErr( *ppPos, (pChar - *ppStart) + m_exprOffs,
+                         FLASH("Invalid identifier") );
+        return false;
+      }
+    }
+    c = *pChar++;
+  }
+  pChar--;
+
+  if ( (WIPE_OPRND_LIT != *pKind) && ((pChar - *ppStart) > MAX_ID_LEN) )
+  {
+    wipeShowExprErr( *ppPos, (pChar - *ppPos),
+                     FLASH("Identifier name is too long"));
+    return false;
+  }
+
+  *pLen = (pChar - *ppStart);
+  *pScanLen = (pChar - *ppPos);
+  *ppPos = pChar;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEmitByte
+//   Append a byte to the tokenized statement being built in program memory.
+// Parameters:
+//   value:I  - Byte to be appended.
+// Returns: true, iff there was room for the byte.
+// Inputs/Outputs:
+//   m_wipeLineStart:I
+//   m_program:O
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+boolean wipeEmitByte(uint8 value)
+{
+  if ( (m_wipeProgByte >= MAX_PROG_SIZE) ||
+       ((m_wipeProgByte - m_wipeLineStart) >= MAX_TKNZD_LEN) )
+  {
+    wipeShowError(FLASH("Statement too long"));
+    return false;
+  }
+  m_program[m_wipeProgByte++] = value;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEmitBytes
+//   Append a sequence of bytes to the tokenized statement being built in
+//   program memory.
+// Parameters:
+//   pBytes:I  - Pointer to the bytes to be appended.
+//   len:I     - Number of bytes to append.
+// Returns: true, iff there was room for the bytes.
+// Inputs/Outputs:
+//   m_program:O
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+boolean wipeEmitBytes(const void *pBytes, uint8 len)
+{
+  const uint8 *pByte = (const uint8 *)pBytes;
+
+  for ( ; len > 0; len--)
+  {
+    if (!wipeEmitByte(*pByte++))
+      return false;
+  }
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEmitIdentifier
+//   Append an identifier, preceded by its symbol table index, to the
+//   tokenized statement being built in program memory.
+// Parameters:
+//   identifier:I  - Identifier string.
+// Returns: true, iff the identifier was appended.
+// Inputs/Outputs:
+//   m_program:O
+//   m_symTbl:IO
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+boolean wipeEmitIdentifier(char *identifier)
+{
+  uint8 symIdx;
+
+  if (!wipeSymbolIntern(identifier, &symIdx))
+  {
+    wipeShowError(FLASH("No room in sym table"));
+    return false;
+  }
+  return ( wipeEmitByte(symIdx) &&
+           wipeEmitBytes(identifier, strlen(identifier) + 1) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEmitOperand
+//   Append the bytecode that pushes a scanned expression operand. Literal
+//   values are converted and variables are assigned their symbol table
+//   entry here, so none of that work is repeated at run time.
+// Parameters:
+//   kind:I    - Kind of operand (e.g. WIPE_OPRND_LIT).
+//   pStart:I  - Pointer to the first character of the operand.
+//   len:I     - Number of characters in the operand.
+// Returns: true, iff the operand bytecode was appended.
+// Inputs/Outputs:
+//   m_program:O
+//   m_symTbl:IO
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+boolean wipeEmitOperand(uint8 kind, char *pStart, uint8 len)
+{
+  char    oprnd[MAX_LIT_LEN + 1];
+  char   *pDecPoint;
+  int32   intVal;
+  float   floatVal;
+  uint8   symIdx;
+  uint8   decimals;
+
+  if (len > MAX_LIT_LEN)
+  {
+    wipeShowError(FLASH("Literal too long"));
+    return false;
+  }
+  memcpy(oprnd, pStart, len);
+  oprnd[len] = '\0';
+
+  if (WIPE_OPRND_ID == kind)
+  {
+    if (!wipeSymbolIntern(oprnd, &symIdx))
+    {
+      wipeShowError(FLASH("No room in sym table"));
+      return false;
+    }
+    return ( wipeEmitByte(WIPE_BC_VAR) &&
+             wipeEmitByte(symIdx) &&
+             wipeEmitBytes(oprnd, len + 1) );
+  }
+
+  pDecPoint = strchr(oprnd, '.');
+  if (pDecPoint != NULL)
+  {
+    /* Remember the # of decimals so the literal can be listed as typed */
+    floatVal = atof(oprnd);
+    decimals = strlen(pDecPoint + 1);
+    if (0 == decimals)
+      decimals = 1;
+    return ( wipeEmitByte(WIPE_BC_FLOAT) &&
+             wipeEmitBytes(&floatVal, sizeof(float)) &&
+             wipeEmitByte(decimals) );
+  }
+
+  intVal = atol(oprnd);
+  if (intVal <= 0xFF)
+  {
+    return ( wipeEmitByte(WIPE_BC_INT8) && wipeEmitByte((uint8)intVal) );
+  }
+  return ( wipeEmitByte(WIPE_BC_INT32) &&
+           wipeEmitBytes(&intVal, sizeof(int32)) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeCompileExpression
+//   Parse an expression and append its postfix (RPN) bytecode to the
+//   statement being built in program memory. As binary operators have equal
+//   precedence and are evaluated left-to-right, "a + -b * c" is compiled as
+//   "a b NEG PLUS c MULT END".
+// Parameters:
+//   pExpr:I       - Pointer to the start of the expression string.
+//   listOk:I      - Allow an expression to be terminated by a comma or
+//                   closed parenthesis, iff true.
+// Returns: true, iff parsing was successful.
+// Inputs/Outputs:
+//   m_exprOffs:O
+//   m_program:O
+//   m_symTbl:IO
+//   m_wipeProgByte:IO
+//-----------------------------------------------------------------------------
+boolean wipeCompileExpression(char *pExpr, boolean listOk)
+{
+  char       *pPos = pExpr;
+  char       *pStart;
+  boolean     scanOk;
+  uint8       oprndKind;
+  uint8       oprndLen;
+  uint8       scanLen;
+  uint8       operatorLen;
+  uint8       operation;
+  uint8       binaryOp = WIPE_OP_UNDEF;
+  uint8       unary;
+
+  m_exprOffs = 0;
+  while (true)
+  {
+    scanOk = wipeScanOperand( &pPos, &oprndKind, &pStart, &oprndLen,
+                              &scanLen, &unary );
+    if (!scanOk)
+    {
+      return false;
+    }
+
+    /* Operand, then its unary operator, then the preceding binary operator */
+    if (!wipeEmitOperand(oprndKind, pStart, oprndLen))
+      return false;
+    if ( (unary != WIPE_OP_UNDEF) && !wipeEmitByte(unary) )
+      return false;
+    if ( (binaryOp != WIPE_OP_UNDEF) && !wipeEmitByte(binaryOp) )
+      return false;
+    m_exprOffs += scanLen;
+
+    scanOk = wipeScanOperator(&pPos, &operation, &operatorLen, &scanLen);
+    m_exprOffs += scanLen;
+    if (!scanOk)
+    {
+      wipeShowExprErr( pExpr, (pStart - pExpr), FLASH("Bad operator") );
+      return false;
+    }
+
+    /* Potential operator or End-of-line found */
+    if (!listOk && (operation == WIPE_OP_DELIM))
+    {
+      wipeShowExprErr( pExpr, (pStart - pExpr + scanLen),
+                       FLASH("Unexpected list") );
+      return false;
+    }
+    if ( (operation == WIPE_OP_UNDEF) || (operation == WIPE_OP_DELIM))
+    {
+      /* We've hit the end of the expression. */
+      return wipeEmitByte(WIPE_BC_END);
+    }
+    binaryOp = operation;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeExprNextCode
+//   Determine where the next expression bytecode starts.
+// Parameters:
+//   pos:I  - m_program[] index of the current expression bytecode.
+// Returns: The m_program[] index of the following bytecode.
+// Inputs/Outputs:
+//   m_program:I
+//-----------------------------------------------------------------------------
+uint16 wipeExprNextCode(uint16 pos)
+{
+  switch (m_program[pos])
+  {
+    case WIPE_BC_INT8:
+      return pos + 2;
+    case WIPE_BC_INT32:
+      return pos + 1 + sizeof(int32);
+    case WIPE_BC_FLOAT:
+      return pos + 2 + sizeof(float);
+    case WIPE_BC_VAR:
+      return pos + 3 + strlen((char *)&m_program[pos + 2]);
+    default:
+      return pos + 1;  /* Operators and WIPE_BC_END */
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeResolveExpression
+//   Reassign the symbol table entries referenced by an expression's
+//   bytecode (e.g. after a program is loaded or the symbol table is
+//   cleared).
+// Parameters:
+//   pos:I  - m_program[] index of the expression's first bytecode.
+// Returns: The m_program[] index following the expression, if successful;
+//          MAX_PROG_SIZE, if the symbol table is full.
+// Inputs/Outputs:
+//   m_program:IO
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+uint16 wipeResolveExpression(uint16 pos)
+{
+  while (m_program[pos] != WIPE_BC_END)
+  {
+    if (WIPE_BC_VAR == m_program[pos])
+    {
+      if (!wipeSymbolIntern((char *)&m_program[pos + 2], &m_program[pos + 1]))
+        return MAX_PROG_SIZE;
+    }
+    pos = wipeExprNextCode(pos);
+  }
+  return pos + 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeResolveIdentifier
+//   Reassign the symbol table entry of a statement's identifier.
+// Parameters:
+//   pos:I  - m_program[] index of the identifier's symbol table index,
+//            which is followed by the identifier string.
+// Returns: The m_program[] index following the identifier string, if
+//          successful; MAX_PROG_SIZE, if the symbol table is full.
+// Inputs/Outputs:
+//   m_program:IO
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+uint16 wipeResolveIdentifier(uint16 pos)
+{
+  char *identifier = (char *)&m_program[pos + 1];
+
+  if (!wipeSymbolIntern(identifier, &m_program[pos]))
+    return MAX_PROG_SIZE;
+  return pos + strlen(identifier) + 2;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeShowRunError
+//   Display a WIPE program execution error on the console.
+// Parameters:
+//   errStr:I  - Error string to display. The argument should be provided
+//               using the FLASH() macro:
+//                 e.g. wipeShowRunError(FLASH("Error text"));
+// Returns: (none)
+// Inputs/Outputs:
+//   m_wipeLineStart:I
+//-----------------------------------------------------------------------------
+void wipeShowRunError(const __FlashStringHelper *errStr)
+{
+  wipePrintStatement();
+  logPrint(FLASH("***ERROR: "));
+  logPrintln(errStr);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeEvalExpression
+//   Evaluate a compiled expression using an operand stack.
+// Parameters:
+//   pPos:IO     - Address of the m_program[] index of the expression's first
+//                 bytecode. Upon successful return, it is the index of the
+//                 byte following the expression.
+//   type:I      - The type to which the expression should evaluate. Valid
+//                 types are: WIPE_ID_INT, WIPE_ID_FLOAT, WIPE_ID_BOOL.
+//   pResult:O   - Address at which to place the result. It's left unchanged
+//                 if evaluation fails.
+// Returns: true, iff evaluation was successful.
+// Inputs/Outputs:
+//   m_program:I
+//   m_symTbl:I
+//-----------------------------------------------------------------------------
+boolean wipeEvalExpression(uint16 *pPos, uint8 type, SymValue_t *pResult)
+{
+  SymValue_t  stack[WIPE_STACK_SIZE];
+  uint8       types[WIPE_STACK_SIZE];
+  uint8       sp = 0;   // # of operands on the stack
+  uint16      pos = *pPos;
+  uint8       code;
+  uint8       symIdx;
+  boolean     legalOp;
+  boolean     truth;
+
+  while (true)
+  {
+    code = m_program[pos];
+    if ( (code >= WIPE_BC_INT8) && (sp >= WIPE_STACK_SIZE) )
+    {
+      wipeShowRunError(FLASH("Expression too complex"));
+      return false;
+    }
+
+    switch (code)
+    {
+      case WIPE_BC_END:
+        if (sp != 1)
         {
-          (*ppPos)++;
-          (*pOpLen)++;
-          (*pScanLen)++;
-          *pKind = WIPE_OP_OR;
-          return true;
+          wipeShowRunError(FLASH("Bad expression code"));
+          return false;
         }
-        else
+        if (!wipeAssign(pResult, type, stack[0], types[0]))
+        {
+          wipeShowRunError(FLASH("Expression is of wrong type"));
           return false;
-      }
-      else
-        return false;
-    case '&':
-      if ('&' == *pChar)
-      {
-        if (' ' == *(pChar+1))
+        }
+        *pPos = pos + 1;
+        return true;
+      case WIPE_BC_INT8:
+        stack[sp].intValue = m_program[pos + 1];
+        types[sp++] = WIPE_ID_INT;
+        pos += 2;
+        break;
+      case WIPE_BC_INT32:
+        memcpy(&stack[sp].intValue, &m_program[pos + 1], sizeof(int32));
+        types[sp++] = WIPE_ID_INT;
+        pos += 1 + sizeof(int32);
+        break;
+      case WIPE_BC_FLOAT:
+        memcpy(&stack[sp].floatValue, &m_program[pos + 1], sizeof(float));
+        types[sp++] = WIPE_ID_FLOAT;
+        pos += 2 + sizeof(float);
+        break;
+      case WIPE_BC_VAR:
+        symIdx = m_program[pos + 1];
+        if ( (symIdx >= MAX_NUM_SYMBOLS) ||
+             (m_symTbl[symIdx].typeId == WIPE_ID_UNDEF) ||
+             (m_symTbl[symIdx].typeId == WIPE_ID_LABEL) )
         {
-          (*ppPos)++;
-          (*pOpLen)++;
-          (*pScanLen)++;
-          *pKind = WIPE_OP_AND;
-          return true;
+          wipePrintStatement();
+          logPrint(FLASH("***ERROR: Variable '"));
+          logPrint((char *)&m_program[pos + 2]);
+          logPrintln(FLASH("' undefined."));
+          return false;
         }
-        else
+        stack[sp] = m_symTbl[symIdx].symValue;
+        types[sp++] = m_symTbl[symIdx].typeId;
+        pos = wipeExprNextCode(pos);
+        break;
+      case WIPE_OP_NEG:
+      case WIPE_OP_COMPL:
+        if (0 == sp)
+        {
+          wipeShowRunError(FLASH("Bad expression code"));
           return false;
-      }
-      else
-        return false;
-    case '!':
-      if ('=' == *pChar)
-      {
-        (*ppPos)++;
-        (*pOpLen)++;
-        (*pScanLen)++;
-        *pKind = WIPE_OP_NE;
-        return true;
-      }
-      else
-        return false;
-    case '<':
-      if (' ' == *pChar)
-      {
-        *pKind = WIPE_OP_LT;
-        return true;
-      }
-      else if ('=' == *pChar)
-      {
-        if (' ' == *(pChar+1))
+        }
+        switch (types[sp - 1])
         {
-          (*ppPos)++;
-          (*pOpLen)++;
-          (*pScanLen)++;
-          *pKind = WIPE_OP_LE;
-          return true;
+          case WIPE_ID_INT:
+            legalOp = wipeEvalIntOperation(&stack[sp - 1].intValue, 0, code);
+            break;
+          case WIPE_ID_FLOAT:
+            legalOp = wipeEvalFloatOperation(&stack[sp - 1].floatValue, 0,
+                                             code);
+            break;
+          case WIPE_ID_BOOL:
+            truth = stack[sp - 1].boolValue;
+            legalOp = wipeEvalBoolOperation(&truth, false, code);
+            stack[sp - 1].intValue = (int32)truth;
+            break;
+          default:
+            legalOp = false;
         }
-        else
+        if (!legalOp)
+        {
+          wipeShowRunError(FLASH("Bad unary operator"));
           return false;
-      }
-      else
-        return false;
-    case '>':
-      if (' ' == *pChar)
-      {
-        *pKind = WIPE_OP_GT;
-        return true;
-      }
-      else if ('=' == *pChar)
-      {
-        if (' ' == *(pChar+1))
+        }
+        pos++;
+        break;
+      default:
+        /* Binary operator */
+        if (sp < 2)
         {
-          (*ppPos)++;
-          (*pOpLen)++;
-          (*pScanLen)++;
-          *pKind = WIPE_OP_GE;
-          return true;
+          wipeShowRunError(FLASH("Bad expression code"));
+          return false;
         }
-        else
+        sp--;
+        if (!wipeEvalBinaryOperation( &stack[sp - 1], &types[sp - 1],
+                                      stack[sp], types[sp], code ))
+        {
+          wipeShowRunError(FLASH("Bad operands for operator"));
           return false;
-      }
-      else
-        return false;
-    default:
-      return false;
+        }
+        pos++;
+    }
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeScanOperand
-//   Scan for the next operand in an expression. It also scan unary operators.
+// Function: wipeFuncGetParmNum
+//   Retrieve the number of parameters expected for each of WIPE's WASP
+//   functions.
 // Parameters:
-//   ppPos:IO   - Address of a pointer to the current character in the
-//                expression string. Upon invocation, this should point to a
-//                string position preceding a presumed operand. Upon
-//                return this points to the first white space character
-//                following the operand, if the function returns false;
-//                otherwise it points to the position at which the error
-//                was detected.
-//   eval:I     - Expression is being evaluated.
-//   pKind:O    - Address at which to return the kind of operand (e.g.
-//                WIPE_OPRND_LIT).
-//   ppStart:O  - Address at which to return the pointer to the first
-//                character of the operand.
-//   pLen:O     - Address at which to return the number of characters in
-//                the operand.
-//   pScanLen:O - Address at which to return the total number of characters
-//                scanned.
-//   pUnary:O   - Address at which to return the unary operator (e.g.
-//                WIPE_OP_NEG). The output value is WIPE_OP_UNDEF if
-//                there wasn't one.
-// Returns: true, iff an operand was successfully scanned.
-// Inputs/Outputs: (none)
+//   funcId:I  - Function identifier.
+// Returns: The number of parameters expected.
+// Inputs/Outputs:
 //-----------------------------------------------------------------------------
-boolean wipeScanOperand( char    **ppPos,
-                         boolean   eval,
-                         uint8    *pKind,
-                         char    **ppStart,
-                         uint8    *pLen,
-                         uint8    *pScanLen,
-                         uint8    *pUnary)
+uint8 wipeFuncGetParmNum(uint8 funcId)
 {
-  char     c;
-  char    *pChar;
-  uint8    strLen;
-  uint8    tmp;
-  boolean  foundDecPoint = false;
-
-  *pKind = WIPE_OPRND_UNDEF;
-  *pUnary = WIPE_OP_UNDEF;
-  pChar = *ppPos;
-  *ppStart = pChar;
-  *pLen = 0;
-  *pScanLen = 0;
-  
-  /* Skip white space */
-  c = *pChar++;
-  while (c == ' ')
-    c = *pChar++;
-    
-  if ('\0' == c)
-  {
-    return false;
-  }
-
-  /* Scan for a negation/complement */
-  if ( (c == '-') || (c == '!') )
+  switch (funcId)
   {
-    if (c == '-')
-      *pUnary = WIPE_OP_NEG;
-    else
-      *pUnary = WIPE_OP_COMPL;
-    c = *pChar++;
-    if (' ' == c)
-    {
-      wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs, eval,
-                       FLASH("Invalid unary operation"));
-    }
+    case WASPCMD_GROUP:       return 4;
+    case WASPCMD_STATE:       return 2;
+    case WASPCMD_BKGRD:       return 4;
+    case WASPCMD_LINE:        return 6;
+    case WASPCMD_SHIFT:       return 2;
+    case WASPCMD_SWAP:        return 7;
+    case WASPCMD_RESET:       return 1;
+    case WASPCMD_SPEED:       return 2;
+    case WASPCMD_RAINBOW:     return 2;
+    case WASPCMD_RAINCYCLE:   return 1;
+    case WASPCMD_TWINKLE:     return 5;
+    case WASPCMD_PIXELS:      return 3;
+    case WIPE_FN_PAUSE:       return 3;
+    case WIPE_FN_PAINT:       return 5;
+    case WIPE_FN_CODE:        return 4;
+    case WASPCMD_SCRIPT:      return 2;
+    case WASPCMD_SCRIPT_RUN:  return 2;
+    case WASPCMD_AT:          return 1;
+    case WASPCMD_PALETTE:     return 5;
+    case WASPCMD_FADE:        return 5;
+    case WASPCMD_GRADIENT:    return 8;
+    case WASPCMD_BRIGHT:      return 4;
+    default:
+      logPrintln(FLASH("***SYS ERROR: Unknown func"));
+      return 0;
   }
+}
 
-  *ppStart = (pChar - 1);
 
+//-----------------------------------------------------------------------------
+// Function: wipeParseStatement
+//   Parse and tokenize a WIPE programming language statement.
+// Parameters:
+//   lineNum:I     - The line number assigned to the candidate statement. A
+//                   value of 0 means that the line is going to be executed
+//                   immediately.
+//   initToken:I   - The prescanned token, if applicable. Set the value
+//                   to WIPE_UNDEF if a statement token needs to be scanned
+//                   first by the function.
+//   stmtErr:O     - The parameter is set to true upon return iff a WIPE
+//                   statement has been detected but contains an error that
+//                   has already been reported.
+// Returns: true iff the statement is valid.
+// Inputs/Outputs:
+//   m_consoleBuffer:I
+//   m_consoleLen:I
+//   m_exprOffs:I
+//   m_wipeLineStart:I
+//   m_consolePos:IO
+//   m_program:IO
+//   m_tokenBuffer:IO
+//   m_wipeProgByte:IO
+// Notes:
+//   WIPE staement format:
+//      byte   byte
+//    +-------+-----+------+-
+//    | LINE# | LEN | STMT |              b
+//    +-------+-----+------+-             y
+//                                 strlen() <=  t
+//                     ...         MAX_ID_LEN   e    byte
+//                  +------+-----+-------------+--+--------+  (LEN =
+//                  | var  | SYM | NAME-STRING |\0| TYPEID |   strlen() + 6)
+//                  +------+-----+-------------+--+--------+
+//                  | let  | SYM | NAME-STRING |\0| EXPR   |
+//                  +------+-----+-------------+--+--------+
+//                  |label | SYM | NAME-STRING |\0|
+//                  +------+-----+-------------+--+
+//                  | goto | SYM | NAME-STRING |\0|
+//                  +------+-----+-------------+--+
+//                  +------+------+
+//                  |  if  | EXPR |
+//                  +------+------+
+//                  +------+-------+-------+-------+
+//                  |pause | uint8 | uint8 | uint8 |
+//                  +------+-------+-------+-------+
+//                  +------+--------------+---------------------+--+
+//                  |print | WIPE_PRT_STR | QUOTED-STRING       |\0|
+//                  +------+--------------+-----+---------------+--+
+//                         | WIPE_PRT_VAR | SYM | NAME-STRING   |\0|
+//                         +--------------+-----+---------------+--+
+//                  +------+---+---+------+-----+------+
+//                  |[func]|<f>|<n>| EXPR | ... | EXPR | (<n> EXPR instances)
+//                  +------+---+---+------+-----+------+
+//
+//    EXPR = a simple expression with no operator precedence, compiled
+//           to postfix bytecode (refer to WIPE_BC_END, etc.) that ends
+//           with WIPE_BC_END.
+//    LEN  = total # of bytes in the line.
+//    SYM  = symbol table index assigned to NAME-STRING (refer to
+//           wipeResolveProgram()).
+//    STMT = statement type
+//    <f> in {WASP command codes (e.g. WASPCMD_GROUP) & misc functions
+//            (e.g. WIPE_FN_PAUSE)}
+//    <n> = the number of uint8 parameters defined for <f> that follow.
+//-----------------------------------------------------------------------------
+boolean wipeParseStatement(uint8 lineNum, uint8 initToken, boolean *stmtErr)
+{
+  char       *identifier;
+  char       *typeStr;
+  char       *token;
+  uint8       tokenId;
+  uint8       typeId;
+  uint8       symIdx;
+  uint8       tmp;
+  uint8       strLen;
+  uint8       parmsLen = 0;
 
-  /*---  scan the operand  ---*/
 
-  /* Determine if operand is a literal */
-  if (isdigit(c))
-  {
-    *pKind = WIPE_OPRND_LIT;
-    c = *pChar++;
-  }
+  if (initToken != WIPE_UNDEF)
+    tokenId = initToken;
   else
-  {
-    *pKind = WIPE_OPRND_ID;
-  }
+    tokenId = wipeScanToken();
+  if (WIPE_UNDEF == tokenId)
+    return false;
 
-  while ( (c != ' ') && (c != '\0') && (c != ',') && (c != ')') )
+  m_program[m_wipeProgByte++] = lineNum;
+  m_program[m_wipeProgByte++] = 3;
+  m_program[m_wipeProgByte++] = tokenId;
+
+  *stmtErr = true;
+  switch (tokenId)
   {
-    if (WIPE_OPRND_LIT == *pKind)
-    {
-      if (!isdigit(c) && (c != '.'))
+    case WIPE_IF:
+      /* Compile the expression */
+      if (!wipeCompileExpression(&m_tokenBuffer[m_consolePos], false))
       {
-        wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs, eval,
-                         FLASH("Invalid literal value") );
+        wipeShowError(FLASH("Expr Syntax"));
         return false;
       }
-      if ('.' == c)
+
+      /* Statement is valid */
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+      *stmtErr = false;
+      return true;
+      break;
+    case WIPE_GOTO:
+      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
+      if (0 == strLen)
+        return false;
+      if (!wipeEmitIdentifier(identifier))
+        return false;
+
+      /* Statement is valid */
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+      *stmtErr = false;
+      return true;
+      break;
+    case WIPE_LABEL:
+      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
+      if (0 == strLen)
+        return false;
+      if (!wipeEmitIdentifier(identifier))
+        return false;
+
+      /* Statement is valid */
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+      *stmtErr = false;
+      return true;
+      break;
+    case WIPE_LET:
+      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
+      if (0 == strLen)
+        return false;
+      if (!wipeEmitIdentifier(identifier))
+        return false;
+      
+      /* Scan for, and skip over, the "=" */
+      tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
+      token = strtok(&m_tokenBuffer[m_consolePos], " \n");
+      m_consolePos += tmp + 1;
+      if (strcmp(token, "=") != 0)
       {
-        if (!foundDecPoint)
-        {
-          foundDecPoint = true;
-        }
-        else
-        {
-          wipeShowExprErr( *ppPos, (pChar - *ppPos) + m_exprOffs, eval,
-                           FLASH("Invalid floating point number") );
-          return false;
-        }
+        wipeShowError(FLASH("Missing '='"));
+        return false;
       }
-    }
-    else
-    {
-      /* (WIPE_OPRND_ID == *pKind) */
-      if (!isalnum(c) && (c != '_'))
+      m_consolePos += strlen(token);
+
+      /* Compile the expression */
+      if (!wipeCompileExpression(&m_tokenBuffer[m_consolePos], false))
       {
-        wipeShowExprErr( *ppPos, (pChar - *ppStart) + m_exprOffs, eval,
-                         FLASH("Invalid identifier") );
+        wipeShowError(FLASH("Expr Syntax"));
         return false;
       }
-    }
-    c = *pChar++;
-  }
-  pChar--;
-
-  if ( (WIPE_OPRND_LIT != *pKind) && ((pChar - *ppStart) > MAX_ID_LEN) )
-  {
-    wipeShowExprErr( *ppPos, (pChar - *ppPos), eval,
-                     FLASH("Identifier name is too long"));
-    return false;
-  }
-
-  *pLen = (pChar - *ppStart);
-  *pScanLen = (pChar - *ppPos);
-  *ppPos = pChar;
-  return true;
-}
-
-
-//-----------------------------------------------------------------------------
-// Function: wipeParseExpression
-//   Parse, and optionally evaluate, an expression.
-// Parameters:
-//   pExpr:I       - Pointer to the start of the expression string.
-//   type:I        - The type to which the expression should evaluate. If set
-//                   to WIPE_ID_UNDEF, the expression is only parsed. Valid
-//                   types are: WIPE_ID_INT, WIPE_ID_FLOAT, WIPE_ID_BOOL.
-//   listOk:I      - Allow an expression to be terminated by a comma or
-//                   closed parenthesis, iff true.
-//   pResult:O     - Address at which to place the result, if evaluate
-//                   is set to true.
-// Returns: true, iff parsing and/or evaluation was successful.
-// Inputs/Outputs:
-//   m_symTbl:I
-//   m_exprOffs:O
-//-----------------------------------------------------------------------------
-boolean wipeParseExpression( char *pExpr, uint8 type, boolean listOk,
-                             SymValue_t *pResult )
-{
-  char       *pPos = pExpr;
-  char       *pStart;
-  SymValue_t  oprndValue1;
-  SymValue_t  currOprndValue;
-  uint32      dummyValue;
-  float       tmpValue;
-  boolean     scanOk;
-  boolean     firstOprnd = true;
-  boolean     legalOp;
-  uint8       oprndKind;
-  uint8       oprndType1;
-  uint8       currOprndType;
-  uint8       oprndLen;
-  uint8       scanLen;
-  uint8       operatorLen;
-  uint8       operation;
-  uint8       unary;
-  uint8       oprndIdx;     // Symbol table index for variable
-  uint8       i;
-  char        tmpChar;
 
-  m_exprOffs = 0;
-  while (true)
-  {
-    scanOk = wipeScanOperand( &pPos, (type != WIPE_ID_UNDEF), &oprndKind,
-                              &pStart, &oprndLen, &scanLen, &unary );
-    if (!scanOk)
-    {
-      return false;
-    }
-    
-    if (type != WIPE_ID_UNDEF)
+      /* Expression is valid */
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+      *stmtErr = false;
+      return true;
+      break;
+    case WIPE_PRINT:
     {
-      /* We have to evaluate the expression. */
-
-      /* First determine the current operand's type and value */
-      if (WIPE_OPRND_ID == oprndKind)
+      char  *pChar;
+      uint8  maxLen;
+      
+      if (m_consoleBuffer[m_consolePos] == '\"')
       {
-        /* Find the variable's symbol table index. */
-        tmpChar = *(pStart + oprndLen);
-        *(pStart + oprndLen) = '\0';
-        if (!wipeSymbolLookup(pStart, &oprndIdx))
+        /* Print a string */
+        m_consolePos++;
+        maxLen = MAX_SERIAL_BUF_LEN - m_consolePos - 1;
+        m_program[m_wipeProgByte++] = WIPE_PRT_STR;
+        pChar = &m_tokenBuffer[m_consolePos];
+        strLen = 0;
+        for (parmsLen = 0; parmsLen < maxLen; parmsLen++)
         {
-          *(pStart + oprndLen) = tmpChar;
-          wipeShowExprErr( pExpr, (pStart - pExpr + oprndLen), true,
-                           FLASH("Variable not defined") );
-          return false;
-        }
-        *(pStart + oprndLen) = tmpChar;
+          if ('"' == *pChar)
+            break;
 
-        currOprndType = m_symTbl[oprndIdx].typeId;
-        currOprndValue.intValue = (uint32)m_symTbl[oprndIdx].symValue.intValue;
-      }
-      else
-      {
-        /* (oprndKind == WIPE_OPRND_LIT): Determine the literal value. */
-        currOprndValue.intValue = 0;
-        currOprndType = WIPE_ID_INT;
-        for ( ; oprndLen > 0; oprndLen--)
-        {
-          if ('.' == *pStart)
+          strLen++;
+          if ( (*pChar == '\\') && (*(pChar+1) == 'n') )
           {
-            currOprndType = WIPE_ID_FLOAT;
-            pStart++;
-            break;
+            pChar++;
+            parmsLen++;
+            m_program[m_wipeProgByte++] = '\n';
           }
-          currOprndValue.intValue *= 10;
-          currOprndValue.intValue += *pStart++ - (uint32)'0';
-        }
-        if (oprndLen > 0)
-        {
-          tmpValue = (float)currOprndValue.intValue;
-          i = oprndLen - 1;
-          for ( ; i > 0; i--)
+          else
           {
-            tmpValue += ((float)(*pStart++ - (uint32)'0') /
-                        pow(10, oprndLen - i));
+            m_program[m_wipeProgByte++] = *pChar;
           }
-          currOprndValue.floatValue = tmpValue;
+          pChar++;
         }
-      }
-
-      /* Apply unary operator is there is one. */
-      if (unary != WIPE_OP_UNDEF)
-      {
-        switch (currOprndType)
+        if (parmsLen == maxLen)
         {
-          case WIPE_ID_INT:
-            legalOp = wipeEvalIntOperation(
-                                    (int32 *)&currOprndValue.intValue,
-                                    (int32)dummyValue,
-                                    unary );
-            break;
-          case WIPE_ID_FLOAT:
-            legalOp = wipeEvalFloatOperation(
-                                    (float *)&currOprndValue.floatValue,
-                                    (float)dummyValue,
-                                    unary );
-            break;
-          case WIPE_ID_BOOL:
-            legalOp = wipeEvalBoolOperation(
-                                    (boolean *)&currOprndValue.boolValue,
-                                    (boolean)dummyValue,
-                                    unary );
-            break;
-          default:
-            logPrint(FLASH("***SYS ERROR: unknown expr type-"));
-            logPrintln(type);
-            return false;
+          wipeShowError(FLASH("Bad string length"));
+          return false;
         }
-        if (!legalOp)
-        {
-          wipeShowExprErr( pExpr, (pStart - pExpr), true,
-                           FLASH("Bad unary operator") );
-        } 
+        m_program[m_wipeProgByte++] = '\0';
+        m_program[m_wipeLineStart + TKNZD_LEN_OFFS] = m_wipeProgByte
+                                                    - m_wipeLineStart;
+        *stmtErr = false;
+        return true;
+      }
+      else
+      {
+        /* Print result of an expression */
+        m_program[m_wipeProgByte++] = WIPE_PRT_VAR;
+        strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
+        if (0 == strLen)
+          return false;
+        if (!wipeEmitIdentifier(identifier))
+          return false;
+        m_program[m_wipeLineStart + TKNZD_LEN_OFFS] = m_wipeProgByte
+                                                    - m_wipeLineStart;
+        *stmtErr = false;
+        return true;
       }
+      break;
+    }
+    case WIPE_VAR:
+      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
+      if (0 == strLen)
+        return false;
 
-      if (firstOprnd)
+      /* Scan for, and skip over, the ':' */
+      tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
+      token = strtok(&m_tokenBuffer[m_consolePos], " \n");
+      m_consolePos += tmp + 1;
+      if (strcmp(token, ":") != 0)
       {
-        /* Just record the very first operand. */
-        oprndValue1.intValue = currOprndValue.intValue;
-        oprndType1 = currOprndType;
+        wipeShowError(FLASH("Missing ':'"));
+        return false;
       }
+      m_consolePos += strlen(token);
+
+      /* Scan for the type identifier */
+      if (0 == wipeScanIdentifier(&typeStr, 10))
+        return false;
+
+      /* Determine the variable's type */
+      if (strcmp(typeStr, "label") == 0)
+        typeId = WIPE_ID_LABEL;
+      else if (strcmp(typeStr, "int") == 0)
+        typeId = WIPE_ID_INT;
+      else if (strcmp(typeStr, "float") == 0)
+        typeId = WIPE_ID_FLOAT;
+      else if (strcmp(typeStr, "bool") == 0)
+        typeId = WIPE_ID_BOOL;
       else
       {
-        /* Compute intermediate result */
-        
-        /* Check type compatibility */
-        if (!wipeAreTypesValid( operation, oprndType1, oprndValue1,
-                                currOprndType, currOprndValue, type )
-           )
+        wipeShowError(FLASH("Bad type"));
+        return false;
+      }
+
+      /* Statement is valid */
+      if ( !wipeEmitIdentifier(identifier) || !wipeEmitByte(typeId) )
+        return false;
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+      *stmtErr = false;
+      return true;
+      break;
+    case WASPCMD_BKGRD:
+    case WASPCMD_GROUP:
+    case WASPCMD_LINE:
+    case WASPCMD_RESET:
+    case WASPCMD_STATE:
+    case WASPCMD_SHIFT:
+    case WASPCMD_SWAP:
+    case WASPCMD_RAINBOW:
+    case WASPCMD_RAINCYCLE:
+    case WASPCMD_SPEED:
+    case WASPCMD_TWINKLE:
+    case WASPCMD_PIXELS:
+    case WIPE_FN_PAUSE:
+    case WIPE_FN_PAINT:
+    case WIPE_FN_CODE:
+    case WASPCMD_SCRIPT:
+    case WASPCMD_SCRIPT_RUN:
+    case WASPCMD_AT:
+    case WASPCMD_PALETTE:
+    case WASPCMD_FADE:
+    case WASPCMD_GRADIENT:
+    case WASPCMD_BRIGHT:
+    {
+      uint8   numParms;
+      
+      numParms = wipeFuncGetParmNum(tokenId);
+      --m_wipeProgByte; /* Back up to statement id */
+      m_program[m_wipeProgByte++] = WIPE_FUNC;
+      m_program[m_wipeProgByte++] = tokenId;
+      m_program[m_wipeProgByte++] = numParms;
+      
+      for (uint8 i = numParms; i != 0; i--)
+      {
+        /* Compile the expression */
+        if (!wipeCompileExpression(&m_tokenBuffer[m_consolePos], true))
         {
-          wipeShowExprErr( pExpr, (pStart - pExpr), true,
-                           FLASH("Incompatible operand types") );
+          wipeShowError(FLASH("Expr Syntax"));
           return false;
         }
-        
-        if (WIPE_ID_BOOL == type)
-        {
-          /* Perform binary computation */
-          if (wipeIsRelational(operation))
-          {
-            switch (oprndType1)
-            {
-              case WIPE_ID_INT:
-                oprndValue1.intValue = (uint32)wipeEvalIntRelation(
-                                               (int32)oprndValue1.intValue,
-                                               (int32)currOprndValue.intValue,
-                                               operation );
-                break;
-              case WIPE_ID_FLOAT:
-                oprndValue1.floatValue = (uint32)wipeEvalFloatRelation(
-                                               (float)oprndValue1.floatValue,
-                                               (float)currOprndValue.floatValue,
-                                               operation );
-                break;
-              case WIPE_ID_BOOL:
-                oprndValue1.boolValue = (uint32)wipeEvalBoolRelation(
-                                               (boolean)oprndValue1.boolValue,
-                                               (boolean)currOprndValue.boolValue,
-                                               operation );
-                break;
-              default:
-                logPrint(FLASH("***SYS ERROR: unknown expr type-"));
-                logPrintln(type);
-                return false;
-            }
-          }
-        }
-        else
+        tmp = m_tokenBuffer[m_consolePos + m_exprOffs - 1];
+        if ( (i > 1) && (tmp != ',') && (tmp != ')') )
         {
-          /* Evaluate arithmetic operator */
-          switch (oprndType1)
-          {
-            case WIPE_ID_INT:
-              legalOp = wipeEvalIntOperation( (int32 *)&oprndValue1.intValue,
-                                              (int32)currOprndValue.intValue,
-                                              operation );
-              break;
-            case WIPE_ID_FLOAT:
-              legalOp = wipeEvalFloatOperation( (float *)&oprndValue1.floatValue,
-                                                (float)currOprndValue.floatValue,
-                                                operation );
-              break;
-            case WIPE_ID_BOOL:
-              legalOp = wipeEvalBoolOperation( (boolean *)&oprndValue1.boolValue,
-                                               (boolean)currOprndValue.boolValue,
-                                               operation );
-              break;
-            default:
-              logPrint(FLASH("***SYS ERROR: unknown expr type-"));
-              logPrintln(type);
-              return false;
-          }
-          if (!legalOp)
-          {
-            wipeShowExprErr( pExpr, (pStart - pExpr), true,
-                             FLASH("Bad operator for type") );
-          } 
+           wipeShowError(FLASH("Bad params"));
+           return false;
         }
+        m_consolePos += m_exprOffs;
       }
-    }
-    m_exprOffs += scanLen;
-
-    scanOk = wipeScanOperator(&pPos, &operation, &operatorLen, &scanLen);
-    m_exprOffs += scanLen;
-    if (scanOk)
-    {
-      /* Potential operator or End-of-line found */
-      if (!listOk && (operation == WIPE_OP_DELIM))
+      
+      if (m_tokenBuffer[m_consolePos - 1] != ')')
       {
-        wipeShowExprErr( pExpr, (pStart - pExpr + scanLen),
-                         (type != WIPE_ID_UNDEF),
-                         FLASH("Unexpected list") );
+        wipeShowError(FLASH("# of parms"));
         return false;
       }
-      if ( (operation == WIPE_OP_UNDEF) || (operation == WIPE_OP_DELIM))
-      {
-        /* We've hit the end of the expression. */
-        if (type != WIPE_ID_UNDEF)
-        {
-          /* We have to provide a result. */
-          if (!wipeAssign(pResult, type, oprndValue1, oprndType1))
-          {
-            wipeShowExprErr( pExpr, (pStart - pExpr), true,
-                             FLASH("Expression is of wrong type") );
-            return false;
-          }
-        }
-        return true;
-      }
+
+      /* Statement is valid */
+      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
+                             (m_wipeProgByte - m_wipeLineStart);
+
+      *stmtErr = false;
+      return true;
+      break;
     }
-    else
-    {
-      wipeShowExprErr( pExpr, (pStart - pExpr), (type != WIPE_ID_UNDEF),
-                       FLASH("Bad operator") );
+    default:
+      *stmtErr = true;
       return false;
-    }
-    firstOprnd = false;
   }
+  wipeShowError(FLASH("Parse fail"));
+  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeLabelLocate
-//   Locate a specific program label. If located and not already in the
-//   symbol table, the label definition is added to the symbol table.
-// Parameters:
-//   label:I     - Program label identifier.
-//   progPos:O   - Address at which to return the m_program[] index at the
-//                 located line starts.
-// Returns: true iff the label was located and was in, or was able to be added
-//               to, the symbol table.
+// Function: wipeScanCommand
+//   Scan for the next command name in the WIPE command line.
+// Parameters: (none)
+// Returns: WIPE_UNDEF or WIPE command id (e.g. WIPE_CMD_EXIT, etc).
 // Inputs/Outputs:
-//   m_program:I
-//   m_wipeProgByte:I
-//   m_symTbl:IO
+//   m_consoleLen:I
+//   m_consolePos:IO
+//   m_tokenBuffer:IO
 //-----------------------------------------------------------------------------
-boolean wipeLabelLocate(char *label, uint16 *progPos)
+uint8 wipeScanCommand(void)
 {
-  uint16   currLine;
-  uint8    symIdx = MAX_NUM_SYMBOLS;
-  boolean  located = false;
-
-  /* Check if label is already in the symbol table. */
-  if (wipeSymbolLookup(label, &symIdx))
-  {
-    *progPos = m_symTbl[symIdx].symValue.intValue;
-    return true;
-  }
+  int32  intVal;
+  char   *token = NULL;
+  uint8   tmp;
 
-  /* The label isn't in the symbol table. */
-  for ( currLine = m_wipeLineStart;
-        currLine < m_wipeProgByte;
-        currLine += m_program[currLine + TKNZD_LEN_OFFS]
-      )
+  if (m_consolePos >= m_consoleLen)
+    return WIPE_UNDEF;
+  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
+  token = strtok(&m_tokenBuffer[m_consolePos], "( \n");
+  m_consolePos += tmp;
+  if (token != NULL)
   {
-    if (m_program[currLine + TKNZD_STMT_OFFS] == WIPE_LABEL)
+    m_consolePos += strlen(token) + 1;
+    if (strcmp(token, "del") == 0)
+      return WIPE_CMD_DEL;
+    else if (strcmp(token, "dir") == 0)
+      return WIPE_CMD_DIR;
+    else if (strcmp(token, "erase") == 0)
+      return WIPE_CMD_ERASE;
+    else if (strcmp(token, "exit") == 0)
+      return WIPE_CMD_EXIT;
+    else if (strcmp(token, "help") == 0)
+      return WIPE_CMD_HELP;
+    else if (strcmp(token, "list") == 0)
+      return WIPE_CMD_LIST;
+    else if (strcmp(token, "load") == 0)
+      return WIPE_CMD_LOAD;
+    else if (strcmp(token, "mrun") == 0)
+      return WIPE_CMD_MRUN;
+    else if (strcmp(token, "prof") == 0)
+      return WIPE_CMD_PROF;
+    else if (strcmp(token, "renum") == 0)
+      return WIPE_CMD_RENUM;
+    else if (strcmp(token, "run") == 0)
+      return WIPE_CMD_RUN;
+    else if (strcmp(token, "save") == 0)
+      return WIPE_CMD_SAVE;
+    else if (strcmp(token, "start") == 0)
+      return WIPE_CMD_START;
+    else if (strcmp(token, "hexdump") == 0)
+      wipeDumpProgramHex();
+    else
     {
-      /* Current program line is a 'label' statement. */
-      if (strcmp((char *)&m_program[currLine + TKNZD_STMT_OFFS + 1], label)
-          == 0)
+      m_consolePos -= strlen(token) + 1;
+      if (wipeParseInt(&intVal, false))
       {
-        /* The current program line's label matches the target label.
-         * Add the label definition to the symbol table and return
-         * the target line's starting position in m_program[].
-         */
-        if (wipeSymbolInsert(label, WIPE_ID_LABEL, &symIdx))
-        {
-          m_symTbl[symIdx].symValue.intValue = currLine;
-          *progPos = currLine;
-          return true;
-        }
-        else
-        {
-          logPrint(FLASH("No room for '"));
-          logPrint(label);
-          logPrintln(FLASH("' in sym table"));
-          return false;
-        }
+          return WIPE_CMD_LINENUM;
       }
+      else
+        m_consolePos = 0;
     }
   }
-  return false;
-}
-
-
-
-//-----------------------------------------------------------------------------
-// Function: wipeFuncGetParmNum
-//   Retrieve the number of parameters expected for each of WIPE's WASP
-//   functions.
-// Parameters:
-//   funcId:I  - Function identifier.
-// Returns: The number of parameters expected.
-// Inputs/Outputs:
-//-----------------------------------------------------------------------------
-uint8 wipeFuncGetParmNum(uint8 funcId)
-{
-  switch (funcId)
-  {
-    case WASPCMD_GROUP:       return 4;
-    case WASPCMD_STATE:       return 2;
-    case WASPCMD_BKGRD:       return 4;
-    case WASPCMD_LINE:        return 6;
-    case WASPCMD_SHIFT:       return 2;
-    case WASPCMD_SWAP:        return 7;
-    case WASPCMD_RESET:       return 1;
-    case WASPCMD_SPEED:       return 2;
-    case WASPCMD_RAINBOW:     return 2;
-    case WASPCMD_RAINCYCLE:   return 1;
-    case WASPCMD_TWINKLE:     return 5;
-    case WIPE_FN_PAUSE:       return 3;
-    default:
-      logPrintln(FLASH("***SYS ERROR: Unknown func"));
-      return 0;
-  }
+  return WIPE_UNDEF;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeParseStatement
-//   Parse and tokenize a WIPE programming language statement.
+// Function: pause
+//   Pause WIPE program execution. The pause is a deadline that wipeRunStep()
+//   waits out, so the main loop keeps running in the meantime.
 // Parameters:
-//   lineNum:I     - The line number assigned to the candidate statement. A
-//                   value of 0 means that the line is going to be executed
-//                   immediately.
-//   initToken:I   - The prescanned token, if applicable. Set the value
-//                   to WIPE_UNDEF if a statement token needs to be scanned
-//                   first by the function.
-//   stmtErr:O     - The parameter is set to true upon return iff a WIPE
-//                   statement has been detected but contains an error that
-//                   has already been reported.
-// Returns: true iff the statement is valid.
+//   minutes:I  - # of minutes, seconds, and hundredths of seconds to delay.
+//   seconds:I
+//   hundredths:I
+// Returns: (none)
 // Inputs/Outputs:
-//   m_consoleBuffer:I
-//   m_consoleLen:I
-//   m_exprOffs:I
-//   m_wipeLineStart:I
-//   m_consolePos:IO
-//   m_program:IO
-//   m_tokenBuffer:IO
-//   m_wipeProgByte:IO
-// Notes:
-//   WIPE staement format:
-//      byte   byte
-//    +-------+-----+------+-
-//    | LINE# | LEN | STMT |              b
-//    +-------+-----+------+-             y
-//                           strlen() <=  t
-//                     ...   MAX_ID_LEN   e    byte
-//                  +------+-------------+--+--------+  (LEN =
-//                  | var  | NAME-STRING |\0| TYPEID |   strlen() + 5)
-//                  +------+-------------+--+--------+--+
-//                  | let  | NAME-STRING |\0| EXPR   |\0|
-//                  +------+-------------+--+--------+--+
-//                  |label | NAME-STRING |\0|
-//                  +------+-------------+--+
-//                  | goto | NAME-STRING |\0|
-//                  +------+-------------+--+
-//                  +------+------+--+
-//                  |  if  | EXPR |\0|
-//                  +------+------+--+
-//                  +------+-------+-------+-------+
-//                  |pause | uint8 | uint8 | uint8 |
-//                  +------+-------+-------+-------+
-//                  +------+--------------+---------------+--+
-//                  |print | WIPE_PRT_STR | QUOTED-STRING |\0|
-//                  +------+--------------+---------------+--+
-//                         | WIPE_PRT_VAR | NAME-STRING   |\0|
-//                         +--------------+---------------+--+
-//                  +------+---+---+------+-----+------+
-//                  |[func]|<f>|<n>| EXPR | ... | EXPR | (<n> EXPR instances)
-//                  +------+---+---+------+-----+------+
-//
-//    EXPR = a simple expression with no operator precedence
-//    LEN  = total # of bytes in the line.
-//    STMT = statement type
-//    <f> in {WASP command codes (e.g. WASPCMD_GROUP) & misc functions
-//            (e.g. WIPE_FN_PAUSE)}
-//    <n> = the number of uint8 parameters defined for <f> that follow.
+//   m_wipeResumeTime:O
 //-----------------------------------------------------------------------------
-boolean wipeParseStatement(uint8 lineNum, uint8 initToken, boolean *stmtErr)
+void pause(uint8 minutes, uint8 seconds, uint8 hundredths)
 {
-  char       *identifier;
-  char       *typeStr;
-  char       *token;
-  SymValue_t  dummyValue;
-  uint8       tokenId;
-  uint8       typeId;
-  uint8       symIdx;
-  uint8       tmp;
-  uint8       strLen;
-  uint8       parmsLen = 0;
-
-
-  if (initToken != WIPE_UNDEF)
-    tokenId = initToken;
-  else
-    tokenId = wipeScanToken();
-  if (WIPE_UNDEF == tokenId)
-    return false;
-
-  m_program[m_wipeProgByte++] = lineNum;
-  m_program[m_wipeProgByte++] = 3;
-  m_program[m_wipeProgByte++] = tokenId;
-
-  *stmtErr = true;
-  switch (tokenId)
-  {
-    case WIPE_IF:
-      /* Parse the expression */
-      if (!wipeParseExpression( &m_tokenBuffer[m_consolePos],
-                                 WIPE_OPRND_UNDEF, false, &dummyValue ))
-      {
-        wipeShowError(FLASH("Expr Syntax"));
-        return false;
-      }
-
-      /* Statement is valid */
-      memcpy( &m_program[m_wipeProgByte], &m_consoleBuffer[m_consolePos],
-              m_exprOffs + 1 );
-      m_wipeProgByte += m_exprOffs;
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart + 1);
-      *stmtErr = false;
-      return true;
-      break;
-    case WIPE_GOTO:
-      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
-      if (0 == strLen)
-        return false;
+  uint32 delayTime;
 
-      /* Statement is valid */
-      strcpy((char *)&m_program[m_wipeProgByte], identifier);
-      m_wipeProgByte += strlen(identifier) + 1;
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart);
-      *stmtErr = false;
-      return true;
-      break;
-    case WIPE_LABEL:
-      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
-      if (0 == strLen)
-        return false;
+  delayTime = minutes;                       /* Minutes      */
+  delayTime = delayTime *  60 + seconds;     /* Seconds      */
+  delayTime = delayTime * 100 + hundredths;  /* Centiseconds */
+  delayTime = delayTime *  10;               /* Milliseconds */
+  if (delayTime > 0)
+    m_wipeResumeTime = millis() + delayTime;
+}
 
-      /* Statement is valid */
-      strcpy((char *)&m_program[m_wipeProgByte], identifier);
-      m_wipeProgByte += strlen(identifier) + 1;
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart);
-      *stmtErr = false;
-      return true;
-      break;
-    case WIPE_LET:
-      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
-      if (0 == strLen)
-        return false;
-      strcpy((char *)&m_program[m_wipeProgByte], identifier);
-      m_wipeProgByte += strlen(identifier) + 1;
-      
-      /* Scan for, and skip over, the "=" */
-      tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
-      token = strtok(&m_tokenBuffer[m_consolePos], " \n");
-      m_consolePos += tmp + 1;
-      if (strcmp(token, "=") != 0)
-      {
-        wipeShowError(FLASH("Missing '='"));
-        return false;
-      }
-      m_consolePos += strlen(token);
 
-      /* Parse the expression */
-      if (!wipeParseExpression( &m_tokenBuffer[m_consolePos],
-                                 WIPE_OPRND_UNDEF, false, &dummyValue ))
-      {
-        wipeShowError(FLASH("Expr Syntax"));
-        return false;
-      }
+//-----------------------------------------------------------------------------
+// Function: wipeDeadlinePending
+//   Check a WIPE execution deadline, clearing it once it has been reached.
+// Parameters:
+//   pDeadline:IO  - Address of the deadline (a millis() value; 0 = none).
+// Returns: true iff the deadline has not yet been reached.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+boolean wipeDeadlinePending(uint32 *pDeadline)
+{
+  if (0 == *pDeadline)
+    return false;
+  if ((int32)(millis() - *pDeadline) < 0)
+    return true;
+  *pDeadline = 0;
+  return false;
+}
 
-      /* Expression is valid */
-      memcpy( &m_program[m_wipeProgByte], &m_consoleBuffer[m_consolePos],
-              m_exprOffs + 1 );
-      m_wipeProgByte += m_exprOffs;
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart + 1);
-      *stmtErr = false;
-      return true;
-      break;
-    case WIPE_PRINT:
+
+//-----------------------------------------------------------------------------
+// Function: wipeExecuteStatement
+//   Execute the tokenized WIPE statement.
+// Parameters:
+//   lineStart:I  - Starting program memory location of the line.
+// Returns: Program memory location of end of tokenized WIPE statement, if
+//          statement execution was successful; MAX_PROG_SIZE, otherwise.
+// Inputs/Outputs:
+//   m_program:I
+//   m_symTbl:IO
+//   m_wipeLineStart:IO
+//   m_wipeRunByte:IO
+//   m_wipeRunEnd:I
+//-----------------------------------------------------------------------------
+uint16 wipeExecuteStatement(uint16 lineStart)
+{
+  SymValue_t  exprVal;
+  char       *identifier;
+  uint16      rc = MAX_PROG_SIZE;
+  uint8       symIdx;
+  uint8       typeId;
+  boolean     execError;
+
+  execError = false;
+  m_wipeRunByte = lineStart + TKNZD_STMT_OFFS + 1;
+  m_wipeLineStart = lineStart;
+  switch (m_program[lineStart + TKNZD_STMT_OFFS])
+  {
+    case WIPE_FUNC:
     {
-      char  *pChar;
-      uint8  maxLen;
-      
-      if (m_consoleBuffer[m_consolePos] == '\"')
+      uint8 numParms;
+      uint8 funcId;
+      uint8 parmValue[WIPE_MAX_PARMS];
+
+      funcId   = m_program[m_wipeRunByte++];
+      numParms = m_program[m_wipeRunByte++];
+      for (uint8 i = 0; i < numParms; i++)
       {
-        /* Print a string */
-        m_consolePos++;
-        maxLen = MAX_SERIAL_BUF_LEN - m_consolePos - 1;
-        m_program[m_wipeProgByte++] = WIPE_PRT_STR;
-        pChar = &m_tokenBuffer[m_consolePos];
-        strLen = 0;
-        for (parmsLen = 0; parmsLen < maxLen; parmsLen++)
+        if (!wipeEvalExpression(&m_wipeRunByte, WIPE_ID_INT, &exprVal))
         {
-          if ('"' == *pChar)
-            break;
-
-          strLen++;
-          if ( (*pChar == '\\') && (*(pChar+1) == 'n') )
-          {
-            pChar++;
-            parmsLen++;
-            m_program[m_wipeProgByte++] = '\n';
-          }
-          else
-          {
-            m_program[m_wipeProgByte++] = *pChar;
-          }
-          pChar++;
+          return rc;
         }
-        if (parmsLen == maxLen)
+        if ( (exprVal.intValue < -128) || (exprVal.intValue > 255) )
         {
-          wipeShowError(FLASH("Bad string length"));
-          return false;
+          wipePrintStatement();
+          logPrintln(FLASH("***ERROR: arg value out of range"));
         }
-        m_program[m_wipeProgByte++] = '\0';
-        m_program[m_wipeLineStart + TKNZD_LEN_OFFS] = m_wipeProgByte
-                                                    - m_wipeLineStart;
-        *stmtErr = false;
-        return true;
+        parmValue[i] = (uint8)exprVal.intValue;
       }
-      else
+      switch (funcId)
       {
-        /* Print result of an expression */
-        m_program[m_wipeProgByte++] = WIPE_PRT_VAR;
-        strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
-        if (0 == strLen)
-          return false;
-        strcpy((char *)&m_program[m_wipeProgByte], identifier);
-        m_wipeProgByte += strlen(identifier) + 1;
-        m_program[m_wipeLineStart + TKNZD_LEN_OFFS] = m_wipeProgByte
-                                                    - m_wipeLineStart;
-        *stmtErr = false;
-        return true;
+        case WASPCMD_BKGRD:
+          background(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
+          break;
+        case WASPCMD_GROUP:
+          setGroup(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
+          break;
+        case WASPCMD_LINE:
+          line(parmValue[0], parmValue[4], parmValue[5], parmValue[1],
+               parmValue[2], parmValue[3]);
+          break;
+        case WASPCMD_RESET:
+          waspReset(parmValue[0]);
+          break;
+        case WASPCMD_STATE:
+          setState(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_SHIFT:
+          shift(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_SWAP:
+          swap(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
+               parmValue[4], parmValue[5], parmValue[6]);
+          break;
+        case WASPCMD_RAINBOW:
+          rainbow(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_RAINCYCLE:
+          rainbowCycle(parmValue[0]);
+          break;
+        case WASPCMD_SPEED:
+          fxSpeed(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_TWINKLE:
+          twinkle(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
+                  parmValue[4]);
+          break;
+        case WASPCMD_PIXELS:
+          pixels(parmValue[0], parmValue[1], parmValue[2]);
+          break;
+        case WIPE_FN_PAUSE:
+          pause(parmValue[0], parmValue[1], parmValue[2]);
+          break;
+        case WIPE_FN_PAINT:
+          paint(parmValue[3], parmValue[4], parmValue[0], parmValue[1],
+                parmValue[2]);
+          break;
+        case WIPE_FN_CODE:
+          scriptCode(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
+          break;
+        case WASPCMD_SCRIPT:
+          scriptUpload(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_SCRIPT_RUN:
+          scriptRun(parmValue[0], parmValue[1]);
+          break;
+        case WASPCMD_AT:
+          schedAt(parmValue[0]);
+          break;
+        case WASPCMD_PALETTE:
+          palette(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
+                  parmValue[4]);
+          break;
+        case WASPCMD_FADE:
+          fade(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
+               parmValue[4]);
+          break;
+        case WASPCMD_GRADIENT:
+          gradient(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
+                   parmValue[4], parmValue[5], parmValue[6], parmValue[7]);
+          break;
+        case WASPCMD_BRIGHT:
+          bright(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
+          break;
+        default:
+          wipeShowError(FLASH("<unknown func>"));
+          return rc;
       }
       break;
     }
-    case WIPE_VAR:
-      strLen = wipeScanIdentifier(&identifier, MAX_ID_LEN);
-      if (0 == strLen)
-        return false;
-
-      /* Scan for, and skip over, the ':' */
-      tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
-      token = strtok(&m_tokenBuffer[m_consolePos], " \n");
-      m_consolePos += tmp + 1;
-      if (strcmp(token, ":") != 0)
-      {
-        wipeShowError(FLASH("Missing ':'"));
-        return false;
-      }
-      m_consolePos += strlen(token);
-
-      /* Scan for the type identifier */
-      if (0 == wipeScanIdentifier(&typeStr, 10))
-        return false;
-
-      /* Determine the variable's type */
-      if (strcmp(typeStr, "label") == 0)
-        typeId = WIPE_ID_LABEL;
-      else if (strcmp(typeStr, "int") == 0)
-        typeId = WIPE_ID_INT;
-      else if (strcmp(typeStr, "float") == 0)
-        typeId = WIPE_ID_FLOAT;
-      else if (strcmp(typeStr, "bool") == 0)
-        typeId = WIPE_ID_BOOL;
-      else
+    case WIPE_GOTO:
+      /* Labels are located by wipeResolveProgram() */
+      symIdx = m_program[m_wipeRunByte];
+      if (WIPE_ID_LABEL == m_symTbl[symIdx].typeId)
       {
-        wipeShowError(FLASH("Bad type"));
-        return false;
+        m_wipeRunByte = m_symTbl[symIdx].symValue.intValue;
+        return m_wipeRunByte;
       }
-
-      /* Statement is valid */
-      strcpy((char *)&m_program[m_wipeProgByte], identifier);
-      m_wipeProgByte += strlen(identifier) + 1;
-      m_program[m_wipeProgByte++] = typeId;
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart);
-      *stmtErr = false;
-      return true;
+      wipeShowError(FLASH("Can't jump to label"));
+      return rc;
       break;
-    case WASPCMD_BKGRD:
-    case WASPCMD_GROUP:
-    case WASPCMD_LINE:
-    case WASPCMD_RESET:
-    case WASPCMD_STATE:
-    case WASPCMD_SHIFT:
-    case WASPCMD_SWAP:
-    case WASPCMD_RAINBOW:
-    case WASPCMD_RAINCYCLE:
-    case WASPCMD_SPEED:
-    case WASPCMD_TWINKLE:
-    case WIPE_FN_PAUSE:
-    {
-      uint8   numParms;
-      uint8   consolePosStart = m_consolePos - 1;
-      
-      numParms = wipeFuncGetParmNum(tokenId);
-      --m_wipeProgByte; /* Back up to statement id */
-      m_program[m_wipeProgByte++] = WIPE_FUNC;
-      m_program[m_wipeProgByte++] = tokenId;
-      m_program[m_wipeProgByte++] = numParms;
-      
-      for (uint8 i = numParms; i != 0; i--)
+    case WIPE_IF:
+      if (wipeEvalExpression(&m_wipeRunByte, WIPE_ID_BOOL, &exprVal))
+      {
+        if (0 == exprVal.boolValue)
+        {
+          /* Skip over the next command */
+          m_wipeRunByte = lineStart + m_program[lineStart + TKNZD_LEN_OFFS];
+          if (m_wipeRunByte < m_wipeRunEnd)
+          {
+            m_wipeRunByte += m_program[m_wipeRunByte + TKNZD_LEN_OFFS];
+            return m_wipeRunByte;
+          }
+          else
+          {
+            /* We've hit the end of the program */
+            m_wipeRunByte = MAX_PROG_SIZE;
+            return m_wipeRunByte;
+          }
+        }
+      }
+      else
+      {
+        return rc;
+      }
+      break;
+    case WIPE_LABEL:
+      /* Labels are defined by wipeResolveProgram() */
+      break;
+    case WIPE_LET:
+      symIdx = m_program[m_wipeRunByte];
+      identifier = (char *)&m_program[m_wipeRunByte + 1];
+      m_wipeRunByte += strlen(identifier) + 2;
+      if (WIPE_ID_UNDEF == m_symTbl[symIdx].typeId)
+      {
+        wipePrintStatement();
+        logPrint(FLASH("***ERROR: Variable '"));
+        logPrint(identifier);
+        logPrintln(FLASH("' undefined."));
+        return rc;
+      }
+      else
       {
-        /* Parse the expression */
-        if (!wipeParseExpression( &m_tokenBuffer[m_consolePos],
-                                   WIPE_OPRND_UNDEF, true, &dummyValue ))
+        if ( !wipeEvalExpression( &m_wipeRunByte,
+                                  m_symTbl[symIdx].typeId,
+                                  &m_symTbl[symIdx].symValue )
+           )
         {
-          wipeShowError(FLASH("Expr Syntax"));
-          return false;
+          return rc;
         }
-        tmp = m_tokenBuffer[m_consolePos + m_exprOffs - 1];
-        if ( (i > 1) && (tmp != ',') && (tmp != ')') )
+      }
+      break;
+    case WIPE_PRINT:
+      if (m_program[lineStart + TKNZD_STMT_OFFS + 1] == WIPE_PRT_STR)
+      {
+        /* Print quoted string */
+        logPrint((char *)&m_program[lineStart + TKNZD_STMT_OFFS + 2]);
+      }
+      else
+      {
+        /* Print the value of a variable */
+        m_wipeRunByte++;
+        symIdx = m_program[m_wipeRunByte];
+        identifier = (char *)&m_program[m_wipeRunByte + 1];
+        m_wipeRunByte += strlen(identifier) + 2;
+        exprVal = m_symTbl[symIdx].symValue;
+        switch (m_symTbl[symIdx].typeId)
         {
-           wipeShowError(FLASH("Bad params"));
-           return false;
+          case WIPE_ID_INT:
+            logPrint(exprVal.intValue);
+            break;
+          case WIPE_ID_FLOAT:
+            logPrint(exprVal.floatValue);
+            break;
+          case WIPE_ID_BOOL:
+            logPrint(exprVal.boolValue);
+            break;
+          case WIPE_ID_UNDEF:
+            wipePrintStatement();
+            logPrint(FLASH("***ERROR: Variable '"));
+            logPrint(identifier);
+            logPrintln(FLASH("' undefined."));
+            return rc;
+          default:
+            wipePrintStatement();
+            logPrint(FLASH("***Can't print value for "));
+            logPrintln(identifier);
+            return rc;
         }
-        parmsLen += m_exprOffs;
-        m_consolePos += m_exprOffs;
       }
-      
-      if (m_tokenBuffer[m_consolePos - 1] != ')')
+      break;
+    case WIPE_VAR:
+      symIdx = m_program[m_wipeRunByte];
+      identifier = (char *)&m_program[m_wipeRunByte + 1];
+      m_wipeRunByte += strlen(identifier) + 2;
+      typeId = m_program[m_wipeRunByte];
+      if (m_symTbl[symIdx].typeId != WIPE_ID_UNDEF)
       {
-        wipeShowError(FLASH("# of parms"));
-        return false;
+        // Labels and variables share the symbol table.
+        wipePrintStatement();
+        logPrint(FLASH("***ERROR: Variable '"));
+        logPrint(identifier);
+        if (WIPE_ID_LABEL == m_symTbl[symIdx].typeId)
+          logPrintln(FLASH("' clashes with a label of the same name."));
+        else
+          logPrintln(FLASH("' already defined."));
+        return rc;
       }
-
-      /* Statement is valid */
-      memcpy( &m_program[m_wipeProgByte], &m_consoleBuffer[consolePosStart],
-              parmsLen + 1);
-      m_wipeProgByte += parmsLen + 1;
-      m_program[m_wipeProgByte] = '\0';
-      m_program[m_wipeLineStart + TKNZD_LEN_OFFS] =
-                             (m_wipeProgByte - m_wipeLineStart + 1);
-
-      *stmtErr = false;
-      return true;
+      m_symTbl[symIdx].typeId = typeId;
+      m_symTbl[symIdx].symValue.intValue = 0;
       break;
-    }
     default:
-      *stmtErr = true;
-      return false;
+      logPrint(FLASH("***ERROR: Unknown statement: "));
+      logPrintln(m_program[lineStart + TKNZD_STMT_OFFS]);
   }
-  wipeShowError(FLASH("Parse fail"));
-  return false;
+  
+  if (execError)
+  {
+    wipePrintStatement();
+    logPrintln(FLASH("***ERROR: Statement execution"));
+    return rc;
+  }
+
+  m_wipeRunByte = lineStart + m_program[lineStart + TKNZD_LEN_OFFS];
+  return m_wipeRunByte;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeScanCommand
-//   Scan for the next command name in the WIPE command line.
-// Parameters: (none)
-// Returns: WIPE_UNDEF or WIPE command id (e.g. WIPE_CMD_EXIT, etc).
+// Function: wipeSeekLineStart
+//   Find the starting address, in program memory, of the program line
+//   with the smallest line number that is not less than specified target
+//   line number.
+// Parameters:
+//   targetNum:I   - The line number of the line to be found.
+//   lineExists:O  - Address at which to return indication that the
+//                   specified line number exists. The output
+//                   value is true iff targetNum already exists.
+// Returns: MAX_PROG_SIZE, if line cannot be found;
+//          The m_program[] index at which the found line starts, otherwise.
 // Inputs/Outputs:
-//   m_consoleLen:I
-//   m_consolePos:IO
-//   m_tokenBuffer:IO
+//   m_program:I
+//   m_wipeProgByte:I
 //-----------------------------------------------------------------------------
-uint8 wipeScanCommand(void)
+uint16 wipeSeekLineStart(uint8 targetNum, boolean *lineExists)
 {
-  int32  intVal;
-  char   *token = NULL;
-  uint8   tmp;
+  uint16 currPos;
+  uint8  currLineNum;
 
-  if (m_consolePos >= m_consoleLen)
-    return WIPE_UNDEF;
-  tmp = strspn(&m_tokenBuffer[m_consolePos], " \n");
-  token = strtok(&m_tokenBuffer[m_consolePos], "( \n");
-  m_consolePos += tmp;
-  if (token != NULL)
+  *lineExists = false;
+  currPos = 0;
+  while ( (currPos < MAX_PROG_SIZE) && (currPos < m_wipeProgByte) )
   {
-    m_consolePos += strlen(token) + 1;
-    if (strcmp(token, "del") == 0)
-      return WIPE_CMD_DEL;
-    else if (strcmp(token, "dir") == 0)
-      return WIPE_CMD_DIR;
-    else if (strcmp(token, "erase") == 0)
-      return WIPE_CMD_ERASE;
-    else if (strcmp(token, "exit") == 0)
-      return WIPE_CMD_EXIT;
-    else if (strcmp(token, "help") == 0)
-      return WIPE_CMD_HELP;
-    else if (strcmp(token, "list") == 0)
-      return WIPE_CMD_LIST;
-    else if (strcmp(token, "load") == 0)
-      return WIPE_CMD_LOAD;
-    else if (strcmp(token, "prof") == 0)
-      return WIPE_CMD_PROF;
-    else if (strcmp(token, "renum") == 0)
-      return WIPE_CMD_RENUM;
-    else if (strcmp(token, "run") == 0)
-      return WIPE_CMD_RUN;
-    else if (strcmp(token, "save") == 0)
-      return WIPE_CMD_SAVE;
-    else if (strcmp(token, "start") == 0)
-      return WIPE_CMD_START;
-    else if (strcmp(token, "hexdump") == 0)
-      wipeDumpProgramHex();
+    currLineNum = m_program[currPos + TKNZD_LINE_OFFS];
+    if (currLineNum == targetNum)
+    {
+      *lineExists = true;
+      return currPos;
+    }
     else
     {
-      m_consolePos -= strlen(token) + 1;
-      if (wipeParseInt(&intVal, false))
+      if (m_program[currPos + TKNZD_LINE_OFFS] < targetNum)
       {
-          return WIPE_CMD_LINENUM;
+        currPos += m_program[currPos + TKNZD_LEN_OFFS];
       }
       else
-        m_consolePos = 0;
+      {
+        return currPos;
+      }
     }
   }
-  return WIPE_UNDEF;
+
+  return MAX_PROG_SIZE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: pause
-//   Pause WIPE program execution.
+// Function: wipeDelLines
+//   Delete a program line, with a specified starting address and length,
+//   from program memory. Byte following the line-to-be-deleted as shifted
+//   downward to fill the gap.
 // Parameters:
-//   minutes:I  - # of minutes, seconds, and hundredths of seconds to delay.
-//   seconds:I
-//   hundredths:I
+//   lineStart:I  - Starting address of the line to be deleted.
+//   lineLen:I    - Length of the line to be deleted.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_breakProg:O
+//   m_program:I
+//   m_wipeLineStart:IO
+//   m_wipeProgByte:IO
 //-----------------------------------------------------------------------------
-void pause(uint8 minutes, uint8 seconds, uint8 hundredths)
+void wipeDeleteLine(uint16 lineStart, uint8 lineLen)
 {
-  uint32 delayTime;
+  uint8  *dst;
+  uint8  *src;
+  uint16 numBytesToMove;
+  
+  numBytesToMove = m_wipeProgByte - lineLen + 1;
+  dst = &m_program[lineStart];
+  src = dst + m_program[lineStart + TKNZD_LEN_OFFS];
+  for (uint16 i = numBytesToMove; i > 0; i--)
+    *dst++ = *src++;
+   m_wipeLineStart -= lineLen;
+   m_wipeProgByte  -= lineLen;
+}
 
-  delayTime = minutes;                       /* Minutes      */
-  delayTime = delayTime *  60 + seconds;     /* Seconds      */
-  delayTime = delayTime * 100 + hundredths;  /* Centiseconds */
-  delayTime = delayTime *  10;               /* Milliseconds */
-  delayTime += millis();
-  while (delayTime > millis())
+
+//-----------------------------------------------------------------------------
+// Function: wipeDelLines
+//   Delete program lines.
+// Parameters:
+//   lower:I  - Lower line number limit.
+//   upper:I  - Upper line number limit.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_program:I
+//   m_wipeProgByte:I
+//-----------------------------------------------------------------------------
+void wipeDelLines(uint8 lower, uint8 upper)
+{
+  uint16   delLineStart;
+  boolean  lineExists;
+  uint8    lineNum;
+  uint8    lineLen;
+
+  /* Find first line whose line number is >= lower */
+  delLineStart = wipeSeekLineStart(lower, &lineExists);
+
+  lineNum = m_program[delLineStart + TKNZD_LINE_OFFS];
+  while ( (delLineStart < m_wipeProgByte) && (lineNum <= upper) )
+  {
+    lineLen = m_program[delLineStart + TKNZD_LEN_OFFS];
+    wipeDeleteLine(delLineStart, lineLen);
+    lineNum = m_program[delLineStart + TKNZD_LINE_OFFS];
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeRenumLines
+//   Reunumber program lines evenly from 5 - 250.
+// Parameters:
+//   lower:I  - Lower line number limit.
+//   upper:I  - Upper line number limit.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_wipeProgByte:I
+//   m_program:IO
+//-----------------------------------------------------------------------------
+void wipeRenumLines(void)
+{
+  #define  LOWEST_LINE_NUM   5  /* The lowest line # to allow for edit room */
+  uint8   *currLinePos;
+  uint8    count;
+  uint8    newLineNum;
+
+  /* Determine how many program lines there are */
+  count = 0;
+  for ( currLinePos = &m_program[0];
+        currLinePos < &m_program[m_wipeProgByte];
+        currLinePos += *(currLinePos + TKNZD_LEN_OFFS)
+      )
+    count++;
+
+  /* Determine line number increment for line range #LOWEST_LINE_NUM thru 
+   * approx #(MAX_LINE_NUM - LOWEST_LINE_NUM). So the increment is calculated
+   * as:   (MAX_LINE_NUM - 2*LOWEST_LINE_NUM) / (count - 1)
+   */
+  count = (MAX_LINE_NUM - (LOWEST_LINE_NUM << 1)) / (count - 1);
+  
+  currLinePos = 0;
+  newLineNum = LOWEST_LINE_NUM;
+  for ( currLinePos = &m_program[0];
+        currLinePos < &m_program[m_wipeProgByte];
+        currLinePos += *(currLinePos + TKNZD_LEN_OFFS),
+          newLineNum += count
+      )
   {
-    /* Check for 'x' from the console */
-    if ( (Serial.available() > 0) && (Serial.read() == 'x') )
-    {
-        m_breakProg = true;
-        return;
-    }
+    *(currLinePos + TKNZD_LINE_OFFS) = newLineNum;
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeExecuteStatement
-//   Execute the tokenized WIPE statement.
-// Parameters:
-//   lineStart:I  - Starting program memory location of the line.
-// Returns: Program memory location of end of tokenized WIPE statement, if
-//          statement execution was successful; MAX_PROG_SIZE, otherwise.
+// Function: wipeSaveLine
+//   Save the numbered, parsed line that is being edited into program store
+//   in it correct location.
+// Parameters: (none)
+// Returns: true, iff there was enough memory to store the line.
 // Inputs/Outputs:
-//   m_breakProg:I
 //   m_program:I
-//   m_symTbl:IO
 //   m_wipeLineStart:IO
-//   m_wipeRunByte:IO
+//   m_wipeProgByte:IO
 //-----------------------------------------------------------------------------
-uint16 wipeExecuteStatement(uint16 lineStart)
+boolean wipeSaveLine(void)
 {
-  SymValue_t  exprVal;
-  char       *identifier;
-  char       *exprStart;
-  uint16      rc = MAX_PROG_SIZE;
-  uint8       symIdx;
-  uint8       typeId;
-  char        inChar;
-  boolean     execError;
+  uint8  *dst;
+  uint8  *src;
+  uint16  insertPos;
+  uint16  moveStartPos;
+  uint16  numBytesToMove;
+  uint8   insertLineNum;
+  uint8   insertLineLen;
+  uint8   deleteLineLen;
+  uint8   transientByte;
+  boolean isReplacement; /* true = The edit line replaces an existing line */
 
-  /* Check for 'x' from the console */
-  if (m_breakProg)
-    return MAX_PROG_SIZE;
-  if (Serial.available() > 0)
+  insertLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
+  insertLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
+  insertPos = wipeSeekLineStart(insertLineNum, &isReplacement);
+
+  if (insertPos == m_wipeLineStart)
   {
-    inChar = Serial.read();
-    if (inChar == 'x')
-    {
-      m_wipeRunByte = MAX_PROG_SIZE;
-      return MAX_PROG_SIZE;
-    }
+    /* Current edit line is already in the right position */
+    m_wipeLineStart += insertLineLen;
+    return true;
   }
-
-  execError = false;
-  m_wipeRunByte = lineStart + TKNZD_STMT_OFFS + 1;
-  m_wipeLineStart = lineStart;
-  switch (m_program[lineStart + TKNZD_STMT_OFFS])
+  
+  else if (insertPos < MAX_PROG_SIZE)
   {
-    case WIPE_FUNC:
+    /*---  Insertion is ok.  ---*/
+
+    if (isReplacement)
     {
-      uint8 numParms;
-      uint8 funcId;
-      uint8 parmValue[WIPE_MAX_PARMS];
+      /* The edit line replaces an existing line. So delete the latter. */
+      wipeDeleteLine(insertPos, m_program[insertPos + TKNZD_LEN_OFFS]);
+    }
+    
+    numBytesToMove = m_wipeLineStart - insertPos;
+    for (uint16 i = 0; i < insertLineLen; i++)
+    {
+      /*---  Insert the next byte of the edit line.  ---*/
+      
+      dst = &m_program[m_wipeLineStart + i];
+      src = dst - 1;
+      transientByte = *dst; /* Note byte being moved */
 
-      funcId   = m_program[m_wipeRunByte++];
-      numParms = m_program[m_wipeRunByte++];
-      m_wipeRunByte++; /* Skip open parenthesis */
-      for (uint8 i = 0; i < numParms; i++)
-      {
-        if ( !wipeParseExpression( (char *)&m_program[m_wipeRunByte],
-                                   WIPE_ID_INT,
-                                   true,
-                                   &exprVal )
-           )
-        {
-          wipePrintStatement();
-          logPrintln(FLASH("***SYS ERROR"));
-          return rc;
-        }
-        if ( (exprVal.intValue < -128) || (exprVal.intValue > 255) )
-        {
-          wipePrintStatement();
-          logPrintln(FLASH("***ERROR: arg value out of range"));
-        }
-        parmValue[i] = (uint8)exprVal.intValue;
-        m_wipeRunByte += m_exprOffs;
-      }
-      switch (funcId)
+      /* Shift program memory bytes upward by one byte */
+      for (uint16 j = numBytesToMove; j > 0; j--)
       {
-        case WASPCMD_BKGRD:
-          background(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
-          break;
-        case WASPCMD_GROUP:
-          setGroup(parmValue[0], parmValue[1], parmValue[2], parmValue[3]);
-          break;
-        case WASPCMD_LINE:
-          line(parmValue[0], parmValue[4], parmValue[5], parmValue[1],
-               parmValue[2], parmValue[3]);
-          break;
-        case WASPCMD_RESET:
-          waspReset(parmValue[0]);
-          break;
-        case WASPCMD_STATE:
-          setState(parmValue[0], parmValue[1]);
-          break;
-        case WASPCMD_SHIFT:
-          shift(parmValue[0], parmValue[1]);
-          break;
-        case WASPCMD_SWAP:
-          swap(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
-               parmValue[4], parmValue[5], parmValue[6]);
-          break;
-        case WASPCMD_RAINBOW:
-          rainbow(parmValue[0], parmValue[1]);
-          break;
-        case WASPCMD_RAINCYCLE:
-          rainbowCycle(parmValue[0]);
-          break;
-        case WASPCMD_SPEED:
-          fxSpeed(parmValue[0], parmValue[1]);
-          break;
-        case WASPCMD_TWINKLE:
-          twinkle(parmValue[0], parmValue[1], parmValue[2], parmValue[3],
-                  parmValue[4]);
-          break;
-        case WIPE_FN_PAUSE:
-          pause(parmValue[0], parmValue[1], parmValue[2]);
-          break;
-        default:
-          wipeShowError(FLASH("<unknown func>"));
-          return rc;
+        *dst-- = *src--;
       }
-      break;
+
+      m_program[insertPos + i] = transientByte; /* Store byte being moved */
     }
-    case WIPE_GOTO:
-      identifier = (char *)&m_program[m_wipeRunByte];
-      m_wipeRunByte += strlen(identifier) + 1;
-      if (wipeLabelLocate(identifier, &m_wipeRunByte))
-      {
-        return m_wipeRunByte;
-      }
-      wipeShowError(FLASH("Can't jump to label"));
-      return rc;
-      break;
-    case WIPE_IF:
-      exprStart = (char *)&m_program[m_wipeRunByte];
-      if ( wipeParseExpression(exprStart, WIPE_ID_BOOL, false, &exprVal) )
-      {
-        if (0 == exprVal.boolValue)
-        {
-          /* Skip over the next command */
-          m_wipeRunByte = lineStart + m_program[lineStart + TKNZD_LEN_OFFS];
-          if (m_wipeRunByte < m_wipeProgByte)
-          {
-            m_wipeRunByte += m_program[m_wipeRunByte + TKNZD_LEN_OFFS];
-            return m_wipeRunByte;
-          }
-          else
-          {
-            /* We've hit the end of the program */
-            m_wipeRunByte = MAX_PROG_SIZE;
-            return m_wipeRunByte;
-          }
-        }
-      }
-      else
-      {
-        wipePrintStatement();
-        return rc;
-      }
-      break;
-    case WIPE_LABEL:
-      identifier = (char *)&m_program[m_wipeRunByte];
-      m_wipeRunByte += strlen(identifier) + 1;
-      if (!wipeSymbolInsert(identifier, WIPE_ID_LABEL, &symIdx))
-      {
-        if (symIdx == MAX_NUM_SYMBOLS)
-        {
-          wipePrintStatement();
-          logPrint(FLASH("***ERROR: No space for label "));
-          logPrintln(identifier);
-          return rc;
-        }
-      }
-      else
-      {
-        m_symTbl[symIdx].symValue.intValue = lineStart;
-      }
-      break;
-    case WIPE_LET:
-      identifier = (char *)&m_program[m_wipeRunByte];
-      m_wipeRunByte += strlen(identifier) + 1;
-      exprStart = (char *)&m_program[m_wipeRunByte];
-      m_wipeRunByte += 2;
-      if (!wipeSymbolLookup(identifier, &symIdx))
-      {
-        wipePrintStatement();
-        logPrint(FLASH("***ERROR: Variable '"));
-        logPrint(identifier);
-        logPrintln(FLASH("' undefined."));
-        return rc;
-      }
-      else
-      {
-        if ( !wipeParseExpression( exprStart,
-                                   m_symTbl[symIdx].typeId,
-                                   false,
-                                   &m_symTbl[symIdx].symValue )
-           )
-        {
-          wipePrintStatement();
-          logPrintln(FLASH("***SYS ERROR"));
-          return rc;
-        }
-      }
-      break;
-    case WIPE_PRINT:
-      if (m_program[lineStart + TKNZD_STMT_OFFS + 1] == WIPE_PRT_STR)
-      {
-        /* Print quoted string */
-        logPrint((char *)&m_program[lineStart + TKNZD_STMT_OFFS + 2]);
-      }
-      else
-      {
-        /* Print result of expression evaluation */
-        m_wipeRunByte++;
-        identifier = (char *)&m_program[m_wipeRunByte];
-        m_wipeRunByte += strlen(identifier) + 1;
-        if (!wipeSymbolLookup(identifier, &symIdx))
-        {
-          wipePrintStatement();
-          logPrint(FLASH("***ERROR: Variable '"));
-          logPrint(identifier);
-          logPrintln(FLASH("' undefined."));
-          return rc;
-        }
-        else
+
+    m_wipeLineStart += insertLineLen;
+    return true;
+  }
+
+  else
+  {
+    return false;
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeParseLineRange
+//   Parse for and return a line range from the WIPE command line.
+// Parameters:
+//   lower:O  - Address at which to return the lower line number limit.
+//   upper:O  - Address at which to return the upper line number limit.
+// Returns: true, iff at least one line number was specified.
+// Inputs/Outputs:
+//   m_consolePos:IO
+//   m_tokenBuffer:IO
+//-----------------------------------------------------------------------------
+boolean wipeParseLineRange(uint8 *lower, uint8 *upper)
+{
+  int32 tmpLower;
+  int32 tmpUpper;
+  boolean hasLineNum;
+
+  hasLineNum = false;
+
+  /* Check for lower limit or only line number */
+  if (wipeParseInt(&tmpLower, true))
+  {
+    hasLineNum = true;
+  }
+  else
+  {
+    tmpLower = 0;
+  }
+  
+  tmpUpper = strspn(&m_tokenBuffer[m_consolePos], " \r\0");
+  m_consolePos += tmpUpper;
+  tmpUpper = 0;
+  if (m_tokenBuffer[m_consolePos] == '-')
+  {
+    m_consolePos += 2;
+    if (wipeParseInt(&tmpUpper, true))
+    {
+      hasLineNum = true;
+    }
+    else
+    {
+      tmpUpper = MAX_LINE_NUM;
+    }
+  }
+  if (0 == tmpLower)
+  {
+    tmpLower = 1;
+    if (0 == tmpUpper)
+    {
+      tmpUpper = MAX_LINE_NUM;
+    }
+  }
+  else
+  {
+    if (0 == tmpUpper)
+    {
+      tmpUpper = tmpLower;
+    }
+  }
+
+  if ( (tmpLower < 1) || (tmpUpper < 1) ||
+       (tmpUpper > MAX_LINE_NUM) || (tmpUpper > MAX_LINE_NUM) ||
+       (tmpUpper < tmpLower)
+     )
+  {
+    logPrintln(FLASH("Bad line range"));
+    *lower = 0;
+    *upper = 0;
+    return false;
+  }
+  *lower = (uint8)tmpLower;
+  *upper = (uint8)tmpUpper;
+  return hasLineNum;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeResolveLines
+//   Reassign the symbol table entries referenced by a range of program
+//   lines, within the current variable frame, and define their labels.
+// Parameters:
+//   progStart:I  - m_program[] index of the first line.
+//   progEnd:I    - m_program[] index following the last line.
+// Returns: true, iff there was room in the symbol table for all of the
+//          lines' identifiers and no label is defined more than once.
+// Inputs/Outputs:
+//   m_program:IO
+//   m_symBase:I
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+boolean wipeResolveLines(uint16 progStart, uint16 progEnd)
+{
+  uint16 currLine;
+  uint16 pos;
+  uint8  numParms;
+  uint8  symIdx;
+
+  for ( currLine = progStart;
+        currLine < progEnd;
+        currLine += m_program[currLine + TKNZD_LEN_OFFS]
+      )
+  {
+    pos = currLine + TKNZD_STMT_OFFS + 1;
+    switch (m_program[currLine + TKNZD_STMT_OFFS])
+    {
+      case WIPE_LET:
+        pos = wipeResolveIdentifier(pos);
+        if (pos < MAX_PROG_SIZE)
+          pos = wipeResolveExpression(pos);
+        break;
+      case WIPE_IF:
+        pos = wipeResolveExpression(pos);
+        break;
+      case WIPE_GOTO:
+      case WIPE_VAR:
+        pos = wipeResolveIdentifier(pos);
+        break;
+      case WIPE_PRINT:
+        if (WIPE_PRT_VAR == m_program[pos])
+          pos = wipeResolveIdentifier(pos + 1);
+        break;
+      case WIPE_LABEL:
+        /* Build the label map so that goto can jump in either direction */
+        pos = wipeResolveIdentifier(pos);
+        if (pos < MAX_PROG_SIZE)
         {
-          exprVal = m_symTbl[symIdx].symValue;
-          switch (m_symTbl[symIdx].typeId)
+          symIdx = m_program[currLine + TKNZD_STMT_OFFS + 1];
+          if (m_symTbl[symIdx].typeId != WIPE_ID_UNDEF)
           {
-            case WIPE_ID_INT:
-              logPrint(exprVal.intValue);
-              break;
-            case WIPE_ID_FLOAT:
-              logPrint(exprVal.floatValue);
-              break;
-            case WIPE_ID_BOOL:
-              logPrint(exprVal.boolValue);
-            default:
-              wipePrintStatement();
-              logPrint(FLASH("***Can't print value for "));
-              logPrintln(identifier);
-              return rc;
+            logPrint(FLASH("***ERROR: Label '"));
+            logPrint(m_symTbl[symIdx].symbol);
+            if (WIPE_ID_LABEL == m_symTbl[symIdx].typeId)
+              logPrintln(FLASH("' already defined"));
+            else
+              logPrintln(FLASH("' clashes with a variable of the same name"));
+            return false;
           }
+          m_symTbl[symIdx].typeId = WIPE_ID_LABEL;
+          m_symTbl[symIdx].symValue.intValue = currLine;
         }
-      }
-      break;
-    case WIPE_VAR:
-      identifier = (char *)&m_program[m_wipeRunByte];
-      m_wipeRunByte += strlen(identifier) + 1;
-      typeId = m_program[m_wipeRunByte];
-      if (!wipeSymbolInsert(identifier, typeId, &symIdx))
-      {
-        wipePrintStatement();
-        logPrint(FLASH("***ERROR: "));
-        if (symIdx != MAX_NUM_SYMBOLS)
-        {
-          logPrint(FLASH("Variable '"));
-          logPrint(identifier);
-          logPrintln(FLASH("' already defined."));
-          return rc;
-        }
-        else
-        {
-          logPrint(FLASH("No space for variable "));
-          logPrintln(identifier);
-          return rc;
-        }
-      }
-      break;
-    default:
-      logPrint(FLASH("***ERROR: Unknown statement: "));
-      logPrintln(m_program[lineStart + TKNZD_STMT_OFFS]);
+        break;
+      case WIPE_FUNC:
+        numParms = m_program[pos + 1];
+        pos += 2;
+        for ( ; (numParms > 0) && (pos < MAX_PROG_SIZE); numParms--)
+          pos = wipeResolveExpression(pos);
+        break;
+      default:
+        break;
+    }
+    if (pos >= MAX_PROG_SIZE)
+    {
+      logPrintln(FLASH("***ERROR: No room in sym table"));
+      return false;
+    }
   }
-  
-  if (execError)
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeResolveProgram
+//   Clear the symbol table, reassign the symbol table entries referenced
+//   by the program that's loaded in RAM and define the program's labels.
+// Parameters: (none)
+// Returns: true, iff there was room in the symbol table for all of the
+//          program's identifiers and no label is defined more than once.
+// Inputs/Outputs:
+//   m_wipeProgByte:I
+//   m_program:IO
+//   m_symTbl:IO
+//-----------------------------------------------------------------------------
+boolean wipeResolveProgram(void)
+{
+  wipeSymbolsClear();
+  return wipeResolveLines(0, m_wipeProgByte);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeTaskAdd
+//   Add a task to the WIPE task table. The task runs the WIPE statements in
+//   a range of program memory, interleaved with any other tasks in the
+//   table, by successive calls to wipeRunStep().
+// Parameters:
+//   runByte:I  - m_program[] index of the first statement to run.
+//   runEnd:I   - m_program[] index at which to stop running.
+// Returns: true iff there was room in the task table.
+// Inputs/Outputs:
+//   m_numWipeTasks:IO
+//   m_wipeTasks:O
+//-----------------------------------------------------------------------------
+boolean wipeTaskAdd(uint16 runByte, uint16 runEnd)
+{
+  WipeTask_t *pTask;
+
+  if (m_numWipeTasks >= MAX_WIPE_TASKS)
   {
-    wipePrintStatement();
-    logPrintln(FLASH("***ERROR: Statement execution"));
-    return rc;
+    logPrintln(FLASH("***ERROR: Too many tasks"));
+    return false;
   }
-
-  m_wipeRunByte = lineStart + m_program[lineStart + TKNZD_LEN_OFFS];
-  return m_wipeRunByte;
+  pTask = &m_wipeTasks[m_numWipeTasks++];
+  pTask->runByte = runByte;
+  pTask->runEnd = runEnd;
+  pTask->resumeTime = 0;
+  pTask->cmdExecDelay = 0;
+  pTask->progAddr = 0;
+  pTask->schedFrame = 0;
+  pTask->schedOn = false;
+  pTask->symBase = m_symBase;
+  pTask->lineGrowth = 0;
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSeekLineStart
-//   Find the starting address, in program memory, of the program line
-//   with the smallest line number that is not less than specified target
-//   line number.
+// Function: wipeStreamAdd
+//   Add a task that runs a saved program streamed from flash: its lines are
+//   paged in by wipeStreamFetch() as they run, rather than loaded. The
+//   program's image is validated, and its identifiers are entered in the
+//   current variable frame (which must be empty), as it's scanned here.
 // Parameters:
-//   targetNum:I   - The line number of the line to be found.
-//   lineExists:O  - Address at which to return indication that the
-//                   specified line number exists. The output
-//                   value is true iff targetNum already exists.
-// Returns: MAX_PROG_SIZE, if line cannot be found;
-//          The m_program[] index at which the found line starts, otherwise.
+//   progName:I  - Program file name string.
+// Returns: true iff the program was found, valid and resolved and there was
+//          room in the task table.
 // Inputs/Outputs:
-//   m_program:I
-//   m_wipeProgByte:I
+//   m_dirIndex:I
+//   m_numWipeTasks:IO
+//   m_symTbl:IO
+//   m_program:O
+//   m_streamWinAddr:O
+//   m_wipeTasks:O
 //-----------------------------------------------------------------------------
-uint16 wipeSeekLineStart(uint8 targetNum, boolean *lineExists)
+boolean wipeStreamAdd(char *progName)
 {
-  uint16 currPos;
-  uint8  currLineNum;
+  ImgCursor_t  cur;
+  uint32       addr;
+  uint16       fileSize;
+  uint16       progSize;
+  uint16       offs;
+  uint8        len;
+  uint8        symIdx;
+  boolean      valid;
+
+  addr = wipeDirFileFind(progName, &fileSize);
+  if (0 == addr)
+  {
+    logPrint(FLASH("Not found: "));
+    logPrintln(progName);
+    return false;
+  }
+  addr += PROG_HDR_LEN;
+  m_streamWinAddr = 0;  /* The scan pages each line into the window */
+
+  wipeImgCursorInit(&cur, addr + IMG_BODY_OFFS, fileSize - IMG_BODY_OFFS,
+                    false);
+  valid = wipeImgCheck(addr, fileSize, &progSize) &&
+          wipeImgGetStrings(&cur);
+  if (!valid)
+  {
+    wipeImgShowBad(progName, addr);
+    return false;
+  }
 
-  *lineExists = false;
-  currPos = 0;
-  while ( (currPos < MAX_PROG_SIZE) && (currPos < m_wipeProgByte) )
+  /* Offsets from here on are those of the lines, past the string table */
+  addr = cur.addr;
+  fileSize = cur.limit - cur.len;
+  for (offs = 0; valid && (offs < fileSize); offs += len)
   {
-    currLineNum = m_program[currPos + TKNZD_LINE_OFFS];
-    if (currLineNum == targetNum)
+    len = wipeImgGetLine(&cur, STREAM_WIN_POS);
+    if (0 == len)
     {
-      *lineExists = true;
-      return currPos;
+      valid = false;
+      break;
     }
-    else
+    if (!wipeResolveLines(STREAM_WIN_POS,
+                          STREAM_WIN_POS +
+                          m_program[STREAM_WIN_POS + TKNZD_LEN_OFFS]))
+      return false;
+    if (WIPE_LABEL == m_program[STREAM_WIN_POS + TKNZD_STMT_OFFS])
     {
-      if (m_program[currPos + TKNZD_LINE_OFFS] < targetNum)
-      {
-        currPos += m_program[currPos + TKNZD_LEN_OFFS];
-      }
-      else
-      {
-        return currPos;
-      }
+      /* A goto jumps to the label's line offset (see wipeTaskSave()) */
+      symIdx = m_program[STREAM_WIN_POS + TKNZD_STMT_OFFS + 1];
+      m_symTbl[symIdx].symValue.intValue = STREAM_LABEL | offs;
     }
   }
+  if (!valid)
+  {
+    wipeImgShowBad(progName, addr);
+    return false;
+  }
 
-  return MAX_PROG_SIZE;
+  if (!wipeTaskAdd(0, fileSize))
+    return false;
+  m_wipeTasks[m_numWipeTasks - 1].progAddr = addr;
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDelLines
-//   Delete a program line, with a specified starting address and length,
-//   from program memory. Byte following the line-to-be-deleted as shifted
-//   downward to fill the gap.
+// Function: wipeStreamFetch
+//   Page the next line of a task streamed from flash into the stream
+//   window, followed by the header of the line after it (for an if
+//   statement to skip over). The line is expanded from the program's image
+//   with its identifiers resolved within the task's variable frame. It's
+//   only paged in once: while the task's blocked, the window keeps it.
 // Parameters:
-//   lineStart:I  - Starting address of the line to be deleted.
-//   lineLen:I    - Length of the line to be deleted.
-// Returns: (none)
+//   taskIdx:I  - Task table index of the current task.
+// Returns: true, unless the line is invalid (which stops the task).
 // Inputs/Outputs:
-//   m_program:I
-//   m_wipeLineStart:IO
-//   m_wipeProgByte:IO
+//   m_symTbl:I
+//   m_streamWinAddr:IO
+//   m_streamWinBase:IO
+//   m_wipeTasks:IO
+//   m_program:O
+//   m_wipeRunByte:O
+//   m_wipeRunEnd:O
 //-----------------------------------------------------------------------------
-void wipeDeleteLine(uint16 lineStart, uint8 lineLen)
+boolean wipeStreamFetch(uint8 taskIdx)
 {
-  uint8  *dst;
-  uint8  *src;
-  uint16 numBytesToMove;
-  
-  numBytesToMove = m_wipeProgByte - lineLen + 1;
-  dst = &m_program[lineStart];
-  src = dst + m_program[lineStart + TKNZD_LEN_OFFS];
-  for (uint16 i = numBytesToMove; i > 0; i--)
-    *dst++ = *src++;
-   m_wipeLineStart -= lineLen;
-   m_wipeProgByte  -= lineLen;
+  WipeTask_t  *pTask = &m_wipeTasks[taskIdx];
+  ImgCursor_t  cur;
+  uint8        len;
+  uint8        winLen;
+
+  if (0 == pTask->progAddr)
+    return true;
+
+  if ( (pTask->progAddr + pTask->runByte == m_streamWinAddr) &&
+       (pTask->symBase == m_streamWinBase) )
+  {
+    winLen = m_program[STREAM_WIN_POS + TKNZD_LEN_OFFS];
+    m_wipeRunEnd = STREAM_WIN_POS + winLen;
+    if (pTask->runByte + winLen - pTask->lineGrowth < pTask->runEnd)
+      m_wipeRunEnd++;
+    return true;
+  }
+
+  m_streamWinAddr = 0;
+  wipeImgCursorInit(&cur, pTask->progAddr + pTask->runByte,
+                    pTask->runEnd - pTask->runByte, false);
+  m_symBase = pTask->symBase;
+  len = wipeImgGetLine(&cur, STREAM_WIN_POS);
+  m_symBase = 0;
+  if (0 == len)
+  {
+    logPrintln(FLASH("***ERROR: Bad program file"));
+    m_wipeRunByte = MAX_PROG_SIZE;
+    return false;
+  }
+
+  winLen = m_program[STREAM_WIN_POS + TKNZD_LEN_OFFS];
+  pTask->lineGrowth = winLen - len;
+  m_wipeRunEnd = STREAM_WIN_POS + winLen;
+  if (pTask->runByte + len < pTask->runEnd)
+  {
+    for (uint8 i = 0; i < TKNZD_STMT_OFFS; i++)
+      m_program[m_wipeRunEnd + i] = wipeImgGet(&cur);
+    m_wipeRunEnd++;
+  }
+  m_streamWinAddr = pTask->progAddr + pTask->runByte;
+  m_streamWinBase = pTask->symBase;
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeDelLines
-//   Delete program lines.
+// Function: wipeRunStart
+//   Set up to run WIPE statements from a range of program memory as the
+//   only task. The statements are then executed by successive calls to
+//   wipeRunStep().
 // Parameters:
-//   lower:I  - Lower line number limit.
-//   upper:I  - Upper line number limit.
+//   runByte:I  - m_program[] index of the first statement to run.
+//   runEnd:I   - m_program[] index at which to stop running.
 // Returns: (none)
 // Inputs/Outputs:
-//   m_program:I
-//   m_wipeProgByte:I
+//   m_currWipeTask:O
+//   m_numWipeTasks:O
+//   m_schedOn:O
+//   m_wipeTasks:O
 //-----------------------------------------------------------------------------
-void wipeDelLines(uint8 lower, uint8 upper)
+void wipeRunStart(uint16 runByte, uint16 runEnd)
 {
-  uint16   delLineStart;
-  boolean  lineExists;
-  uint8    lineNum;
-  uint8    lineLen;
+  wipeRunStatsClear();
+  m_schedOn = false;
+  m_numWipeTasks = 0;
+  m_currWipeTask = 0;
+  (void)wipeTaskAdd(runByte, runEnd);
+}
 
-  /* Find first line whose line number is >= lower */
-  delLineStart = wipeSeekLineStart(lower, &lineExists);
 
-  lineNum = m_program[delLineStart + TKNZD_LINE_OFFS];
-  while ( (delLineStart < m_wipeProgByte) && (lineNum <= upper) )
+//-----------------------------------------------------------------------------
+// Function: wipeTaskLoad
+//   Make a task the current task. The interpreter works on the current
+//   task's running state in m_wipeRunByte, etc. A task streamed from flash
+//   runs in the stream window, into which wipeStreamFetch() pages its next
+//   line when it's ready to run.
+// Parameters:
+//   taskIdx:I  - Task table index of the task.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_cmdExecDelay:O
+//   m_schedFrame:O
+//   m_schedOn:O
+//   m_wipeResumeTime:O
+//   m_wipeRunByte:O
+//   m_wipeRunEnd:O
+//   m_wipeTasks:I
+//-----------------------------------------------------------------------------
+void wipeTaskLoad(uint8 taskIdx)
+{
+  WipeTask_t *pTask = &m_wipeTasks[taskIdx];
+
+  m_wipeRunByte = pTask->runByte;
+  m_wipeRunEnd = pTask->runEnd;
+  m_wipeResumeTime = pTask->resumeTime;
+  m_cmdExecDelay = pTask->cmdExecDelay;
+  m_schedFrame = pTask->schedFrame;
+  m_schedOn = pTask->schedOn;
+  if (pTask->progAddr != 0)
   {
-    lineLen = m_program[delLineStart + TKNZD_LEN_OFFS];
-    wipeDeleteLine(delLineStart, lineLen);
-    lineNum = m_program[delLineStart + TKNZD_LINE_OFFS];
+    m_wipeRunByte = STREAM_WIN_POS;
+    m_wipeRunEnd = STREAM_WIN_POS;
+    if (pTask->runByte < pTask->runEnd)
+      m_wipeRunEnd++;
   }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeRenumLines
-//   Reunumber program lines evenly from 5 - 250.
+// Function: wipeTaskSave
+//   Save the running state of the current task. For a task streamed from
+//   flash, the position reached in the stream window (or the line offset of
+//   a goto's label) is mapped back to a line offset in the program image.
+// Parameters:
+//   taskIdx:I  - Task table index of the current task.
+// Returns: (none)
+// Inputs/Outputs:
+//   m_cmdExecDelay:I
+//   m_schedFrame:I
+//   m_schedOn:I
+//   m_wipeResumeTime:I
+//   m_wipeRunByte:I
+//   m_wipeTasks:IO
+//-----------------------------------------------------------------------------
+void wipeTaskSave(uint8 taskIdx)
+{
+  WipeTask_t *pTask = &m_wipeTasks[taskIdx];
+
+  if (0 == pTask->progAddr)
+    pTask->runByte = m_wipeRunByte;
+  else if (m_wipeRunByte & STREAM_LABEL)
+    pTask->runByte = m_wipeRunByte & ~STREAM_LABEL;
+  else if ( (m_wipeRunByte > STREAM_WIN_POS) &&
+            (m_wipeRunByte < MAX_PROG_SIZE) )
+    pTask->runByte += m_wipeRunByte - STREAM_WIN_POS - pTask->lineGrowth;
+  else if (m_wipeRunByte != STREAM_WIN_POS)  /* Paged-in line yet to run? */
+    pTask->runByte = pTask->runEnd;  /* Error, or skipped past the end */
+  pTask->resumeTime = m_wipeResumeTime;
+  pTask->cmdExecDelay = m_cmdExecDelay;
+  pTask->schedFrame = m_schedFrame;
+  pTask->schedOn = m_schedOn;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeRunBlocked
+//   Check whether the current task must wait before running its next
+//   statement: for a pause, the execution time of a long-running command,
+//   or room in the radio Tx queue. Once it's not pausing, the next line of
+//   a task streamed from flash is paged in.
 // Parameters:
-//   lower:I  - Lower line number limit.
-//   upper:I  - Upper line number limit.
-// Returns: (none)
+//   taskIdx:I  - Task table index of the current task.
+// Returns: true iff the task can't run its next statement yet.
 // Inputs/Outputs:
-//   m_wipeProgByte:I
-//   m_program:IO
+//   m_batchPos:I
+//   m_pixPending:I
+//   m_cmdExecDelay:IO
+//   m_program:I
+//   m_wipeResumeTime:IO
+//   m_wipeRunByte:IO
 //-----------------------------------------------------------------------------
-void wipeRenumLines(void)
+boolean wipeRunBlocked(uint8 taskIdx)
 {
-  #define  LOWEST_LINE_NUM   5  /* The lowest line # to allow for edit room */
-  uint8   *currLinePos;
-  uint8    count;
-  uint8    newLineNum;
+  uint16 stmtPos;
 
-  /* Determine how many program lines there are */
-  count = 0;
-  for ( currLinePos = &m_program[0];
-        currLinePos < &m_program[m_wipeProgByte];
-        currLinePos += *(currLinePos + TKNZD_LEN_OFFS)
-      )
-    count++;
+  if (wipeDeadlinePending(&m_wipeResumeTime) ||
+      wipeDeadlinePending(&m_cmdExecDelay) ||
+      !wipeStreamFetch(taskIdx))
+    return true;
 
-  /* Determine line number increment for line range #LOWEST_LINE_NUM thru 
-   * approx #(MAX_LINE_NUM - LOWEST_LINE_NUM). So the increment is calculated
-   * as:   (MAX_LINE_NUM - 2*LOWEST_LINE_NUM) / (count - 1)
+  /* Hold back a WASP command (or the flush of a pending batch) until the
+   * radio Tx queue can take it, and any pixel upload has been queued.
    */
-  count = (MAX_LINE_NUM - (LOWEST_LINE_NUM << 1)) / (count - 1);
-  
-  currLinePos = 0;
-  newLineNum = LOWEST_LINE_NUM;
-  for ( currLinePos = &m_program[0];
-        currLinePos < &m_program[m_wipeProgByte];
-        currLinePos += *(currLinePos + TKNZD_LEN_OFFS),
-          newLineNum += count
-      )
-  {
-    *(currLinePos + TKNZD_LINE_OFFS) = newLineNum;
-  }
+  stmtPos = m_wipeRunByte + TKNZD_STMT_OFFS;
+  return ( ( (m_batchPos != 0) ||
+             ( (WIPE_FUNC == m_program[stmtPos]) &&
+               (m_program[stmtPos + 1] <= MAX_WASPCMD_VAL) )
+           ) &&
+           (!radioTxReady() || m_pixPending) );
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeSaveLine
-//   Save the numbered, parsed line that is being edited into program store
-//   in it correct location.
+// Function: wipeStmtBatchable
+//   Check whether the current task's next statement sends a WASP command
+//   that can be added to a batch (see radioSendCmd()).
 // Parameters: (none)
-// Returns: true, iff there was enough memory to store the line.
+// Returns: true iff the statement's WASP command can be batched.
 // Inputs/Outputs:
 //   m_program:I
-//   m_wipeLineStart:IO
-//   m_wipeProgByte:IO
+//   m_wipeRunByte:I
 //-----------------------------------------------------------------------------
-boolean wipeSaveLine(void)
+boolean wipeStmtBatchable(void)
 {
-  uint8  *dst;
-  uint8  *src;
-  uint16  insertPos;
-  uint16  moveStartPos;
-  uint16  numBytesToMove;
-  uint8   insertLineNum;
-  uint8   insertLineLen;
-  uint8   deleteLineLen;
-  uint8   transientByte;
-  boolean isReplacement; /* true = The edit line replaces an existing line */
+  uint16 stmtPos = m_wipeRunByte + TKNZD_STMT_OFFS;
 
-  insertLineNum = m_program[m_wipeLineStart + TKNZD_LINE_OFFS];
-  insertLineLen = m_program[m_wipeLineStart + TKNZD_LEN_OFFS];
-  insertPos = wipeSeekLineStart(insertLineNum, &isReplacement);
+  return ( (WIPE_FUNC == m_program[stmtPos]) &&
+           WASP_BATCHABLE(m_program[stmtPos + 1]) );
+}
 
-  if (insertPos == m_wipeLineStart)
+
+//-----------------------------------------------------------------------------
+// Function: wipeRunStep
+//   Execute the next WIPE statement of the first task, after the one that
+//   ran most recently, that isn't waiting on a deadline. Since tasks are
+//   scanned round-robin, the radio is granted fairly among the tasks
+//   waiting to transmit. Waiting never blocks, so the main loop keeps
+//   servicing the radio and console between statements. A run of
+//   batchable WASP commands is sent as a single batch when a statement
+//   that can't join the batch is reached; sending the batch takes the
+//   place of that statement's step.
+// Parameters: (none)
+// Returns: true iff any task has not yet completed.
+// Inputs/Outputs:
+//   m_batchPos:I
+//   m_pixPending:I
+//   m_currWipeTask:IO
+//   m_numWipeTasks:IO
+//   m_runStmts:IO
+//   m_wipeLedState:IO
+//   m_wipeTasks:IO
+//-----------------------------------------------------------------------------
+boolean wipeRunStep(void)
+{
+  uint8   taskIdx;
+  boolean running = false;
+
+  /* Check for 'x' from the console */
+  if ( (Serial.available() > 0) && (Serial.read() == 'x') )
   {
-    /* Current edit line is already in the right position */
-    m_wipeLineStart += insertLineLen;
-    return true;
+    radioBatchFlush();
+    m_numWipeTasks = 0;
+    m_wipeRunByte = MAX_PROG_SIZE;
+    return false;
   }
-  
-  else if (insertPos < MAX_PROG_SIZE)
-  {
-    /*---  Insertion is ok.  ---*/
 
-    if (isReplacement)
+  for (uint8 i = 1; i <= m_numWipeTasks; i++)
+  {
+    taskIdx = (m_currWipeTask + i) % m_numWipeTasks;
+    wipeTaskLoad(taskIdx);
+    if (m_wipeRunByte >= m_wipeRunEnd)
     {
-      /* The edit line replaces an existing line. So delete the latter. */
-      wipeDeleteLine(insertPos, m_program[insertPos + TKNZD_LEN_OFFS]);
+      /* The task has completed once its last pause (or command) is over */
+      if (wipeDeadlinePending(&m_wipeResumeTime) ||
+          wipeDeadlinePending(&m_cmdExecDelay) || m_pixPending)
+      {
+        running = true;
+        wipeTaskSave(taskIdx);
+      }
+      continue;
     }
-    
-    numBytesToMove = m_wipeLineStart - insertPos;
-    for (uint16 i = 0; i < insertLineLen; i++)
-    {
-      /*---  Insert the next byte of the edit line.  ---*/
-      
-      dst = &m_program[m_wipeLineStart + i];
-      src = dst - 1;
-      transientByte = *dst; /* Note byte being moved */
 
-      /* Shift program memory bytes upward by one byte */
-      for (uint16 j = numBytesToMove; j > 0; j--)
+    running = true;
+    if (!wipeRunBlocked(taskIdx))
+    {
+      if ( (m_batchPos != 0) && !wipeStmtBatchable() )
       {
-        *dst-- = *src--;
+        radioBatchFlush();
+        wipeTaskSave(taskIdx);
+        m_currWipeTask = taskIdx;
+        return true;
       }
 
-      m_program[insertPos + i] = transientByte; /* Store byte being moved */
-    }
-
-    m_wipeLineStart += insertLineLen;
-    return true;
-  }
+      digitalWrite(WIPE_RUN_LED, m_wipeLedState);
+      if (LOW == m_wipeLedState)
+        m_wipeLedState = HIGH;
+      else
+        m_wipeLedState = LOW;
 
-  else
-  {
-    return false;
+      //wipePrintStatement();
+      m_wipeRunByte = wipeExecuteStatement(m_wipeRunByte);
+      m_runStmts++;
+      wipeTaskSave(taskIdx);
+      m_currWipeTask = taskIdx;
+      return true;
+    }
+    wipeTaskSave(taskIdx);  /* Note any expired deadlines */
   }
+  return running;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: wipeParseLineRange
-//   Parse for and return a line range from the WIPE command line.
-// Parameters:
-//   lower:O  - Address at which to return the lower line number limit.
-//   upper:O  - Address at which to return the upper line number limit.
-// Returns: true, iff at least one line number was specified.
+// Function: wipeRunStatsClear
+//   Start collecting the statistics of a WIPE run.
+// Parameters: (none)
+// Returns: (none)
 // Inputs/Outputs:
-//   m_consolePos:IO
-//   m_tokenBuffer:IO
+//   m_runAirUs:O
+//   m_runStartMs:O
+//   m_runStmts:O
+//   m_runTxBytes:O
+//   m_runTxFrames:O
 //-----------------------------------------------------------------------------
-boolean wipeParseLineRange(uint8 *lower, uint8 *upper)
+void wipeRunStatsClear(void)
 {
-  int32 tmpLower;
-  int32 tmpUpper;
-  boolean hasLineNum;
-
-  hasLineNum = false;
+  m_runStartMs = millis();
+  m_runStmts = 0;
+  m_runTxBytes = 0;
+  m_runAirUs = 0;
+  m_runTxFrames = 0;
+}
 
-  /* Check for lower limit or only line number */
-  if (wipeParseInt(&tmpLower, true))
-  {
-    hasLineNum = true;
-  }
-  else
-  {
-    tmpLower = 0;
-  }
-  
-  tmpUpper = strspn(&m_tokenBuffer[m_consolePos], " \r\0");
-  m_consolePos += tmpUpper;
-  tmpUpper = 0;
-  if (m_tokenBuffer[m_consolePos] == '-')
-  {
-    m_consolePos += 2;
-    if (wipeParseInt(&tmpUpper, true))
-    {
-      hasLineNum = true;
-    }
-    else
-    {
-      tmpUpper = MAX_LINE_NUM;
-    }
-  }
-  if (0 == tmpLower)
-  {
-    tmpLower = 1;
-    if (0 == tmpUpper)
-    {
-      tmpUpper = MAX_LINE_NUM;
-    }
-  }
-  else
-  {
-    if (0 == tmpUpper)
-    {
-      tmpUpper = tmpLower;
-    }
-  }
 
-  if ( (tmpLower < 1) || (tmpUpper < 1) ||
-       (tmpUpper > MAX_LINE_NUM) || (tmpUpper > MAX_LINE_NUM) ||
-       (tmpUpper < tmpLower)
-     )
-  {
-    logPrintln(FLASH("Bad line range"));
-    *lower = 0;
-    *upper = 0;
-    return false;
-  }
-  *lower = (uint8)tmpLower;
-  *upper = (uint8)tmpUpper;
-  return hasLineNum;
+//-----------------------------------------------------------------------------
+// Function: wipeRunReport
+//   Report the statistics of the WIPE run that has just completed: its
+//   statement rate, and the radio traffic that it (and the time-sync
+//   beacons, etc., sent meanwhile) caused.
+// Parameters: (none)
+// Returns: (none)
+// Inputs/Outputs:
+//   m_runAirUs:I
+//   m_runStartMs:I
+//   m_runStmts:I
+//   m_runTxBytes:I
+//   m_runTxFrames:I
+//-----------------------------------------------------------------------------
+void wipeRunReport(void)
+{
+  uint32 elapsed = millis() - m_runStartMs;
+
+  logPrint(FLASH("Run: "));
+  logPrint(m_runStmts);
+  logPrint(FLASH(" stmts in "));
+  logPrint(elapsed);
+  logPrint(FLASH(" ms ("));
+  logPrint(elapsed ? (m_runStmts * 1000UL) / elapsed : m_runStmts);
+  logPrint(FLASH("/s); Tx: "));
+  logPrint(m_runTxFrames);
+  logPrint(FLASH(" frames, "));
+  logPrint(m_runTxBytes);
+  logPrint(FLASH(" bytes, "));
+  logPrint(m_runAirUs / 1000);
+  logPrint(FLASH(" ms airtime ("));
+  logPrint(elapsed ? (m_runAirUs / 10) / elapsed : 0);
+  logPrintln(FLASH("%)"));
 }
 
 
 //-----------------------------------------------------------------------------
 // Function: wipeRunProgram
-//   Run the program that's currently loaded in RAM.
+//   Start running the program that's currently loaded in RAM.
 // Parameters: (none)
-// Returns: (none)
+// Returns: true iff the program was started.
 // Inputs/Outputs:
 //   m_wipeProgByte:I
-//   m_wipeRunByte:IO
+//   m_symTbl:O
+//   m_wipeRunByte:O
 //-----------------------------------------------------------------------------
-void wipeRunProgram(void)
+boolean wipeRunProgram(void)
 {
-  uint32 currentTime;
-  
   m_wipeRunByte = 0;
-  wipeSymbolsClear();
+  if (!wipeResolveProgram())
+    return false;
   logPrintln();
   digitalWrite(WIPE_PRGM_LED, LOW);
-  while (m_wipeRunByte < m_wipeProgByte)
-  {
-    digitalWrite(WIPE_RUN_LED, m_wipeLedState);
-    if (LOW == m_wipeLedState)
-      m_wipeLedState = HIGH;
-    else
-      m_wipeLedState = LOW;
-    currentTime = millis();
+  wipeRunStart(0, m_wipeProgByte);
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: wipeRunTasks
+//   Load the saved programs named on the command line into the program
+//   memory following the program being edited, and start running them
+//   concurrently. Each program runs as a separate task with its own
+//   variable frame. Programs stored in flash are streamed from there
+//   instead of being loaded (see wipeStreamAdd()).
+// Parameters: (none)
+// Returns: true iff all of the programs were started.
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_consolePos:IO
+//   m_currWipeTask:O
+//   m_numWipeTasks:IO
+//   m_program:O
+//   m_schedOn:O
+//   m_symBase:O
+//   m_symTbl:O
+//   m_wipeProgByte:I
+//-----------------------------------------------------------------------------
+boolean wipeRunTasks(void)
+{
+  char   *progName;
+  uint16  loadPos = m_wipeProgByte;
+  uint16  fileSize;
 
-    /* Check command-specific timeout (for long-running command) */
-    if (m_cmdExecDelay)
+  wipeRunStatsClear();
+  m_schedOn = false;
+  m_numWipeTasks = 0;
+  wipeSymbolsClear();
+  if (m_flashPresent && (m_wipeProgByte > STREAM_WIN_POS))
+  {
+    logPrintln(FLASH("***Out of RAM for streaming"));
+    return false;
+  }
+  while (wipeScanIdentifier(&progName, MAX_PROGNAME_LEN) != 0)
+  {
+    if (m_flashPresent)
     {
-      while (m_cmdExecDelay > currentTime)
+      m_symBase = m_numSymbols;  /* Start a new variable frame */
+      if (!wipeStreamAdd(progName))
       {
-        delay(m_cmdExecDelay - currentTime);
-        currentTime = millis();      
+        m_symBase = 0;
+        m_numWipeTasks = 0;
+        return false;
       }
-      m_cmdExecDelay = 0;
+      continue;
     }
-    
-    //wipePrintStatement();
-    m_wipeRunByte = wipeExecuteStatement(m_wipeRunByte);
+    m_symBase = m_numSymbols;  /* Start a new variable frame */
+    fileSize = wipeDirFileRead(progName, loadPos, NULL);
+    if ( (0 == fileSize) ||
+         !wipeResolveLines(loadPos, loadPos + fileSize) ||
+         !wipeTaskAdd(loadPos, loadPos + fileSize) )
+    {
+      m_symBase = 0;
+      m_numWipeTasks = 0;
+      return false;
+    }
+    loadPos += fileSize;
+  }
+  m_symBase = 0;
+  if (0 == m_numWipeTasks)
+  {
+    wipeShowError(FLASH("No filename"));
+    return false;
   }
-  digitalWrite(WIPE_PRGM_LED, HIGH);
+  m_currWipeTask = m_numWipeTasks - 1;  /* First task runs first */
+
   logPrintln();
+  digitalWrite(WIPE_PRGM_LED, LOW);
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
 // Function: processWipeCommand
 //   Process WASP Interpretive Programming Environment (WIPE) console commands.
+//   While statements are running, each call executes at most one of them.
 // Parameters: (none)
 // Returns: true iff command processing has completed.
 // Inputs/Outputs:
 //   m_consoleBuffer:IO
 //   m_consolePos:IO
 //   m_wipeProgByte:IO
+//   m_schedOn:O
 //   m_wipeRunByte:O
 //-----------------------------------------------------------------------------
 void processWipeCommand(void)
@@ -5118,15 +9370,41 @@ void processWipeCommand(void)
   static uint8    wipeStage = PRG_PROMPT;
   static uint8    wipeSubstage = WIPE_PARSE_START;
   static uint8    token;
+  static uint8    runType = WIPE_RUN_IMMED;
   static boolean  saveToRam = false;  // Save program line to RAM buffer
   char    *progName;
   uint16   fileSize;
+  uint16   tmpUint16;
   uint8    lower, upper;
   uint8    tmpUint8;
   char     inChar;
   boolean  errorReported;
 
-  m_breakProg = false;
+  if (PRG_RUN == wipeStage)
+  {
+    if (wipeRunStep())
+      return;  /* Give loop() a turn before the next statement */
+
+    /* The run has completed */
+    radioBatchFlush();
+    m_numWipeTasks = 0;
+    m_schedOn = false;  /* Left as the last task to run had it */
+    wipeStage = PRG_PROMPT;
+    if (WIPE_RUN_IMMED == runType)
+    {
+      logPrintln();
+    }
+    else
+    {
+      digitalWrite(WIPE_PRGM_LED, HIGH);
+      logPrintln();
+      wipeRunReport();
+      waspReset(BROADCASTID);
+      if (WIPE_RUN_AUTO == runType)
+        logPrintln(FLASH("Autorun done"));
+    }
+  }
+
   if (PRG_PROMPT == wipeStage)
   {
     if (m_triggerAutoRun)
@@ -5138,7 +9416,12 @@ void processWipeCommand(void)
         logPrintln(FLASH("***Autorun file missing"));
         return;
       }
-      wipeRunProgram();
+      if (wipeRunProgram())
+      {
+        runType = WIPE_RUN_AUTO;
+        wipeStage = PRG_RUN;
+        return;
+      }
       waspReset(BROADCASTID);
       logPrintln(FLASH("Autorun done"));
     }
@@ -5155,7 +9438,7 @@ void processWipeCommand(void)
   while (PRG_INPUT == wipeStage)
   {
     if (0 == Serial.available())
-      continue; // Nothing to process
+      return; // Nothing to process; check again on the next loop() pass
  
     /* Process an input character */
     inChar = Serial.read();
@@ -5288,6 +9571,13 @@ void processWipeCommand(void)
       case WIPE_CMD_HELP:
         wipeShowHelp();
         break;
+      case WIPE_CMD_MRUN:
+        if (wipeRunTasks())
+        {
+          runType = WIPE_RUN_PROG;
+          wipeStage = PRG_RUN;
+        }
+        break;
       case WIPE_CMD_PROF:
         wipeSymbolsShow();
         break;
@@ -5295,27 +9585,43 @@ void processWipeCommand(void)
         wipeRenumLines();
         break;
       case WIPE_CMD_RUN:
-        wipeRunProgram();
-        waspReset(BROADCASTID);
+        if (wipeRunProgram())
+        {
+          runType = WIPE_RUN_PROG;
+          wipeStage = PRG_RUN;
+        }
+        else
+        {
+          waspReset(BROADCASTID);
+        }
         break;
       case WIPE_CMD_SAVE:
-        if ( (m_wipeProgByte + DIR_PROG_OFFS) > m_wipeDirSpace )
+        /* Saving leaves just the program's identifiers in the sym table */
+        if (!wipeResolveProgram())
+          break;
+        fileSize = wipeImgWrite(0, false);
+        if ( (fileSize + DIR_PROG_OFFS) > m_wipeDirSpace )
         {
           wipeShowError(FLASH("Out of file space"));
           break;
         }
+        if (m_dirCount >= MAX_DIR_FILES)
+        {
+          wipeShowError(FLASH("Directory full"));
+          break;
+        }
         tmpUint8 = wipeScanIdentifier(&progName, MAX_PROGNAME_LEN);
         if (tmpUint8 == 0)
         {
           wipeShowError(FLASH("No filename"));
           break;
         }
-        if (wipeDirFileFind(progName, &fileSize) != 0)
+        if (wipeDirFileFind(progName, &tmpUint16) != 0)
         {
           wipeShowError(FLASH("File exists"));
           break;
         }
-        wipeDirFileSave(progName);
+        wipeDirFileSave(progName, fileSize);
         break;
       case WIPE_CMD_START:
         tmpUint8 = wipeScanIdentifier(&progName, MAX_PROGNAME_LEN);
@@ -5359,13 +9665,16 @@ void processWipeCommand(void)
           }
           else
           {
-            /* Execute the tokenized line directly. */
-            //wipePrintStatement();
-
+            /* Execute the tokenized line directly. It stays in place
+             * beyond the end of the program until the run completes,
+             * since no lines can be entered in the meantime.
+             */
             m_wipeProgByte = m_wipeLineStart;
-            m_wipeRunByte = m_wipeLineStart;
-            (void)wipeExecuteStatement(m_wipeLineStart);
-            logPrintln();
+            wipeRunStart( m_wipeLineStart,
+                          m_wipeLineStart +
+                            m_program[m_wipeLineStart + TKNZD_LEN_OFFS] );
+            runType = WIPE_RUN_IMMED;
+            wipeStage = PRG_RUN;
           }
         }
         else
@@ -5387,6 +9696,8 @@ void processWipeCommand(void)
 //-----------------------------------------------------------------------------
 void setup()
 {
+  uint8 fwVersion;
+
 #ifdef CONSOLE_ENABLED
   Serial.begin(SERIAL_BAUD);
 #endif
@@ -5401,7 +9712,8 @@ void setup()
   m_resetCount = EEPROM.read(EEPROM_RESET_COUNT_ADDR) + 1;
   
   // Check if we need to clear out EEPROM and start from scratch
-  m_resetEeprom = (EEPROM.read(EEPROM_FW_ADDR) != FW_VERSION_c);
+  fwVersion = EEPROM.read(EEPROM_FW_ADDR);
+  m_resetEeprom = (fwVersion < FW_KEPT_c) || (fwVersion > FW_VERSION_c);
   if (m_resetEeprom)
   {
     // Record new F/W version and start with blank parameters
@@ -5415,11 +9727,18 @@ void setup()
   }
   else
   {
-    // Read in parameters stored in EEPROM
+    // Read in parameters stored in EEPROM. Earlier F/W laid them out the
+    // same way, and its programs are converted as they're loaded.
+    if (fwVersion != FW_VERSION_c)
+      EEPROM.write(EEPROM_FW_ADDR, FW_VERSION_c);
     EepromLoad();
   }
   EEPROM.write(EEPROM_RESET_COUNT_ADDR, m_resetCount);
 
+  // Keep WIPE programs in the external add-on Flash memory, if available
+  m_flashPresent = m_flash.initialize();
+  wipeDirIndexBuild();
+
 #ifdef CONSOLE_ENABLED
   Serial.println();
   Serial.print(FLASH("Wireless Addressable Strings of Pixels (WASP) network"));
@@ -5440,6 +9759,8 @@ void setup()
   Serial.print(m_resetCount);
   Serial.print(FLASH("\t"));
   CheckRam();
+  Serial.print(FLASH("WIPE program store: "));
+  Serial.println(m_flashPresent ? FLASH("SPI flash") : FLASH("EEPROM"));
   Serial.println();
 
   #ifndef LOGGING_ON
@@ -5547,8 +9868,14 @@ void loop()
     }
   #endif
   
+  // Send queued WASP commands that are due
+  radioTxPoll();
+  pixelsPoll();
+
   // Listen to RFM radio
   receiveRadioWaspRsp();
+  telemetryPoll();
+  syncPoll();
 
   // Generate RFM radio response when necessary
   //processRadioOutput();
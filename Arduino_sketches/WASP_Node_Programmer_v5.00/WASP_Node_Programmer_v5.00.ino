@@ -33,14 +33,22 @@
  *       - Click the "Start!" button.
  *       - Because the gateway outputs help text for someone opening the
  *         console, the first "Start!" may fail. Simply retry.
+ *
+ * To wirelessly program all WASP slave nodes at once, do the same, but
+ * select node ID 255 (BROADCASTID). The gateway stores the hex file in its
+ * own add-on Flash memory, then broadcasts it to the slaves in blocks (see
+ * FWD_OFFER in WASP_defs.h). It then queries each slave in turn, resends the
+ * blocks that the slave missed, and has the slave check the image's CRC and
+ * restart with it. A slave that drops out keeps the blocks it has already
+ * received, so running the update again only sends it the missing ones.
  *       
  * NOTES:
  *   - The WASP slaves must have LowPowerLab's DualOptiboot bootloader
  *     installed; they are sold with the bootloader already installed. Without
  *     that bootloader, the slave cannot load a new sketch from the add-on
  *     Flash memory.
- *   - The programming gateway node requires neither the add-on Flash memory,
- *     nor the custon Optiboot.
+ *   - The programming gateway node requires neither the add-on Flash memory
+ *     (except to program all slaves at once), nor the custon Optiboot.
  *   - This gateway code can run on any Moteino board that has an RFM69 radio.
  * 
  *
@@ -61,6 +69,7 @@
 #include <RFM69_OTA.h>//get it here: https://github.com/lowpowerlab/RFM69
 #include <SPIFlash.h> //get it here: https://www.github.com/lowpowerlab/spiflash
 #include <SPI.h>      //included with Arduino IDE (www.arduino.cc)
+#include "WASP_defs.h"
 
 #define COPYRIGHT     "(C)2018, A.J. van Schouwen"
 #define SW_VERSION_c  "5.00 (2019-03-29)"
@@ -86,15 +95,41 @@
 
 #define ASCII_NL  0x0A  // ASCII newline character
 
+// Define the Moteino pin used for Flash memory chip select.
+#ifdef __AVR_ATmega1284P__
+  #define FLASH_SS      23   // FLASH SS on D23
+#else
+  #define FLASH_SS       8   // FLASH SS on D8
+#endif
+
+// Broadcast programming of all slaves (see fwdSerialHEX())
+#define FWD_BLOCK_GAP_MS  10  // Pause after each block, for the slaves'
+                              //   Flash writes
+#define FWD_QUERY_TRIES    3  // # of unanswered queries before a slave is
+                              //   taken to be absent
+#define FWD_MAX_ROUNDS    60  // Max # of query and resend rounds
+#define FWD_NODE_BUSY      0  // Slave's update is in progress
+#define FWD_NODE_DONE      1  // Slave is restarting with the new image
+#define FWD_NODE_ABSENT    2  // Slave didn't answer
+#define FWD_NODE_NOCOMMIT  3  // Slave didn't confirm the COMMIT
+#define FWD_HEX_LINES      3  // Max # of hex records per line (the PC
+                              //   programmer's LINESPERPACKET)
+#define FWD_HEX_DATA_LEN  (16 * FWD_HEX_LINES)  // Max data bytes per line
+#define FWD_LINE_LEN      (4 + 5 + 11 + 2 * FWD_HEX_DATA_LEN)
+                              // Max line "FLX:<seq>:LLAAAATT<data>CC"
+
 // Macro for defining strings that are stored in flash (program) memory rather
 // than in RAM. Arduino defines the non-descript F("string") syntax.
 #define FLASH(x) F(x)
 
 
 RFM69 radio;
+SPIFlash flash(FLASH_SS, 0xEF30);  // EF30 for windbond 4mbit flash
+boolean flashPresent = false;
 char c = 0;
-char input[64]; //serial input buffer
+char input[FWD_LINE_LEN + 1]; //serial input buffer
 byte targetID=0;
+uint8 fwdStatus[RF69_MAX_DATA_LEN]; // Last FWD_STATUS reply (see fwdRequest())
 
 
 
@@ -112,6 +147,7 @@ void setup()
   Serial.begin(SERIAL_BAUD);
   radio.initialize(FREQUENCY, NODEID, NETWORKID);
   //radio.encrypt(ENCRYPTKEY);
+  flashPresent = flash.initialize();
 
   Serial.println();
   Serial.print(FLASH("WASP network"));
@@ -155,6 +191,349 @@ void setup()
   Serial.println(FLASH("    - Click the 'Start!' button."));
   Serial.println(FLASH("    - Due to this help text, the first 'Start!' may "
                              "fail: Just retry."));
+  Serial.println(FLASH("- To program all WASP slaves at once, select node ID "
+                         "255 instead."));
+  if (!flashPresent)
+    Serial.println(FLASH("  (This needs Flash memory, which this gateway "
+                           "lacks.)"));
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdCrc
+//   Add a byte to a CRC-16/CCITT (polynomial 0x1021) checksum.
+// Parameters:
+//   crc:I   - Checksum of the preceding bytes.
+//   data:I  - The byte to add.
+// Returns: The updated checksum.
+//-----------------------------------------------------------------------------
+uint16 fwdCrc(uint16 crc, uint8 data)
+{
+  crc ^= (uint16)data << 8;
+  for (uint8 i = 0; i < 8; i++)
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  return crc;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdHex
+//   Convert a pair of hex digits to a byte.
+// Parameters:
+//   pHex:I  - The two hex digits.
+// Returns: The byte value, or -1 if they aren't hex digits.
+//-----------------------------------------------------------------------------
+int16 fwdHex(const char *pHex)
+{
+  int16 value = 0;
+
+  for (uint8 i = 0; i < 2; i++)
+  {
+    value <<= 4;
+    if ( (pHex[i] >= '0') && (pHex[i] <= '9') )
+      value += pHex[i] - '0';
+    else if ( (pHex[i] >= 'A') && (pHex[i] <= 'F') )
+      value += pHex[i] - 'A' + 10;
+    else if ( (pHex[i] >= 'a') && (pHex[i] <= 'f') )
+      value += pHex[i] - 'a' + 10;
+    else
+      return -1;
+  }
+  return value;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdHexRecord
+//   Decode an Intel HEX record, as sent by the PC-based programmer. (It may
+//   bundle up to FWD_HEX_LINES consecutive data records into one.)
+// Parameters:
+//   pRec:I    - The record (":LLAAAATT<data>CC").
+//   recLen:I  - # of characters in the record.
+//   pData:O   - The record's data bytes, if it's a data record.
+// Returns: The # of data bytes (0 if it isn't a data record), or -1 if the
+//          record is invalid.
+//-----------------------------------------------------------------------------
+int16 fwdHexRecord(const char *pRec, uint8 recLen, uint8 *pData)
+{
+  int16 value;
+  uint8 sum = 0;
+  uint8 len;
+
+  if ( (recLen < 11) || (recLen > 11 + 2 * FWD_HEX_DATA_LEN) ||
+       (':' != pRec[0]) )
+    return -1;
+  len = (recLen - 11) / 2;
+  for (uint8 i = 0; i < (recLen - 1) / 2; i++)
+  {
+    value = fwdHex(&pRec[1 + 2 * i]);
+    if (value < 0)
+      return -1;
+    sum += value;
+    if ( (i >= 4) && (i < 4 + len) )
+      pData[i - 4] = value;
+  }
+  if ( (0 != sum) || (fwdHex(&pRec[1]) != len) || (recLen != 11 + 2 * len) )
+    return -1;
+  return (0 == fwdHex(&pRec[7]) ? len : 0);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdSendBlock
+//   Send one block of the image stored in Flash memory.
+// Parameters:
+//   dst:I  - Destination slave node ID, or BROADCASTID.
+//   id:I   - Image id.
+//   blk:I  - Block number.
+//   len:I  - Image length (bytes).
+// Returns: (none)
+//-----------------------------------------------------------------------------
+void fwdSendBlock(uint8 dst, uint8 id, uint16 blk, uint16 len)
+{
+  uint8  buf[FWD_HDR_LEN + FWD_BLOCK_LEN];
+  uint32 offs = (uint32)blk * FWD_BLOCK_LEN;
+  uint8  n;
+
+  n = (len - offs > FWD_BLOCK_LEN ? FWD_BLOCK_LEN : len - offs);
+  buf[0] = FWD_BLOCK;
+  buf[1] = id;
+  buf[2] = (uint8)blk;
+  buf[3] = (uint8)(blk >> 8);
+  flash.readBytes(offs, &buf[FWD_HDR_LEN], n);
+  radio.send(dst, buf, FWD_HDR_LEN + n, false);
+  delay(FWD_BLOCK_GAP_MS);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdSendImage
+//   Offer the image stored in Flash memory, then send all of its blocks.
+// Parameters:
+//   dst:I  - Destination slave node ID, or BROADCASTID.
+//   id:I   - Image id.
+//   len:I  - Image length (bytes).
+//   crc:I  - CRC-16/CCITT of the image.
+// Returns: (none)
+//-----------------------------------------------------------------------------
+void fwdSendImage(uint8 dst, uint8 id, uint16 len, uint16 crc)
+{
+  uint8  buf[6];
+  uint16 blocks = (len + FWD_BLOCK_LEN - 1) / FWD_BLOCK_LEN;
+
+  buf[0] = FWD_OFFER;
+  buf[1] = id;
+  buf[2] = (uint8)len;
+  buf[3] = (uint8)(len >> 8);
+  buf[4] = (uint8)crc;
+  buf[5] = (uint8)(crc >> 8);
+  radio.send(dst, buf, sizeof(buf), false);
+  delay(FWD_BLOCK_GAP_MS);
+  radio.send(dst, buf, sizeof(buf), false);  // A broadcast isn't ACKed
+  delay(FWD_ERASE_MS);
+
+  for (uint16 blk = 0; blk < blocks; blk++)
+  {
+    fwdSendBlock(dst, id, blk, len);
+    if (63 == (blk & 63))
+      Serial.print('.');
+  }
+  Serial.println();
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdRequest
+//   Send a QUERY or COMMIT to a slave, and await its STATUS reply.
+// Parameters:
+//   dst:I     - Slave node ID.
+//   fwd:I     - FWD_QUERY or FWD_COMMIT.
+//   id:I      - Image id.
+//   waitMs:I  - How long to wait for the reply.
+// Returns: The length of the reply in fwdStatus[], or 0 if there was none.
+//-----------------------------------------------------------------------------
+uint8 fwdRequest(uint8 dst, uint8 fwd, uint8 id, uint16 waitMs)
+{
+  uint8  buf[2];
+  uint32 start;
+
+  buf[0] = fwd;
+  buf[1] = id;
+  radio.send(dst, buf, sizeof(buf), false);
+  start = millis();
+  while ((millis() - start) < waitMs)
+  {
+    if ( radio.receiveDone() && (radio.SENDERID == dst) &&
+         (radio.DATALEN >= FWD_HDR_LEN) && (FWD_STATUS == radio.DATA[0]) &&
+         (id == radio.DATA[1]) )
+    {
+      memcpy(fwdStatus, (const void *)radio.DATA, radio.DATALEN);
+      return radio.DATALEN;
+    }
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdDistribute
+//   Program all slaves with the image stored in Flash memory: broadcast it,
+//   then bring each slave up to date in turn, and have it install the image.
+// Parameters:
+//   len:I  - Image length (bytes).
+//   crc:I  - CRC-16/CCITT of the image.
+// Returns: (none)
+//-----------------------------------------------------------------------------
+void fwdDistribute(uint16 len, uint16 crc)
+{
+  uint8   id = (uint8)crc;
+  uint8   state[MAX_SLAVES];
+  uint8   rspLen;
+  uint16  missing;
+  boolean pending = true;
+
+  Serial.print(FLASH("Broadcasting "));
+  Serial.print(len);
+  Serial.println(FLASH(" bytes"));
+  fwdSendImage(BROADCASTID, id, len, crc);
+
+  memset(state, FWD_NODE_BUSY, sizeof(state));
+  for (uint8 round = 0; pending && (round < FWD_MAX_ROUNDS); round++)
+  {
+    pending = false;
+    for (uint8 i = 0; i < MAX_SLAVES; i++)
+    {
+      if (FWD_NODE_BUSY != state[i])
+        continue;
+      rspLen = 0;
+      for (uint8 j = 0; (0 == rspLen) && (j < FWD_QUERY_TRIES); j++)
+        rspLen = fwdRequest(FIRST_SLAVE + i, FWD_QUERY, id, FWD_REPLY_MS);
+      if (0 == rspLen)
+      {
+        state[i] = FWD_NODE_ABSENT;
+        continue;
+      }
+
+      missing = fwdStatus[2] | ((uint16)fwdStatus[3] << 8);
+      if ( (FWD_NO_IMAGE == missing) || (FWD_BAD_CRC == missing) )
+        fwdSendImage(FIRST_SLAVE + i, id, len, crc);
+      else if (0 != missing)
+      {
+        for (uint8 k = FWD_HDR_LEN; (k + 1) < rspLen; k += 2)
+          fwdSendBlock(FIRST_SLAVE + i, id,
+                       fwdStatus[k] | ((uint16)fwdStatus[k + 1] << 8), len);
+      }
+      else
+      {
+        rspLen = fwdRequest(FIRST_SLAVE + i, FWD_COMMIT, id, FWD_ERASE_MS);
+        missing = fwdStatus[2] | ((uint16)fwdStatus[3] << 8);
+        if (0 == rspLen)
+          state[i] = FWD_NODE_NOCOMMIT;
+        else if (0 == missing)
+          state[i] = FWD_NODE_DONE;
+      }
+      if (FWD_NODE_BUSY == state[i])
+        pending = true;
+    }
+  }
+
+  for (uint8 i = 0; i < MAX_SLAVES; i++)
+  {
+    Serial.print(FLASH("Node "));
+    Serial.print(FIRST_SLAVE + i);
+    if (FWD_NODE_DONE == state[i])
+      Serial.println(FLASH(": updated"));
+    else if (FWD_NODE_ABSENT == state[i])
+      Serial.println(FLASH(": no reply"));
+    else if (FWD_NODE_NOCOMMIT == state[i])
+      Serial.println(FLASH(": no reply to COMMIT (check it)"));
+    else
+      Serial.println(FLASH(": ***incomplete (program it again)"));
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdSerialHEX
+//   Receive a hex file from the PC-based programmer into Flash memory, as
+//   CheckForSerialHEX() would for a single slave, then program all slaves
+//   with it (see fwdDistribute()).
+// Parameters: (none)
+// Returns: (none)
+//-----------------------------------------------------------------------------
+void fwdSerialHEX(void)
+{
+  uint8  data[FWD_HEX_DATA_LEN];
+  uint32 len = 0;
+  uint16 crc = 0xFFFF;
+  uint16 seq;
+  uint16 nextSeq = 0;
+  uint32 lastRx;
+  uint8  inputLen;
+  uint8  i;
+  int16  n;
+
+  if (!flashPresent)
+  {
+    Serial.println(FLASH("FLX?NOK"));
+    return;
+  }
+  flash.blockErase64K(0);
+  Serial.println();
+  Serial.println(FLASH("FLX?OK"));
+
+  for (lastRx = millis(); (millis() - lastRx) < TIMEOUT; )
+  {
+    inputLen = readSerialLine(input, ASCII_NL, FWD_LINE_LEN, 100);
+    if ( (7 == inputLen) && (0 == strncmp(input, "FLX?EOF", 7)) )
+    {
+      if (0 == len)
+        break;                     // No image to send
+      Serial.println(FLASH("FLX?OK"));
+      fwdDistribute((uint16)len, crc);
+      return;
+    }
+    if ( (inputLen < 6) || (0 != strncmp(input, "FLX:", 4)) )
+      continue;
+
+    seq = 0;
+    for (i = 4; (i < inputLen) && (input[i] >= '0') && (input[i] <= '9'); i++)
+      seq = seq * 10 + (input[i] - '0');
+    if ( (i >= inputLen) || (':' != input[i]) )
+      n = -1;
+    else if ( (0 != len) && ((seq + 1) == nextSeq) )
+      n = 0;                       // A repeat; it's already stored
+    else if ( (0 != len) && (seq != nextSeq) )
+      n = -1;
+    else
+    {
+      n = fwdHexRecord(&input[i], inputLen - i, data);
+      if ( (n > 0) && ((len + n) > MAXUINT16) )
+      {
+        Serial.println(FLASH("FLX?NOK"));
+        return;
+      }
+      if (n >= 0)
+      {
+        flash.writeBytes(len, data, n);
+        for (uint8 k = 0; k < n; k++)
+          crc = fwdCrc(crc, data[k]);
+        len += n;
+        nextSeq = seq + 1;
+      }
+    }
+
+    if (n < 0)
+    {
+      Serial.println(FLASH("FLX:INV"));
+      continue;
+    }
+    Serial.print(FLASH("FLX:"));
+    Serial.print(seq);
+    Serial.println(FLASH(":OK"));
+    lastRx = millis();
+  }
+  Serial.println(FLASH("FLX?NOK"));
 }
 
 void loop()
@@ -169,6 +548,8 @@ void loop()
   {
     if (0 == targetID)
       Serial.println("TO?");
+    else if (BROADCASTID == targetID)
+      fwdSerialHEX();
     else
       CheckForSerialHEX( (byte*)input, inputLen, radio, targetID,
                           TIMEOUT, ACK_TIME, DEBUG_MODE );
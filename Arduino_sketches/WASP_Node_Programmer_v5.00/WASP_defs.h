@@ -0,0 +1,683 @@
+/* WASP_defs.h */
+#ifndef Wasp_defs_h
+#define Wasp_defs_h
+
+// Ruler
+//345678901234567890123456789012345678901234567890123456789012345678901234567890
+
+
+/*************************************************************************
+ * Definitions for Wireless Addressable Strings of Pixels network (WASP)
+ *************************************************************************/
+
+#define NODEID_UNDEF     0 // Undefined RFM node ID.
+#define CONTROLLERID     1 // Designated RFM node ID of controller
+#define BROADCASTID    255 // Designated RFM node ID for broadcasts
+#define PROG_GW_ID     254 // Wireless programmer gateway node ID
+#define NETWORKID       77 // The same for all nodes on the network
+
+#define FIRST_SLAVE      2 // Node ID of first slave node
+#define MAX_SLAVES       5 // Max # of WASP slave nodes.
+#define FIRST_GROUP    128 // Node ID of first group of slave nodes.
+#define MAX_GROUPS       5 // Max # of WASP slave groups.
+#define NODEID_MAX     (MAX_SLAVES + CONTROLLERID)
+
+// Match frequency to the Moteino's radio hardware
+#define FREQUENCY      RF69_433MHZ
+
+//#define IS_RFM69HW     // uncomment only for RFM69HW transceivers.
+// NOTE: Encryption isn't currently being used.
+#define ENCRYPTKEY     "JVS_WASP_Key3456" // exactly 16 chars: same on all nodes
+#define ACK_WAIT_TIME  10  // max # of ms to wait for an ack
+#define TX_NUM_RETRIES 2   // number of TX transmission attempts when ACK needed
+
+// Time windows for slave Tx (milliseconds)
+#define SLAVE_TX_WIND    15  // Time windows for slave-to-slave Tx (milliseconds)
+#define CMD_TIMEOUT     (MAX_SLAVES * SLAVE_TX_WIND)
+#define SLAVE_PING_TX   100  // Slave Tx window for WASPCMD_PING (milliseconds)
+#define PING_TIMEOUT    (MAX_SLAVES * SLAVE_PING_TX)
+#define MIN_UPD_PERIOD   20  // Min # milliseconds between WASP commands.
+#define SHIFT_FRAME_BYTES 58 // Max # colour bytes per SHIFT report frame
+#define MAX_SHIFT_FRAMES  3  // Max # report frames per SHIFT command
+#define MAX_SHIFT_BYTES  (MAX_SHIFT_FRAMES * SHIFT_FRAME_BYTES)
+#define MAX_SHIFT_SIZE   58  // Max # pixels to shift for WASPCMD_SHIFT command.
+#define MAX_IDX_SHIFT_SIZE 127 // Max # pixels to shift in indexed colour mode
+#define SHIFT_FRAMES(b) ((b) <= SHIFT_FRAME_BYTES ? 1 : \
+                         ((b) + SHIFT_FRAME_BYTES - 1) / SHIFT_FRAME_BYTES)
+#define MIN_SLOT_WIND    10  // Min compacted SHIFT slot window (milliseconds)
+#define MAX_SLOT_WIND   (4 * SLAVE_TX_WIND) // Max compacted SHIFT slot window
+#define SLOT_GUARD_MS     3  // Margin added to measured SHIFT Tx times
+
+
+// WASP Command Codes
+//=======================
+// Note: Unless stated otherwise, the dst parameter for each command
+//       can be the BROADCAST address, a Group address, or a specific
+//       node address. The dst parameter is implcitly transmitted in
+//       the radio packet header and is not encoded in the message
+//       payload. The radio packet payload is in the following format:
+//           +-------+----------+-----+----------+
+//           | <cmd> | <arg #1> | ... | <arg #n> |
+//           +-------+----------+-----+----------+
+//       where <cmd> is one of the WASPCMD_... values below.
+
+/*     =========================  Base Commands  ========================     */
+#define WASPCMD_NONE      0  // No WASP command received.
+
+#define WASPCMD_GROUP     1  // GROUP(dst:8, groupId:8, l:8, r:8)
+                             //       ^^^               ^    ^
+                             //   Registers specific WASP slave #dst to
+                             //   group #groupId with specific neigbhours
+                             //   node #l to its left and node #r to its right.
+                             //   Node dst is its own neighbour if l = r = dst;
+                             //   otherwise l != dst and r != dst. Neighbours
+                             //   must form a connected loop of size >= 1. The
+                             //   groupId value must be in the range
+                             //   FIRST_GROUP .. (FIRST_GROUP + MAX_GROUPS - 1).
+                             //   The groupId value can be used in subsequent
+                             //   commands as a dst value.
+
+#define WASPCMD_STATE     2  // STATE(dst:8, opts:8) - State operations. The
+                             // opts arg is a bit field with the following
+                             // definitions:
+                             //     Bxxxxxx01, Save pixel colours
+                             //     Bxxxxxx10, Restore pixel colours
+                             //     Bxxxx10xx, Suspend drawing after subsequent
+                             //                  commands.
+                             //     Bxxxx01xx, Resume drawing on subsequent
+                             //                  commands.
+                             //     Note: When restore flag is set, the restore
+                             //           happens before the suspend/resume
+                             //           action.
+                             //   Invalid combinations:
+                             //     Bxxxx11xx
+                             //     Bxxxxxx11
+                             
+#define WASPCMD_BKGRD     3  // BKGRD(dst:8, r:8, g:8, b:8) - Set (and save)
+                             //   the background colour of all pixels.
+                             
+#define WASPCMD_LINE      4  // LINE(dst:8, r:8, g:8, b:8, s:8, l:8)
+                             //  Draw a line starting at pixel #s of length
+                             //  l pixels.
+                             
+#define WASPCMD_SHIFT     5  // SHIFT(dst:8, n:8 [, w:8, [nodeId:8]k])
+                             //   from controller, where n is a signed int.
+                             //   Shift the pixels by |n| positions.
+                             //   If n > 0, shift right; else shift left. Each
+                             //   node, in turn, reports the colours of
+                             //   the pixels that it shifted out (in the order
+                             //   they were shifted out) to its neighbouring
+                             //   node so that it can shift them in.
+                             //
+                             // SHIFT(dst:8, n:8, seq:8, [r:8, g:8, b:8]...)
+                             //       ^^^
+                             //   where n is a positive integer specifying the
+                             //   number of pixels shifted, and dst must be a
+                             //   specific node Id. This is each node's
+                             //   response (when needed) to the controller's
+                             //   SHIFT command. The colours are from leftmost
+                             //   (first) to rightmost (last) of the pixels
+                             //   that were shifted out.
+                             //   Notes:
+                             //     1) n must be <= MAX_SHIFT_SIZE, or
+                             //        <= MAX_IDX_SHIFT_SIZE / 3 (42) if a
+                             //        regular Moteino slave takes part
+                             //        (it has less RAM). The 3 * n
+                             //        colour bytes are split over
+                             //        SHIFT_FRAMES(3 * n) frames sent
+                             //        back-to-back; frame seq carries bytes
+                             //        [seq * SHIFT_FRAME_BYTES, ...) of up to
+                             //        SHIFT_FRAME_BYTES each.
+                             //     2) MAX_DATA_LEN (= 61) is defined in the
+                             //        RFM69 library. Each TDMA slot (note 3
+                             //        and 5) is stretched by the number of
+                             //        frames.
+                             //     3) Each node, n, broadcasts its response
+                             //        the following # milliseconds after
+                             //        the command is sent:
+                             //           (n - 1) * INTERNODE_DLY
+                             //     4) Each WASP node must defer updating its
+                             //        pixels until it has both shifted in its
+                             //        neighbor's pixels and reported the pixels
+                             //        that it has shifted out.
+                             //     5) When dst is a group, the controller
+                             //        appends the group's TDMA schedule: a
+                             //        window of w milliseconds per slot and
+                             //        the k member node Ids in slot order.
+                             //        Members then respond in consecutive
+                             //        w ms slots and the command completes
+                             //        after k * w ms. Otherwise (or if a
+                             //        member isn't listed), slot (n - 2) of
+                             //        SLAVE_TX_WIND ms is used, as in note 3.
+                             //     6) In indexed colour mode (see
+                             //        WASPCMD_PALETTE), the response carries
+                             //        a palette index:8 per pixel instead of
+                             //        (r,g,b), so n can be up to
+                             //        MAX_IDX_SHIFT_SIZE (and the number
+                             //        of frames is SHIFT_FRAMES(n)).
+                             
+#define WASPCMD_SWAP      6  // SWAP( dst:8, r_old:8, g_old:8, b_old:8,
+                             //       r:8, g:8, b:8 )
+                             //   Swap all pixels having the old colour with
+                             //   the new colour (r,g,b).
+
+#define WASPCMD_RESET     7  // RESET(dst:8, "DEAD") - Request the dst node(s)
+                             //   to reset themselves.
+
+#define WASPCMD_SPEED     8  // SPEED(dst:8, delay:8) - Adjust the speed
+                             //   of an animated effect that is currently
+                             //   running without controller intervention
+                             //   (e.g. RAINBOW()). Generally, smaller delay
+                             //   values increase the effect's speed. The
+                             //   following dleay values are distinguished:
+                             //     0 = Pause the current special F/X.
+                             //     1 = Single-step the current special F/X;
+                             //           F/X progress is, thus, under control
+                             //           of the WASP controller.
+
+/*     ========================  Special Effects  =======================     */
+#define WASPCMD_RAINBOW   9  // RAINBOW(dst:8, offs:8) - Run a rainbow effect
+                             //   with a starting colour offset (offs) for
+                             //   LED #0 on the (each) destination. The offset
+                             //   is equivalent to a number of LEDs. Each
+                             //   subsequent pixel picks up the next colour
+                             //   in a 256 colour wheel (the wheel cycling
+                             //   thru red to green to blue, back to red.
+
+#define WASPCMD_RAINCYCLE 10 // RAINCYCLE(dst:8) - Run a rainbow effect with
+                             //   the rainbow colours always spanning the
+                             //   number of pixels at the (each) dst node.
+                             //   The effect is similar to RAINBOW() but tends
+                             //   to have the colours more compressed.
+
+#define WASPCMD_TWINKLE   11 // TWINKLE(dst:8, minDly:8, maxDly:8,
+                             //          burst:8, hold:8)
+                             //   Run a twinkling effect on the currently
+                             //   defined background colour. The dst value
+                             //   can be any single node, group, or the
+                             //   BROADCASTID. The minDly and maxDly values
+                             //   define the relative time range between
+                             //   random twinkles. The burst value defines the
+                             //   upper bound on the number of pixels that can
+                             //   twinkle simultaneously on each individual
+                             //   node. The hold value determine how long
+                             //   each twinkle lasts.
+                             //   NOTE: Send a WASPCMD_BKGRD first to set the
+                             //         background colour.
+
+/*     ====================  Configuration Commands  ====================     */
+#define WASPCMD_PING      12 // PING(dst:8)
+                             //   Query the presence of a specific node or all
+                             //   nodes on the network. Each node will reply
+                             //   in turn with its response delay dictated by
+                             //   its node ID. Each node replies with the
+                             //   sequence of unsigned 8-bit values:
+                             //     - Firmware version number
+                             //     - Major software version number
+                             //     - Minor software version number
+                             //     - Digital output pin # used for LED control
+                             //     - Number of pixels in the pixel string
+                             //     - Pixel string frequency
+                             //     - RGB wiring order for pixels
+                             //     (For the latter three items, refer to
+                             //     WASPCMD_CFG_LED.)
+                             //     - Seconds since the node restarted
+                             //       (32-bit, least significant byte first;
+                             //       wraps with millis(), ~49.7 days)
+                             //   Node #2 is the first to transmit. Each slave
+                             //   node, n, transmits at ((n - 2) * SLAVE_TX_WIND)
+                             //   milliseconds following receipt of the command.
+
+#define WASPCMD_CFG_NODE  13 // CFG_NODE(dst:8, magic[4], newNodeId:8)
+                             //   Modify a known node's (dst) node ID to new
+                             //   value, newNodeId. The destination node will
+                             //   have to be power cycled for the change to
+                             //   take affect. The value of array magic[] must
+                             //   be confirmed to be "WASP"; this is intended
+                             //   to minimize accidental corruption of a node's
+                             //   configuration.
+                             //   RECOMMENDATION: Ping the node afterward to
+                             //                   confirm the change.
+
+#define WASPCMD_CFG_CTRL  14 // CFG_CTRL(dst:8, magic[4], pinNumber:8)
+                             //   Modify the digital output pin used for
+                             //   controlling the LED pixel string on a specific
+                             //   node. The value of array magic[] must
+                             //   be confirmed to be "WASP"; this is intended
+                             //   to minimize accidental corruption of a node's
+                             //   configuration.
+                             //   NOTE: Following this command, the CFG_SAVE
+                             //         command should be sent by the controller
+                             //         and then the slave should be reset.
+
+#define WASPCMD_CFG_LED   15 // CFG_LED(dst:8, magic[4], len:8, freq:8, order:8)
+                             //   Modify pixel string parameters on a specific
+                             //   node:
+                             //     len:   n in [1 - 255], the number of pixels
+                             //              in the string. For a regular Moteino
+                             //              slave, n should < 100 due to RAM
+                             //              size constraints. (Default value
+                             //              is 3.)
+                             //     freq:  8 = 800 kHz update frequency (default)
+                             //            4 = 400 kHz
+                             //     order: The RGB colour wirting order.
+                             //            0 = RGB (default)
+                             //            1 = RBG
+                             //            2 = GRB
+                             //            3 = GBR
+                             //            4 = BRG
+                             //            5 = BGR
+                             //   The value of array magic[] must be confirmed
+                             //   to be "WASP"; this is intended to minimize
+                             //   accidental corruption of a node's
+                             //   configuration.
+                             //   NOTE: Following this command, the CFG_SAVE
+                             //         command should be sent by the controller
+                             //         and then the slave should be reset.
+
+#define WASPCMD_CFG_SAVE  16 // CFG_SAVE(dst:8)
+                             //   Save the configuration for a specific slave
+                             //   node, or all slaves, to its (their) EEPROM(s)
+                             //   so that the changes are permanent. (This
+                             //   command saves the LED control pin and pixel
+                             //   string parameters.)
+
+/*     =======================  Transport Commands  =====================     */
+#define WASPCMD_BATCH     17 // BATCH(dst:8, n:8, [cmd:8, args...]n)
+                             //   Carry n WASP commands in a single radio
+                             //   packet, each one encoded as it would be in
+                             //   a packet of its own. The commands are
+                             //   executed in order, as though they had been
+                             //   received separately, and all of them apply
+                             //   to the packet's dst. Only commands that
+                             //   complete immediately can be batched (see
+                             //   WASP_BATCHABLE()).
+
+#define WASPCMD_PIXELS    18 // PIXELS(dst:8, seq:8, opts:8, s:8, [rec]...)
+                             //   Upload a region of pixel colours, starting
+                             //   at pixel #s, as a sequence of run-length
+                             //   records packed up to the end of the packet:
+                             //     n:8, r:8, g:8, b:8 (n = 1..127)
+                             //       Set the next n pixels to (r,g,b).
+                             //     (0x80 | n):8 (n = 1..127)
+                             //       Skip the next n pixels, leaving them
+                             //       unchanged (delta against the previously
+                             //       uploaded frame).
+                             //   An upload that needs more than one packet
+                             //   is sent as packets numbered seq = 0, 1, ...
+                             //   each carrying its own starting pixel s. The
+                             //   first packet's opts has F_SUSPEND set and
+                             //   the last packet's opts has F_RESUME set (as
+                             //   for WASPCMD_STATE) so that the whole region
+                             //   is shown at once; opts is 0 for a single
+                             //   packet upload. A gap in seq indicates a lost
+                             //   packet.
+
+/*     ======================  Diagnostic Commands  =====================     */
+#define WASPCMD_TMR_STATS 19 // TMR_STATS(dst:8, tmrId:8, opts:8)
+                             //   Query the execution timing statistics that
+                             //   a node keeps for its timer #tmrId. If bit 0
+                             //   of opts (TMR_STATS_RESET) is set, the
+                             //   node's statistics for that timer are reset
+                             //   once they have been reported. Each node
+                             //   replies in turn, as for WASPCMD_PING, with:
+                             //     TMR_STATS(CONTROLLERID, tmrId:8,
+                             //               count:16, min:32, max:32,
+                             //               sum:32, [hist:8]TMR_HIST_BUCKETS)
+                             //   where times are in microseconds, multi-byte
+                             //   values are sent least significant byte
+                             //   first, and hist[k] counts the samples of
+                             //   (2^(k+4))..(2^(k+5) - 1) usec; hist[0] also
+                             //   counts shorter samples and the last bucket
+                             //   also counts longer ones. The sum and counts
+                             //   are halved as needed to avoid overflow, so
+                             //   they keep their proportions (and the mean).
+                             //   A slave built without TMR_STATS_ON (the
+                             //   Moteino's default) keeps only the maximum,
+                             //   and reports 0 for the other fields.
+
+#define WASPCMD_TELEMETRY 20 // TELEMETRY(dst:8)
+                             //   Query the health of a node, group, or all
+                             //   nodes. Each node replies in turn, as for
+                             //   WASPCMD_PING, with:
+                             //     TELEMETRY(CONTROLLERID, rssi:16,
+                             //               freeRam:16, txLate:16,
+                             //               [omet:16]TELEM_NUM_TIMERS)
+                             //   where rssi is the (signed) RSSI of the last
+                             //   packet received from the controller,
+                             //   freeRam is the # of free RAM bytes, txLate
+                             //   is the # of late transmissions, and omet[]
+                             //   holds the Observed Maximum Execution Times
+                             //   (usec) of timers #1, #2, ... Values are sent
+                             //   least significant byte first; unsigned
+                             //   values saturate at 0xFFFF. Unlike PING, the
+                             //   query doesn't hold up other commands on the
+                             //   node while it waits to reply.
+
+/*     ======================  Scripting Commands  ======================     */
+#define WASPCMD_SCRIPT    21 // SCRIPT(dst:8, slot:8, offs:8, opts:8, [c:8]...)
+                             //   Upload bytes c... of a bytecode effect script
+                             //   (see SOP_... below) to script slot #slot of
+                             //   the node's SPI flash, starting at byte #offs
+                             //   of the script. A script is uploaded in
+                             //   order, in one or more packets; the first
+                             //   (offs = 0) erases the slot, and the last
+                             //   has bit 0 of opts (SCRIPT_F_LAST) set to
+                             //   commit the script. A node needs up to
+                             //   SCRIPT_ERASE_MS milliseconds after the first
+                             //   packet before it can receive the next one.
+
+#define WASPCMD_SCRIPT_RUN 22 // SCRIPT_RUN(dst:8, slot:8)
+                             //   Run the script in slot #slot as a special
+                             //   effect: the whole script runs once per
+                             //   effect iteration (paced by WASPCMD_SPEED).
+                             //   Script time (SOP_TIME) counts from receipt
+                             //   of this command, so the nodes started by a
+                             //   single broadcast or group command stay in
+                             //   step with each other.
+
+/*     ========================  Timing Commands  =======================     */
+#define WASPCMD_SYNC      23 // SYNC(dst:8, frame:16, phase:8, time:32,
+                             //      [stream:8, seq:8]n)
+                             //   Time-sync beacon, broadcast periodically by
+                             //   the controller: time is the controller's
+                             //   clock (milliseconds) when the beacon was
+                             //   sent, which is phase milliseconds into
+                             //   network frame #frame (of SYNC_FRAME_MS
+                             //   each). Slaves discipline their own network
+                             //   clock to it, and pace their special effects
+                             //   by it so that adjacent strings stay in step.
+                             //   Values are sent least significant byte
+                             //   first. Each (stream, seq) pair gives the
+                             //   seq of the last MCAST command sent on a
+                             //   multicast stream (0 = BROADCASTID, i =
+                             //   group FIRST_GROUP + i - 1), so that a slave
+                             //   that missed it can NACK it (see
+                             //   WASPCMD_MCAST).
+
+#define WASPCMD_AT        24 // AT(dst:8, frame:16, n:8, [cmd:8, args...]n)
+                             //   Carry n WASP commands, as for WASPCMD_BATCH,
+                             //   to be executed at the start of network
+                             //   frame #frame (see WASPCMD_SYNC) rather than
+                             //   on receipt. Each slave queues up to
+                             //   SCHED_QUEUE_LEN of these, and executes all
+                             //   the ones that are due together, before its
+                             //   strip is next updated, so that a scene sent
+                             //   ahead of time to several nodes appears on
+                             //   all of them at once. Commands for a frame
+                             //   that has passed, or received before the
+                             //   node's clock is synchronized, are executed
+                             //   right away, as are those that don't fit in
+                             //   the queue (which holds fewer on a Moteino
+                             //   than on a Moteino Mega).
+
+/*     =======================  Colour Mode Commands  ===================     */
+#define WASPCMD_PALETTE   25 // PALETTE(dst:8, first:8, n:8, [r:8,g:8,b:8]n)
+                             //   Set palette entries #first .. #first+n-1 (of
+                             //   PAL_LEN) and switch to indexed colour mode,
+                             //   or back to direct colour mode if n = 0. In
+                             //   indexed mode, each pixel is kept as a
+                             //   palette index: drawn colours map to the
+                             //   nearest palette entry, SWAP rewrites
+                             //   palette entries, SHIFT reports carry
+                             //   indices (see note 6), and changing an entry
+                             //   recolours every pixel that uses it.
+                             //   Starting a special effect or a fade
+                             //   returns to direct colour mode. Switching
+                             //   modes saves the current pixels (see
+                             //   WASPCMD_STATE).
+
+/*     ========================  Fade Effects  ==========================     */
+#define WASPCMD_FADE      26 // FADE(dst:8, r:8, g:8, b:8, time:8)
+                             //   Crossfade every pixel from its current
+                             //   colour to (r,g,b) over time 100's of
+                             //   milliseconds (0 = at once). The frames are
+                             //   interpolated locally, in network time, so
+                             //   the fade ends at the same moment on every
+                             //   destination. If animated effects aren't
+                             //   running (see WASPCMD_SPEED), they're
+                             //   started with a frame every FADE_FRAME_MS.
+                             //   The effect ends with the fade.
+
+#define WASPCMD_GRADIENT  27 // GRADIENT(dst:8, r:8, g:8, b:8,
+                             //          r':8, g':8, b':8, time:8)
+                             //   Crossfade, as for WASPCMD_FADE, to a
+                             //   linear gradient from (r,g,b) at the first
+                             //   pixel to (r',g',b') at the last one.
+
+/*     ========================  Output Stage  ==========================     */
+#define WASPCMD_BRIGHT    28 // BRIGHT(dst:8, level:8, gamma:8, time:8)
+                             //   Set the output brightness (255 = full) and
+                             //   gamma correction (0 = off) applied to the
+                             //   pixel colours as they're shown. The pixel
+                             //   colours themselves are unchanged, so this
+                             //   dims (or brightens) whatever is drawn,
+                             //   including running effects. The brightness
+                             //   is faded to the new level over time 100's
+                             //   of milliseconds (0 = at once), in network
+                             //   time.
+
+/*     ======================  Reliable Multicast  ======================     */
+#define WASPCMD_MCAST     29 // MCAST(dst:8, flags:8, seq:8, <command>)
+                             //   A command (see WASP_MCASTABLE()) sent to a
+                             //   group or BROADCASTID in sequence. seq
+                             //   counts the MCAST commands sent to dst
+                             //   (mod 256). Each slave executes <command>
+                             //   only in seq order. On a gap, it discards
+                             //   it and reports the gap with a NACK in its
+                             //   TDMA slot (see WASPCMD_NACK); the
+                             //   controller then resends the missing
+                             //   commands with their original seq. Lost
+                             //   final commands show up in the next
+                             //   WASPCMD_SYNC beacons. The flags are:
+                             //     MCAST_F_RESYNC, this is the first MCAST
+                             //       to dst since the controller started;
+                             //       the sequence restarts at seq.
+
+#define WASPCMD_NACK      30 // NACK(CONTROLLERID, dst:8, first:8, last:8,
+                             //      [WASPCMD_PIXELS])
+                             //   ^^^^^^^^^^^^
+                             //   A slave's report that it has missed the
+                             //   MCAST commands to dst (a group or
+                             //   BROADCASTID) numbered first .. last. It's
+                             //   sent (m_myNodeId - CONTROLLERID) *
+                             //   SLAVE_TX_WIND milliseconds after the MCAST
+                             //   command that revealed the gap.
+                             //   With the trailing WASPCMD_PIXELS, it
+                             //   reports instead that packets first .. last
+                             //   of the pixel upload to dst were lost (last
+                             //   = 255 if the upload's end was lost); the
+                             //   controller then resends the whole region.
+
+#define MAX_WASPCMD_VAL   (WASPCMD_NACK) // Max valid WASP command value.
+#define LAST_NONCFG_CMD   (WASPCMD_TWINKLE)
+
+// WASP commands that may be carried by a WASPCMD_BATCH command. (SHIFT and
+// RESET don't complete immediately, and the remaining commands are either
+// configuration commands or require a response.)
+#define WASP_BATCHABLE(cmd)  ( ((cmd) == WASPCMD_GROUP)     || \
+                               ((cmd) == WASPCMD_STATE)     || \
+                               ((cmd) == WASPCMD_BKGRD)     || \
+                               ((cmd) == WASPCMD_LINE)      || \
+                               ((cmd) == WASPCMD_SWAP)      || \
+                               ((cmd) == WASPCMD_SPEED)     || \
+                               ((cmd) == WASPCMD_RAINBOW)   || \
+                               ((cmd) == WASPCMD_RAINCYCLE) || \
+                               ((cmd) == WASPCMD_TWINKLE)   || \
+                               ((cmd) == WASPCMD_SCRIPT_RUN) || \
+                               ((cmd) == WASPCMD_PALETTE)   || \
+                               ((cmd) == WASPCMD_FADE)      || \
+                               ((cmd) == WASPCMD_GRADIENT)  || \
+                               ((cmd) == WASPCMD_BRIGHT) )
+
+// WASP commands that may be carried by a WASPCMD_MCAST command: those that
+// need no response.
+#define WASP_MCASTABLE(cmd)  ( WASP_BATCHABLE(cmd)         || \
+                               ((cmd) == WASPCMD_BATCH)     || \
+                               ((cmd) == WASPCMD_AT) )
+
+
+// ACK codes
+#define ACK_OK        0    // No error.
+#define ACK_ECMD      1    // Command unsupported.
+#define ACK_ETIME     2    // Timed out waiting for ACK.
+#define ACK_ERR       254  // Unspecified error.
+#define ACK_NULL      255  // 'undefined' ACK value
+
+
+// WASP node state operation flags:
+#define F_SAVE         B00000001
+#define F_RESTORE      B00000010
+#define F_SUSPEND      B00001000
+#define F_RESUME       B00000100
+
+// WASPCMD_TMR_STATS definitions:
+#define TMR_HIST_BUCKETS  10        // # of log2 histogram buckets per timer
+#define TMR_STATS_RESET   B00000001 // opts: reset statistics after reporting
+
+// WASPCMD_TELEMETRY definitions:
+#define TELEM_NUM_TIMERS  15        // # of timers reported (#1 thru #15)
+#define TELEM_SHFT_TX1    8         // omet[] index of SHIFT Tx end timer
+
+// WASPCMD_PIXELS record definitions:
+#define PIXELS_HDR_LEN   4          // Payload bytes before first record
+#define PIXELS_SKIP      0x80       // Record flag: skip unchanged pixels
+#define PIXELS_MAX_RUN   0x7F       // Max run length of a single record
+
+// WASPCMD_SYNC definitions:
+#define SYNC_FRAME_MS     20        // Network frame period (milliseconds)
+#define SYNC_TX_LATENCY   2         // Beacon send-to-receipt time (ms)
+#define SYNC_STEP_MS      50        // Larger clock errors are stepped, not
+                                    //   slewed
+#define SYNC_DFLT_PERIOD  10        // Default beacon period (100's of ms)
+
+// WASPCMD_PALETTE definitions:
+#define PAL_LEN           16        // # of palette entries (4-bit indices)
+
+// WASPCMD_FADE definitions:
+#define FADE_FRAME_MS     16        // Default fade frame period (~60 fps)
+
+// WASPCMD_BRIGHT definitions:
+#define BRIGHT_FULL       255       // Full output brightness
+
+// WASPCMD_MCAST definitions:
+#define MCAST_HDR_LEN     3         // MCAST, flags and seq bytes
+#define MCAST_F_RESYNC    0x01      // Restart the sequence (see WASPCMD_MCAST)
+#define MCAST_HIST_LEN    8         // # of recent MCAST commands that the
+                                    //   controller can resend
+#define MCAST_NACK_TRIES  3         // # of NACKs sent for a gap before a slave
+                                    //   skips it
+
+// WASPCMD_AT definitions:
+#define SCHED_QUEUE_LEN   4         // # of AT commands a slave can queue
+#define SCHED_MAX_LEN     28        // Max size of an AT command's n and cmds
+
+// WASPCMD_SCRIPT definitions:
+#define SCRIPT_NUM_SLOTS  4         // # of script slots per node
+#define SCRIPT_MAX_LEN    128       // Max script length (bytes)
+#define SCRIPT_CHUNK_LEN  48        // Max script bytes per SCRIPT packet
+#define SCRIPT_F_LAST     B00000001 // opts: last packet of the script
+#define SCRIPT_ERASE_MS   100       // Time to erase a slot on the first packet
+#define SCRIPT_TICK_MS    10        // Units of SOP_TIME (milliseconds)
+
+// Script bytecode. Every instruction is 4 bytes: op:8, x:8, y:8, z:8. Rx and
+// Ry are registers #x and #y (of SCRIPT_NUM_REGS signed 16-bit registers,
+// cleared when the script starts), imm is the 16-bit value (z << 8) | y,
+// and t is the index of the target instruction (0 = first).
+#define SOP_END       0   // End of the iteration.
+#define SOP_LDI       1   // Rx = imm
+#define SOP_TIME      2   // Rx = # of SCRIPT_TICK_MS since the script started
+#define SOP_LEN       3   // Rx = # of pixels in the strip
+#define SOP_MOV       4   // Rx = Ry
+#define SOP_ADD       5   // Rx = Rx + Ry
+#define SOP_SUB       6   // Rx = Rx - Ry
+#define SOP_MUL       7   // Rx = Rx * Ry
+#define SOP_DIV       8   // Rx = Rx / Ry  (0 if Ry = 0)
+#define SOP_MOD       9   // Rx = Rx % Ry  (0 if Ry = 0)
+#define SOP_ADDI     10   // Rx = Rx + imm
+#define SOP_JMP      11   // Go to instruction #z
+#define SOP_JLT      12   // If Rx < Ry, go to instruction #z
+#define SOP_JNZ      13   // If Rx != 0, go to instruction #z
+#define SOP_COLOR    14   // Pen colour = (x, y, z)
+#define SOP_WHEEL    15   // Pen colour = colour wheel slot (Rx modulo 256)
+#define SOP_PIX      16   // Set pixel #Rx to the pen colour
+#define SOP_FILL     17   // Set pixels #Rx thru #(Rx + Ry - 1) to pen colour
+#define SCRIPT_INSTR_LEN  4         // Bytes per instruction
+#define SCRIPT_NUM_REGS   8         // # of script registers
+#define SCRIPT_MAX_STEPS  4000      // Max instructions run per iteration
+
+
+// Broadcast Firmware Distribution
+//=================================
+// Packets from the programming gateway (PROG_GW_ID) that push a new sketch
+// image into the add-on Flash memory of all slaves at once (see the
+// WASP_Node_Programmer sketch). The image is sent in blocks of
+// FWD_BLOCK_LEN bytes. Each slave records the blocks it has in a bitmap in
+// Flash, so that a transfer interrupted by a dropout or a restart resumes
+// with the missing blocks only. 16-bit values are sent least significant
+// byte first.
+#define FWD_OFFER      0xF0 // OFFER(BROADCASTID|dst, id:8, len:16, crc:16)
+                            //   Announce image id: len bytes, with CRC-16/
+                            //   CCITT crc. A slave that isn't already
+                            //   receiving this image erases its image area
+                            //   and block bitmap (see FWD_ERASE_MS).
+#define FWD_BLOCK      0xF1 // BLOCK(BROADCASTID|dst, id:8, blk:16, data)
+                            //   Block #blk of the image. Only the last block
+                            //   may be shorter than FWD_BLOCK_LEN.
+#define FWD_QUERY      0xF2 // QUERY(dst, id:8)
+                            //   Ask a slave which blocks of the image it is
+                            //   missing.
+#define FWD_STATUS     0xF3 // STATUS(PROG_GW_ID, id:8, missing:16, blk:16...)
+                            //   ^^^^^^^^^^
+                            //   A slave's reply to QUERY or COMMIT: the # of
+                            //   blocks it's missing, and the numbers of the
+                            //   first (up to FWD_MAX_LIST) of them. missing
+                            //   is instead one of:
+                            //     FWD_NO_IMAGE, not receiving image id
+                            //     FWD_BAD_CRC,  the image failed its CRC
+                            //       check; all of it must be resent
+                            //   missing is 0 in reply to COMMIT only if the
+                            //   slave is about to restart with the image.
+#define FWD_COMMIT     0xF4 // COMMIT(dst, id:8)
+                            //   Check the image's CRC and, if it's good, mark
+                            //   it for the bootloader and restart.
+
+// Firmware distribution definitions:
+#define FWD_HDR_LEN       4         // BLOCK code, id and blk bytes
+#define FWD_BLOCK_LEN     56        // Image bytes per block
+#define FWD_MAX_LIST      28        // Max missing blocks listed per STATUS
+#define FWD_NO_IMAGE      0xFFFF    // STATUS: Not receiving the image
+#define FWD_BAD_CRC       0xFFFE    // STATUS: Image failed its CRC check
+#define FWD_ERASE_MS      4000      // Time for a slave to erase on OFFER
+#define FWD_REPLY_MS      100       // Time for a slave to reply with STATUS
+
+
+#ifndef int8
+  typedef signed char   int8;
+#endif
+#ifndef int16
+  typedef int           int16;
+#endif
+#ifndef int32
+  typedef long          int32;
+#endif
+#ifndef uint8
+  typedef unsigned char uint8;
+#endif
+#ifndef uint16
+  typedef unsigned int  uint16;
+#endif
+#ifndef uint32
+  typedef unsigned long uint32;
+#endif
+#ifndef MAXUINT16
+  #define MAXUINT16     0xFFFF
+#endif
+#ifndef MAXUINT32
+  #define MAXUINT32     0xFFFFFFFF
+#endif
+
+typedef uint8 AckCode_t;  /* ACK codes (e.g. ACK_OK)           */
+typedef uint8 WaspCmd_t;  /* WASP commands (e.g. WASPCMD_NONE) */
+
+#endif  /* Wasp_defs_h */
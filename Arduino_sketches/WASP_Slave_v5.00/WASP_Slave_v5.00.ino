@@ -11,9 +11,12 @@
  * and Moteino Mega boards.
  * 
  * NOTES:
- *  - Regular Moteino nodes support only up to about 100 LED pixels; this is
- *    constrained by the limited onboard 2 KiB of RAM. A Moteino Mega (with
- *    its 16 KiB of RAM) can support more nodes.
+ *  - Regular Moteino nodes support only up to about 145 LED pixels, or
+ *    about 75 with brightness control; this is constrained by the limited
+ *    onboard 2 KiB of RAM (see RAM_RESERVE). (The strip length is limited
+ *    at startup to what fits in the free RAM, and longer strips save their
+ *    pixels as a palette-compressed snapshot; see pixelPoolInit()). A
+ *    Moteino Mega (with its 16 KiB of RAM) can support more pixels.
  *  - When using multiple pixel strings, power each string separately. Each
  *    string causes a significant voltage drop that can't be tolerated by
  *    the next string. The usual three wires (ground, +ve, data) can be fed
@@ -28,6 +31,13 @@
  *  - External add-on Flash memory chips use up the following Moteino pins:
  *       Regular Moteino:  D8  (chip select), D11 - D13
  *       Moteino Mega:     D23 (chip select), D5  - D7
+ *  - Builds can be specialised for one colour wiring order (FIXED_WIRING)
+ *    and a shorter strip length bound (STRIP_MAX_LEN). The pixel byte
+ *    offsets then become constants, and the static pixel buffers shrink,
+ *    leaving more RAM for the strip. Script build_variants.sh (next to
+ *    this sketch) builds the standard variants with arduino-cli, passing
+ *    the options as -D flags, and names each .hex file after its board
+ *    and options, e.g. WASP_Slave_v5.00.ino.MoteinoMEGA.GRB.hex.
  * History
  * =======
  * Version  Date     Author         Description
@@ -85,11 +95,24 @@
                            //   clears EEPROM.
 
 #define CONSOLE_ENABLED     // Uncomment to enable the console
+//#define SPLIT_STRIP_PIN 14  // Uncomment to drive the second half of the
+                              //   strip from this pin (see splitStripInit())
+//#define FIXED_WIRING WIRING_GRB // Uncomment to build for this colour wiring
+                                  //   order only (see WIRING_OFFS()), or
+                                  //   see build_variants.sh
+//#define STRIP_MAX_LEN 150   // Uncomment to build for strips of at most this
+                              //   many pixels
 #ifdef CONSOLE_ENABLED
   //#define DEBUG_ON            // Uncomment to turn off debug output to serial port.
   #define LOGGING_ON          // Uncomment to turn off logging to serial port.
   #define SERIAL_CMDS_ENABLED // Enables command line at serial port
 #endif
+// Keep each timer's minimum, mean and histogram besides its maximum (see
+// WASPCMD_TMR_STATS). These take 320 bytes of RAM, which a Moteino can't
+// spare in normal use.
+#if defined(__AVR_ATmega1284P__) || defined(DEBUG_ON)
+  #define TMR_STATS_ON
+#endif
 
 // I/O pin definitions
 #define NEO_PIN          3 // Default digital pin for LED strip control
@@ -115,6 +138,13 @@
 #define WIRING_BGR    5
 #define WIRING_MAX_VAL (WIRING_BGR)
 
+// Byte offset of a colour within a pixel, for each wiring order. The offsets
+// are packed 4 bits per wiring order, WIRING_RGB in the low bits.
+#define WIRING_RED_OFFS    0x212100UL
+#define WIRING_GREEN_OFFS  0x120021UL
+#define WIRING_BLUE_OFFS   0x001212UL
+#define WIRING_OFFS(wiring, colour)  (((colour) >> (4 * (wiring))) & 0x0F)
+
 // Define the Moteino pin used for Flash memory chip select.
 #ifdef __AVR_ATmega1284P__
   #define FLASH_SS      23   // FLASH SS on D23
@@ -125,7 +155,69 @@
 #else
   #define FLASH_SS       8   // FLASH SS on D8
   #define IS_MEGA   (false)  // This is NOT a Moteino Mega
-  #define MAX_PIXELS   100   // Maximum supported pixels
+  #define MAX_PIXELS   150   // Maximum supported pixels (see RAM_RESERVE)
+#endif
+#ifdef STRIP_MAX_LEN
+  #if (STRIP_MAX_LEN > MAX_PIXELS) || (STRIP_MAX_LEN < 1)
+    #error "STRIP_MAX_LEN is out of range for this board"
+  #endif
+  #undef  MAX_PIXELS
+  #define MAX_PIXELS   STRIP_MAX_LEN
+#endif
+
+// Saved pixel snapshot formats (see pixelPoolInit())
+#define SAVE_NONE         0  // No room to save the pixels
+#define SAVE_FULL         1  // Every pixel's colour is saved
+#define SAVE_PALETTE      2  // A palette of up to SAVE_PAL_LEN colours, and a
+                             //   4-bit palette index per pixel, are saved
+#define SAVE_PAL_LEN     16
+
+// The static pixel pool holds the dirty pixel map and the saved pixels. It's
+// sized for a full snapshot of the longest strip on the Moteino Mega, and for
+// a palette snapshot of it otherwise.
+#define DIRTY_MAP_LEN(n)  (((n) + 7) >> 3)
+#ifdef __AVR_ATmega1284P__
+  #define PIXEL_POOL_SIZE ( DIRTY_MAP_LEN(MAX_PIXELS) +                  \
+                            MAX_PIXELS * LEDS_PER_PIX )
+#else
+  #define PIXEL_POOL_SIZE ( DIRTY_MAP_LEN(MAX_PIXELS) +                  \
+                            SAVE_PAL_LEN * LEDS_PER_PIX +                \
+                            ((MAX_PIXELS + 1) >> 1) )
+#endif
+#define RAM_RESERVE       (192 + SCRIPT_MAX_LEN) // Free RAM to keep for the
+                                                 //   stack and effect script
+// On the ATmega328P, the static data (about 1.1K, of which the pixel pool
+// takes 142 bytes and the SHIFT buffer 127) and the libraries' (about 0.25K)
+// leave about 450 bytes of the 2K of RAM for the strip beyond RAM_RESERVE:
+// 3 bytes per pixel, and 3 more for the output stage's drawing buffer (see
+// showPixels()). So a strip of up to about 75 pixels gets brightness
+// control, and one of up to about 145 pixels doesn't. Indexed colour mode takes another 48 bytes plus half a
+// byte per pixel, once it's used. Building with STRIP_MAX_LEN shrinks the
+// pool to suit.
+
+// Radio receive queue (see radioRxPoll())
+#ifdef __AVR_ATmega1284P__
+  #define RX_QUEUE_LEN    6  // Max # of received packets awaiting execution
+#else
+  #define RX_QUEUE_LEN    1  // (Besides the one in m_radioInBuf)
+#endif
+
+// Shifted-out pixels buffer (m_shiftOutLeds). On the ATmega328P it's only
+// sized for an indexed colour SHIFT, which limits a direct colour SHIFT to
+// SHIFT_MAX_PIX (42) pixels.
+#ifdef __AVR_ATmega1284P__
+  #define SHIFT_BUF_LEN   MAX_SHIFT_BYTES
+#else
+  #define SHIFT_BUF_LEN   MAX_IDX_SHIFT_SIZE
+#endif
+#define SHIFT_MAX_PIX   ( SHIFT_BUF_LEN / LEDS_PER_PIX < MAX_SHIFT_SIZE ?    \
+                          SHIFT_BUF_LEN / LEDS_PER_PIX : MAX_SHIFT_SIZE )
+
+// Scheduled command queue (see waspCmdHdlrAt())
+#ifdef __AVR_ATmega1284P__
+  #define SCHED_SLOTS     SCHED_QUEUE_LEN  // Max # of AT commands queued
+#else
+  #define SCHED_SLOTS     2
 #endif
 
 #define MAX_SERIAL_BUF_LEN           20
@@ -143,6 +235,23 @@
 
 #define DEL_CHAR                   0x7F  // ASCII Del character
 
+// Effect scripts (WASPCMD_SCRIPT) are kept in the top 64K of SPI flash, well
+// clear of the wireless software upgrade image stored from address 0.
+#define SCRIPT_FLASH_BASE  0x70000UL  // Address of script slot #0
+#define SCRIPT_SLOT_SIZE   0x1000     // One 4K erase block per slot
+#define SCRIPT_MAGIC       0x5A       // Header byte 0 of a committed script
+#define SCRIPT_HDR_LEN     2          // Header: magic:8, len:8
+
+// Broadcast firmware distribution (FWD_OFFER etc.). The image is stored where
+// the DualOptiboot bootloader looks for it: after the tag "FLXIMG:", len:16
+// (most significant byte first), ":". The distribution state is kept below
+// the effect scripts.
+#define FWD_IMG_ADDR       10         // Address of the image's first byte
+#define FWD_STATE_ADDR     0x60000UL  // Address of the distribution state
+#define FWD_STATE_MAGIC    0xA5       // Header byte 0 of the state
+#define FWD_STATE_HDR_LEN  6          // Header: magic:8, id:8, len:16, crc:16
+                                      //   (then the block bitmap: 1 = missing)
+
 
 // Command processing stages
 #define CMD_PROMPT        0  // Display command prompt
@@ -238,12 +347,61 @@ uint16   m_myRespDelay = 0;
 
 uint8    m_radioInBuf[RF69_MAX_DATA_LEN];
 uint8    m_radioInBufPos = 0;
+uint8    m_radioInBufLen = 0;
 uint8    m_radioOutBuf[RF69_MAX_DATA_LEN];
 uint8    m_radioOutBufPos = 0;
 
 boolean  m_ackRequested = false;
 uint32   m_txLate = 0;
 
+// Received packets, in order of receipt, that are awaiting execution.
+typedef struct
+{
+  uint8   dst;                    // Destination node ID
+  uint8   src;                    // Source node ID
+  uint8   len;                    // # of bytes in data[]
+  boolean ack;                    // An ACK was requested
+  int16   rssi;                   // RSSI on receipt
+  uint8   data[RF69_MAX_DATA_LEN];
+} RxPacket_t;
+
+RxPacket_t m_rxQueue[RX_QUEUE_LEN];
+uint8    m_rxHead = 0;            // Index of the oldest queued packet
+uint8    m_rxCount = 0;           // # of queued packets
+uint16   m_rxDropped = 0;         // # of packets lost to a full queue
+int16    m_ctrlRssi = 0;          // RSSI of last packet from the controller
+
+boolean  m_telemPending = false;  // A WASPCMD_TELEMETRY reply is due
+uint32   m_telemTxTime = 0;       // When to send the reply
+
+// Multicast streams (WASPCMD_MCAST): BROADCASTID, then my group
+#define MCAST_STREAMS 2
+boolean  m_mcValid[MCAST_STREAMS] = { false, false }; // Sequence is known
+uint8    m_mcExpect[MCAST_STREAMS];     // Next seq expected on each stream
+uint8    m_mcNacks[MCAST_STREAMS] = { 0, 0 }; // # NACKs sent for the gap
+boolean  m_nackPending = false;   // A WASPCMD_NACK is due
+uint32   m_nackTxTime = 0;        // When to send it
+uint8    m_nackBuf[5];            // The NACK command
+uint8    m_nackLen;               // # of bytes in m_nackBuf[]
+
+// Network clock (WASPCMD_SYNC)
+boolean  m_syncValid = false;     // A sync beacon has been received
+int32    m_netOffs = 0;           // Network time = millis() + m_netOffs
+uint16   m_syncFrame = 0;         // Network frame # at m_syncFrameTime
+uint32   m_syncFrameTime = 0;     // Network time at start of m_syncFrame
+
+// Scheduled commands (WASPCMD_AT), in order of receipt
+typedef struct
+{
+  uint16 frame;                   // Network frame # to execute them at
+  uint8  dst;                     // Destination they were sent to
+  uint8  len;                     // # of bytes in cmds[]
+  uint8  cmds[SCHED_MAX_LEN];     // n, followed by the commands
+} SchedCmd_t;
+
+SchedCmd_t m_schedQueue[SCHED_SLOTS];
+uint8    m_schedCount = 0;
+
 
 /*------------------------------  WASP State ---------------------------------*/
 uint8    m_waspCmd = WASPCMD_NONE;
@@ -261,7 +419,19 @@ uint8    m_consolePos = 0;
 
 
 /*----------------------  Execution Timing State  ----------------------------*/
-int32    m_timings[MAX_TIMINGS];
+// Per-timer statistics, in addition to the maximum kept in m_timings[].
+typedef struct
+{
+  uint32  minTime;                 // Minimum (usec)
+  uint32  sumTime;                 // Sum of samples (usec), see tmrRecord()
+  uint16  count;                   // # of samples in sumTime
+  uint8   hist[TMR_HIST_BUCKETS];  // log2 histogram (see WASPCMD_TMR_STATS)
+} TmrStats_t;
+
+int32      m_timings[MAX_TIMINGS];  // Observed Maximum Execution Times
+#ifdef TMR_STATS_ON
+TmrStats_t m_tmrStats[MAX_TIMINGS];
+#endif
 uint32   m_loopStartTime = 0;
 uint32   m_loopRefTime = 0;
 uint32   m_tmrUpdOverhead = 0;   // Execution time to call tmrUpdateOmet()
@@ -280,36 +450,85 @@ uint32   m_powerLedOffMs = 0;
 
 
 /*---------------------------  LED Pixels State  -----------------------------*/
-Adafruit_NeoPixel *m_pStrip;
+Adafruit_NeoPixel *m_pStrip = NULL;
 // IMPORTANT [Adafruit note]: To reduce NeoPixel burnout risk, add 1000 uF
 // capacitor across pixel power leads, add 300 - 500 Ohm resistor on first
 // pixel's data input and minimize distance between Arduino and first pixel.
 // Avoid connecting on a live circuit...if you must, connect GND first.
 
 uint8   *m_pPixels;
-uint8   *m_savedLeds;  // Dynamically allocated array for saving pixel states.
-uint8    m_shiftInLeds[MAX_SHIFT_SIZE * LEDS_PER_PIX];
-uint8    m_shiftOutLeds[MAX_SHIFT_SIZE * LEDS_PER_PIX];
+uint8    m_pixelPool[PIXEL_POOL_SIZE];  // See pixelPoolInit()
+uint8    m_saveMode = SAVE_NONE;
+uint8   *m_savedLeds;  // Saved pixel colours, or palette indices
+uint8   *m_savedPal;   // Palette of the saved pixels (SAVE_PALETTE only)
+uint8   *m_dirtyMap;   // Bit per pixel: set iff it may differ from m_savedLeds
+
+// Indexed colour mode (WASPCMD_PALETTE)
+boolean  m_palMode = false;
+uint8   *m_palette = NULL;  // In pixel byte order; allocated on first use
+uint8   *m_pixIdx;          // 4-bit palette index per pixel (after m_palette)
+uint8    m_shiftOutLeds[SHIFT_BUF_LEN];
 uint16   m_numPixelBytes;
+#ifdef FIXED_WIRING
+const uint8 m_offsRed   = WIRING_OFFS(FIXED_WIRING, WIRING_RED_OFFS);
+const uint8 m_offsGreen = WIRING_OFFS(FIXED_WIRING, WIRING_GREEN_OFFS);
+const uint8 m_offsBlue  = WIRING_OFFS(FIXED_WIRING, WIRING_BLUE_OFFS);
+#else
 uint8    m_offsRed   = 0; // Pixel byte data ordering.
 uint8    m_offsGreen = 1;
 uint8    m_offsBlue  = 2;
+#endif
 boolean  m_pixelShowSuspend = false;
+boolean  m_showDefer = false; // Hold show() back (e.g. during a SHIFT)
 boolean  m_updatePixels = false;
+uint8    m_pixelsSeq = 0;     // Next expected WASPCMD_PIXELS packet number
+boolean  m_pixelsOpen = false;  // A multi-packet upload awaits its F_RESUME
+boolean  m_pixelsLost = false;  // It has lost a packet
+uint8    m_pixelsLostSeq;       // seq of the first packet it lost
+
+// Output stage (WASPCMD_BRIGHT). The pixel colours are drawn in m_pPixels
+// and copied through the output stage to the strip's own buffer when shown.
+uint8   *m_pShowPixels;       // Strip's buffer (m_pPixels if no room for both)
+uint16   m_splitBytes = 0;    // # of pixel bytes shown from m_pShowPixels
+Adafruit_NeoPixel *m_pStrip2 = NULL; // Second half of a split strip
+uint8   *m_pShowPixels2;      // m_pStrip2's buffer
+uint8    m_bright = BRIGHT_FULL;     // Current output brightness
+uint8    m_brightFrom = BRIGHT_FULL; // Brightness fade start level
+uint8    m_brightTo = BRIGHT_FULL;   // Brightness fade end level
+uint32   m_brightStart = 0;   // Brightness fade start (network time)
+uint32   m_brightTime = 0;    // Brightness fade duration (0 = not fading)
+uint32   m_brightNext = 0;    // Time of the next brightness fade step
+boolean  m_gamma = false;     // Gamma-correct the shown colours
 
 
 // Animated Local Effect parameters
 WaspCmd_t  m_runningFx = WASPCMD_NONE;
 uint16     m_fxDelay = 0;
 boolean    m_runAnimation = false;
+uint16     m_fxDelayPrev = 0;      // m_fxDelay and m_runAnimation before a
+boolean    m_runAnimationPrev = false; //   fade started (see fxFadeStart())
 boolean    m_fxStep = true;  // Execute a single special F/X iteration.
 boolean    m_fxRestart = true;
 uint32     m_fxResumeTime = 0;
+uint32     m_fxFrame = 0;     // Effect iteration # (network-wide once synced)
 uint32     m_fxParam1 = 0;
 uint32     m_fxParam2 = 0;
 uint32     m_fxParam3 = 0;
 uint32     m_fxParam4 = 0;
 
+// Effect script state (WASPCMD_SCRIPT)
+boolean    m_flashPresent = false;
+uint8     *m_script = NULL;  // Running script; allocated on first use
+uint8      m_scriptLen = 0;
+uint8      m_scriptNext = 0; // Expected offs of the next SCRIPT packet
+
+// Broadcast firmware distribution state (see fwdRx()), as kept in SPI flash
+boolean    m_fwdActive = false; // An image is being received
+uint8      m_fwdId;
+uint16     m_fwdLen;
+uint16     m_fwdCrc;
+uint16     m_fwdBlocks;         // # of blocks in the image
+
 
 // LED strip parameters
 uint8    m_ledStripFlags;
@@ -371,10 +590,12 @@ typedef struct
 } CmdCtrl_t;
 
 boolean cmdHdlrHelp(void);
+boolean cmdHdlrHist(void);
 boolean cmdHdlrLed(void);
 boolean cmdHdlrLedCtrl(void);
 boolean cmdHdlrNodeId(void);
 boolean cmdHdlrPerf(void);
+boolean cmdHdlrPerfClr(void);
 boolean cmdHdlrReset(void);
 boolean cmdHdlrRun(void);
 boolean cmdHdlrStop(void);
@@ -386,10 +607,12 @@ CmdCtrl_t m_cmdCtrl[] =
   {/*   Cmd Name      Handler
         -----------   ----------------- */
       { "h",          cmdHdlrHelp      },
+      { "hist",       cmdHdlrHist      },
       { "led",        cmdHdlrLed       },
       { "ledCtrl",    cmdHdlrLedCtrl   },
       { "nodeid",     cmdHdlrNodeId    },
       { "perf",       cmdHdlrPerf      },
+      { "perfClr",    cmdHdlrPerfClr   },
       { "reset",      cmdHdlrReset     },
       { "run",        cmdHdlrRun       },
       { "s",          cmdHdlrStop      },
@@ -411,6 +634,9 @@ const uint8 m_numCmds = sizeof(m_cmdCtrl)/sizeof(CmdCtrl_t);
 //   - Command handling must be done quickly, in stages if necessary.
 typedef WaspCmd_t PxCmdHdlr_t(void);
 
+// The handler tables are kept in flash, to save RAM. Look up a handler with:
+#define PX_HDLR(tbl, cmd)   ((PxCmdHdlr_t *)pgm_read_ptr(&(tbl)[cmd]))
+
 WaspCmd_t waspCmdHdlrNone(void);
 WaspCmd_t waspCmdHdlrGroup(void);
 WaspCmd_t waspCmdHdlrState(void);
@@ -428,10 +654,23 @@ WaspCmd_t waspCmdHdlrCfgNode(void);
 WaspCmd_t waspCmdHdlrCfgCtrl(void);
 WaspCmd_t waspCmdHdlrCfgLed(void);
 WaspCmd_t waspCmdHdlrCfgSave(void);
+WaspCmd_t waspCmdHdlrBatch(void);
+WaspCmd_t waspCmdHdlrPixels(void);
+WaspCmd_t waspCmdHdlrTmrStats(void);
+WaspCmd_t waspCmdHdlrTelemetry(void);
+WaspCmd_t waspCmdHdlrScript(void);
+WaspCmd_t waspCmdHdlrScriptRun(void);
+WaspCmd_t waspCmdHdlrSync(void);
+WaspCmd_t waspCmdHdlrAt(void);
+WaspCmd_t waspCmdHdlrPalette(void);
+WaspCmd_t waspCmdHdlrFade(void);
+WaspCmd_t waspCmdHdlrGradient(void);
+WaspCmd_t waspCmdHdlrBright(void);
+WaspCmd_t waspCmdHdlrMcast(void);
 
 
 // When updating the following, be sure to update m_pxFxHdlrs[] as well.
-PxCmdHdlr_t *m_pxCmdHdlrs[MAX_WASPCMD_VAL + 1] =
+PxCmdHdlr_t * const m_pxCmdHdlrs[MAX_WASPCMD_VAL + 1] PROGMEM =
   {
     waspCmdHdlrNone,          // WASPCMD_NONE
     waspCmdHdlrGroup,         // WASPCMD_GROUP
@@ -449,7 +688,21 @@ PxCmdHdlr_t *m_pxCmdHdlrs[MAX_WASPCMD_VAL + 1] =
     waspCmdHdlrCfgNode,       // WASPCMD_CFG_NODE
     waspCmdHdlrCfgCtrl,       // WASPCMD_CFG_CTRL
     waspCmdHdlrCfgLed,        // WASPCMD_CFG_LED
-    waspCmdHdlrCfgSave        // WASPCMD_CFG_SAVE
+    waspCmdHdlrCfgSave,       // WASPCMD_CFG_SAVE
+    waspCmdHdlrBatch,         // WASPCMD_BATCH
+    waspCmdHdlrPixels,        // WASPCMD_PIXELS
+    waspCmdHdlrTmrStats,      // WASPCMD_TMR_STATS
+    waspCmdHdlrTelemetry,     // WASPCMD_TELEMETRY
+    waspCmdHdlrScript,        // WASPCMD_SCRIPT
+    waspCmdHdlrScriptRun,     // WASPCMD_SCRIPT_RUN
+    waspCmdHdlrSync,          // WASPCMD_SYNC
+    waspCmdHdlrAt,            // WASPCMD_AT
+    waspCmdHdlrPalette,       // WASPCMD_PALETTE
+    waspCmdHdlrFade,          // WASPCMD_FADE
+    waspCmdHdlrGradient,      // WASPCMD_GRADIENT
+    waspCmdHdlrBright,        // WASPCMD_BRIGHT
+    waspCmdHdlrMcast,         // WASPCMD_MCAST
+    waspCmdHdlrNone           // WASPCMD_NACK
 };
 
 
@@ -460,9 +713,11 @@ WaspCmd_t fxHdlrNull(void);
 WaspCmd_t fxHdlrRainbow(void);
 WaspCmd_t fxHdlrRainbowCycle(void);
 WaspCmd_t fxHdlrTwinkle(void);
+WaspCmd_t fxHdlrScript(void);
+WaspCmd_t fxHdlrFade(void);
 
 // When updating the following, be sure to update m_pxCmdHdlrs[] as well.
-PxCmdHdlr_t *m_pxFxHdlrs[MAX_WASPCMD_VAL + 1] =
+PxCmdHdlr_t * const m_pxFxHdlrs[MAX_WASPCMD_VAL + 1] PROGMEM =
   {
     fxHdlrNull,               // WASPCMD_NONE
     fxHdlrNull,               // WASPCMD_NEIGHBOUR
@@ -480,43 +735,131 @@ PxCmdHdlr_t *m_pxFxHdlrs[MAX_WASPCMD_VAL + 1] =
     fxHdlrNull,               // WASPCMD_CFG_NODE
     fxHdlrNull,               // WASPCMD_CFG_CTRL
     fxHdlrNull,               // WASPCMD_CFG_LED
-    fxHdlrNull                // WASPCMD_CFG_SAVE
+    fxHdlrNull,               // WASPCMD_CFG_SAVE
+    fxHdlrNull,               // WASPCMD_BATCH
+    fxHdlrNull,               // WASPCMD_PIXELS
+    fxHdlrNull,               // WASPCMD_TMR_STATS
+    fxHdlrNull,               // WASPCMD_TELEMETRY
+    fxHdlrNull,               // WASPCMD_SCRIPT
+    fxHdlrScript,             // WASPCMD_SCRIPT_RUN
+    fxHdlrNull,               // WASPCMD_SYNC
+    fxHdlrNull,               // WASPCMD_AT
+    fxHdlrNull,               // WASPCMD_PALETTE
+    fxHdlrFade,               // WASPCMD_FADE
+    fxHdlrFade,               // WASPCMD_GRADIENT
+    fxHdlrNull,               // WASPCMD_BRIGHT
+    fxHdlrNull,               // WASPCMD_MCAST
+    fxHdlrNull                // WASPCMD_NACK
   };
 
 
 
 /*---------------------------  Forward declarations -------------------------*/
 void CheckRam(void);
+int  FreeRam(void);
 int  serialParseInt(void);
 
 
 
 
+//-----------------------------------------------------------------------------
+// Function: tmrReset
+//   Clear a specified timer's execution time statistics.
+// Parameters:
+//   timerId:I  - Identifier of the timer to reset (e.g. TMR_BASELINE).
+// Returns: (none)
+// Inputs/Outputs:
+//   m_timings:O
+//   m_tmrStats:O
+//-----------------------------------------------------------------------------
+static void tmrReset(uint8 timerId)
+{
+  m_timings[timerId] = 0;
+#ifdef TMR_STATS_ON
+  memset(&m_tmrStats[timerId], 0, sizeof(TmrStats_t));
+  m_tmrStats[timerId].minTime = MAXUINT32;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: tmrRecord
+//   Add an execution time sample to a specified timer's statistics. When
+//   the sample count or sum would overflow, both are halved (preserving the
+//   mean); likewise, when a histogram bucket would overflow, all buckets are
+//   halved (preserving the distribution's shape). Only the maximum is kept
+//   unless TMR_STATS_ON is defined.
+// Parameters:
+//   timerId:I    - Identifier of the timer to update (e.g. TMR_BASELINE).
+//   timeDelta:I  - The execution time (usec).
+// Returns: (none)
+// Inputs/Outputs:
+//   m_timings:IO
+//   m_tmrStats:IO
+//-----------------------------------------------------------------------------
+static void tmrRecord(uint8 timerId, uint32 timeDelta)
+{
+#ifdef TMR_STATS_ON
+  TmrStats_t *pStats = &m_tmrStats[timerId];
+  uint32      t;
+  uint8       bucket;
+#endif
+
+  if (timeDelta > (uint32)m_timings[timerId])
+    m_timings[timerId] = timeDelta;
+#ifdef TMR_STATS_ON
+  if (timeDelta < pStats->minTime)
+    pStats->minTime = timeDelta;
+
+  if ( (MAXUINT16 == pStats->count) ||
+       (pStats->sumTime > (MAXUINT32 - timeDelta)) )
+  {
+    pStats->count   >>= 1;
+    pStats->sumTime >>= 1;
+  }
+  pStats->count++;
+  pStats->sumTime += timeDelta;
+
+  bucket = 0;
+  for (t = timeDelta >> 5; (t != 0) && (bucket < (TMR_HIST_BUCKETS - 1));
+       t >>= 1)
+  {
+    bucket++;
+  }
+  if (0xFF == pStats->hist[bucket])
+  {
+    for (uint8 i = 0; i < TMR_HIST_BUCKETS; i++)
+      pStats->hist[i] >>= 1;
+  }
+  pStats->hist[bucket]++;
+#endif
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: tmrUpdateOmet
 //   Update a specified timer's per-loop Observed Maximum Execution Time
-//   relative to the most recent value of m_loopRefTime.
+//   (and its other statistics) relative to the most recent value of
+//   m_loopRefTime.
 // Parameters:
 //   timerId:I  - Identifier of the timer to update (e.g. TMR_BASELINE).
 // Returns: (none)
 // Inputs/Outputs:
 //   m_loopRefTime:I
 //   m_timings:IO
+//   m_tmrStats:IO
 //-----------------------------------------------------------------------------
 static inline void tmrUpdateOmet(uint8 timerId)
 {
   uint32   time;
   uint32   timeDelta = 0;
-  int32   *pTimer;
 
   time = micros();
   if (time < m_loopRefTime)
     timeDelta = MAXUINT32 - m_loopRefTime + time;
   else
     timeDelta = time - m_loopRefTime;
-  pTimer = &m_timings[timerId];
-  if (timeDelta > *pTimer)
-    *pTimer = timeDelta;
+  tmrRecord(timerId, timeDelta);
 }
       
       
@@ -578,6 +921,29 @@ void EepromSave()
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: FreeRam
+//   Test how much RAM is left on the MPU.
+// Parameters: (none)
+// Returns:    # of free RAM bytes between the heap and the stack.
+// Inputs/Outputs:
+//   __bss_end:I
+//   __brkval:I
+//-----------------------------------------------------------------------------
+int FreeRam(void)
+{
+  extern int __bss_end;
+  extern void *__brkval;
+  int freeValue;
+  
+  if ((int)__brkval == 0)
+    freeValue = ((int)&freeValue) - ((int)&__bss_end);
+  else
+    freeValue = ((int)&freeValue) - ((int)__brkval);
+  return freeValue;
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: CheckRam
 //   Test how much RAM is left on the MPU, printing the results out to
@@ -585,8 +951,6 @@ void EepromSave()
 // Parameters: (none)
 // Returns:    (none)
 // Inputs/Outputs:
-//   __bss_end:I
-//   __brkval:I
 //   m_consoleBuffer:IO
 // Note:
 //   IMPORTANT: Avoid calling this function during normal operation. This
@@ -594,16 +958,9 @@ void EepromSave()
 //-----------------------------------------------------------------------------
 void CheckRam(void)
 {
-  extern int __bss_end;
-  extern void *__brkval;
   /* Comment out either of the following to limit the CheckRam output */
   #define OUT_TO_SERIAL
-  int freeValue;
-  
-  if ((int)__brkval == 0)
-    freeValue = ((int)&freeValue) - ((int)&__bss_end);
-  else
-    freeValue = ((int)&freeValue) - ((int)__brkval);
+  int freeValue = FreeRam();
     
   #ifdef OUT_TO_SERIAL
     Serial.print(F("Free RAM: "));
@@ -677,6 +1034,12 @@ boolean cmdHdlrLed(void)
   stripLen  = serialParseInt();
   stripFreq = serialParseInt();
   stripCol  = serialParseInt();
+  if (stripLen > MAX_PIXELS)
+  {
+    logPrint(FLASH("ERROR: Too many LED pixels: "));
+    logPrintln(stripLen);
+    return true;
+  }
   if ( (stripFreq != 8) && (stripFreq != 4) )
   {
     logPrint(FLASH("ERROR: Invalid LED strip frequency: "));
@@ -780,22 +1143,111 @@ boolean cmdHdlSave(void)
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrHist
+//   Display the execution time histogram of a timer on the console.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_tmrStats:I
+//   m_consolePos:IO
+//   m_consoleBuffer:IO
+//-----------------------------------------------------------------------------
+boolean cmdHdlrHist(void)
+{
+#ifdef TMR_STATS_ON
+  TmrStats_t *pStats;
+#endif
+  uint8       timerId;
+
+  timerId = serialParseInt();
+  if ( (timerId < 1) || (timerId >= MAX_TIMINGS) )
+  {
+    logPrint(FLASH("ERROR: Invalid timer: "));
+    logPrintln(timerId);
+    return true;
+  }
+
+#ifndef TMR_STATS_ON
+  logPrintln(FLASH("ERROR: Built without TMR_STATS_ON"));
+#else
+  pStats = &m_tmrStats[timerId];
+  logPrint(FLASH("\nTimer #"));
+  logPrint(timerId);
+  logPrintln(FLASH(" histogram: (usec)"));
+  for (uint8 i = 0; i < TMR_HIST_BUCKETS; i++)
+  {
+    logPrint(FLASH("\t"));
+    if (0 == i)
+      logPrint(FLASH("0"));
+    else
+      logPrint((uint32)1 << (i + 4));
+    if (i < (TMR_HIST_BUCKETS - 1))
+    {
+      logPrint(FLASH(".."));
+      logPrint(((uint32)1 << (i + 5)) - 1);
+    }
+    else
+    {
+      logPrint(FLASH("+"));
+    }
+    logPrint(FLASH("\t"));
+    logPrintln(pStats->hist[i]);
+  }
+#endif
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: cmdHdlrPerfClr
+//   Reset all timing data.
+// Parameters: (none)
+// Returns: true iff command processing has completed.
+// Inputs/Outputs:
+//   m_timings:O
+//   m_rxDropped:O
+//   m_tmrStats:O
+//   m_txLate:O
+//-----------------------------------------------------------------------------
+boolean cmdHdlrPerfClr(void)
+{
+  // Keep the baseline; it calibrates the timer update overhead.
+  for (uint8 i = 1; i < MAX_TIMINGS; i++)
+    tmrReset(i);
+  m_txLate = 0;
+  m_rxDropped = 0;
+  logPrintln(FLASH("Timing data cleared"));
+  return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Function: cmdHdlrPerf
 //   Display all timing data on the console.
 // Parameters: (none)
 // Returns: true iff command processing has completed.
 // Inputs/Outputs:
+//   m_rxDropped:I
 //   m_timings:I
+//   m_tmrStats:I
 //   m_tmrUpdOverhead:I
 //   m_txLate:I
 //-----------------------------------------------------------------------------
 boolean cmdHdlrPerf(void)
 {
-  int32  *pOmet;  // Ptr to current Observed Max Execution Time entry.
+  int32      *pOmet;  // Ptr to current Observed Max Execution Time entry.
+#ifdef TMR_STATS_ON
+  TmrStats_t *pStats = &m_tmrStats[1];
+#endif
   
-  pOmet = &m_timings[1];
+  pOmet  = &m_timings[1];
   logPrintln(FLASH("\nTiming Data: (usec)"));
+#ifdef TMR_STATS_ON
+  logPrintln(FLASH("\tTimer\tOMET\t\t   actual\tmin\tmean\tcount"));
+#else
+  logPrintln(FLASH("\tTimer\tOMET\t\t   actual"));
+#endif
   for (uint8 i = 1; i < MAX_TIMINGS; i++)
   {
     logPrint(FLASH("\t"));
@@ -804,15 +1256,27 @@ boolean cmdHdlrPerf(void)
     if (*pOmet > 0)
     {
       logPrint(*pOmet - m_tmrUpdOverhead);
-      logPrint(FLASH("\t\t   actual ("));
+      logPrint(FLASH("\t\t   ("));
       logPrint(*pOmet);
+#ifdef TMR_STATS_ON
+      logPrint(FLASH(")\t"));
+      logPrint(pStats->minTime);
+      logPrint(FLASH("\t"));
+      logPrint(pStats->sumTime / pStats->count);
+      logPrint(FLASH("\t"));
+      logPrintln(pStats->count);
+#else
       logPrintln(FLASH(")"));
+#endif
     }
     else
     {
       logPrintln(FLASH("-"));
     }
     pOmet++;
+#ifdef TMR_STATS_ON
+    pStats++;
+#endif
   }
   logPrint(FLASH("\tPer-timer update overhead: "));
   logPrint(m_tmrUpdOverhead);
@@ -821,6 +1285,8 @@ boolean cmdHdlrPerf(void)
   logPrint(MAX_TX_EXEC_MS);
   logPrint(FLASH("ms): "));
   logPrintln(m_txLate);
+  logPrint(FLASH("# Rx packets dropped (queue full): "));
+  logPrintln(m_rxDropped);
   return true;
 }
 
@@ -892,7 +1358,8 @@ boolean cmdHdlrHelp(void)
   logPrint(FLASH("  led l,f,c"));
       logPrintln(FLASH("\t- Configure addressable LED strip:"));
       logPrintln(FLASH("\t\t\tl = # tricolor LED pixels (default = 3)"));
-      logPrintln(FLASH("\t\t\t      - Max 100 recommended for Moteino"));
+      logPrintln(FLASH("\t\t\t      - Max 150 for Moteino; may be"));
+      logPrintln(FLASH("\t\t\t        limited further by free RAM"));
       logPrintln(FLASH("\t\t\tf = 8, for 800kHz, WS2812 LEDs (default)"));
       logPrintln(FLASH("\t\t\t    4, for 400kHz, WS2811 drivers"));
       logPrintln(FLASH("\t\t\tc = 0, for RGB color wiring order (default)"));
@@ -908,6 +1375,10 @@ boolean cmdHdlrHelp(void)
       logPrintln(FLASH("\t- Set the Node Id to n. n in {2, 3, ..., 20}"));
   logPrint(FLASH("  perf"));
       logPrintln(FLASH("\t\t- Show performance timing data"));
+  logPrint(FLASH("  perfClr"));
+      logPrintln(FLASH("\t- Clear performance timing data"));
+  logPrint(FLASH("  hist n"));
+      logPrintln(FLASH("\t- Show execution time histogram of timer n"));
   logPrint(FLASH("  reset"));
       logPrintln(FLASH("\t\t- Software reset"));
   logPrint(FLASH("  save"));
@@ -1214,44 +1685,284 @@ void processCommandLine()
 
 
 //-----------------------------------------------------------------------------
-// Function: receiveRadioWaspCmd
-//   Check for and pixel commands from the RFM radio network.
+// Function: fwdLoad
+//   Resume a broadcast firmware distribution cut off by a restart, if its
+//   state is in SPI flash.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_fwdActive:O
+//   m_fwdBlocks:O
+//   m_fwdCrc:O
+//   m_fwdId:O
+//   m_fwdLen:O
+//-----------------------------------------------------------------------------
+void fwdLoad(void)
+{
+  uint8 hdr[FWD_STATE_HDR_LEN];
+
+  m_flash.readBytes(FWD_STATE_ADDR, hdr, sizeof(hdr));
+  m_fwdActive = (FWD_STATE_MAGIC == hdr[0]);
+  m_fwdId     = hdr[1];
+  m_fwdLen    = hdr[2] | ((uint16)hdr[3] << 8);
+  m_fwdCrc    = hdr[4] | ((uint16)hdr[5] << 8);
+  m_fwdBlocks = (m_fwdLen + FWD_BLOCK_LEN - 1) / FWD_BLOCK_LEN;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdStart
+//   Erase the image area and the block bitmap in SPI flash, and start
+//   receiving a new image.
+// Parameters:
+//   id:I   - Image id.
+//   len:I  - Image length (bytes).
+//   crc:I  - CRC-16/CCITT of the image.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_fwdActive:O
+//   m_fwdBlocks:O
+//   m_fwdCrc:O
+//   m_fwdId:O
+//   m_fwdLen:O
+//-----------------------------------------------------------------------------
+void fwdStart(uint8 id, uint16 len, uint16 crc)
+{
+  uint8 hdr[FWD_STATE_HDR_LEN];
+
+  logPrint(FLASH("Receiving image "));
+  logPrintln(id);
+  for (uint32 addr = 0; addr < (FWD_IMG_ADDR + (uint32)len); addr += 0x1000)
+    m_flash.blockErase4K(addr);
+  m_flash.blockErase4K(FWD_STATE_ADDR);
+
+  hdr[0] = FWD_STATE_MAGIC;
+  hdr[1] = id;
+  hdr[2] = (uint8)len;
+  hdr[3] = (uint8)(len >> 8);
+  hdr[4] = (uint8)crc;
+  hdr[5] = (uint8)(crc >> 8);
+  m_flash.writeBytes(FWD_STATE_ADDR, hdr, sizeof(hdr));
+  fwdLoad();
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdMissing
+//   Find the blocks of the image that haven't been received yet.
+// Parameters:
+//   pList:O  - Where to list the first (up to FWD_MAX_LIST) missing block
+//              numbers, least significant byte first.
+// Returns: The # of missing blocks.
+// Inputs/Outputs:
+//   m_fwdBlocks:I
+//-----------------------------------------------------------------------------
+uint16 fwdMissing(uint8 *pList)
+{
+  uint16 missing = 0;
+  uint8  bits = 0;
+
+  for (uint16 blk = 0; blk < m_fwdBlocks; blk++)
+  {
+    if (0 == (blk & 7))
+      bits = m_flash.readByte(FWD_STATE_ADDR + FWD_STATE_HDR_LEN + (blk >> 3));
+    if (bits & (1 << (blk & 7)))
+    {
+      if (missing < FWD_MAX_LIST)
+      {
+        *pList++ = (uint8)blk;
+        *pList++ = (uint8)(blk >> 8);
+      }
+      missing++;
+    }
+  }
+  return missing;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdCheck
+//   Check the received image against its CRC.
+// Parameters: (none)
+// Returns: true iff the image is intact.
+// Inputs/Outputs:
+//   m_fwdCrc:I
+//   m_fwdLen:I
+//-----------------------------------------------------------------------------
+boolean fwdCheck(void)
+{
+  uint8  buf[FWD_BLOCK_LEN];
+  uint16 crc = 0xFFFF;
+  uint16 n;
+
+  for (uint16 offs = 0; offs < m_fwdLen; offs += n)
+  {
+    n = m_fwdLen - offs;
+    if (n > sizeof(buf))
+      n = sizeof(buf);
+    m_flash.readBytes(FWD_IMG_ADDR + (uint32)offs, buf, n);
+    for (uint8 i = 0; i < n; i++)
+    {
+      crc ^= (uint16)buf[i] << 8;
+      for (uint8 j = 0; j < 8; j++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return (crc == m_fwdCrc);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fwdRx
+//   Handle a broadcast firmware distribution packet from the programming
+//   gateway (see FWD_OFFER). A COMMIT of an intact image restarts the node,
+//   so that the bootloader installs it.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_fwdBlocks:I
+//   m_fwdCrc:I
+//   m_fwdId:I
+//   m_fwdLen:I
+//   m_fwdActive:IO
+//   m_radio:IO
+//-----------------------------------------------------------------------------
+void fwdRx(void)
+{
+  uint8  pkt[RF69_MAX_DATA_LEN];
+  uint8  len = m_radio.DATALEN;
+  uint8  fwd;
+  uint16 missing;
+  uint16 blk;
+  uint32 addr;
+  uint8  bits;
+
+  memcpy(pkt, (const void *)&m_radio.DATA[0], len);
+  m_radio.DATALEN = 0;
+  if (!m_flashPresent)
+    return;
+
+  fwd = pkt[0];
+  if (FWD_OFFER == fwd)
+  {
+    if ( (len >= 6) &&
+         ( !m_fwdActive || (pkt[1] != m_fwdId) ||
+           (m_fwdLen != (pkt[2] | ((uint16)pkt[3] << 8))) ||
+           (m_fwdCrc != (pkt[4] | ((uint16)pkt[5] << 8))) ) )
+    {
+      fwdStart(pkt[1], pkt[2] | ((uint16)pkt[3] << 8),
+               pkt[4] | ((uint16)pkt[5] << 8));
+    }
+    return;
+  }
+
+  if (!m_fwdActive || (pkt[1] != m_fwdId))
+    missing = FWD_NO_IMAGE;
+  else if (FWD_BLOCK == fwd)
+  {
+    blk = pkt[2] | ((uint16)pkt[3] << 8);
+    if ( (len <= FWD_HDR_LEN) || (blk >= m_fwdBlocks) )
+      return;
+    addr = FWD_STATE_ADDR + FWD_STATE_HDR_LEN + (blk >> 3);
+    bits = m_flash.readByte(addr);
+    if (bits & (1 << (blk & 7)))
+    {
+      m_flash.writeBytes(FWD_IMG_ADDR + (uint32)blk * FWD_BLOCK_LEN,
+                         &pkt[FWD_HDR_LEN], len - FWD_HDR_LEN);
+      m_flash.writeByte(addr, bits & ~(1 << (blk & 7)));
+    }
+    return;
+  }
+  else
+  {
+    missing = fwdMissing(&pkt[4]);
+    if ( (FWD_COMMIT == fwd) && (0 == missing) )
+    {
+      if (fwdCheck())
+      {
+        // Tag the image for the bootloader, and forget the distribution.
+        memcpy(&pkt[4], "FLXIMG:", 7);
+        pkt[11] = (uint8)(m_fwdLen >> 8);
+        pkt[12] = (uint8)m_fwdLen;
+        pkt[13] = ':';
+        m_flash.writeBytes(0, &pkt[4], FWD_IMG_ADDR);
+        m_flash.blockErase4K(FWD_STATE_ADDR);
+        m_fwdActive = false;
+      }
+      else
+      {
+        logPrintln(FLASH("***FWD: Bad image CRC"));
+        fwdStart(m_fwdId, m_fwdLen, m_fwdCrc);
+        missing = FWD_BAD_CRC;
+      }
+    }
+  }
+
+  pkt[0] = FWD_STATUS;
+  pkt[2] = (uint8)missing;
+  pkt[3] = (uint8)(missing >> 8);
+  if (missing >= FWD_BAD_CRC)
+    len = FWD_HDR_LEN;
+  else if (missing > FWD_MAX_LIST)
+    len = FWD_HDR_LEN + 2 * FWD_MAX_LIST;
+  else
+    len = FWD_HDR_LEN + 2 * missing;
+  radioSendBuf(PROG_GW_ID, pkt, len);
+
+  if ( (FWD_COMMIT == fwd) && (0 == missing) )
+  {
+    logPrintln(FLASH("Restarting to install the new image"));
+    resetUsingWatchdog(false);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: radioRxPoll
+//   Move the packets received by the RFM radio, that this node is an
+//   intended receiver of, to the receive queue. The radio holds only the
+//   one packet, which is overwritten by the next, so this is called
+//   wherever the main loop may have been busy for a while (e.g. after
+//   show(), which disables interrupts). Wireless software updates are
+//   handled as they're received.
 // Parameters: (none)
 // Returns:    (none)
 // Inputs/Outputs:
 //   m_myGroupId:I
 //   m_myNodeId:I
-//   m_radio:I
-//   m_dstNodeId:O
-//   m_waspCmd:O
-//   m_radioInBuf:O
-//   m_radioInBufPos:O
-//   m_srcNodeId:O
+//   m_radio:IO
+//   m_rxCount:IO
+//   m_rxDropped:IO
+//   m_rxHead:I
+//   m_rxQueue:O
 //-----------------------------------------------------------------------------
-void receiveRadioWaspCmd(void)
+void radioRxPoll(void)
 {
-  const  uint32 k_rxDelay = MIN_UPD_PERIOD / 2;
-  static uint32  lastRxTime = 0;
   static boolean waspRxLedOn = false;
-  uint8 waspCmd = WASPCMD_NONE;
-  
-  m_radioInBuf[0] = WASPCMD_NONE;
-  m_radioInBufPos = 0;
-  
-  if ( (millis() - lastRxTime) < k_rxDelay)
-    return;
+  RxPacket_t *pPkt;
+  uint8 dst;
+  uint8 src;
 
-  if (m_radio.receiveDone())
+  // Each call re-arms the receiver after a packet is taken.
+  while (m_radio.receiveDone())
   {
-    m_dstNodeId = m_radio.TARGETID;
-    m_srcNodeId = m_radio.SENDERID;
+    dst = m_radio.TARGETID;
+    src = m_radio.SENDERID;
 
-    // Check for wireless software update
-    if (m_srcNodeId == PROG_GW_ID)
+    // Check for broadcast firmware distribution, or wireless software update
+    if ( (src == PROG_GW_ID) && (m_radio.DATALEN >= 2) &&
+         (m_radio.DATA[0] >= FWD_OFFER) && (m_radio.DATA[0] <= FWD_COMMIT) )
+    {
+      if ( (dst == m_myNodeId) || (dst == BROADCASTID) )
+        fwdRx();
+      continue;
+    }
+    if (src == PROG_GW_ID)
     {
       Serial.println(FLASH("Rx from WASP slave programming gateway node"));
       dbgPrint("Got [");
-      dbgPrint(m_srcNodeId);
+      dbgPrint(src);
       dbgPrint(':');
       dbgPrint(m_radio.DATALEN);
       dbgPrint("] > ");
@@ -1261,7 +1972,7 @@ void receiveRadioWaspCmd(void)
       #endif
       dbgPrintln();
 
-      if (m_dstNodeId == m_myNodeId)
+      if (dst == m_myNodeId)
       {
         // Invoke function that checks for, and receive, a wireless external
         // Flash memory program update. (Set the last parameter to true to
@@ -1276,39 +1987,33 @@ void receiveRadioWaspCmd(void)
       dbgPrintln();
     }
 
-    //noInterrupts();
     // Determine if we're an intended receiver
-    if (   ( (m_dstNodeId == BROADCASTID) && (m_srcNodeId == CONTROLLERID) )
-        || ( (m_dstNodeId == m_myNodeId) && (m_myNodeId != NODEID_UNDEF) )
-        || ( (m_dstNodeId == m_myGroupId) && (m_myGroupId != NODEID_UNDEF) )
+    if (   ( (dst == BROADCASTID) && (src == CONTROLLERID) )
+        || ( (dst == m_myNodeId) && (m_myNodeId != NODEID_UNDEF) )
+        || ( (dst == m_myGroupId) && (m_myGroupId != NODEID_UNDEF) )
        )
     {
-      m_ackRequested = m_radio.ACK_REQUESTED;
-      memcpy(m_radioInBuf, (const void *)&m_radio.DATA[0], m_radio.DATALEN);
+      if (m_rxCount >= RX_QUEUE_LEN)
+      {
+        m_rxDropped++;
+        dbgPrintln(FLASH("***Rx queue full"));
+        m_radio.DATALEN = 0;
+        continue;
+      }
+      pPkt = &m_rxQueue[(m_rxHead + m_rxCount) % RX_QUEUE_LEN];
+      pPkt->dst  = dst;
+      pPkt->src  = src;
+      pPkt->len  = m_radio.DATALEN;
+      pPkt->ack  = m_radio.ACK_REQUESTED;
+      pPkt->rssi = m_radio.RSSI;
+      memcpy(pPkt->data, (const void *)&m_radio.DATA[0], m_radio.DATALEN);
       m_radio.DATALEN = 0;
+      m_rxCount++;
       waspRxLedOn = !waspRxLedOn;
       if (waspRxLedOn)
         digitalWrite(WASP_RX_LED, HIGH);
       else
         digitalWrite(WASP_RX_LED, LOW);
-      //interrupts();
-      m_radioInBufPos = 0;
-      waspCmd = m_radioInBuf[m_radioInBufPos++];
-      if (waspCmd > MAX_WASPCMD_VAL)
-      {
-        dbgPrint(FLASH(" ... invalid Rx WASP cmd="));
-        dbgPrintln(waspCmd);
-        m_radioInBuf[0] = WASPCMD_NONE;
-        waspCmd = WASPCMD_NONE;
-      }
-      else
-      {
-        dbgPrint(FLASH("Rx Cmd["));
-        dbgPrint(waspCmd);
-        dbgPrint(FLASH("] Src["));
-        dbgPrint(m_srcNodeId);
-        dbgPrintln(FLASH("]"));
-      }
     }
     else
     {
@@ -1316,22 +2021,87 @@ void receiveRadioWaspCmd(void)
 //JVS
 #if 0
       dbgPrint(FLASH(" ... ignored (pkt not for me). Src:"));
-      dbgPrint(m_srcNodeId);
+      dbgPrint(src);
       dbgPrint(FLASH(" Dst:"));
-      dbgPrint(m_dstNodeId);
+      dbgPrint(dst);
       dbgPrintln(FLASH(")"));
 #endif
     }
   }
-  m_waspCmd = waspCmd;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: radioSendBuf
-//   Send a WASP response message.
-// Parameters:
-//   dst:I         - Destination node ID; Don't use BROADCASTID .
+// Function: receiveRadioWaspCmd
+//   Take the next pixel command, if any, from the receive queue (see
+//   radioRxPoll()).
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_rxQueue:I
+//   m_rxCount:IO
+//   m_rxHead:IO
+//   m_ackRequested:O
+//   m_ctrlRssi:O
+//   m_dstNodeId:O
+//   m_waspCmd:O
+//   m_radioInBuf:O
+//   m_radioInBufLen:O
+//   m_radioInBufPos:O
+//   m_srcNodeId:O
+//-----------------------------------------------------------------------------
+void receiveRadioWaspCmd(void)
+{
+  RxPacket_t *pPkt;
+  uint8 waspCmd = WASPCMD_NONE;
+  
+  m_radioInBuf[0] = WASPCMD_NONE;
+  m_radioInBufPos = 0;
+
+  radioRxPoll();
+  if (0 == m_rxCount)
+  {
+    m_waspCmd = waspCmd;
+    return;
+  }
+
+  pPkt = &m_rxQueue[m_rxHead];
+  m_rxHead = (m_rxHead + 1) % RX_QUEUE_LEN;
+  m_rxCount--;
+
+  m_dstNodeId = pPkt->dst;
+  m_srcNodeId = pPkt->src;
+  m_ackRequested = pPkt->ack;
+  memcpy(m_radioInBuf, pPkt->data, pPkt->len);
+  m_radioInBufLen = pPkt->len;
+  if (CONTROLLERID == m_srcNodeId)
+    m_ctrlRssi = pPkt->rssi;
+
+  waspCmd = m_radioInBuf[m_radioInBufPos++];
+  if (waspCmd > MAX_WASPCMD_VAL)
+  {
+    dbgPrint(FLASH(" ... invalid Rx WASP cmd="));
+    dbgPrintln(waspCmd);
+    m_radioInBuf[0] = WASPCMD_NONE;
+    waspCmd = WASPCMD_NONE;
+  }
+  else
+  {
+    dbgPrint(FLASH("Rx Cmd["));
+    dbgPrint(waspCmd);
+    dbgPrint(FLASH("] Src["));
+    dbgPrint(m_srcNodeId);
+    dbgPrintln(FLASH("]"));
+  }
+  m_waspCmd = waspCmd;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: radioSendBuf
+//   Send a WASP response message.
+// Parameters:
+//   dst:I         - Destination node ID; Don't use BROADCASTID .
 //   pPayload:I    - Pointer to the payload buffer.
 //   payloadLen:I  - Number of bytes to send from the payload buffer.
 // Returns: (none)
@@ -1387,685 +2157,1276 @@ uint32 mapToColour(uint8 r, uint8 g, uint8 b)
 
 
 //-----------------------------------------------------------------------------
-// Function: savePixels
-//   Save the current pixel colours.
-// Parameters: (none)
+// Function: markDirty
+//   Record that a range of pixels may no longer match the saved pixel
+//   colours, so that savePixels() and restorePixels() only copy the pixels
+//   that have changed.
+// Parameters:
+//   first:I  - First pixel number of the range.
+//   count:I  - Number of pixels in the range.
 // Returns:    (none)
 // Inputs/Outputs:
-//   m_savedLeds:O
+//   m_dirtyMap:IO
 //-----------------------------------------------------------------------------
-static inline void savePixels(void)
+static void markDirty(uint16 first, uint16 count)
 {
-  memcpy(m_savedLeds, m_pPixels, m_numPixelBytes);
+  uint16 end = first + count;
+
+  for ( ; (first < end) && ((first & 7) != 0); first++)
+    m_dirtyMap[first >> 3] |= (1 << (first & 7));
+  for ( ; (first + 8) <= end; first += 8)
+    m_dirtyMap[first >> 3] = 0xFF;
+  for ( ; first < end; first++)
+    m_dirtyMap[first >> 3] |= (1 << (first & 7));
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: restorePixels
-//   Restore the previously saved pixel colours.
+// Function: syncPixels
+//   Copy the dirty pixels (see markDirty()) from one pixel buffer to the
+//   other; afterward, no pixel is dirty.
+// Parameters:
+//   dst:O  - Pixel buffer to copy to.
+//   src:I  - Pixel buffer to copy from.
+// Returns:    true iff any pixel was copied.
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_dirtyMap:IO
+//-----------------------------------------------------------------------------
+static boolean syncPixels(uint8 *dst, const uint8 *src)
+{
+  uint16  offs;
+  uint16  mapIdx;
+  uint16  pixNum;
+  uint8   bits;
+  boolean copied = false;
+
+  for (mapIdx = 0; (mapIdx << 3) < m_ledStripLen; mapIdx++)
+  {
+    bits = m_dirtyMap[mapIdx];
+    if (0 == bits)
+      continue;
+    m_dirtyMap[mapIdx] = 0;
+    copied = true;
+
+    pixNum = mapIdx << 3;
+    if ( (0xFF == bits) && ((pixNum + 8) <= m_ledStripLen) )
+    {
+      offs = pixNum * LEDS_PER_PIX;
+      memcpy(&dst[offs], &src[offs], 8 * LEDS_PER_PIX);
+      continue;
+    }
+    for ( ; (bits != 0) && (pixNum < m_ledStripLen); bits >>= 1, pixNum++)
+    {
+      if (bits & 1)
+      {
+        offs = pixNum * LEDS_PER_PIX;
+        memcpy(&dst[offs], &src[offs], LEDS_PER_PIX);
+      }
+    }
+  }
+  return copied;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: pixelPoolInit
+//   Lay out the static pixel pool for the strip: the dirty pixel map first,
+//   followed by the saved pixels. These are saved in full if there's room,
+//   and as a palette-compressed snapshot (see savePalette()) otherwise.
+//   (Scenes usually use only a handful of colours.)
 // Parameters: (none)
 // Returns:    (none)
 // Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_numPixelBytes:I
+//   m_dirtyMap:O
+//   m_saveMode:O
 //   m_savedLeds:O
+//   m_savedPal:O
 //-----------------------------------------------------------------------------
-static inline void restorePixels(void)
+void pixelPoolInit(void)
 {
-  memcpy(m_pPixels, m_savedLeds, m_numPixelBytes);
+  uint16 mapLen = DIRTY_MAP_LEN(m_ledStripLen);
+  uint16 room = PIXEL_POOL_SIZE - mapLen;
+
+  m_dirtyMap = m_pixelPool;
+  memset(m_dirtyMap, 0xFF, mapLen);  // Nothing saved yet
+  m_savedPal = &m_pixelPool[mapLen];
+  m_savedLeds = m_savedPal;
+  if (m_numPixelBytes <= room)
+  {
+    m_saveMode = SAVE_FULL;
+  }
+  else if ( (SAVE_PAL_LEN * LEDS_PER_PIX + ((m_ledStripLen + 1) >> 1))
+            <= room )
+  {
+    m_saveMode = SAVE_PALETTE;
+    m_savedLeds = &m_savedPal[SAVE_PAL_LEN * LEDS_PER_PIX];
+  }
+  else
+  {
+    m_saveMode = SAVE_NONE;
+  }
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrNone
-//   No-operation WASP command handler.
-// Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Function: nibbleGet
+//   Get an entry of an array of 4-bit values, packed two per byte.
+// Parameters:
+//   buf:I  - The array.
+//   n:I    - Index of the entry.
+// Returns:    The entry's value.
 // Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrNone(void)
+static inline uint8 nibbleGet(const uint8 *buf, uint16 n)
 {
-  return WASPCMD_NONE;
+  return ( (n & 1) ? (buf[n >> 1] >> 4) : (buf[n >> 1] & 0x0F) );
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrGroup
-//   Record my neighbouring nodes.
-// Parameters:     (none)
-// Returns:  WASPCMD_NONE
-// Inputs/Outputs:
-//   m_radioInBuf:I
-//   m_myGroupId:O
-//   m_leftNeighbour:O
-//   m_rightNeighbour:O
-//   m_selfShift:O
-//   m_radioInBufPos:IO
+// Function: nibbleSet
+//   Set an entry of an array of 4-bit values, packed two per byte.
+// Parameters:
+//   buf:IO  - The array.
+//   n:I     - Index of the entry.
+//   k:I     - The entry's new value.
+// Returns:    (none)
+// Inputs/Outputs: (none)
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrGroup(void)
+static inline void nibbleSet(uint8 *buf, uint16 n, uint8 k)
 {
-  uint8 *buf;
-  uint8  tmpGroup, tmpLeft, tmpRight;
+  if (n & 1)
+    buf[n >> 1] = (buf[n >> 1] & 0x0F) | (k << 4);
+  else
+    buf[n >> 1] = (buf[n >> 1] & 0xF0) | (k & 0x0F);
+}
 
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  tmpGroup = *buf++;
-  tmpLeft = *buf++;
-  tmpRight = *buf++;
-  m_radioInBufPos += 3;
 
-  // Confirm that this is a unicast command.
-  if (m_dstNodeId != m_myNodeId)
-  {
-    dbgPrintln(FLASH("***GROUP: Ignore broadcast command"));
-    return WASPCMD_NONE;
-  }
+//-----------------------------------------------------------------------------
+// Function: paletteFind
+//   Look up a pixel colour in a palette.
+// Parameters:
+//   pal:I         - The palette.
+//   numColours:I  - # of colours in the palette.
+//   pixel:I       - The pixel colour.
+// Returns:    Index of the colour in the palette; numColours if not found.
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+static uint8 paletteFind(const uint8 *pal, uint8 numColours,
+                         const uint8 *pixel)
+{
+  uint8 k;
 
-  if ( (tmpGroup < FIRST_GROUP) || (tmpGroup >= (FIRST_GROUP + MAX_GROUPS)) )
+  for (k = 0; k < numColours; k++, pal += LEDS_PER_PIX)
   {
-    logPrint(FLASH("***GROUP: Invalid WASP slave group Id - "));
-    logPrintln(tmpGroup);
-    return WASPCMD_NONE;
+    if ( (pal[0] == pixel[0]) && (pal[1] == pixel[1]) &&
+         (pal[2] == pixel[2]) )
+      break;
   }
+  return k;
+}
 
-  m_myGroupId = tmpGroup;
-  if (tmpLeft == m_myNodeId)
+
+//-----------------------------------------------------------------------------
+// Function: savePalette
+//   Save the current pixel colours as a palette of up to SAVE_PAL_LEN
+//   colours, and a 4-bit palette index per pixel. If there are more colours
+//   than that, the previous snapshot is kept instead.
+// Parameters: (none)
+// Returns:    true iff the pixel colours were saved.
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_pPixels:I
+//   m_dirtyMap:O
+//   m_savedLeds:O
+//   m_savedPal:O
+//-----------------------------------------------------------------------------
+static boolean savePalette(void)
+{
+  uint8   pal[SAVE_PAL_LEN * LEDS_PER_PIX];
+  uint8   numColours = 0;
+  uint8  *pixel;
+  uint16  i;
+  uint8   k = 0;
+
+  // Collect the palette first, so that a failure leaves the old snapshot.
+  pixel = m_pPixels;
+  for (i = 0; i < m_ledStripLen; i++, pixel += LEDS_PER_PIX)
   {
-    if (tmpRight == m_myNodeId)
-    {
-      // left = right = me. Ok, We're an isolated world unto ourself.
-      m_leftNeighbour = tmpLeft;
-      m_rightNeighbour = tmpRight;
-      m_selfShift = true;
-    }
-    else
+    if (paletteFind(pal, numColours, pixel) < numColours)
+      continue;
+    if (SAVE_PAL_LEN == numColours)
     {
-      // left = me != right.  Not cool.
-      logPrintln(FLASH("***GROUP: L = me != R"));
-      return WASPCMD_NONE;
+      logPrintln(FLASH("***SAVE: Too many colours to save"));
+      return false;
     }
+    memcpy(&pal[numColours++ * LEDS_PER_PIX], pixel, LEDS_PER_PIX);
   }
-  else
+  memcpy(m_savedPal, pal, numColours * LEDS_PER_PIX);
+
+  pixel = m_pPixels;
+  for (i = 0; i < m_ledStripLen; i++, pixel += LEDS_PER_PIX)
   {
-    if (tmpRight == m_myNodeId)
-    {
-        // right = me != left.  Not cool.
-        logPrintln(FLASH("***GROUP: R = me != L"));
-        return WASPCMD_NONE;
-    }
-    else
-    {
-      // Ok, we have distinct neighbour(s).
-      m_leftNeighbour = tmpLeft;
-      m_rightNeighbour = tmpRight;
-      m_selfShift = false;
-    }
+    // Pixels mostly come in runs of the same colour.
+    if ( (0 == i) || (memcmp(pixel, pixel - LEDS_PER_PIX, LEDS_PER_PIX) != 0) )
+      k = paletteFind(m_savedPal, numColours, pixel);
+    nibbleSet(m_savedLeds, i, k);
   }
-
-//??JVS
-//  logPrint(FLASH("Grp="));
-//  logPrintln(m_myGroupId);
-//  logPrint(FLASH("L="));
-//  logPrintln(m_leftNeighbour);
-//  logPrint(FLASH("R="));
-//  logPrintln(m_rightNeighbour);
-  
-  return WASPCMD_NONE;
+  memset(m_dirtyMap, 0, DIRTY_MAP_LEN(m_ledStripLen));
+  return true;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrState
-//   Respond to state control commands.
-// Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Function: restorePalette
+//   Restore the dirty pixels (see markDirty()) from the palette-compressed
+//   snapshot; afterward, no pixel is dirty.
+// Parameters: (none)
+// Returns:    true iff any pixel colour was restored.
 // Inputs/Outputs:
-//   m_radioInBuf:I
-//   m_radioInBufPos:IO
-//   m_pixelShowSuspend:O
-//   m_updatePixels:O
+//   m_ledStripLen:I
+//   m_savedLeds:I
+//   m_savedPal:I
+//   m_dirtyMap:IO
+//   m_pPixels:O
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrState(void)
+static boolean restorePalette(void)
 {
-  uint8 *buf;
-  uint8  opts;
-  uint8  saveRestore;
-  uint8  suspendResume;
+  uint16  i;
+  uint8   k;
+  boolean restored = false;
 
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  opts = *buf++; // default is red
-  m_radioInBufPos += 1;
-  
-  saveRestore = opts & (F_SAVE | F_RESTORE);
-  suspendResume = opts & (F_SUSPEND | F_RESUME);
-  
-  // Validate parameters
-  if ( saveRestore == (F_SAVE | F_RESTORE) )
-  {
-    // Both bits can't be set. Ignore the command.
-    return WASPCMD_NONE;
-  }
-  if ( suspendResume == (F_SUSPEND | F_RESUME) )
+  for (i = 0; i < m_ledStripLen; i++)
   {
-    // Both bits can't be set. Ignore the command.
-    return WASPCMD_NONE;
+    if (0 == m_dirtyMap[i >> 3])
+    {
+      i |= 7;  // Skip the rest of the clean byte
+      continue;
+    }
+    if ( !(m_dirtyMap[i >> 3] & (1 << (i & 7))) )
+      continue;
+    k = nibbleGet(m_savedLeds, i);
+    memcpy(&m_pPixels[i * LEDS_PER_PIX], &m_savedPal[k * LEDS_PER_PIX],
+           LEDS_PER_PIX);
+    restored = true;
   }
+  memset(m_dirtyMap, 0, DIRTY_MAP_LEN(m_ledStripLen));
+  return restored;
+}
 
-  // Update pixel strip state accordingly
-  if (saveRestore)
-  {
-    if (saveRestore & F_SAVE)
-      savePixels();
-    else
-      restorePixels();
-      m_updatePixels = true;
-  }
-  
-  if (suspendResume)
+
+//-----------------------------------------------------------------------------
+// Function: savePixels
+//   Save the current pixel colours (or their palette indices, in indexed
+//   colour mode).
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_palMode:I
+//   m_pixIdx:I
+//   m_pPixels:I
+//   m_saveMode:I
+//   m_dirtyMap:IO
+//   m_savedLeds:O
+//-----------------------------------------------------------------------------
+static void savePixels(void)
+{
+  if ( m_palMode && (m_saveMode != SAVE_NONE) )
+    memcpy(m_savedLeds, m_pixIdx, (m_ledStripLen + 1) >> 1);
+  else if (SAVE_FULL == m_saveMode)
+    (void)syncPixels(m_savedLeds, m_pPixels);
+  else if (SAVE_PALETTE == m_saveMode)
+    (void)savePalette();
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: restorePixels
+//   Restore the previously saved pixel colours.
+// Parameters: (none)
+// Returns:    true iff any pixel colour was restored.
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_palMode:I
+//   m_saveMode:I
+//   m_savedLeds:I
+//   m_dirtyMap:IO
+//   m_pixIdx:O
+//   m_pPixels:O
+//-----------------------------------------------------------------------------
+static boolean restorePixels(void)
+{
+  if ( m_palMode && (m_saveMode != SAVE_NONE) )
   {
-    m_pixelShowSuspend = ( (suspendResume & F_SUSPEND) != 0 );
+    memcpy(m_pixIdx, m_savedLeds, (m_ledStripLen + 1) >> 1);
+    palExpand(0, m_ledStripLen);
+    return true;
   }
-    
-  return WASPCMD_NONE;
+  else if (SAVE_FULL == m_saveMode)
+    return syncPixels(m_pPixels, m_savedLeds);
+  else if (SAVE_PALETTE == m_saveMode)
+    return restorePalette();
+  return false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrBackground
-//   Set and save the background colour for all pixels.
-// Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Function: palNearest
+//   Find the palette entry nearest to a colour.
+// Parameters:
+//   r:I  - Red intensity.
+//   g:I  - Green intensity.
+//   b:I  - Blue intensity.
+// Returns:    Index of the nearest palette entry.
 // Inputs/Outputs:
-//   m_ledStripLen:I
 //   m_offsBlue:I
 //   m_offsGreen:I
 //   m_offsRed:I
-//   m_radioInBuf:I
-//   m_pPixels:IO
-//   m_radioInBufPos:IO
-//   m_updatePixels:O
+//   m_palette:I
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrBackground(void)
+uint8 palNearest(uint8 r, uint8 g, uint8 b)
 {
-  uint8   red, green, blue;
-  uint8  *buf;
-  uint8  *pixels;
-  uint8   numPixels;
-  uint16  i;
-  
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  red   = *buf++; // default is red
-  green = *buf++; // default is green
-  blue  = *buf++; // blue
-  m_radioInBufPos += 3;
-  
-  
-  //  Set the pixel colours directly
-  pixels = m_pPixels;
-  for (i = m_ledStripLen; i != 0; i--)
+  const uint8 *pal = m_palette;
+  uint16 dist;
+  uint16 bestDist = MAXUINT16;
+  uint8  best = 0;
+
+  for (uint8 k = 0; k < PAL_LEN; k++, pal += LEDS_PER_PIX)
   {
-    *(pixels + m_offsRed)   = red;
-    *(pixels + m_offsGreen) = green;
-    *(pixels + m_offsBlue)  = blue;
-    pixels += LEDS_PER_PIX;
+    dist = abs((int16)pal[m_offsRed] - r) +
+           abs((int16)pal[m_offsGreen] - g) +
+           abs((int16)pal[m_offsBlue] - b);
+    if (dist < bestDist)
+    {
+      bestDist = dist;
+      best = k;
+      if (0 == dist)
+        break;
+    }
   }
-  
-  savePixels();
-  m_updatePixels = true;
-  
-  return WASPCMD_NONE;
+  return best;
 }
 
- 
+
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrLine
-//   Draw a line.
-// Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Function: palExpand
+//   Colour a range of pixels from their palette indices.
+// Parameters:
+//   first:I  - First pixel number of the range.
+//   count:I  - Number of pixels in the range.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_palette:I
+//   m_pixIdx:I
+//   m_pPixels:O
+//-----------------------------------------------------------------------------
+void palExpand(uint16 first, uint16 count)
+{
+  uint8 *pixels = &m_pPixels[first * LEDS_PER_PIX];
+
+  markDirty(first, count);
+  for ( ; count != 0; count--, first++, pixels += LEDS_PER_PIX)
+  {
+    memcpy(pixels, &m_palette[nibbleGet(m_pixIdx, first) * LEDS_PER_PIX],
+           LEDS_PER_PIX);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: palFill
+//   Set a range of pixels to a palette entry.
+// Parameters:
+//   first:I  - First pixel number of the range.
+//   count:I  - Number of pixels in the range.
+//   k:I      - Index of the palette entry.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_pixIdx:O
+//   m_pPixels:O
+//-----------------------------------------------------------------------------
+void palFill(uint16 first, uint16 count, uint8 k)
+{
+  for (uint16 i = 0; i < count; i++)
+    nibbleSet(m_pixIdx, first + i, k);
+  palExpand(first, count);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: palIndex
+//   Map a range of pixels to the palette: each pixel is set to its nearest
+//   palette entry.
+// Parameters:
+//   first:I  - First pixel number of the range.
+//   count:I  - Number of pixels in the range.
+// Returns:    (none)
 // Inputs/Outputs:
-//   m_ledStripLen:I
 //   m_offsBlue:I
 //   m_offsGreen:I
 //   m_offsRed:I
-//   m_radioInBuf:I
-//   m_radioInBufPos:IO
-//   m_updatePixels:O
+//   m_pixIdx:O
+//   m_pPixels:IO
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrLine(void)
+void palIndex(uint16 first, uint16 count)
 {
-  uint8  *buf;
-  uint8  *pixels;
-  uint16  start;
-  uint16  len;
-  uint8   red, green, blue;
-  uint8   i;
+  uint8 *pixel = &m_pPixels[first * LEDS_PER_PIX];
 
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  start = *buf++;
-  len   = *buf++;
-  red   = *buf++;
-  green = *buf++;
-  blue  = *buf++;
-  m_radioInBufPos += 5;
-  
-  // Validate parameters
-  if ( (start + len) > m_ledStripLen)
-    return WASPCMD_NONE;
-    
-  // Set the pixel colours directly
-  pixels = &m_pPixels[start * LEDS_PER_PIX];
-  for (i = len; i != 0; i--)
+  for (uint16 i = 0; i < count; i++, pixel += LEDS_PER_PIX)
   {
-    *(pixels + m_offsRed)   = red;
-    *(pixels + m_offsGreen) = green;
-    *(pixels + m_offsBlue)  = blue;
-    pixels += LEDS_PER_PIX;
+    nibbleSet(m_pixIdx, first + i,
+              palNearest(pixel[m_offsRed], pixel[m_offsGreen],
+                         pixel[m_offsBlue]));
   }
-  m_updatePixels = true;
-  
-  return WASPCMD_NONE;
+  palExpand(first, count);
 }
-    
-    
+
+
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrShift
-//   Shift pixels.
-// Parameters:     (none)
-// Returns:  WASPCMD_SHIFT, if SHIFT command handling is still in progress;
-//           WASPCMD_NONE,  if SHIFT command has completed or timed out.
+// Function: palShiftOut
+//   Shift the pixels' palette indices, in indexed colour mode, recording the
+//   indices of the pixels shifted out of the strip (in the order they were
+//   shifted out).
+// Parameters:
+//   num:I         - # of pixels to shift.
+//   shiftRight:I  - true to shift to the right; false to shift left.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_pixIdx:IO
+//   m_pPixels:O
+//   m_shiftOutLeds:O
+//-----------------------------------------------------------------------------
+void palShiftOut(uint8 num, boolean shiftRight)
+{
+  uint16 len = m_ledStripLen;
+  uint16 n;
+
+  if (shiftRight)
+  {
+    for (n = 0; n < num; n++)
+      m_shiftOutLeds[n] = nibbleGet(m_pixIdx, len - num + n);
+    for (n = len; n > num; n--)
+      nibbleSet(m_pixIdx, n - 1, nibbleGet(m_pixIdx, n - 1 - num));
+  }
+  else
+  {
+    for (n = 0; n < num; n++)
+      m_shiftOutLeds[n] = nibbleGet(m_pixIdx, n);
+    for (n = num; n < len; n++)
+      nibbleSet(m_pixIdx, n - num, nibbleGet(m_pixIdx, n));
+  }
+  palExpand(0, len);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: shiftIn
+//   Shift (part of) the reported pixels into the end of the strip vacated
+//   by a SHIFT. The data are (r,g,b) bytes, or palette indices in indexed
+//   colour mode.
+// Parameters:
+//   src:I         - The data to shift in.
+//   offs:I        - Offset of src[0] within the shifted-out data.
+//   count:I       - # of data bytes in src.
+//   numBytes:I    - Total # of data bytes being shifted in.
+//   shiftRight:I  - true if shifting to the right; false if shifting left.
+// Returns:    (none)
 // Inputs/Outputs:
 //   m_ledStripLen:I
-//   m_ledStripWiring:I
-//   m_leftNeighbour:I
-//   m_myNodeId:I
 //   m_numPixelBytes:I
+//   m_palMode:I
+//   m_pixIdx:O
+//   m_pPixels:O
+//-----------------------------------------------------------------------------
+void shiftIn(const uint8 *src, uint8 offs, uint8 count, uint8 numBytes,
+             boolean shiftRight)
+{
+  uint16 first = offs;
+
+  if (m_palMode)
+  {
+    if (!shiftRight)
+      first += m_ledStripLen - numBytes;
+    for (uint8 n = 0; n < count; n++)
+      nibbleSet(m_pixIdx, first + n, src[n]);
+    palExpand(first, count);
+  }
+  else
+  {
+    if (!shiftRight)
+      first += m_numPixelBytes - numBytes;
+    memcpy(&m_pPixels[first], src, count);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: palLeave
+//   Switch back to direct colour mode, if in indexed colour mode, as for
+//   WASPCMD_PALETTE with n = 0. The special effects draw in direct colour,
+//   so they leave indexed mode when they start.
+// Parameters:     (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_palMode:IO
+//-----------------------------------------------------------------------------
+void palLeave(void)
+{
+  if (m_palMode)
+  {
+    m_palMode = false;
+    markDirty(0, m_ledStripLen);
+    savePixels();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrNone
+//   No-operation WASP command handler.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrNone(void)
+{
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrGroup
+//   Record my neighbouring nodes.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
 //   m_radioInBuf:I
-//   m_rightNeighbour:I
-//   m_selfShift:I
-//   m_srcNodeId:I
+//   m_myGroupId:O
+//   m_leftNeighbour:O
+//   m_rightNeighbour:O
+//   m_selfShift:O
 //   m_radioInBufPos:IO
-//   m_shiftInLeds:IO
-//   m_shiftOutLeds:IO
-//   m_radioOutBuf:o
-//   m_radioOutBufPos:O
-//   m_updatePixels:O
-// Note:
-//   This handler gets called repeatedly when we have other nodes as
-//   neighbours and a SHIFT command is in effect. The various stages need to
-//   confirm whether or not an actual WASP message was received.
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrShift(void)
+WaspCmd_t waspCmdHdlrGroup(void)
 {
-//  const int8 k_TxStartOffs =  6; // Millisecond delay offset before Tx.
-//  const int8 k_TxDeadOffs  =  5; // Millisecond deadline offset for Tx.
-  const int8 k_TxStartOffs =  0; // Millisecond delay offset before Tx.
-  const int8 k_TxDeadOffs  =  7; // Millisecond deadline offset for Tx.
-  static uint32  startTime = 0;
-  static uint32  timeout = 0;
-  static uint32  releaseTime = 0;
-  static uint32  deadline = 0;
-  static uint16  numShifts = 0;
-  static uint8   stage = PX_SHIFT_START; // Processing stage.
-  static int16   num = 0;                // # pixels to shift.
-  static uint8   numShiftBytes = 0;      // # of colour bytes involved in shift
-  static uint8   neighbour = 0;
-  static boolean shiftRight = true;      // TRUE = shift to the right; else left
-  uint32   currentTime;
-  uint8    rxCmd;
-  uint8   *buf;
-  uint8   *srcPixels;
-  uint8   *dstPixels;
-  uint8    i;
+  uint8 *buf;
+  uint8  tmpGroup, tmpLeft, tmpRight;
 
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  tmpGroup = *buf++;
+  tmpLeft = *buf++;
+  tmpRight = *buf++;
+  m_radioInBufPos += 3;
 
-  rxCmd = m_radioInBuf[0];
-  m_updatePixels = false; // Default is don't yet update the pixels.
-  
-  /*------------  PX_SHIFT_START stage (command start)  -----------------*/
-  if (PX_SHIFT_START == stage)
+  // Confirm that this is a unicast command.
+  if (m_dstNodeId != m_myNodeId)
   {
-    // Did we actually receive a new command?
-    if (rxCmd != WASPCMD_SHIFT)
+    dbgPrintln(FLASH("***GROUP: Ignore broadcast command"));
+    return WASPCMD_NONE;
+  }
+
+  if ( (tmpGroup < FIRST_GROUP) || (tmpGroup >= (FIRST_GROUP + MAX_GROUPS)) )
+  {
+    logPrint(FLASH("***GROUP: Invalid WASP slave group Id - "));
+    logPrintln(tmpGroup);
+    return WASPCMD_NONE;
+  }
+
+  m_myGroupId = tmpGroup;
+  if (tmpLeft == m_myNodeId)
+  {
+    if (tmpRight == m_myNodeId)
     {
-      // Hmm. So why were we called. Anyway, there's nothing more to do.
-      return WASPCMD_NONE;
+      // left = right = me. Ok, We're an isolated world unto ourself.
+      m_leftNeighbour = tmpLeft;
+      m_rightNeighbour = tmpRight;
+      m_selfShift = true;
     }
-    
-    startTime = millis();
-    numShifts++;
-        
-    // Confirm that the controller sent the command.
-    if (m_srcNodeId != CONTROLLERID)
+    else
     {
-      // Only the controller can request the command. Ignore the
-      // message.
+      // left = me != right.  Not cool.
+      logPrintln(FLASH("***GROUP: L = me != R"));
       return WASPCMD_NONE;
     }
-//JVS
-//logPrint(FLASH(">"));
-//logPrintln(startTime);
-    
-    // Retrieve first parameter
-    buf = &m_radioInBuf[m_radioInBufPos];
-    num = (int8)*buf++;
-    m_radioInBufPos += 1;
-
-    if (num > 0)
+  }
+  else
+  {
+    if (tmpRight == m_myNodeId)
     {
-      shiftRight = true;
+        // right = me != left.  Not cool.
+        logPrintln(FLASH("***GROUP: R = me != L"));
+        return WASPCMD_NONE;
     }
     else
     {
-      shiftRight = false;
-      num = -num;
+      // Ok, we have distinct neighbour(s).
+      m_leftNeighbour = tmpLeft;
+      m_rightNeighbour = tmpRight;
+      m_selfShift = false;
     }
-    
-    // Validate parameters
-    if (num > MAX_SHIFT_SIZE)
-      return WASPCMD_NONE;
-    if (num > m_ledStripLen)
-      return WASPCMD_NONE;
+  }
+
+//??JVS
+//  logPrint(FLASH("Grp="));
+//  logPrintln(m_myGroupId);
+//  logPrint(FLASH("L="));
+//  logPrintln(m_leftNeighbour);
+//  logPrint(FLASH("R="));
+//  logPrintln(m_rightNeighbour);
+  
+  return WASPCMD_NONE;
+}
 
 
-    /* Command is valid. Now shift the pixels outward, recording the pixels
-     * that have shifted out of the strip.
-     */
-    numShiftBytes = num * LEDS_PER_PIX;
-    if (shiftRight)
-    {
-      // Save pixels that are shifting out
-      srcPixels = &m_pPixels[m_numPixelBytes - numShiftBytes];
-      dstPixels = &m_shiftOutLeds[0];
-      for (i = numShiftBytes; i != 0; i--)
-        *dstPixels++ = *srcPixels++;
-      
-      // Shift the pixels over to the right.
-      srcPixels = &m_pPixels[m_numPixelBytes - 1 - numShiftBytes];
-      dstPixels = &m_pPixels[m_numPixelBytes - 1];
-      for (i = m_numPixelBytes - numShiftBytes; i != 0; i--)
-        *dstPixels-- = *srcPixels--;
-    }
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrState
+//   Respond to state control commands.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//   m_pixelShowSuspend:O
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrState(void)
+{
+  uint8 *buf;
+  uint8  opts;
+  uint8  saveRestore;
+  uint8  suspendResume;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  opts = *buf++; // default is red
+  m_radioInBufPos += 1;
+  
+  saveRestore = opts & (F_SAVE | F_RESTORE);
+  suspendResume = opts & (F_SUSPEND | F_RESUME);
+  
+  // Validate parameters
+  if ( saveRestore == (F_SAVE | F_RESTORE) )
+  {
+    // Both bits can't be set. Ignore the command.
+    return WASPCMD_NONE;
+  }
+  if ( suspendResume == (F_SUSPEND | F_RESUME) )
+  {
+    // Both bits can't be set. Ignore the command.
+    return WASPCMD_NONE;
+  }
+
+  // Update pixel strip state accordingly
+  if (saveRestore)
+  {
+    if (saveRestore & F_SAVE)
+      savePixels();
     else
-    {
-      // Shifting left
-      
-      // Save pixels that are shifting out
-      srcPixels = &m_pPixels[0];
-      dstPixels = &m_shiftOutLeds[0];
-      for (i = numShiftBytes; i !=0; i--)
-        *dstPixels++ = *srcPixels++;
-        
-      // Shift the pixels over to the left.
-      srcPixels = &m_pPixels[numShiftBytes];
-      dstPixels = &m_pPixels[0];
-      for (i = m_numPixelBytes - numShiftBytes; i != 0; i--)
-        *dstPixels++ = *srcPixels++;
-    }
-    
-    if (m_selfShift)
-    {
-      // We don't have neighbouring nodes. So shift in the saved pixels now.
-      // The command will then be finished.
+      restorePixels();
       m_updatePixels = true;
-      if (shiftRight)
-      {      
-        srcPixels = &m_shiftOutLeds[0];
-        dstPixels = &m_pPixels[0];
-        for (i = numShiftBytes; i !=0; i--)
-          *dstPixels++ = *srcPixels++;
-      }
-      else
-      {
-        srcPixels = &m_shiftOutLeds[0];
-        dstPixels = &m_pPixels[m_numPixelBytes - numShiftBytes];
-        for (i = numShiftBytes; i !=0; i--)
-          *dstPixels++ = *srcPixels++;
-      }
-      return WASPCMD_NONE;
-    }
-    else
-    {
-      // Interaction with neighbours is required. Determine to which
-      // neighbour to report and from which neighbour to await a reply.
-      // The relative WASP node ID's determine what the next stage
-      // should be. Reponses are expected in sequence with the lowest
-      // numbered node transmitting first.
-      
-      timeout = startTime + CMD_TIMEOUT;
-      
-      if (shiftRight)
-      {
-        // Who is first to transmit--us or our left neighbour?
-        if (m_leftNeighbour < m_myNodeId)
-        {
-          neighbour = m_leftNeighbour;
-          stage = PX_SHIFT_WAIT1;  // Left neighbour Tx first.
-        }
-        else
-        {
-          stage = PX_SHIFT_RESP;
-        }
-      }
-      else
-      {
-        // Who is first to transmit--us or our right neighbour?
-        if (m_rightNeighbour < m_myNodeId)
-        {
-          neighbour = m_rightNeighbour;
-          stage = PX_SHIFT_WAIT1;  // Right neighbour Tx first.
-        }
-        else
-        {
-          stage = PX_SHIFT_RESP;
-        }
-      }
-      
-      tmrUpdateOmet(TMR_SHFT_STRT);
-      
-      if (PX_SHIFT_RESP == stage)
-      {
-        releaseTime = startTime + (m_myNodeId - FIRST_SLAVE) * SLAVE_TX_WIND;
-        deadline = releaseTime + SLAVE_TX_WIND - k_TxDeadOffs;
-        releaseTime += k_TxStartOffs;
-      }
-      else
-      {
-        releaseTime = startTime + (neighbour - FIRST_SLAVE) * SLAVE_TX_WIND;
-        deadline = releaseTime + SLAVE_TX_WIND;
-      }
-      return WASPCMD_SHIFT;
-    } /* else - !m_selfShift */
-  }  /* if (PX_SHIFT_START == stage) */
+  }
+  
+  if (suspendResume)
+  {
+    m_pixelShowSuspend = ( (suspendResume & F_SUSPEND) != 0 );
+  }
+    
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrBackground
+//   Set and save the background colour for all pixels.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_palMode:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_radioInBuf:I
+//   m_pPixels:IO
+//   m_radioInBufPos:IO
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrBackground(void)
+{
+  uint8   red, green, blue;
+  uint8  *buf;
+  uint8  *pixels;
+  uint8   numPixels;
+  uint16  i;
+  
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  red   = *buf++; // default is red
+  green = *buf++; // default is green
+  blue  = *buf++; // blue
+  m_radioInBufPos += 3;
+  
+  
+  //  Set the pixel colours directly
+  if (m_palMode)
+  {
+    palFill(0, m_ledStripLen, palNearest(red, green, blue));
+  }
   else
   {
-    // Before proceeding, we need to check if:
-    //   - The command has timed out, or
-    //   - The Controller, for whatever reason, sent a new command.
-    // In either case, we need to abort the current command, updating
-    // the pixels to whatever state with which we're now stuck.
-    currentTime = millis();
-    if (    (currentTime > timeout)
-         || ( (WASPCMD_SHIFT == rxCmd) && (m_srcNodeId == CONTROLLERID) )
-       )
+    pixels = m_pPixels;
+    for (i = m_ledStripLen; i != 0; i--)
     {
-//JVS
-if (currentTime > timeout)
-{
-  //logPrint(FLASH("!TO:"));
-  //logPrintln(currentTime);
-  logPrintln("!");
-}
-else
-//  logPrintln(FLASH("??"));
-      m_updatePixels = true;
-//m_updatePixels = false;
-      stage = PX_SHIFT_START;
-      return WASPCMD_NONE;
+      *(pixels + m_offsRed)   = red;
+      *(pixels + m_offsGreen) = green;
+      *(pixels + m_offsBlue)  = blue;
+      pixels += LEDS_PER_PIX;
     }
+    markDirty(0, m_ledStripLen);
   }
   
+  savePixels();
+  m_updatePixels = true;
   
-  /*------ PX_SHIFT_WAIT1 / PX_SHIFT_WAIT2 stage (await neighbour Tx) ------*/
-  if ( (PX_SHIFT_WAIT1 == stage) || (PX_SHIFT_WAIT2 == stage) )
-  {
-    currentTime = millis();
+  return WASPCMD_NONE;
+}
 
-    if (currentTime >= deadline)
-    {
-      // Our neighbour missed its chance. There's not much we can do:
-      //   - We can't shift in any pixels. So just leave them as is.
-      //   - Move on to the next stage.
-//JVS
-//logPrint(stage);
-//logPrint(FLASH("  #"));
-//logPrintln(numShifts);
-logPrintln("@");
-      if (PX_SHIFT_WAIT1 == stage)
-      {
-        // Move on to the next stage.
-        stage = PX_SHIFT_RESP;
-        releaseTime = startTime + (m_myNodeId - FIRST_SLAVE) * SLAVE_TX_WIND;
-        deadline = releaseTime + SLAVE_TX_WIND - k_TxDeadOffs;
-        releaseTime += k_TxStartOffs;
-        //dbgPrintln(FLASH("***SHIFT: Missed Rx - WAIT1"));
-        return WASPCMD_SHIFT;
-      }
-      else
-      {
-        // There's nothing more we can do. Just make sure that the
-        // pixels get updated (for better or worse).
-        stage = PX_SHIFT_START;
-        m_updatePixels = true;
-        //dbgPrintln(FLASH("***SHIFT: Missed Rx - WAIT2"));
-        return WASPCMD_NONE;
-      }
-    }
+ 
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrLine
+//   Draw a line.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_palMode:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrLine(void)
+{
+  uint8  *buf;
+  uint8  *pixels;
+  uint16  start;
+  uint16  len;
+  uint8   red, green, blue;
+  uint8   i;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  start = *buf++;
+  len   = *buf++;
+  red   = *buf++;
+  green = *buf++;
+  blue  = *buf++;
+  m_radioInBufPos += 5;
+  
+  // Validate parameters
+  if ( (start + len) > m_ledStripLen)
+    return WASPCMD_NONE;
     
-    // Did we actually receive a new msg?
+  // Set the pixel colours directly
+  if (m_palMode)
+  {
+    palFill(start, len, palNearest(red, green, blue));
+    m_updatePixels = true;
+    return WASPCMD_NONE;
+  }
+  pixels = &m_pPixels[start * LEDS_PER_PIX];
+  for (i = len; i != 0; i--)
+  {
+    *(pixels + m_offsRed)   = red;
+    *(pixels + m_offsGreen) = green;
+    *(pixels + m_offsBlue)  = blue;
+    pixels += LEDS_PER_PIX;
+  }
+  markDirty(start, len);
+  m_updatePixels = true;
+  
+  return WASPCMD_NONE;
+}
+    
+    
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrShift
+//   Shift pixels.
+// Parameters:     (none)
+// Returns:  WASPCMD_SHIFT, if SHIFT command handling is still in progress;
+//           WASPCMD_NONE,  if SHIFT command has completed or timed out.
+// Inputs/Outputs:
+//   m_dstNodeId:I
+//   m_ledStripLen:I
+//   m_ledStripWiring:I
+//   m_leftNeighbour:I
+//   m_myGroupId:I
+//   m_myNodeId:I
+//   m_numPixelBytes:I
+//   m_palMode:I
+//   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_rightNeighbour:I
+//   m_selfShift:I
+//   m_srcNodeId:I
+//   m_radioInBufPos:IO
+//   m_shiftOutLeds:IO
+//   m_pPixels:O
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//   m_updatePixels:O
+// Note:
+//   This handler gets called repeatedly when we have other nodes as
+//   neighbours and a SHIFT command is in effect. The various stages need to
+//   confirm whether or not an actual WASP message was received. The pixels
+//   aren't shown while it's in effect (see processWaspCommand()).
+//   Reports longer than SHIFT_FRAME_BYTES are sent as several frames, one
+//   per call of the RESP stage, and the WAIT stages collect frames (in any
+//   order) until all of them have arrived.
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrShift(void)
+{
+//  const int8 k_TxStartOffs =  6; // Millisecond delay offset before Tx.
+//  const int8 k_TxDeadOffs  =  5; // Millisecond deadline offset for Tx.
+  const int8 k_TxStartOffs =  0; // Millisecond delay offset before Tx.
+  const int8 k_TxDeadOffs  =  7; // Millisecond deadline offset for Tx.
+  static uint32  startTime = 0;
+  static uint32  timeout = 0;
+  static uint32  releaseTime = 0;
+  static uint32  deadline = 0;
+  static uint16  numShifts = 0;
+  static uint8   stage = PX_SHIFT_START; // Processing stage.
+  static int16   num = 0;                // # pixels to shift.
+  static uint8   numShiftBytes = 0;      // # of colour bytes involved in shift
+  static uint8   neighbour = 0;
+  static uint8   nbrSlot = 0;            // TDMA slot of neighbour
+  static uint8   mySlot = 0;             // TDMA slots of us and neighbours
+  static uint8   leftSlot = 0;
+  static uint8   rightSlot = 0;
+  static uint8   numSlots = MAX_SLAVES;  // # of TDMA slots in the cycle
+  static uint16  slotWind = SLAVE_TX_WIND; // Milliseconds per TDMA slot
+  static uint8   numFrames = 1;          // # of report frames
+  static uint8   txSeq = 0;              // Next report frame to Tx
+  static uint8   rxFrames = 0;           // Bit per report frame received
+  static boolean shiftRight = true;      // TRUE = shift to the right; else left
+  uint32   currentTime;
+  uint8    rxCmd;
+  uint8   *buf;
+  uint8   *srcPixels;
+  uint8   *dstPixels;
+  uint8    i;
+  uint8    seq;
+  uint8    offs;
+  uint8    len;
+  uint16   n;
+
+
+  rxCmd = m_radioInBuf[0];
+  
+  /*------------  PX_SHIFT_START stage (command start)  -----------------*/
+  if (PX_SHIFT_START == stage)
+  {
+    // Did we actually receive a new command?
     if (rxCmd != WASPCMD_SHIFT)
     {
-      // There's nothing yet. So just keep waiting.
-      return WASPCMD_SHIFT;
+      // Hmm. So why were we called. Anyway, there's nothing more to do.
+      return WASPCMD_NONE;
     }
-      
-    // Is the message from the expected neighbour?
-    if (m_srcNodeId != neighbour)
+    
+    startTime = millis();
+    numShifts++;
+        
+    // Confirm that the controller sent the command.
+    if (m_srcNodeId != CONTROLLERID)
     {
-      // We're still waiting to hear from our neighbour.
-      {
-        return WASPCMD_SHIFT;
-      }
+      // Only the controller can request the command. Ignore the
+      // message.
+      return WASPCMD_NONE;
     }
-      
-    // Retrieve the parameters
-    buf = &m_radioInBuf[m_radioInBufPos];
-    if (*buf++ != num)
-    {
-      // The number of expected colours is incorrect. Just ignore the
-      // message and hope there's a correct one coming.
 //JVS
-logPrint(FLASH("***SHIFT: Bad report - "));
-logPrintln(stage);
-      dbgPrint(FLASH("***SHIFT: Bad report - "));
-      dbgPrintln(stage);
-      return WASPCMD_SHIFT;
-    }
+//logPrint(FLASH(">"));
+//logPrintln(startTime);
+    
+    // Retrieve first parameter
+    buf = &m_radioInBuf[m_radioInBufPos];
+    num = (int8)*buf++;
     m_radioInBufPos += 1;
-    dstPixels = &m_shiftInLeds[0];
-    // Read in the pixel colours
-    for (i = numShiftBytes; i != 0; i--)
-      *dstPixels++ = *buf++;
-    m_radioInBufPos += numShiftBytes;
-      
-    // Shift in the pixels
-    if (shiftRight)
-    {      
-      srcPixels = &m_shiftInLeds[0];
-      dstPixels = &m_pPixels[0];
-      for (i = numShiftBytes; i !=0; i--)
-        *dstPixels++ = *srcPixels++;
-    }
-    else
+
+    // Use the group's compacted schedule, if the controller sent one and
+    // it lists us and both our neighbours. Otherwise, each node Tx's in
+    // the slot given by its node Id.
+    mySlot    = m_myNodeId - FIRST_SLAVE;
+    leftSlot  = m_leftNeighbour - FIRST_SLAVE;
+    rightSlot = m_rightNeighbour - FIRST_SLAVE;
+    numSlots  = MAX_SLAVES;
+    slotWind  = SLAVE_TX_WIND;
+    if ( (m_radioInBufPos < m_radioInBufLen) && (m_dstNodeId == m_myGroupId) )
     {
-      srcPixels = &m_shiftInLeds[0];
-      dstPixels = &m_pPixels[m_numPixelBytes - numShiftBytes];
-      for (i = numShiftBytes; i !=0; i--)
-        *dstPixels++ = *srcPixels++;
+      uint8 tmpWind = *buf++;
+      uint8 tmpNum = m_radioInBufLen - m_radioInBufPos - 1;
+      uint8 found = 0;
+
+      for (i = 0; i < tmpNum; i++, buf++)
+      {
+        if (*buf == m_myNodeId)
+        {
+          mySlot = i;
+          found |= B001;
+        }
+        if (*buf == m_leftNeighbour)
+        {
+          leftSlot = i;
+          found |= B010;
+        }
+        if (*buf == m_rightNeighbour)
+        {
+          rightSlot = i;
+          found |= B100;
+        }
+      }
+      m_radioInBufPos = m_radioInBufLen;
+
+      if ( (B111 == found) && (tmpWind > k_TxDeadOffs) )
+      {
+        numSlots = tmpNum;
+        slotWind = tmpWind;
+      }
+      else
+      {
+        mySlot    = m_myNodeId - FIRST_SLAVE;
+        leftSlot  = m_leftNeighbour - FIRST_SLAVE;
+        rightSlot = m_rightNeighbour - FIRST_SLAVE;
+      }
     }
-    if (PX_SHIFT_WAIT1 == stage)
+
+    if (num > 0)
     {
-      tmrUpdateOmet(TMR_SHFT_WT1);
+      shiftRight = true;
     }
     else
     {
-      tmrUpdateOmet(TMR_SHFT_WT2);
-    }
-      
-    // Move on to the next stage.
-    if (PX_SHIFT_WAIT1 == stage)
-    {
-      stage = PX_SHIFT_RESP;
-      releaseTime = startTime + (m_myNodeId - FIRST_SLAVE) * SLAVE_TX_WIND;
-      deadline = releaseTime + SLAVE_TX_WIND - k_TxDeadOffs;
-      releaseTime += k_TxStartOffs;
-      return WASPCMD_SHIFT;
+      shiftRight = false;
+      num = -num;
     }
-    else
-    {
-      stage = PX_SHIFT_START;
-      m_updatePixels = true;
+    
+    // Validate parameters
+    if (num > (m_palMode ? MAX_IDX_SHIFT_SIZE : SHIFT_MAX_PIX))
+      return WASPCMD_NONE;
+    if (num > m_ledStripLen)
       return WASPCMD_NONE;
-    }
-  }  /* if (PX_SHIFT_WAIT1 == stage) */
 
 
-  /*------- PX_SHIFT_RESP stage (Tx to neighbour) -----------------*/
-  if (PX_SHIFT_RESP == stage)
-  {
-    currentTime = millis();
-    if (currentTime < releaseTime)
+    /* Command is valid. Now shift the pixels outward, recording the pixels
+     * that have shifted out of the strip (as palette indices in indexed
+     * colour mode).
+     */
+    numShiftBytes = num * (m_palMode ? 1 : LEDS_PER_PIX);
+    numFrames = SHIFT_FRAMES(numShiftBytes);
+    slotWind *= numFrames;
+    txSeq = 0;
+    rxFrames = 0;
+    if (m_palMode)
     {
-      // It's not our turn to Tx yet.
-      return WASPCMD_SHIFT;
+      palShiftOut(num, shiftRight);
     }
-
-    if (currentTime <= deadline)
-    {   
-      /* We're clear to Tx now. */
-
-      //dbgPrintln(FLASH("SHIFT: Tx start..."));
-            
-      // Datafill the output buffer.
-      buf = &m_radioOutBuf[0];
-      *buf++ = WASPCMD_SHIFT;
-      *buf++ = num;
-      m_radioOutBufPos = 2;
-      srcPixels = &m_shiftOutLeds[0];
+    else if (shiftRight)
+    {
+      // Save pixels that are shifting out
+      srcPixels = &m_pPixels[m_numPixelBytes - numShiftBytes];
+      dstPixels = &m_shiftOutLeds[0];
       for (i = numShiftBytes; i != 0; i--)
-        *buf++ = *srcPixels++;
-      m_radioOutBufPos += numShiftBytes;
+        *dstPixels++ = *srcPixels++;
       
-      // Send the shifted-pixels report to the appropriate neighbour.
-      if (shiftRight)
-        neighbour = m_rightNeighbour;
-      else
-        neighbour = m_leftNeighbour;
-
-      tmrUpdateOmet(TMR_SHFT_TX0);
-      radioSendBuf(neighbour, m_radioOutBuf, m_radioOutBufPos);
-      tmrUpdateOmet(TMR_SHFT_TX1);
-      currentTime = millis();
-      if (currentTime < releaseTime)
-      {
-        logPrint(FLASH("!! #"));
-        logPrintln(numShifts);
-      }
+      // Shift the pixels over to the right.
+      srcPixels = &m_pPixels[m_numPixelBytes - 1 - numShiftBytes];
+      dstPixels = &m_pPixels[m_numPixelBytes - 1];
+      for (n = m_numPixelBytes - numShiftBytes; n != 0; n--)
+        *dstPixels-- = *srcPixels--;
     }
     else
     {
-      dbgPrintln(FLASH("***SHIFT: Missed Tx deadline"));
-//JVS
+      // Shifting left
+      
+      // Save pixels that are shifting out
+      srcPixels = &m_pPixels[0];
+      dstPixels = &m_shiftOutLeds[0];
+      for (i = numShiftBytes; i !=0; i--)
+        *dstPixels++ = *srcPixels++;
+        
+      // Shift the pixels over to the left.
+      srcPixels = &m_pPixels[numShiftBytes];
+      dstPixels = &m_pPixels[0];
+      for (n = m_numPixelBytes - numShiftBytes; n != 0; n--)
+        *dstPixels++ = *srcPixels++;
+    }
+    markDirty(0, m_ledStripLen);
+    
+    if (m_selfShift)
+    {
+      // We don't have neighbouring nodes. So shift in the saved pixels now.
+      // The command will then be finished.
+      m_updatePixels = true;
+      shiftIn(m_shiftOutLeds, 0, numShiftBytes, numShiftBytes, shiftRight);
+      return WASPCMD_NONE;
+    }
+    else
+    {
+      // Interaction with neighbours is required. Determine to which
+      // neighbour to report and from which neighbour to await a reply.
+      // The relative TDMA slots determine what the next stage
+      // should be. Reponses are expected in sequence with the lowest
+      // numbered slot transmitting first.
+      
+      timeout = startTime + (uint16)numSlots * slotWind;
+      
+      if (shiftRight)
+      {
+        // Who is first to transmit--us or our left neighbour?
+        if (leftSlot < mySlot)
+        {
+          neighbour = m_leftNeighbour;
+          nbrSlot = leftSlot;
+          stage = PX_SHIFT_WAIT1;  // Left neighbour Tx first.
+        }
+        else
+        {
+          stage = PX_SHIFT_RESP;
+        }
+      }
+      else
+      {
+        // Who is first to transmit--us or our right neighbour?
+        if (rightSlot < mySlot)
+        {
+          neighbour = m_rightNeighbour;
+          nbrSlot = rightSlot;
+          stage = PX_SHIFT_WAIT1;  // Right neighbour Tx first.
+        }
+        else
+        {
+          stage = PX_SHIFT_RESP;
+        }
+      }
+      
+      tmrUpdateOmet(TMR_SHFT_STRT);
+      
+      if (PX_SHIFT_RESP == stage)
+      {
+        releaseTime = startTime + mySlot * slotWind;
+        deadline = releaseTime + slotWind - numFrames * k_TxDeadOffs;
+        releaseTime += k_TxStartOffs;
+      }
+      else
+      {
+        releaseTime = startTime + nbrSlot * slotWind;
+        deadline = releaseTime + slotWind;
+      }
+      return WASPCMD_SHIFT;
+    } /* else - !m_selfShift */
+  }  /* if (PX_SHIFT_START == stage) */
+  else
+  {
+    // Before proceeding, we need to check if:
+    //   - The command has timed out, or
+    //   - The Controller, for whatever reason, sent a new command.
+    // In either case, we need to abort the current command, updating
+    // the pixels to whatever state with which we're now stuck.
+    currentTime = millis();
+    if (    (currentTime > timeout)
+         || ( (WASPCMD_SHIFT == rxCmd) && (m_srcNodeId == CONTROLLERID) )
+       )
+    {
+//JVS
+if (currentTime > timeout)
+{
+  //logPrint(FLASH("!TO:"));
+  //logPrintln(currentTime);
+  logPrintln("!");
+}
+else
+//  logPrintln(FLASH("??"));
+      m_updatePixels = true;
+//m_updatePixels = false;
+      stage = PX_SHIFT_START;
+      return WASPCMD_NONE;
+    }
+  }
+  
+  
+  /*------ PX_SHIFT_WAIT1 / PX_SHIFT_WAIT2 stage (await neighbour Tx) ------*/
+  if ( (PX_SHIFT_WAIT1 == stage) || (PX_SHIFT_WAIT2 == stage) )
+  {
+    currentTime = millis();
+
+    if (currentTime >= deadline)
+    {
+      // Our neighbour missed its chance. There's not much we can do:
+      //   - We can't shift in any pixels. So just leave them as is.
+      //   - Move on to the next stage.
+//JVS
+//logPrint(stage);
+//logPrint(FLASH("  #"));
+//logPrintln(numShifts);
+logPrintln("@");
+      if (PX_SHIFT_WAIT1 == stage)
+      {
+        // Move on to the next stage.
+        stage = PX_SHIFT_RESP;
+        releaseTime = startTime + mySlot * slotWind;
+        deadline = releaseTime + slotWind - numFrames * k_TxDeadOffs;
+        releaseTime += k_TxStartOffs;
+        //dbgPrintln(FLASH("***SHIFT: Missed Rx - WAIT1"));
+        return WASPCMD_SHIFT;
+      }
+      else
+      {
+        // There's nothing more we can do. Just make sure that the
+        // pixels get updated (for better or worse).
+        stage = PX_SHIFT_START;
+        m_updatePixels = true;
+        //dbgPrintln(FLASH("***SHIFT: Missed Rx - WAIT2"));
+        return WASPCMD_NONE;
+      }
+    }
+    
+    // Did we actually receive a new msg?
+    if (rxCmd != WASPCMD_SHIFT)
+    {
+      // There's nothing yet. So just keep waiting.
+      return WASPCMD_SHIFT;
+    }
+      
+    // Is the message from the expected neighbour?
+    if (m_srcNodeId != neighbour)
+    {
+      // We're still waiting to hear from our neighbour.
+      {
+        return WASPCMD_SHIFT;
+      }
+    }
+      
+    // Retrieve the parameters
+    buf = &m_radioInBuf[m_radioInBufPos];
+    seq = buf[1];
+    offs = seq * SHIFT_FRAME_BYTES;
+    len = numShiftBytes - offs;
+    if (len > SHIFT_FRAME_BYTES)
+      len = SHIFT_FRAME_BYTES;
+    if ( (*buf++ != num) || (seq >= numFrames) ||
+         ((m_radioInBufLen - m_radioInBufPos) != (len + 2)) )
+    {
+      // The number of expected colours is incorrect (or the neighbour isn't
+      // in the same colour mode). Just ignore the message and hope there's
+      // a correct one coming.
+//JVS
+logPrint(FLASH("***SHIFT: Bad report - "));
+logPrintln(stage);
+      dbgPrint(FLASH("***SHIFT: Bad report - "));
+      dbgPrintln(stage);
+      return WASPCMD_SHIFT;
+    }
+    buf++;
+    m_radioInBufPos += 2 + len;
+      
+    // Shift in the frame's pixels, then keep waiting for any more frames.
+    markDirty(0, m_ledStripLen);
+    shiftIn(buf, offs, len, numShiftBytes, shiftRight);
+    rxFrames |= (1 << seq);
+    if (rxFrames != (uint8)((1 << numFrames) - 1))
+      return WASPCMD_SHIFT;
+
+    if (PX_SHIFT_WAIT1 == stage)
+    {
+      tmrUpdateOmet(TMR_SHFT_WT1);
+    }
+    else
+    {
+      tmrUpdateOmet(TMR_SHFT_WT2);
+    }
+      
+    // Move on to the next stage.
+    if (PX_SHIFT_WAIT1 == stage)
+    {
+      stage = PX_SHIFT_RESP;
+      releaseTime = startTime + mySlot * slotWind;
+      deadline = releaseTime + slotWind - numFrames * k_TxDeadOffs;
+      releaseTime += k_TxStartOffs;
+      return WASPCMD_SHIFT;
+    }
+    else
+    {
+      stage = PX_SHIFT_START;
+      m_updatePixels = true;
+      return WASPCMD_NONE;
+    }
+  }  /* if (PX_SHIFT_WAIT1 == stage) */
+
+
+  /*------- PX_SHIFT_RESP stage (Tx to neighbour) -----------------*/
+  if (PX_SHIFT_RESP == stage)
+  {
+    currentTime = millis();
+    if (currentTime < releaseTime)
+    {
+      // It's not our turn to Tx yet.
+      return WASPCMD_SHIFT;
+    }
+
+    // Once the first frame is out, the rest follow regardless of deadline.
+    if ( (txSeq != 0) || (currentTime <= deadline) )
+    {   
+      /* We're clear to Tx now. */
+
+      //dbgPrintln(FLASH("SHIFT: Tx start..."));
+            
+      // Datafill the output buffer with the next frame.
+      offs = txSeq * SHIFT_FRAME_BYTES;
+      len = numShiftBytes - offs;
+      if (len > SHIFT_FRAME_BYTES)
+        len = SHIFT_FRAME_BYTES;
+      buf = &m_radioOutBuf[0];
+      *buf++ = WASPCMD_SHIFT;
+      *buf++ = num;
+      *buf++ = txSeq;
+      m_radioOutBufPos = 3;
+      srcPixels = &m_shiftOutLeds[offs];
+      for (i = len; i != 0; i--)
+        *buf++ = *srcPixels++;
+      m_radioOutBufPos += len;
+      
+      // Send the shifted-pixels report to the appropriate neighbour.
+      if (shiftRight)
+        neighbour = m_rightNeighbour;
+      else
+        neighbour = m_leftNeighbour;
+
+      if (0 == txSeq)
+        tmrUpdateOmet(TMR_SHFT_TX0);
+      radioSendBuf(neighbour, m_radioOutBuf, m_radioOutBufPos);
+      if (0 == txSeq)
+        tmrUpdateOmet(TMR_SHFT_TX1);
+      currentTime = millis();
+      if (currentTime < releaseTime)
+      {
+        logPrint(FLASH("!! #"));
+        logPrintln(numShifts);
+      }
+      if (++txSeq < numFrames)
+        return WASPCMD_SHIFT;
+    }
+    else
+    {
+      dbgPrintln(FLASH("***SHIFT: Missed Tx deadline"));
+//JVS
 logPrint(FLASH("!Tx #"));
 logPrintln(numShifts);
     }
@@ -2075,14 +3436,14 @@ logPrintln(numShifts);
     if (shiftRight)
     {
       // Who was first to transmit--us or our left neighbour?
-      if (m_leftNeighbour < m_myNodeId)
+      if (leftSlot < mySlot)
       {
         // OK, we're done.
         stage = PX_SHIFT_START;
       }
       else
       {
-        if (m_rightNeighbour < m_myNodeId)
+        if (rightSlot < mySlot)
         {
           // OK, we've already heard from our neighbour
           stage = PX_SHIFT_START;
@@ -2090,6 +3451,7 @@ logPrintln(numShifts);
         else
         {
           neighbour = m_leftNeighbour;
+          nbrSlot = leftSlot;
           stage = PX_SHIFT_WAIT2;
         }
       }
@@ -2097,14 +3459,14 @@ logPrintln(numShifts);
     else
     {
       // Who was first to transmit--us or our right neighbour?
-      if (m_leftNeighbour < m_myNodeId)
+      if (leftSlot < mySlot)
       {
         // OK, we're done.
         stage = PX_SHIFT_START;
       }
       else
       {
-        if (m_rightNeighbour < m_myNodeId)
+        if (rightSlot < mySlot)
         {
           // Ok, we've already heard from our one neighbour
           stage = PX_SHIFT_START;
@@ -2112,6 +3474,7 @@ logPrintln(numShifts);
         else
         {
           neighbour = m_rightNeighbour;
+          nbrSlot = rightSlot;
           stage = PX_SHIFT_WAIT2;
         }
       }
@@ -2119,297 +3482,1000 @@ logPrintln(numShifts);
     
     tmrUpdateOmet(TMR_SHFT_RSP);
 
-    if (PX_SHIFT_START == stage)
+    if (PX_SHIFT_START == stage)
+    {
+//JVS
+//logPrint(FLASH("<"));
+//logPrintln(startTime);
+      m_updatePixels = true;
+      return WASPCMD_NONE;
+    }
+    else
+    {
+      releaseTime = startTime + nbrSlot * slotWind;
+      deadline = releaseTime + slotWind;
+      return WASPCMD_SHIFT;
+    }    
+  }  /* if (PX_SHIFT_RESP == stage) */
+  
+  // We shouldn't get this far.
+  stage = PX_SHIFT_START;
+  m_updatePixels = true;
+  logPrintln(FLASH("***SHIFT: internal error"));
+  return WASPCMD_NONE;
+}
+    
+    
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrSwap
+//   Swap pixel colours. In indexed colour mode, the palette entries having
+//   the old colour are changed instead.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_numPixelBytes:I
+//   m_palMode:I
+//   m_radioInBuf:I
+//   m_palette:IO
+//   m_radioInBufPos:IO
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrSwap(void)
+{
+  uint8   *pixels;
+  uint8   *buf;
+  uint8    old_r, old_g, old_b, r, g, b;
+  uint32   oldColour;
+  uint32   tmpColour;
+  uint16   i;
+  
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  old_r = *buf++;
+  old_g = *buf++;
+  old_b = *buf++;
+  r = *buf++;
+  g = *buf++;
+  b = *buf++;
+  m_radioInBufPos += 6;
+
+  if (m_palMode)
+  {
+    // Rewrite the palette entries instead, then recolour their pixels.
+    pixels = m_palette;
+    for (i = PAL_LEN; i != 0; i--, pixels += LEDS_PER_PIX)
+    {
+      if ( (pixels[m_offsRed] == old_r) && (pixels[m_offsGreen] == old_g) &&
+           (pixels[m_offsBlue] == old_b) )
+      {
+        pixels[m_offsRed]   = r;
+        pixels[m_offsGreen] = g;
+        pixels[m_offsBlue]  = b;
+        m_updatePixels = true;
+      }
+    }
+    if (m_updatePixels)
+      palExpand(0, m_ledStripLen);
+    return WASPCMD_NONE;
+  }
+  
+  oldColour = mapToColour(old_r, old_g, old_b);
+  pixels = &m_pPixels[0];
+  for (i = m_ledStripLen; i != 0; i--)
+  {
+    tmpColour =   ((uint32)*pixels << 16) | ((uint32)*(pixels+1) << 8)  | *(pixels+2);
+    if (tmpColour == oldColour)
+    {
+      pixels[m_offsRed]   = r;
+      pixels[m_offsGreen] = g;
+      pixels[m_offsBlue]  = b;
+      markDirty(m_ledStripLen - i, 1);
+    }
+    pixels += LEDS_PER_PIX;
+  }
+  m_updatePixels = true;
+  
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrReset
+//   Reset the node.
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrReset(void)
+{
+  uint8   *buf;
+  char    tmpStr[5];
+  
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  tmpStr[0] = *buf++;
+  tmpStr[1] = *buf++;
+  tmpStr[2] = *buf++;
+  tmpStr[3] = *buf++;
+  m_radioInBufPos += 4;
+
+  tmpStr[4] = '\0';
+
+  if (strcmp(tmpStr, "DEAD") == 0)
+  {
+    cmdHdlrReset();
+  }
+
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrSpeed
+//   Adjust the speed of the current animated effect (e.g. RAINBOW()).
+// Parameters:     (none)
+// Returns:  WASPCMD_NONE
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//   m_fxDelay:O
+//   m_fxDelayPrev:O
+//   m_fxResumeTime:O
+//   m_fxStep:O
+//   m_runAnimation:O
+//   m_runAnimationPrev:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrSpeed(void)
+{
+  uint8 *buf;
+  uint8  tmpDelay;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  tmpDelay = *buf++;
+  m_radioInBufPos += 1;
+
+  if (0 == tmpDelay)
+  {
+    m_runAnimation = false;
+  }
+  else if (1 == tmpDelay)
+  {
+    m_runAnimation = false;
+    m_fxStep = true;
+  }
+  else
+  {
+    m_runAnimation = true;
+    m_fxDelay = tmpDelay - 2;
+    m_fxResumeTime = millis();
+  }
+
+  /* The new speed outlasts a fade that's running */
+  m_fxDelayPrev = m_fxDelay;
+  m_runAnimationPrev = m_runAnimation;
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrRainbow
+//   Enable the animated rainbow effect. This leaves indexed colour mode.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_palMode:IO
+//   m_radioInBufPos:IO
+//   m_fxParam1:O
+//   m_fxRestart:O
+//   m_runningFx:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrRainbow(void)
+{
+  uint8 *buf;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  m_fxParam1 = *buf++;
+  m_radioInBufPos += 1;
+  
+  palLeave();
+  m_runningFx = WASPCMD_RAINBOW;
+  m_fxRestart = true;
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrRainCycle
+//   Enable the animated rainbow cycle effect where the pixels always span
+//   the maximum range of rainbow colours. This leaves indexed colour mode.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_palMode:IO
+//   m_fxRestart:O
+//   m_runningFx:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrRainCycle(void)
+{
+  palLeave();
+  m_runningFx = WASPCMD_RAINCYCLE;
+  m_fxRestart = true;
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrTwinkle
+//   Enable the animated twinkle effect. This leaves indexed colour mode.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_radioInBuf:I
+//   m_palMode:IO
+//   m_radioInBufPos:IO
+//   m_fxParam1:O  - minDly (in 100's of milliseconds)
+//   m_fxParam2:O  - maxDly (in 100's of milliseconds)
+//   m_fxParam3:O  - burst
+//   m_fxParam4:O  - hold (in milliseconds)
+//   m_fxRestart:O
+//   m_runningFx:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrTwinkle(void)
+{
+  uint8 *buf;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  m_fxParam1 = *buf++;
+  m_fxParam2 = *buf++;
+  m_fxParam3 = *buf++;
+  m_fxParam4 = *buf++;
+  m_radioInBufPos += 4;
+
+  // Adjust the parameter values
+  m_fxParam1 *= 100;
+  m_fxParam2 *= 100;
+
+  palLeave();
+  m_runningFx = WASPCMD_TWINKLE;
+  m_fxRestart = true;
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrPing
+//   Respond to a PING with status information.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_ledStripCtrlPin:I
+//   m_ledStripLen:I
+//   m_ledStripFreq:I
+//   m_ledStripWiring:I
+//   m_myNodeId:I
+//   m_srcNodeId:I
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrPing(void)
+{
+  static boolean waitingToTx = false;
+  static uint32  txTime = 0;
+  uint8 *buf;
+  uint32 upSecs;
+
+  if (!waitingToTx)
+  {
+    /* Initial processing phase */
+    if (CONTROLLERID == m_srcNodeId)
+    {
+      waitingToTx = true;
+      txTime = millis() + (m_myNodeId - FIRST_SLAVE) * SLAVE_PING_TX;
+      return WASPCMD_PING;
+    }
+  }
+  
+  if (waitingToTx)
+  {
+    /* Is it time for me to respond yet? */
+    if (millis() < txTime)
+    {
+      /* It isn't time yet */
+      return WASPCMD_PING;
+    }
+    else
+    {
+      /* Ok, now we can send our response back to the WASP controller */
+      waitingToTx = false;
+      txTime = 0;
+      buf = &m_radioOutBuf[0];
+      *buf++ = WASPCMD_PING;
+      *buf++ = FW_VERSION_c;
+      *buf++ = SW_VERS_MAJ_c;
+      *buf++ = SW_VERS_MIN_c;
+      *buf++ = m_ledStripCtrlPin;
+      *buf++ = m_ledStripLen;
+      *buf++ = m_ledStripFreq;
+      *buf++ = m_ledStripWiring;
+      upSecs = millis() / 1000;
+      *buf++ = (uint8)upSecs;
+      *buf++ = (uint8)(upSecs >> 8);
+      *buf++ = (uint8)(upSecs >> 16);
+      *buf++ = (uint8)(upSecs >> 24);
+      m_radioOutBufPos = 12;
+      radioSendBuf(CONTROLLERID, m_radioOutBuf, m_radioOutBufPos);
+    }
+  }
+ 
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrTmrStats
+//   Respond to a TMR_STATS query with a timer's execution time statistics.
+//   Without TMR_STATS_ON, only the maximum is kept, and the other fields are
+//   reported as 0.
+// Parameters:     (none)
+// Returns:   WASPCMD_TMR_STATS, while waiting for my turn to respond;
+//            WASPCMD_NONE,      otherwise.
+// Inputs/Outputs:
+//   m_myNodeId:I
+//   m_radioInBuf:I
+//   m_srcNodeId:I
+//   m_timings:IO
+//   m_tmrStats:IO
+//   m_radioInBufPos:IO
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrTmrStats(void)
+{
+  static boolean waitingToTx = false;
+  static uint32  txTime = 0;
+  static uint8   timerId;
+  static uint8   opts;
+#ifdef TMR_STATS_ON
+  TmrStats_t *pStats;
+#endif
+  uint8      *buf;
+
+  if (!waitingToTx)
+  {
+    /* Initial processing phase */
+    buf = &m_radioInBuf[m_radioInBufPos];
+    timerId = *buf++;
+    opts    = *buf++;
+    m_radioInBufPos += 2;
+    if ( (CONTROLLERID == m_srcNodeId) && (timerId < MAX_TIMINGS) )
+    {
+      waitingToTx = true;
+      txTime = millis() + (m_myNodeId - FIRST_SLAVE) * SLAVE_PING_TX;
+      return WASPCMD_TMR_STATS;
+    }
+    return WASPCMD_NONE;
+  }
+
+  /* Is it time for me to respond yet? */
+  if (millis() < txTime)
+    return WASPCMD_TMR_STATS;
+
+  /* Ok, now we can send our response back to the WASP controller */
+  waitingToTx = false;
+  buf = &m_radioOutBuf[0];
+  *buf++ = WASPCMD_TMR_STATS;
+  *buf++ = timerId;
+#ifdef TMR_STATS_ON
+  pStats = &m_tmrStats[timerId];
+  memcpy(buf, &pStats->count, 2);
+  buf += 2;
+  memcpy(buf, &pStats->minTime, 4);
+  buf += 4;
+  memcpy(buf, &m_timings[timerId], 4);
+  buf += 4;
+  memcpy(buf, &pStats->sumTime, 4);
+  buf += 4;
+  memcpy(buf, pStats->hist, TMR_HIST_BUCKETS);
+  buf += TMR_HIST_BUCKETS;
+#else
+  memset(buf, 0, 2 + 4 + 4 + 4 + TMR_HIST_BUCKETS);
+  memcpy(&buf[2 + 4], &m_timings[timerId], 4);
+  buf += 2 + 4 + 4 + 4 + TMR_HIST_BUCKETS;
+#endif
+  m_radioOutBufPos = buf - &m_radioOutBuf[0];
+  radioSendBuf(CONTROLLERID, m_radioOutBuf, m_radioOutBufPos);
+
+  if (opts & TMR_STATS_RESET)
+    tmrReset(timerId);
+
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrTelemetry
+//   Schedule a reply to a TELEMETRY query for my turn to transmit; see
+//   sendTelemetry().
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_myNodeId:I
+//   m_srcNodeId:I
+//   m_telemPending:O
+//   m_telemTxTime:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrTelemetry(void)
+{
+  if (CONTROLLERID == m_srcNodeId)
+  {
+    m_telemPending = true;
+    m_telemTxTime = millis() + (m_myNodeId - FIRST_SLAVE) * SLAVE_PING_TX;
+  }
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: appendTelem16
+//   Append a 16-bit value to a TELEMETRY reply, least significant byte first.
+// Parameters:
+//   buf:IO    - Pointer to the next free byte of the reply.
+//   value:I   - The value to append.
+// Returns:   (none)
+// Inputs/Outputs: (none)
+//-----------------------------------------------------------------------------
+static inline void appendTelem16(uint8 **buf, uint16 value)
+{
+  *(*buf)++ = (uint8)value;
+  *(*buf)++ = (uint8)(value >> 8);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: sendTelemetry
+//   Send my reply to a TELEMETRY query.
+// Parameters:     (none)
+// Returns:   (none)
+// Inputs/Outputs:
+//   m_ctrlRssi:I
+//   m_timings:I
+//   m_txLate:I
+//   m_telemPending:O
+//   m_radioOutBuf:O
+//   m_radioOutBufPos:O
+//-----------------------------------------------------------------------------
+void sendTelemetry(void)
+{
+  uint8 *buf;
+
+  m_telemPending = false;
+  buf = &m_radioOutBuf[0];
+  *buf++ = WASPCMD_TELEMETRY;
+  appendTelem16(&buf, (uint16)m_ctrlRssi);
+  appendTelem16(&buf, (uint16)FreeRam());
+  appendTelem16(&buf, (m_txLate > MAXUINT16 ? MAXUINT16 : m_txLate));
+  for (uint8 i = 1; i <= TELEM_NUM_TIMERS; i++)
+  {
+    appendTelem16(&buf, ( (uint32)m_timings[i] > MAXUINT16 ?
+                          MAXUINT16 : m_timings[i] ));
+  }
+  m_radioOutBufPos = buf - &m_radioOutBuf[0];
+  radioSendBuf(CONTROLLERID, m_radioOutBuf, m_radioOutBufPos);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrScript
+//   Store part of an uploaded effect script in SPI flash.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_radioInBufPos:IO
+//   m_scriptNext:IO
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrScript(void)
+{
+  uint8 *buf;
+  uint8  slot, offs, opts, len;
+  uint32 addr;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  slot = *buf++;
+  offs = *buf++;
+  opts = *buf++;
+  len  = m_radioInBufLen - m_radioInBufPos - 3;
+  m_radioInBufPos = m_radioInBufLen;
+
+  // Validate parameters
+  if (!m_flashPresent)
+  {
+    logPrintln(FLASH("***SCRIPT: No SPI flash"));
+    return WASPCMD_NONE;
+  }
+  if ( (slot >= SCRIPT_NUM_SLOTS) ||
+       ((uint16)offs + len > SCRIPT_MAX_LEN) )
+  {
+    logPrintln(FLASH("***SCRIPT: Bad slot or length"));
+    return WASPCMD_NONE;
+  }
+  if ( (offs != 0) && (offs != m_scriptNext) )
+  {
+    // A packet went missing. Leave the script uncommitted.
+    logPrint(FLASH("***SCRIPT: Lost packet at "));
+    logPrintln(m_scriptNext);
+    m_scriptNext = SCRIPT_MAX_LEN + 1;
+    return WASPCMD_NONE;
+  }
+
+  addr = SCRIPT_FLASH_BASE + (uint32)slot * SCRIPT_SLOT_SIZE;
+  if (0 == offs)
+    m_flash.blockErase4K(addr);
+  m_flash.writeBytes(addr + SCRIPT_HDR_LEN + offs, buf, len);
+  m_scriptNext = offs + len;
+
+  if (opts & SCRIPT_F_LAST)
+  {
+    // Commit the script. (The header bytes are still erased until now.)
+    m_flash.writeByte(addr, SCRIPT_MAGIC);
+    m_flash.writeByte(addr + 1, m_scriptNext);
+  }
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrScriptRun
+//   Load an effect script from SPI flash and start running it. This leaves
+//   indexed colour mode.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_flashPresent:I
+//   m_radioInBuf:I
+//   m_palMode:IO
+//   m_radioInBufPos:IO
+//   m_script:IO
+//   m_fxParam1:O  - Script start time (network time, in milliseconds)
+//   m_fxRestart:O
+//   m_runningFx:O
+//   m_scriptLen:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrScriptRun(void)
+{
+  uint32 startTime = netMillis();
+  uint8 *buf;
+  uint8  slot;
+  uint32 addr;
+  uint8  len;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  slot = *buf++;
+  m_radioInBufPos += 1;
+
+  // Validate parameters
+  if ( !m_flashPresent || (slot >= SCRIPT_NUM_SLOTS) )
+    return WASPCMD_NONE;
+  addr = SCRIPT_FLASH_BASE + (uint32)slot * SCRIPT_SLOT_SIZE;
+  len = m_flash.readByte(addr + 1);
+  if ( (m_flash.readByte(addr) != SCRIPT_MAGIC) || (len > SCRIPT_MAX_LEN) )
+  {
+    logPrint(FLASH("***SCRIPT: No script in slot "));
+    logPrintln(slot);
+    return WASPCMD_NONE;
+  }
+
+  if (NULL == m_script)
+  {
+    m_script = (uint8 *)malloc(SCRIPT_MAX_LEN);
+    if (NULL == m_script)
     {
-//JVS
-//logPrint(FLASH("<"));
-//logPrintln(startTime);
-      m_updatePixels = true;
+      logPrintln(FLASH("***SCRIPT: Insufficient RAM"));
       return WASPCMD_NONE;
     }
-    else
-    {
-      releaseTime = startTime + (neighbour - 1) * SLAVE_TX_WIND;
-      deadline = releaseTime + SLAVE_TX_WIND;
-      return WASPCMD_SHIFT;
-    }    
-  }  /* if (PX_SHIFT_RESP == stage) */
-  
-  // We shouldn't get this far.
-  stage = PX_SHIFT_START;
-  m_updatePixels = true;
-  logPrintln(FLASH("***SHIFT: internal error"));
+  }
+  m_flash.readBytes(addr + SCRIPT_HDR_LEN, m_script, len);
+  m_scriptLen = len;
+
+  palLeave();
+  m_fxParam1 = startTime;
+  m_runningFx = WASPCMD_SCRIPT_RUN;
+  m_fxRestart = true;
   return WASPCMD_NONE;
 }
-    
-    
+
+
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrSwap
-//   Swap pixel colours.
+// Function: waspCmdHdlrSync
+//   Discipline my network clock to the controller's time-sync beacon: small
+//   errors are slewed out (half at a time, so that a single late beacon
+//   can't jolt the effects), while large ones (or the first beacon) are
+//   stepped. The last seq the beacon reports for each of my multicast
+//   streams reveals a lost final MCAST command, which is NACKed.
 // Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Returns:   WASPCMD_NONE
 // Inputs/Outputs:
-//   m_ledStripLen:I
-//   m_numPixelBytes:I
+//   m_mcValid:I
+//   m_myGroupId:I
 //   m_radioInBuf:I
+//   m_radioInBufLen:I
 //   m_radioInBufPos:IO
-//   m_updatePixels:O
+//   m_mcExpect:IO
+//   m_mcNacks:IO
+//   m_netOffs:IO
+//   m_syncFrame:O
+//   m_syncFrameTime:O
+//   m_syncValid:O
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrSwap(void)
+WaspCmd_t waspCmdHdlrSync(void)
 {
-  uint8   *pixels;
-  uint8   *buf;
-  uint8    old_r, old_g, old_b, r, g, b;
-  uint32   oldColour;
-  uint32   tmpColour;
-  uint16   i;
-  
+  uint32 rxTime = millis();
+  uint8 *buf;
+  uint16 frame;
+  uint8  phase;
+  uint32 netTime;
+  int32  err;
+  uint8  stream, head, dst, gap;
+  uint8  s;
+
   // Retrieve parameters
   buf = &m_radioInBuf[m_radioInBufPos];
-  old_r = *buf++;
-  old_g = *buf++;
-  old_b = *buf++;
-  r = *buf++;
-  g = *buf++;
-  b = *buf++;
-  m_radioInBufPos += 6;
-  
-  oldColour = mapToColour(old_r, old_g, old_b);
-  pixels = &m_pPixels[0];
-  for (i = m_ledStripLen; i != 0; i--)
+  frame   = (uint16)buf[0] | ((uint16)buf[1] << 8);
+  phase   = buf[2];
+  netTime = (uint32)buf[3] | ((uint32)buf[4] << 8) |
+            ((uint32)buf[5] << 16) | ((uint32)buf[6] << 24);
+  m_radioInBufPos += 7;
+  netTime += SYNC_TX_LATENCY;
+
+  err = (int32)(netTime - (rxTime + m_netOffs));
+  if ( !m_syncValid || (err > SYNC_STEP_MS) || (err < -SYNC_STEP_MS) )
   {
-    tmpColour =   ((uint32)*pixels << 16) | ((uint32)*(pixels+1) << 8)  | *(pixels+2);
-    if (tmpColour == oldColour)
+    m_netOffs += err;
+  }
+  else
+  {
+    m_netOffs += err / 2;
+  }
+  m_syncFrame = frame;
+  m_syncFrameTime = netTime - phase;
+  m_syncValid = true;
+
+  while ((m_radioInBufPos + 2) <= m_radioInBufLen)
+  {
+    stream = m_radioInBuf[m_radioInBufPos++];
+    head   = m_radioInBuf[m_radioInBufPos++];  // seq of its last MCAST
+    if (0 == stream)
     {
-      pixels[m_offsRed]   = r;
-      pixels[m_offsGreen] = g;
-      pixels[m_offsBlue]  = b;
+      s = 0;
+      dst = BROADCASTID;
+    }
+    else if ((FIRST_GROUP + stream - 1) == m_myGroupId)
+    {
+      s = 1;
+      dst = m_myGroupId;
+    }
+    else
+      continue;
+
+    gap = head + 1 - m_mcExpect[s];
+    if ( m_mcValid[s] && (gap != 0) && (gap < MCAST_HIST_LEN) &&
+         !mcastNack(s, dst, head) )
+    {
+      m_mcExpect[s] = head + 1;
+      m_mcNacks[s]  = 0;
     }
-    pixels += LEDS_PER_PIX;
   }
-  m_updatePixels = true;
-  
   return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrReset
-//   Reset the node.
+// Function: waspCmdHdlrAt
+//   Queue the commands carried by a scheduled command until their network
+//   frame starts (see schedRun()). They're executed right away instead if
+//   my clock isn't synchronized yet, or they can't be queued.
 // Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Returns:   WASPCMD_NONE
 // Inputs/Outputs:
+//   m_dstNodeId:I
 //   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_syncValid:I
 //   m_radioInBufPos:IO
+//   m_schedCount:IO
+//   m_schedQueue:O
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrReset(void)
+WaspCmd_t waspCmdHdlrAt(void)
 {
-  uint8   *buf;
-  char    tmpStr[5];
-  
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  tmpStr[0] = *buf++;
-  tmpStr[1] = *buf++;
-  tmpStr[2] = *buf++;
-  tmpStr[3] = *buf++;
-  m_radioInBufPos += 4;
+  SchedCmd_t *pEntry;
+  uint8      *buf;
+  uint8       len;
 
-  tmpStr[4] = '\0';
+  buf = &m_radioInBuf[m_radioInBufPos];
+  m_radioInBufPos += 2;
+  if (m_radioInBufPos >= m_radioInBufLen)
+    return WASPCMD_NONE;
+  len = m_radioInBufLen - m_radioInBufPos;
 
-  if (strcmp(tmpStr, "DEAD") == 0)
+  if (!m_syncValid)
+    return waspCmdHdlrBatch();
+  if ( (m_schedCount >= SCHED_SLOTS) || (len > SCHED_MAX_LEN) )
   {
-    cmdHdlrReset();
+    logPrintln(FLASH("***AT: Can't queue cmds; running them now"));
+    return waspCmdHdlrBatch();
   }
 
+  pEntry = &m_schedQueue[m_schedCount++];
+  pEntry->frame = (uint16)buf[0] | ((uint16)buf[1] << 8);
+  pEntry->dst = m_dstNodeId;
+  pEntry->len = len;
+  memcpy(pEntry->cmds, &m_radioInBuf[m_radioInBufPos], len);
+  m_radioInBufPos = m_radioInBufLen;
   return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrSpeed
-//   Adjust the speed of the current animated effect (e.g. RAINBOW()).
+// Function: waspCmdHdlrPalette
+//   Set palette entries, switching to indexed colour mode (or switch back to
+//   direct colour mode). The current pixels are mapped to the palette on
+//   entry to indexed mode, and recoloured when their entries change. Either
+//   switch saves the current pixels, since the saved pixels are kept as
+//   palette indices in indexed mode.
 // Parameters:     (none)
-// Returns:  WASPCMD_NONE
+// Returns:   WASPCMD_NONE
 // Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
 //   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_palMode:IO
+//   m_palette:IO
 //   m_radioInBufPos:IO
-//   m_fxDelay:O
-//   m_fxResumeTime:O
-//   m_fxStep:O
-//   m_runAnimation:O
+//   m_pixIdx:O
+//   m_pPixels:O
+//   m_updatePixels:O
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrSpeed(void)
+WaspCmd_t waspCmdHdlrPalette(void)
 {
   uint8 *buf;
-  uint8  tmpDelay;
+  uint8 *pal;
+  uint8  first;
+  uint8  num;
 
   // Retrieve parameters
   buf = &m_radioInBuf[m_radioInBufPos];
-  tmpDelay = *buf++;
-  m_radioInBufPos += 1;
+  first = *buf++;
+  num   = *buf++;
+  m_radioInBufPos += 2;
 
-  if (0 == tmpDelay)
+  if (0 == num)
   {
-    m_runAnimation = false;
+    palLeave();
+    return WASPCMD_NONE;
   }
-  else if (1 == tmpDelay)
+
+  // Validate parameters
+  if ( ((uint16)first + num > PAL_LEN) ||
+       ((m_radioInBufPos + (uint16)num * 3) > m_radioInBufLen) )
   {
-    m_runAnimation = false;
-    m_fxStep = true;
+    logPrintln(FLASH("***PALETTE: Bad entries"));
+    m_radioInBufPos = m_radioInBufLen;
+    return WASPCMD_NONE;
   }
-  else
+
+  // The palette and the pixels' indices are only allocated once needed.
+  if (NULL == m_palette)
   {
-    m_runAnimation = true;
-    m_fxDelay = tmpDelay - 2;
-    m_fxResumeTime = millis();
+    m_palette = (uint8 *)calloc(PAL_LEN * LEDS_PER_PIX +
+                                ((m_ledStripLen + 1) >> 1), 1);
+    if (NULL == m_palette)
+    {
+      logPrintln(FLASH("***PALETTE: Insufficient RAM"));
+      m_radioInBufPos = m_radioInBufLen;
+      return WASPCMD_NONE;
+    }
+    m_pixIdx = &m_palette[PAL_LEN * LEDS_PER_PIX];
+  }
+
+  pal = &m_palette[first * LEDS_PER_PIX];
+  for ( ; num != 0; num--, pal += LEDS_PER_PIX)
+  {
+    pal[m_offsRed]   = *buf++;
+    pal[m_offsGreen] = *buf++;
+    pal[m_offsBlue]  = *buf++;
+    m_radioInBufPos += 3;
   }
 
+  if (m_palMode)
+  {
+    palExpand(0, m_ledStripLen);
+  }
+  else
+  {
+    m_palMode = true;
+    palIndex(0, m_ledStripLen);
+    savePixels();
+  }
+  m_updatePixels = true;
   return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrRainbow
-//   Enable the animated rainbow effect.
-// Parameters:     (none)
-// Returns:   WASPCMD_NONE
+// Function: fxFadeStart
+//   Start a crossfade effect (see fxHdlrFade()) now, in network time. The
+//   interpolated colours aren't palette colours, so indexed colour mode is
+//   left first. If animated effects aren't running, they're started at
+//   FADE_FRAME_MS per frame, until the fade ends.
+// Parameters:
+//   cmd:I   - The fade command (WASPCMD_FADE or WASPCMD_GRADIENT).
+//   time:I  - The duration of the fade (in 100's of milliseconds).
+// Returns:    (none)
 // Inputs/Outputs:
-//   m_radioInBuf:I
-//   m_radioInBufPos:IO
-//   m_fxParam1:O
+//   m_ledStripLen:I
+//   m_palMode:IO
+//   m_fxDelay:IO
+//   m_fxDelayPrev:O
+//   m_runAnimationPrev:O
+//   m_fxParam3:O  - Fade start time (network time, in milliseconds)
+//   m_fxParam4:O  - Fade duration (in milliseconds)
+//   m_fxResumeTime:O
 //   m_fxRestart:O
-//   m_runningFx:O
+//   m_runAnimation:IO
+//   m_runningFx:IO
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrRainbow(void)
+static void fxFadeStart(WaspCmd_t cmd, uint8 time)
 {
-  uint8 *buf;
+  palLeave();
 
-  // Retrieve parameters
-  buf = &m_radioInBuf[m_radioInBufPos];
-  m_fxParam1 = *buf++;
-  m_radioInBufPos += 1;
-  
-  m_runningFx = WASPCMD_RAINBOW;
+  m_fxParam3 = netMillis();
+  m_fxParam4 = time * 100UL;
+
+  /* A fade that replaces one keeps the speed from before the first */
+  if ( (m_runningFx != WASPCMD_FADE) && (m_runningFx != WASPCMD_GRADIENT) )
+  {
+    m_fxDelayPrev = m_fxDelay;
+    m_runAnimationPrev = m_runAnimation;
+  }
+  if (!m_runAnimation)
+  {
+    m_runAnimation = true;
+    m_fxDelay = FADE_FRAME_MS;
+    m_fxResumeTime = millis();
+  }
+
+  m_runningFx = cmd;
   m_fxRestart = true;
-  return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrRainCycle
-//   Enable the animated rainbow cycle effect where the pixels always span
-//   the maximum range of rainbow colours.
+// Function: waspCmdHdlrFade
+//   Enable the crossfade effect to a single colour.
 // Parameters:     (none)
 // Returns:   WASPCMD_NONE
 // Inputs/Outputs:
-//   m_fxRestart:O
-//   m_runningFx:O
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//   m_fxParam1:O  - Colour of the first pixel (0xRRGGBB)
+//   m_fxParam2:O  - Colour of the last pixel (0xRRGGBB)
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrRainCycle(void)
+WaspCmd_t waspCmdHdlrFade(void)
 {
-  m_runningFx = WASPCMD_RAINCYCLE;
-  m_fxRestart = true;
+  uint8 *buf;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  m_fxParam1  = (uint32)*buf++ << 16;
+  m_fxParam1 |= (uint16)*buf++ << 8;
+  m_fxParam1 |= *buf++;
+  m_fxParam2 = m_fxParam1;
+  m_radioInBufPos += 4;
+
+  fxFadeStart(WASPCMD_FADE, *buf);
   return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrTwinkle
-//   Enable the animated twinkle effect.
+// Function: waspCmdHdlrGradient
+//   Enable the crossfade effect to a linear colour gradient.
 // Parameters:     (none)
 // Returns:   WASPCMD_NONE
 // Inputs/Outputs:
 //   m_radioInBuf:I
 //   m_radioInBufPos:IO
-//   m_fxParam1:O  - minDly (in 100's of milliseconds)
-//   m_fxParam2:O  - maxDly (in 100's of milliseconds)
-//   m_fxParam3:O  - burst
-//   m_fxParam4:O  - hold (in milliseconds)
-//   m_fxRestart:O
-//   m_runningFx:O
+//   m_fxParam1:O  - Colour of the first pixel (0xRRGGBB)
+//   m_fxParam2:O  - Colour of the last pixel (0xRRGGBB)
 //-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrTwinkle(void)
+WaspCmd_t waspCmdHdlrGradient(void)
 {
   uint8 *buf;
 
   // Retrieve parameters
   buf = &m_radioInBuf[m_radioInBufPos];
-  m_fxParam1 = *buf++;
-  m_fxParam2 = *buf++;
-  m_fxParam3 = *buf++;
-  m_fxParam4 = *buf++;
-  m_radioInBufPos += 4;
-
-  // Adjust the parameter values
-  m_fxParam1 *= 100;
-  m_fxParam2 *= 100;
-
-  m_runningFx = WASPCMD_TWINKLE;
-  m_fxRestart = true;
+  m_fxParam1  = (uint32)*buf++ << 16;
+  m_fxParam1 |= (uint16)*buf++ << 8;
+  m_fxParam1 |= *buf++;
+  m_fxParam2  = (uint32)*buf++ << 16;
+  m_fxParam2 |= (uint16)*buf++ << 8;
+  m_fxParam2 |= *buf++;
+  m_radioInBufPos += 7;
+
+  fxFadeStart(WASPCMD_GRADIENT, *buf);
   return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: waspCmdHdlrPing
-//   Respond to a PING with status information.
+// Function: waspCmdHdlrBright
+//   Set the output stage's gamma correction, and set or start fading to its
+//   brightness (see brightStep()).
 // Parameters:     (none)
 // Returns:   WASPCMD_NONE
 // Inputs/Outputs:
-//   m_ledStripCtrlPin:I
-//   m_ledStripLen:I
-//   m_ledStripFreq:I
-//   m_ledStripWiring:I
-//   m_myNodeId:I
-//   m_srcNodeId:I
-//   m_radioOutBuf:O
-//   m_radioOutBufPos:O
-//-----------------------------------------------------------------------------
-WaspCmd_t waspCmdHdlrPing(void)
-{
-  static boolean waitingToTx = false;
-  static uint32  txTime = 0;
-  uint8 *buf;
-
-  if (!waitingToTx)
-  {
-    /* Initial processing phase */
-    if (CONTROLLERID == m_srcNodeId)
-    {
-      waitingToTx = true;
-      txTime = millis() + (m_myNodeId - FIRST_SLAVE) * SLAVE_PING_TX;
-      return WASPCMD_PING;
-    }
-  }
-  
-  if (waitingToTx)
-  {
-    /* Is it time for me to respond yet? */
-    if (millis() < txTime)
-    {
-      /* It isn't time yet */
-      return WASPCMD_PING;
-    }
-    else
-    {
-      /* Ok, now we can send our response back to the WASP controller */
-      waitingToTx = false;
-      txTime = 0;
-      buf = &m_radioOutBuf[0];
-      *buf++ = WASPCMD_PING;
-      *buf++ = FW_VERSION_c;
-      *buf++ = SW_VERS_MAJ_c;
-      *buf++ = SW_VERS_MIN_c;
-      *buf++ = m_ledStripCtrlPin;
-      *buf++ = m_ledStripLen;
-      *buf++ = m_ledStripFreq;
-      *buf++ = m_ledStripWiring;
-      m_radioOutBufPos = 8;
-      radioSendBuf(CONTROLLERID, m_radioOutBuf, m_radioOutBufPos);
-    }
+//   m_pPixels:I
+//   m_pShowPixels:I
+//   m_radioInBuf:I
+//   m_bright:IO
+//   m_radioInBufPos:IO
+//   m_brightFrom:O
+//   m_brightNext:O
+//   m_brightStart:O
+//   m_brightTime:O
+//   m_brightTo:O
+//   m_gamma:O
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrBright(void)
+{
+  uint8 *buf;
+  uint8  level;
+  uint8  gamma;
+  uint8  time;
+
+  // Retrieve parameters
+  buf = &m_radioInBuf[m_radioInBufPos];
+  level = *buf++;
+  gamma = *buf++;
+  time  = *buf++;
+  m_radioInBufPos += 3;
+
+  if (m_pShowPixels == m_pPixels)
+  {
+    logPrintln(FLASH("***BRIGHT: Insufficient RAM"));
+    return WASPCMD_NONE;
   }
- 
+
+  m_gamma = (gamma != 0);
+  if (0 == time)
+  {
+    m_bright = level;
+    m_brightTime = 0;
+  }
+  else
+  {
+    m_brightFrom  = m_bright;
+    m_brightTo    = level;
+    m_brightStart = netMillis();
+    m_brightTime  = time * 100UL;
+    m_brightNext  = millis();
+  }
+  m_updatePixels = true;
   return WASPCMD_NONE;
 }
 
@@ -2568,6 +4634,14 @@ WaspCmd_t waspCmdHdlrCfgLed(void)
 
   if (newWiring > WIRING_MAX_VAL)
     return WASPCMD_NONE;
+#ifdef FIXED_WIRING
+  if (newWiring != FIXED_WIRING)
+  {
+    logPrint(FLASH("***CFG_LED: Wiring order fixed at "));
+    logPrintln(FIXED_WIRING);
+    return WASPCMD_NONE;
+  }
+#endif
 
   m_ledStripFreq   = newFreq;
   m_ledStripWiring = newWiring;
@@ -2592,129 +4666,650 @@ WaspCmd_t waspCmdHdlrCfgSave(void)
 
 
 //-----------------------------------------------------------------------------
-// Function: processWaspCommand
-//   Execute the most recent pixel strip command.
-// Parameters: (none)
-// Returns:    (none)
+// Function: waspCmdHdlrBatch
+//   Execute each of the WASP commands carried by a batch command, in order,
+//   through its regular command handler.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
 // Inputs/Outputs:
-//   m_waspCmd:I
 //   m_pxCmdHdlrs:I
-//   m_runningFx:O
-// Note:
-//   The function keeps track of whether or not command handling has completed.
-//   Special effects typically complete their handling right away, but continue
-//   to run until another command is received.
+//   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_radioInBufPos:IO
 //-----------------------------------------------------------------------------
-void processWaspCommand(void)
+WaspCmd_t waspCmdHdlrBatch(void)
 {
-  static WaspCmd_t cmdInProgress = WASPCMD_NONE;
-  WaspCmd_t currentCmd;
+  uint8     numCmds;
+  WaspCmd_t subCmd;
 
-  currentCmd = (WASPCMD_NONE == cmdInProgress ? m_waspCmd : cmdInProgress);
-  if ( (WASPCMD_NONE != currentCmd) &&
-       (WASPCMD_SPEED != currentCmd) &&
-       (WASPCMD_STATE != currentCmd)
-     )
+  numCmds = m_radioInBuf[m_radioInBufPos++];
+  for ( ; (numCmds != 0) && (m_radioInBufPos < m_radioInBufLen); numCmds--)
   {
-    m_runningFx = WASPCMD_NONE;
+    subCmd = m_radioInBuf[m_radioInBufPos++];
+    if (!WASP_BATCHABLE(subCmd))
+    {
+      // The rest of the batch can't be parsed, so discard it.
+      logPrint(FLASH("***BATCH: Bad cmd - "));
+      logPrintln(subCmd);
+      break;
+    }
+    fxStopCheck(subCmd);
+    (void)(*PX_HDLR(m_pxCmdHdlrs, subCmd))();
   }
-
-  cmdInProgress = (*m_pxCmdHdlrs[currentCmd])();
+  return WASPCMD_NONE;
 }
 
 
-
 //-----------------------------------------------------------------------------
-// Function: colourWheel
-//   Select a colour from a wheel of 256 colours that range from
-//   red to green to blue and back to red again.
-
-//   pure red (0), thru red/greens to pure green (85), thru green/blues to
-//   pure blue (170), thru blue/reds to pure red (255 -> 0) again.
+// Function: mcastNack
+//   Schedule a NACK of the multicast commands missed on a stream, for my
+//   turn to transmit (see WASPCMD_NACK). After MCAST_NACK_TRIES NACKs for
+//   the same gap, report it as lost instead.
 // Parameters:
-//   wheelPos:I  - Colour wheel slot:
-//                      0 = red
-//                     42 = yellowish (red/green)
-//                     85 = green
-//                    127 = cyan (green/blue)
-//                    170 = blue
-//                    212 = purple (blue/red)
-// Returns:   WASPCMD_NONE
+//   s:I     - The stream (index into m_mcExpect[]).
+//   dst:I   - The stream's destination (BROADCASTID or my group).
+//   last:I  - seq of the last command missed.
+// Returns:   true iff a NACK was scheduled; false if the gap is to be
+//            skipped.
 // Inputs/Outputs:
-//   m_pStrip:I
+//   m_mcExpect:I
+//   m_myRespDelay:I
+//   m_mcNacks:IO
+//   m_nackBuf:O
+//   m_nackLen:O
+//   m_nackPending:O
+//   m_nackTxTime:O
 //-----------------------------------------------------------------------------
-uint32 colourWheel(uint8 wheelPos)
+boolean mcastNack(uint8 s, uint8 dst, uint8 last)
 {
-  if(wheelPos < 85)
+  if (m_mcNacks[s] < MCAST_NACK_TRIES)
   {
-   return mapToColour(255 - wheelPos * 3, wheelPos * 3, 0);
+    m_mcNacks[s]++;
+    m_nackBuf[0] = WASPCMD_NACK;
+    m_nackBuf[1] = dst;
+    m_nackBuf[2] = m_mcExpect[s];
+    m_nackBuf[3] = last;
+    m_nackLen = 4;
+    m_nackPending = true;
+    m_nackTxTime = millis() + m_myRespDelay;
+    return true;
   }
-  else if(wheelPos < 170)
+  logPrint(FLASH("***MCAST: Lost "));
+  logPrint((uint8)(last + 1 - m_mcExpect[s]));
+  logPrint(FLASH(" cmds to "));
+  logPrintln(dst);
+  return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: waspCmdHdlrMcast
+//   Execute the command carried by a multicast command if it's the next one
+//   in its stream. If earlier commands were missed, discard it and schedule
+//   a NACK for my turn to transmit, so that the controller resends them;
+//   after MCAST_NACK_TRIES NACKs for the same gap, skip the gap instead.
+//   Repeats of commands already executed are ignored.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_dstNodeId:I
+//   m_myGroupId:I
+//   m_pxCmdHdlrs:I
+//   m_radioInBuf:I
+//   m_radioInBufPos:IO
+//   m_mcExpect:IO
+//   m_mcNacks:IO
+//   m_mcValid:IO
+//-----------------------------------------------------------------------------
+WaspCmd_t waspCmdHdlrMcast(void)
+{
+  uint8     flags, seq, gap;
+  uint8     s;
+  WaspCmd_t subCmd;
+
+  // Retrieve parameters
+  flags = m_radioInBuf[m_radioInBufPos++];
+  seq   = m_radioInBuf[m_radioInBufPos++];
+  if (BROADCASTID == m_dstNodeId)
+    s = 0;
+  else if (m_myGroupId == m_dstNodeId)
+    s = 1;
+  else
+    s = MCAST_STREAMS;            // Sent to me alone; there's no stream
+
+  if (s < MCAST_STREAMS)
   {
-   wheelPos -= 85;
-   return mapToColour(0, 255 - wheelPos * 3, wheelPos * 3);
+    gap = seq - m_mcExpect[s];
+    if (!m_mcValid[s] || (0 == gap))
+      ;                           // Take it
+    else if (gap >= (uint8)(0 - MCAST_HIST_LEN))
+    {
+      // The sequence restarts whenever the controller does
+      if (!(flags & MCAST_F_RESYNC) || (0xFF == gap))
+        return WASPCMD_NONE;      // A repeat of one already executed
+    }
+    else if ( (gap < MCAST_HIST_LEN) && !(flags & MCAST_F_RESYNC) &&
+              mcastNack(s, m_dstNodeId, seq) )
+    {
+      return WASPCMD_NONE;
+    }
+    m_mcValid[s]  = true;
+    m_mcExpect[s] = seq + 1;
+    m_mcNacks[s]  = 0;
   }
-  else
+
+  subCmd = m_radioInBuf[m_radioInBufPos++];
+  if (!WASP_MCASTABLE(subCmd))
   {
-   wheelPos -= 170;
-   return mapToColour(wheelPos * 3, 0, 255 - wheelPos * 3);
+    logPrint(FLASH("***MCAST: Bad cmd - "));
+    logPrintln(subCmd);
+    return WASPCMD_NONE;
   }
+  fxStopCheck(subCmd);
+  (void)(*PX_HDLR(m_pxCmdHdlrs, subCmd))();
+  return WASPCMD_NONE;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: fxHdlrNull
-//   The empty special FX handler.
-// Parameters:     (none)
-// Returns:   WASPCMD_NONE
+// Function: pixelsNack
+//   Report a pixel upload that has lost packets with a NACK, in my turn to
+//   transmit, so that the controller resends the whole region (see
+//   WASPCMD_NACK). Its skip records were relative to pixels I never got.
+// Parameters:
+//   first:I  - seq of the first packet lost.
+//   last:I   - seq of the last packet lost (255 if not known).
+// Returns:   (none)
 // Inputs/Outputs:
+//   m_dstNodeId:I
+//   m_myRespDelay:I
+//   m_nackBuf:O
+//   m_nackLen:O
+//   m_nackPending:IO
+//   m_nackTxTime:O
 //-----------------------------------------------------------------------------
-WaspCmd_t fxHdlrNull(void)
+void pixelsNack(uint8 first, uint8 last)
 {
-  return WASPCMD_NONE;
+  if (m_nackPending)
+    return;                       // Let the multicast stream's NACK go first
+  m_nackBuf[0] = WASPCMD_NACK;
+  m_nackBuf[1] = m_dstNodeId;
+  m_nackBuf[2] = first;
+  m_nackBuf[3] = last;
+  m_nackBuf[4] = WASPCMD_PIXELS;
+  m_nackLen = 5;
+  m_nackPending = true;
+  m_nackTxTime = millis() + m_myRespDelay;
 }
 
 
 //-----------------------------------------------------------------------------
-// Function: fxHdlrRainbow
-//   Run an iteration of the animated rainbow effect.
+// Function: waspCmdHdlrPixels
+//   Decode one packet of a pixel upload--run-length records and skips over
+//   unchanged pixels--directly into the pixel buffer. Drawing is suspended
+//   from the first to the last packet of a multi-packet upload. A lost
+//   packet is reported once the upload ends (see pixelsNack()).
 // Parameters:     (none)
 // Returns:   WASPCMD_NONE
 // Inputs/Outputs:
-//   m_fxParam1:I
 //   m_ledStripLen:I
-//   m_fxRestart:IO
-//   m_pPixels:O
-//   m_pStrip:O
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_palMode:I
+//   m_radioInBuf:I
+//   m_radioInBufLen:I
+//   m_pixelsLost:IO
+//   m_pixelsLostSeq:IO
+//   m_pixelsOpen:IO
+//   m_pixelsSeq:IO
+//   m_pPixels:IO
+//   m_radioInBufPos:IO
+//   m_pixelShowSuspend:O
 //   m_updatePixels:O
 //-----------------------------------------------------------------------------
-WaspCmd_t fxHdlrRainbow(void)
+WaspCmd_t waspCmdHdlrPixels(void)
 {
-  static uint16 j = 255;
-  uint32   colour;
-  uint8   *pixels;
-  uint16   i = 0;
+  uint8  *buf;
+  uint8  *bufEnd;
+  uint8  *pixels;
+  uint16  pixNum;
+  uint16  first;
+  uint8   seq;
+  uint8   opts;
+  uint8   count;
 
-  if (m_fxRestart)
+  // Retrieve parameters
+  buf    = &m_radioInBuf[m_radioInBufPos];
+  bufEnd = &m_radioInBuf[m_radioInBufLen];
+  seq    = *buf++;
+  opts   = *buf++;
+  pixNum = *buf++;
+  first  = pixNum;
+  m_radioInBufPos = m_radioInBufLen;
+
+  if (0 == seq)
   {
-    m_fxRestart = false;
-    j = m_fxParam1;
+    // The end of the previous upload never arrived
+    if (m_pixelsOpen)
+      pixelsNack((m_pixelsLost ? m_pixelsLostSeq : m_pixelsSeq), 0xFF);
+    m_pixelsOpen = false;
+    m_pixelsLost = false;
+  }
+  else if (seq != m_pixelsSeq)
+  {
+    // Each packet carries its own start pixel, so decode it regardless.
+    logPrint(FLASH("***PIXELS: Lost packet - "));
+    logPrintln(m_pixelsSeq);
+    if (!m_pixelsLost)
+      m_pixelsLostSeq = m_pixelsSeq;
+    m_pixelsLost = true;
+  }
+  m_pixelsSeq = seq + 1;
+
+  if (opts & F_SUSPEND)
+    m_pixelShowSuspend = true;
+
+  while ( (buf < bufEnd) && (pixNum < m_ledStripLen) )
+  {
+    count = *buf++;
+    if (count & PIXELS_SKIP)
+    {
+      pixNum += (count & PIXELS_MAX_RUN);
+      continue;
+    }
+    if ( (buf + 3) > bufEnd )
+      break;
+    if ( (pixNum + count) > m_ledStripLen )
+      count = m_ledStripLen - pixNum;
+
+    pixels = &m_pPixels[pixNum * LEDS_PER_PIX];
+    markDirty(pixNum, count);
+    pixNum += count;
+    for ( ; count != 0; count--)
+    {
+      *(pixels + m_offsRed)   = buf[0];
+      *(pixels + m_offsGreen) = buf[1];
+      *(pixels + m_offsBlue)  = buf[2];
+      pixels += LEDS_PER_PIX;
+    }
+    buf += 3;
+  }
+  if ( m_palMode && (pixNum > first) )
+    palIndex(first, pixNum - first);
+  m_updatePixels = true;
+
+  if (opts & F_RESUME)
+  {
+    m_pixelShowSuspend = false;
+    if (m_pixelsLost)
+      pixelsNack(m_pixelsLostSeq, seq - 1);
+    m_pixelsOpen = false;
+  }
+  else if ( (seq != 0) || (opts & F_SUSPEND) )
+  {
+    m_pixelsOpen = true;
   }
+
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: netMillis
+//   Get the network time: the controller's clock, as tracked from its
+//   time-sync beacons (or my own clock, until the first one arrives).
+// Parameters:     (none)
+// Returns:   The network time (in milliseconds).
+// Inputs/Outputs:
+//   m_netOffs:I
+//-----------------------------------------------------------------------------
+uint32 netMillis(void)
+{
+  return millis() + (uint32)m_netOffs;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: netFrame
+//   Get the current network frame number.
+// Parameters:     (none)
+// Returns:   The network frame # (of SYNC_FRAME_MS each).
+// Inputs/Outputs:
+//   m_syncFrame:I
+//   m_syncFrameTime:I
+//-----------------------------------------------------------------------------
+uint16 netFrame(void)
+{
+  return m_syncFrame + (uint16)((netMillis() - m_syncFrameTime) /
+                                SYNC_FRAME_MS);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxNextFrame
+//   Advance the special effect's iteration #. Once the network clock is
+//   synchronized, this is derived from the network time rather than just
+//   counted, so every node running the same effect at the same speed shows
+//   the same frame at the same moment, however late it started.
+// Parameters:     (none)
+// Returns:   (none)
+// Inputs/Outputs:
+//   m_fxDelay:I
+//   m_fxRestart:I
+//   m_syncValid:I
+//   m_fxFrame:IO
+//-----------------------------------------------------------------------------
+void fxNextFrame(void)
+{
+  if (m_syncValid)
+    m_fxFrame = netMillis() / (m_fxDelay ? m_fxDelay : 1);
+  else if (m_fxRestart)
+    m_fxFrame = 0;
   else
+    m_fxFrame++;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxResumeTime
+//   Determine when the next special effect iteration is due. Once the
+//   network clock is synchronized, iterations are locked to multiples of
+//   the effect period in network time (so per-iteration execution time
+//   doesn't accumulate as drift between nodes).
+// Parameters:     (none)
+// Returns:   The time of the next iteration (local millis() time).
+// Inputs/Outputs:
+//   m_fxDelay:I
+//   m_netOffs:I
+//   m_syncValid:I
+//-----------------------------------------------------------------------------
+uint32 fxResumeTime(void)
+{
+  uint32 period;
+
+  if (!m_syncValid)
+    return millis() + m_fxDelay;
+
+  period = (m_fxDelay ? m_fxDelay : 1);
+  return (netMillis() / period + 1) * period - (uint32)m_netOffs;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: schedRun
+//   Execute all the queued scheduled commands whose network frame has
+//   started, in the order they were received. Since this happens within a
+//   single loop() pass, before the strip is updated, the changes they make
+//   are all shown together.
+// Parameters:     (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_dstNodeId:IO
+//   m_radioInBuf:IO
+//   m_radioInBufLen:IO
+//   m_radioInBufPos:IO
+//   m_schedCount:IO
+//   m_schedQueue:IO
+//-----------------------------------------------------------------------------
+void schedRun(void)
+{
+  SchedCmd_t *pEntry;
+  uint16      frame;
+  uint8       dst;
+  uint8       i = 0;
+
+  if (0 == m_schedCount)
+    return;
+
+  frame = netFrame();
+  dst = m_dstNodeId;
+  while (i < m_schedCount)
+  {
+    pEntry = &m_schedQueue[i];
+    if ((int16)(frame - pEntry->frame) < 0)
+    {
+      i++;
+      continue;
+    }
+
+    // Run the commands as though they had just been received in a batch.
+    memcpy(m_radioInBuf, pEntry->cmds, pEntry->len);
+    m_radioInBufLen = pEntry->len;
+    m_radioInBufPos = 0;
+    m_dstNodeId = pEntry->dst;
+    (void)waspCmdHdlrBatch();
+
+    m_schedCount--;
+    memmove(pEntry, pEntry + 1, (m_schedCount - i) * sizeof(SchedCmd_t));
+  }
+  m_dstNodeId = dst;
+  m_radioInBuf[0] = WASPCMD_NONE;
+  m_radioInBufLen = 0;
+  m_radioInBufPos = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxStopCheck
+//   Stop the running special effect, unless a command only modifies how it
+//   runs or is shown, only queries the node's diagnostics, only uploads a
+//   script, is a time-sync beacon, or is scheduled for later. (Scheduled
+//   and multicast commands are checked when they're executed.)
+// Parameters:
+//   cmd:I  - The WASP command that is about to be executed.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_runningFx:O
+//-----------------------------------------------------------------------------
+void fxStopCheck(WaspCmd_t cmd)
+{
+  if ( (WASPCMD_NONE != cmd) &&
+       (WASPCMD_SPEED != cmd) &&
+       (WASPCMD_STATE != cmd) &&
+       (WASPCMD_BATCH != cmd) &&
+       (WASPCMD_TMR_STATS != cmd) &&
+       (WASPCMD_TELEMETRY != cmd) &&
+       (WASPCMD_SCRIPT != cmd) &&
+       (WASPCMD_SYNC != cmd) &&
+       (WASPCMD_AT != cmd) &&
+       (WASPCMD_BRIGHT != cmd) &&
+       (WASPCMD_MCAST != cmd)
+     )
   {
-    if (++j >= 256)
-      j = 0;
+    m_runningFx = WASPCMD_NONE;
   }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: processWaspCommand
+//   Execute the most recent pixel strip command.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_waspCmd:I
+//   m_pxCmdHdlrs:I
+//   m_runningFx:O
+//   m_showDefer:O
+// Note:
+//   The function keeps track of whether or not command handling has completed.
+//   Special effects typically complete their handling right away, but continue
+//   to run until another command is received. (A batch command stops the
+//   running effect only if one of the commands it carries does.)
+//-----------------------------------------------------------------------------
+void processWaspCommand(void)
+{
+  static WaspCmd_t cmdInProgress = WASPCMD_NONE;
+  WaspCmd_t currentCmd;
+
+  currentCmd = (WASPCMD_NONE == cmdInProgress ? m_waspCmd : cmdInProgress);
+  fxStopCheck(currentCmd);
+
+  cmdInProgress = (*PX_HDLR(m_pxCmdHdlrs, currentCmd))();
+
+  // Showing the pixels disables interrupts for ~30us per pixel, long enough
+  // to lose neighbours' reports. So don't show them until the SHIFT exchange
+  // is over.
+  m_showDefer = (WASPCMD_SHIFT == cmdInProgress);
+}
+
+
+
+// Colour wheel of 256 colours that range from pure red (0), thru red/greens
+// to pure green (85), thru green/blues to pure blue (170), thru blue/reds to
+// pure red (255 -> 0) again. Entries are (r,g,b); for wheel slot w:
+//      w <  85: (255 - 3w, 3w, 0)
+//      w < 170: (0, 255 - 3(w - 85), 3(w - 85))
+//      else:    (3(w - 170), 0, 255 - 3(w - 170))
+const uint8 k_colourWheel[256][3] PROGMEM =
+  {
+    {255,  0,  0}, {252,  3,  0}, {249,  6,  0}, {246,  9,  0},  //   0
+    {243, 12,  0}, {240, 15,  0}, {237, 18,  0}, {234, 21,  0},  //   4
+    {231, 24,  0}, {228, 27,  0}, {225, 30,  0}, {222, 33,  0},  //   8
+    {219, 36,  0}, {216, 39,  0}, {213, 42,  0}, {210, 45,  0},  //  12
+    {207, 48,  0}, {204, 51,  0}, {201, 54,  0}, {198, 57,  0},  //  16
+    {195, 60,  0}, {192, 63,  0}, {189, 66,  0}, {186, 69,  0},  //  20
+    {183, 72,  0}, {180, 75,  0}, {177, 78,  0}, {174, 81,  0},  //  24
+    {171, 84,  0}, {168, 87,  0}, {165, 90,  0}, {162, 93,  0},  //  28
+    {159, 96,  0}, {156, 99,  0}, {153,102,  0}, {150,105,  0},  //  32
+    {147,108,  0}, {144,111,  0}, {141,114,  0}, {138,117,  0},  //  36
+    {135,120,  0}, {132,123,  0}, {129,126,  0}, {126,129,  0},  //  40
+    {123,132,  0}, {120,135,  0}, {117,138,  0}, {114,141,  0},  //  44
+    {111,144,  0}, {108,147,  0}, {105,150,  0}, {102,153,  0},  //  48
+    { 99,156,  0}, { 96,159,  0}, { 93,162,  0}, { 90,165,  0},  //  52
+    { 87,168,  0}, { 84,171,  0}, { 81,174,  0}, { 78,177,  0},  //  56
+    { 75,180,  0}, { 72,183,  0}, { 69,186,  0}, { 66,189,  0},  //  60
+    { 63,192,  0}, { 60,195,  0}, { 57,198,  0}, { 54,201,  0},  //  64
+    { 51,204,  0}, { 48,207,  0}, { 45,210,  0}, { 42,213,  0},  //  68
+    { 39,216,  0}, { 36,219,  0}, { 33,222,  0}, { 30,225,  0},  //  72
+    { 27,228,  0}, { 24,231,  0}, { 21,234,  0}, { 18,237,  0},  //  76
+    { 15,240,  0}, { 12,243,  0}, {  9,246,  0}, {  6,249,  0},  //  80
+    {  3,252,  0}, {  0,255,  0}, {  0,252,  3}, {  0,249,  6},  //  84
+    {  0,246,  9}, {  0,243, 12}, {  0,240, 15}, {  0,237, 18},  //  88
+    {  0,234, 21}, {  0,231, 24}, {  0,228, 27}, {  0,225, 30},  //  92
+    {  0,222, 33}, {  0,219, 36}, {  0,216, 39}, {  0,213, 42},  //  96
+    {  0,210, 45}, {  0,207, 48}, {  0,204, 51}, {  0,201, 54},  // 100
+    {  0,198, 57}, {  0,195, 60}, {  0,192, 63}, {  0,189, 66},  // 104
+    {  0,186, 69}, {  0,183, 72}, {  0,180, 75}, {  0,177, 78},  // 108
+    {  0,174, 81}, {  0,171, 84}, {  0,168, 87}, {  0,165, 90},  // 112
+    {  0,162, 93}, {  0,159, 96}, {  0,156, 99}, {  0,153,102},  // 116
+    {  0,150,105}, {  0,147,108}, {  0,144,111}, {  0,141,114},  // 120
+    {  0,138,117}, {  0,135,120}, {  0,132,123}, {  0,129,126},  // 124
+    {  0,126,129}, {  0,123,132}, {  0,120,135}, {  0,117,138},  // 128
+    {  0,114,141}, {  0,111,144}, {  0,108,147}, {  0,105,150},  // 132
+    {  0,102,153}, {  0, 99,156}, {  0, 96,159}, {  0, 93,162},  // 136
+    {  0, 90,165}, {  0, 87,168}, {  0, 84,171}, {  0, 81,174},  // 140
+    {  0, 78,177}, {  0, 75,180}, {  0, 72,183}, {  0, 69,186},  // 144
+    {  0, 66,189}, {  0, 63,192}, {  0, 60,195}, {  0, 57,198},  // 148
+    {  0, 54,201}, {  0, 51,204}, {  0, 48,207}, {  0, 45,210},  // 152
+    {  0, 42,213}, {  0, 39,216}, {  0, 36,219}, {  0, 33,222},  // 156
+    {  0, 30,225}, {  0, 27,228}, {  0, 24,231}, {  0, 21,234},  // 160
+    {  0, 18,237}, {  0, 15,240}, {  0, 12,243}, {  0,  9,246},  // 164
+    {  0,  6,249}, {  0,  3,252}, {  0,  0,255}, {  3,  0,252},  // 168
+    {  6,  0,249}, {  9,  0,246}, { 12,  0,243}, { 15,  0,240},  // 172
+    { 18,  0,237}, { 21,  0,234}, { 24,  0,231}, { 27,  0,228},  // 176
+    { 30,  0,225}, { 33,  0,222}, { 36,  0,219}, { 39,  0,216},  // 180
+    { 42,  0,213}, { 45,  0,210}, { 48,  0,207}, { 51,  0,204},  // 184
+    { 54,  0,201}, { 57,  0,198}, { 60,  0,195}, { 63,  0,192},  // 188
+    { 66,  0,189}, { 69,  0,186}, { 72,  0,183}, { 75,  0,180},  // 192
+    { 78,  0,177}, { 81,  0,174}, { 84,  0,171}, { 87,  0,168},  // 196
+    { 90,  0,165}, { 93,  0,162}, { 96,  0,159}, { 99,  0,156},  // 200
+    {102,  0,153}, {105,  0,150}, {108,  0,147}, {111,  0,144},  // 204
+    {114,  0,141}, {117,  0,138}, {120,  0,135}, {123,  0,132},  // 208
+    {126,  0,129}, {129,  0,126}, {132,  0,123}, {135,  0,120},  // 212
+    {138,  0,117}, {141,  0,114}, {144,  0,111}, {147,  0,108},  // 216
+    {150,  0,105}, {153,  0,102}, {156,  0, 99}, {159,  0, 96},  // 220
+    {162,  0, 93}, {165,  0, 90}, {168,  0, 87}, {171,  0, 84},  // 224
+    {174,  0, 81}, {177,  0, 78}, {180,  0, 75}, {183,  0, 72},  // 228
+    {186,  0, 69}, {189,  0, 66}, {192,  0, 63}, {195,  0, 60},  // 232
+    {198,  0, 57}, {201,  0, 54}, {204,  0, 51}, {207,  0, 48},  // 236
+    {210,  0, 45}, {213,  0, 42}, {216,  0, 39}, {219,  0, 36},  // 240
+    {222,  0, 33}, {225,  0, 30}, {228,  0, 27}, {231,  0, 24},  // 244
+    {234,  0, 21}, {237,  0, 18}, {240,  0, 15}, {243,  0, 12},  // 248
+    {246,  0,  9}, {249,  0,  6}, {252,  0,  3}, {255,  0,  0}   // 252
+  };
+
+
+//-----------------------------------------------------------------------------
+// Function: fxWheelFill
+//   Set the pixel colours from successive slots of the colour wheel. Pixel
+//   #i gets wheel slot (wheelPos + floor(i * (posStep + remStep / len)))
+//   modulo 256, where len is the strip length; the fractional part of the
+//   step is accumulated so that no multiply or divide is needed per pixel.
+// Parameters:
+//   wheelPos:I  - Colour wheel slot of the first pixel.
+//   posStep:I   - Whole # of wheel slots between adjacent pixels.
+//   remStep:I   - Remainder of wheel slots between adjacent pixels, in units
+//                 of 1/m_ledStripLen slots.
+// Returns:   (none)
+// Inputs/Outputs:
+//   m_ledStripLen:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_pPixels:O
+//-----------------------------------------------------------------------------
+void fxWheelFill(uint8 wheelPos, uint8 posStep, uint16 remStep)
+{
+  const uint8  offsRed   = m_offsRed;
+  const uint8  offsGreen = m_offsGreen;
+  const uint8  offsBlue  = m_offsBlue;
+  const uint8 *entry;
+  uint8       *pixels;
+  uint16       rem = 0;
+  uint16       i;
 
   pixels = &m_pPixels[0];
-  for (i = 0; i < m_ledStripLen; i++)
+  for (i = m_ledStripLen; i != 0; i--)
   {
-    colour = colourWheel((i+j) & 0xFF);
-    pixels[m_offsRed]   = (uint8)((colour & 0x00FF0000) >> 16);
-    pixels[m_offsGreen] = (uint8)((colour & 0x0000FF00) >>  8);
-    pixels[m_offsBlue]  = (uint8)((colour & 0x000000FF) >>  0);
+    entry = k_colourWheel[wheelPos];
+    pixels[offsRed]   = pgm_read_byte(entry);
+    pixels[offsGreen] = pgm_read_byte(entry + 1);
+    pixels[offsBlue]  = pgm_read_byte(entry + 2);
     pixels += LEDS_PER_PIX;
+
+    wheelPos += posStep;
+    rem += remStep;
+    if (rem >= m_ledStripLen)
+    {
+      rem -= m_ledStripLen;
+      wheelPos++;
+    }
   }
+  markDirty(0, m_ledStripLen);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxHdlrNull
+//   The empty special FX handler.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//-----------------------------------------------------------------------------
+WaspCmd_t fxHdlrNull(void)
+{
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxHdlrRainbow
+//   Run an iteration of the animated rainbow effect.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_fxFrame:I
+//   m_fxParam1:I
+//   m_fxRestart:O
+//   m_pPixels:O
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t fxHdlrRainbow(void)
+{
+  m_fxRestart = false;
+  fxWheelFill((uint8)(m_fxParam1 + m_fxFrame), 1, 0);
 
   m_updatePixels = true;
   return WASPCMD_NONE;
@@ -2727,38 +5322,19 @@ WaspCmd_t fxHdlrRainbow(void)
 // Parameters:     (none)
 // Returns:   WASPCMD_NONE
 // Inputs/Outputs:
+//   m_fxFrame:I
 //   m_ledStripLen:I
-//   m_fxRestart:IO
+//   m_fxRestart:O
 //   m_pPixels:O
-//   m_pStrip:O
 //   m_updatePixels:O
 //-----------------------------------------------------------------------------
 WaspCmd_t fxHdlrRainbowCycle(void)
 {
-  static uint16 j = 255;
-  uint32   colour;
-  uint8   *pixels;
-  uint16   i = 0;
-
-  if (m_fxRestart)
-  {
-    m_fxRestart = false;
-    j = 0;
-  }
-  else
-  {
-    if (++j >= 256)
-      j = 0;
-  }
-
-  pixels = &m_pPixels[0];
-  for (i = 0; i < m_ledStripLen; i++)
+  m_fxRestart = false;
+  if (m_ledStripLen != 0)
   {
-    colour = colourWheel(((i * 256 / m_ledStripLen) + j) & 0xFF);
-    pixels[m_offsRed]   = (uint8)((colour & 0x00FF0000) >> 16);
-    pixels[m_offsGreen] = (uint8)((colour & 0x0000FF00) >>  8);
-    pixels[m_offsBlue]  = (uint8)((colour & 0x000000FF) >>  0);
-    pixels += LEDS_PER_PIX;
+    fxWheelFill((uint8)m_fxFrame, 256 / m_ledStripLen,
+                256 % m_ledStripLen);
   }
 
   m_updatePixels = true;
@@ -2784,7 +5360,6 @@ WaspCmd_t fxHdlrRainbowCycle(void)
 //-----------------------------------------------------------------------------
 WaspCmd_t fxHdlrTwinkle(void)
 {
-  const  uint32  k_white = mapToColour(255,255,255);
   static uint16  i = 0;
   static uint16  j = 0;
   static boolean newIteration = false;
@@ -2797,9 +5372,9 @@ WaspCmd_t fxHdlrTwinkle(void)
   if (m_fxRestart)
   {
     m_fxRestart = false;
-    restorePixels();
+    if (restorePixels())
+      m_updatePixels = true;
     newIteration = true;
-    m_updatePixels = true;
   }
   
   if (newIteration)
@@ -2818,7 +5393,8 @@ WaspCmd_t fxHdlrTwinkle(void)
         for (j = 0; j < m_fxParam3; j++)
         {
           k = (uint16_t)random(0, m_ledStripLen);
-          m_pStrip->setPixelColor(k, k_white);
+          memset(&m_pPixels[k * LEDS_PER_PIX], 255, LEDS_PER_PIX);
+          markDirty(k, 1);
         }
         m_updatePixels = true;
         phase = 2;
@@ -2842,9 +5418,10 @@ WaspCmd_t fxHdlrTwinkle(void)
         break;
       
       case 3:
-        // Remove white pixels (revert to all background colour)
-        restorePixels();
-        m_updatePixels = true;
+        // Remove white pixels (revert to all background colour). Only the
+        // twinkled pixels are dirty, so only those get copied back.
+        if (restorePixels())
+          m_updatePixels = true;
         delayEnd = millis() + random(m_fxParam1, m_fxParam2);
         phase = 4;
         break;
@@ -2878,6 +5455,460 @@ WaspCmd_t fxHdlrTwinkle(void)
 }
 
 
+//-----------------------------------------------------------------------------
+// Function: fxHdlrScript
+//   Run an iteration of the effect script: interpret its bytecode (see
+//   SOP_... in WASP_defs.h) from the first instruction until SOP_END, the
+//   end of the script, or SCRIPT_MAX_STEPS instructions have run.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_fxParam1:I  - Script start time (network time, in milliseconds)
+//   m_ledStripLen:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_script:I
+//   m_scriptLen:I
+//   m_fxRestart:IO
+//   m_pPixels:O
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t fxHdlrScript(void)
+{
+  static int16  regs[SCRIPT_NUM_REGS];
+  const uint8  *entry;
+  uint8        *instr;
+  uint8        *pixels;
+  uint8         pen[3] = {0, 0, 0};
+  int16        *rx;
+  int16        *ry;
+  int16         first;
+  int16         count;
+  uint16        steps = SCRIPT_MAX_STEPS;
+  uint16        pc = 0;
+
+  if (m_fxRestart)
+  {
+    m_fxRestart = false;
+    memset(regs, 0, sizeof(regs));
+  }
+
+  while ((pc + SCRIPT_INSTR_LEN) <= m_scriptLen)
+  {
+    if (0 == steps--)
+    {
+      logPrintln(FLASH("***FX: Script step limit reached"));
+      break;
+    }
+    instr = &m_script[pc];
+    rx = &regs[instr[1] & (SCRIPT_NUM_REGS - 1)];
+    ry = &regs[instr[2] & (SCRIPT_NUM_REGS - 1)];
+    pc += SCRIPT_INSTR_LEN;
+
+    switch (instr[0])
+    {
+      case SOP_END:  pc = m_scriptLen;                                break;
+      case SOP_LDI:
+        *rx = (int16)(instr[2] | ((uint16)instr[3] << 8));
+        break;
+      case SOP_TIME:
+        *rx = ((netMillis() - m_fxParam1) / SCRIPT_TICK_MS) & 0x7FFF;
+        break;
+      case SOP_LEN:  *rx = m_ledStripLen;                             break;
+      case SOP_MOV:  *rx = *ry;                                       break;
+      case SOP_ADD:  *rx += *ry;                                      break;
+      case SOP_SUB:  *rx -= *ry;                                      break;
+      case SOP_MUL:  *rx *= *ry;                                      break;
+      case SOP_DIV:  *rx = (*ry != 0 ? *rx / *ry : 0);                break;
+      case SOP_MOD:  *rx = (*ry != 0 ? *rx % *ry : 0);                break;
+      case SOP_ADDI:
+        *rx += (int16)(instr[2] | ((uint16)instr[3] << 8));
+        break;
+      case SOP_JMP:  pc = (uint16)instr[3] * SCRIPT_INSTR_LEN;        break;
+      case SOP_JLT:
+        if (*rx < *ry)
+          pc = (uint16)instr[3] * SCRIPT_INSTR_LEN;
+        break;
+      case SOP_JNZ:
+        if (*rx != 0)
+          pc = (uint16)instr[3] * SCRIPT_INSTR_LEN;
+        break;
+      case SOP_COLOR:
+        pen[0] = instr[1];
+        pen[1] = instr[2];
+        pen[2] = instr[3];
+        break;
+      case SOP_WHEEL:
+        entry = k_colourWheel[(uint8)*rx];
+        pen[0] = pgm_read_byte(entry);
+        pen[1] = pgm_read_byte(entry + 1);
+        pen[2] = pgm_read_byte(entry + 2);
+        break;
+      case SOP_PIX:
+      case SOP_FILL:
+        first = *rx;
+        count = (SOP_PIX == instr[0] ? 1 : *ry);
+        if (first < 0)
+        {
+          count += first;
+          first = 0;
+        }
+        if (count > (int16)m_ledStripLen - first)
+          count = (int16)m_ledStripLen - first;
+        if (count <= 0)
+          break;
+        markDirty(first, count);
+        pixels = &m_pPixels[first * LEDS_PER_PIX];
+        for ( ; count != 0; count--)
+        {
+          pixels[m_offsRed]   = pen[0];
+          pixels[m_offsGreen] = pen[1];
+          pixels[m_offsBlue]  = pen[2];
+          pixels += LEDS_PER_PIX;
+        }
+        break;
+      default:
+        logPrint(FLASH("***FX: Bad script op "));
+        logPrintln(instr[0]);
+        pc = m_scriptLen;
+        break;
+    }
+  }
+
+  m_updatePixels = true;
+  return WASPCMD_NONE;
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxFadeFill
+//   Move every pixel the given fraction of the way from its current colour
+//   to its target colour on the gradient from m_fxParam1 (first pixel) to
+//   m_fxParam2 (last pixel). The gradient is stepped in 16.16 fixed point,
+//   and any non-zero fraction moves each channel by at least one level, so
+//   a fade always reaches its target colours.
+// Parameters:
+//   frac:I  - The fraction, in 256ths (256 = set the target colours).
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_fxParam1:I
+//   m_fxParam2:I
+//   m_ledStripLen:I
+//   m_offsBlue:I
+//   m_offsGreen:I
+//   m_offsRed:I
+//   m_pPixels:IO
+//   m_dirtyMap:O
+//-----------------------------------------------------------------------------
+static void fxFadeFill(uint16 frac)
+{
+  uint8   offs[LEDS_PER_PIX];
+  uint32  acc[LEDS_PER_PIX];
+  uint32  step[LEDS_PER_PIX];
+  uint8  *pixels;
+  uint8   from, to, diff;
+  uint8   c;
+  uint16  i;
+
+  offs[0] = m_offsRed;
+  offs[1] = m_offsGreen;
+  offs[2] = m_offsBlue;
+  for (c = 0; c < LEDS_PER_PIX; c++)
+  {
+    from = (uint8)(m_fxParam1 >> (16 - 8 * c));
+    to   = (uint8)(m_fxParam2 >> (16 - 8 * c));
+    acc[c]  = ((uint32)from << 16) | 0x8000;
+    step[c] = 0;
+    if (m_ledStripLen > 1)
+    {
+      step[c] = (uint32)((((int32)to - from) << 16) /
+                         (int32)(m_ledStripLen - 1));
+    }
+  }
+
+  pixels = m_pPixels;
+  for (i = m_ledStripLen; i != 0; i--, pixels += LEDS_PER_PIX)
+  {
+    for (c = 0; c < LEDS_PER_PIX; c++)
+    {
+      from = pixels[offs[c]];
+      to   = (uint8)(acc[c] >> 16);
+      acc[c] += step[c];
+      if (to > from)
+      {
+        diff = (uint8)(((uint16)(to - from) * frac + 255) >> 8);
+        pixels[offs[c]] = from + diff;
+      }
+      else
+      {
+        diff = (uint8)(((uint16)(from - to) * frac + 255) >> 8);
+        pixels[offs[c]] = from - diff;
+      }
+    }
+  }
+  markDirty(0, m_ledStripLen);
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: fxHdlrFade
+//   Run an iteration of the crossfade effect (WASPCMD_FADE and
+//   WASPCMD_GRADIENT). Each frame covers the network time elapsed since the
+//   last one as a fraction of the time left, so the fade stays smooth at any
+//   frame rate and ends on time. The effect ends with the fade, leaving the
+//   target colours as the saved colours (as for WASPCMD_BKGRD), and the
+//   effect speed as it was before the fade.
+// Parameters:     (none)
+// Returns:   WASPCMD_NONE
+// Inputs/Outputs:
+//   m_fxDelayPrev:I
+//   m_fxParam3:I  - Fade start time (network time, in milliseconds)
+//   m_fxParam4:I  - Fade duration (in milliseconds)
+//   m_runAnimationPrev:I
+//   m_fxRestart:IO
+//   m_fxDelay:O
+//   m_runAnimation:O
+//   m_runningFx:O
+//   m_pPixels:O
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+WaspCmd_t fxHdlrFade(void)
+{
+  static uint32 lastTime = 0;
+  uint32 currTime;
+  uint32 endTime;
+  uint16 frac;
+
+  if (m_fxRestart)
+  {
+    m_fxRestart = false;
+    lastTime = m_fxParam3;
+  }
+
+  currTime = netMillis();
+  endTime  = m_fxParam3 + m_fxParam4;
+  if ((int32)(currTime - endTime) >= 0)
+    frac = 256;
+  else if ((int32)(currTime - lastTime) <= 0)
+    return WASPCMD_NONE;
+  else
+    frac = (uint16)(((currTime - lastTime) << 8) / (endTime - lastTime));
+
+  /* Until a step is due, let the elapsed time build up */
+  if (0 == frac)
+    return WASPCMD_NONE;
+  lastTime = currTime;
+
+  fxFadeFill(frac);
+  if (256 == frac)
+  {
+    savePixels();
+    m_runningFx = WASPCMD_NONE;
+    m_fxDelay = m_fxDelayPrev;
+    m_runAnimation = m_runAnimationPrev;
+  }
+
+  m_updatePixels = true;
+  return WASPCMD_NONE;
+}
+
+//-----------------------------------------------------------------------------
+// Function: brightStep
+//   Step the output brightness fade (WASPCMD_BRIGHT) every FADE_FRAME_MS.
+//   The level follows the network time, so it ends on time (and at the same
+//   moment on every node) whatever else is running.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_brightFrom:I
+//   m_brightStart:I
+//   m_brightTo:I
+//   m_bright:IO
+//   m_brightNext:IO
+//   m_brightTime:IO
+//   m_updatePixels:O
+//-----------------------------------------------------------------------------
+void brightStep(void)
+{
+  int32 elapsed;
+  uint8 level;
+
+  if ( (0 == m_brightTime) || ((int32)(millis() - m_brightNext) < 0) )
+    return;
+  m_brightNext = millis() + FADE_FRAME_MS;
+
+  elapsed = (int32)(netMillis() - m_brightStart);
+  if (elapsed < 0)
+    elapsed = 0;
+  if ((uint32)elapsed >= m_brightTime)
+  {
+    level = m_brightTo;
+    m_brightTime = 0;
+  }
+  else
+  {
+    level = m_brightFrom + (int16)( ((int16)m_brightTo - m_brightFrom) *
+                                    elapsed / (int32)m_brightTime );
+  }
+
+  if (level != m_bright)
+  {
+    m_bright = level;
+    m_updatePixels = true;
+  }
+}
+
+
+// Gamma correction curve: k_gamma8[v] = 255 * (v / 255)^2.8, rounded.
+const uint8 k_gamma8[256] PROGMEM =
+  {
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  //   0
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,  //  16
+      1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,  //  32
+      2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,  //  48
+      5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,  //  64
+     10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,  //  80
+     17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,  //  96
+     25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,  // 112
+     37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,  // 128
+     51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,  // 144
+     69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,  // 160
+     90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,  // 176
+    115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,  // 192
+    144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,  // 208
+    177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,  // 224
+    215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255   // 240
+  };
+
+
+//-----------------------------------------------------------------------------
+// Function: outputPass
+//   Pass pixel bytes through the output stage (gamma correction, then
+//   brightness scaling).
+// Parameters:
+//   dst:O  - Where to put the output bytes.
+//   src:I  - The pixel bytes.
+//   n:I    - # of bytes; there's nothing to do if dst is src.
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_bright:I
+//   m_gamma:I
+//-----------------------------------------------------------------------------
+static void outputPass(uint8 *dst, const uint8 *src, uint16 n)
+{
+  const uint16 scale = (uint16)m_bright + 1;
+
+  if (dst == src)
+    return;
+
+  if (m_gamma)
+  {
+    for ( ; n != 0; n--)
+      *dst++ = (uint8)((pgm_read_byte(&k_gamma8[*src++]) * scale) >> 8);
+  }
+  else if (BRIGHT_FULL == m_bright)
+  {
+    memcpy(dst, src, n);
+  }
+  else
+  {
+    for ( ; n != 0; n--)
+      *dst++ = (uint8)((*src++ * scale) >> 8);
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: showPixels
+//   Show the pixel colours: pass them through the output stage into the
+//   strip's buffer(s) in a single pass, and send them to the strip, one half
+//   at a time in split-strip mode. Interrupts are disabled while each is
+//   sent, so the radio can take only one packet meanwhile: it's emptied
+//   before and after each (see radioRxPoll()).
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_numPixelBytes:I
+//   m_pPixels:I
+//   m_splitBytes:I
+//   m_pShowPixels:O
+//   m_pShowPixels2:O
+//   m_pStrip:O
+//   m_pStrip2:O
+//-----------------------------------------------------------------------------
+void showPixels(void)
+{
+  outputPass(m_pShowPixels, m_pPixels, m_splitBytes);
+  if (NULL != m_pStrip2)
+  {
+    outputPass(m_pShowPixels2, &m_pPixels[m_splitBytes],
+               m_numPixelBytes - m_splitBytes);
+  }
+
+  radioRxPoll();
+  m_pStrip->show();
+  radioRxPoll();
+  if (NULL != m_pStrip2)
+  {
+    m_pStrip2->show();
+    radioRxPoll();
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// Function: splitStripInit
+//   Set up split-strip mode, if possible: the first half of the strip is
+//   driven from the configured control pin, and the second half from
+//   SPLIT_STRIP_PIN (wired as a separate strip), halving the time that
+//   interrupts are disabled per show(). The halves are shown from a single
+//   pixel buffer, so this needs the room for it.
+// Parameters: (none)
+// Returns:    (none)
+// Inputs/Outputs:
+//   m_ledStripCtrlPin:I
+//   m_ledStripCtrlOk:I
+//   m_ledStripFreq:I
+//   m_ledStripLen:I
+//   m_ledStripWiring:I
+//   m_numPixelBytes:I
+//   m_pPixels:O
+//   m_pShowPixels2:O
+//   m_pStrip:O
+//   m_pStrip2:O
+//   m_splitBytes:O
+//-----------------------------------------------------------------------------
+#ifdef SPLIT_STRIP_PIN
+void splitStripInit(void)
+{
+  uint16 splitLen = (m_ledStripLen + 1) >> 1;
+
+  if ( (m_ledStripLen < 2) || (SPLIT_STRIP_PIN == m_ledStripCtrlPin) ||
+       !m_ledStripCtrlOk[SPLIT_STRIP_PIN] ||
+       !(IS_MEGA || (SPLIT_STRIP_PIN <= MAX_DIO_PIN)) )
+  {
+    logPrintln(FLASH("***Split strip: Bad pin or length"));
+    return;
+  }
+  if ( (FreeRam() - RAM_RESERVE < 2 * (int)m_numPixelBytes) ||
+       (NULL == (m_pPixels = (uint8 *)calloc(m_numPixelBytes, 1))) )
+  {
+    logPrintln(FLASH("***Split strip: Insufficient RAM"));
+    return;
+  }
+
+  m_pStrip  = new Adafruit_NeoPixel( splitLen,
+                                     (uint8_t)m_ledStripCtrlPin,
+                                     (m_ledStripWiring + m_ledStripFreq) );
+  m_pStrip2 = new Adafruit_NeoPixel( m_ledStripLen - splitLen,
+                                     (uint8_t)SPLIT_STRIP_PIN,
+                                     (m_ledStripWiring + m_ledStripFreq) );
+  m_pShowPixels2 = m_pStrip2->getPixels();
+  m_splitBytes = splitLen * LEDS_PER_PIX;
+}
+#endif
+
 
 //-----------------------------------------------------------------------------
 // Function: setup
@@ -2887,6 +5918,9 @@ WaspCmd_t fxHdlrTwinkle(void)
 //-----------------------------------------------------------------------------
 void setup()
 {
+  uint16 stripLen;
+  int    freeRam;
+
 #ifdef CONSOLE_ENABLED
   Serial.begin(SERIAL_BAUD);
 #endif
@@ -2955,8 +5989,12 @@ void setup()
 
   // Initialize external add-on Flash memory, if available
   Serial.print("SPI Flash for wireless software upgrades: ");
-  if (m_flash.initialize())
+  m_flashPresent = m_flash.initialize();
+  if (m_flashPresent)
+  {
     Serial.println("located onboard");
+    fwdLoad();
+  }
   else
     Serial.println("absent");
 
@@ -2975,6 +6013,14 @@ void setup()
   //   NEO_RGB     Pixels are wired for RGB bitstream (v1 FLORA pixels, not v2)
   // JVS: On the 12V strip that I have, the colour order is RBG rather than RGB.
   m_ledStripFlags = WIRING_RGB;
+#ifdef FIXED_WIRING
+  if (m_ledStripWiring != FIXED_WIRING)
+  {
+    logPrint(FLASH("***Wiring order fixed at "));
+    logPrintln(FIXED_WIRING);
+    m_ledStripWiring = FIXED_WIRING;
+  }
+#else
   switch (m_ledStripWiring)
   {
     case WIRING_RGB:
@@ -3009,32 +6055,72 @@ void setup()
       break;
 
   }
+#endif
   m_ledStripFlags = NEO_RGB;
   if (m_ledStripFreq == FREQ_IDX_800kHz)
     m_ledStripFlags += NEO_KHZ800;
   else
     m_ledStripFlags += NEO_KHZ400;
-  if (m_ledStripLen >= 1)
+  // Limit the strip to what fits in the pixel pool and the free RAM (the
+  // strip's pixel data is its only large heap allocation).
+  stripLen = m_ledStripLen;
+  if (m_ledStripLen > MAX_PIXELS)
+    m_ledStripLen = MAX_PIXELS;
+  freeRam = FreeRam() - RAM_RESERVE;
+  if ( (freeRam < LEDS_PER_PIX) && (m_ledStripLen >= 1) )
+    m_ledStripLen = 1;
+  else if (m_ledStripLen > (uint16)(freeRam / LEDS_PER_PIX))
+    m_ledStripLen = freeRam / LEDS_PER_PIX;
+  if (m_ledStripLen != stripLen)
   {
-    // Apparently valid configuration parameters
-    m_pStrip = new Adafruit_NeoPixel( m_ledStripLen,
-                                      (uint8_t)m_ledStripCtrlPin,
-                                      (m_ledStripWiring + m_ledStripFreq) );
+    logPrint(FLASH("***Strip limited to "));
+    logPrint(m_ledStripLen);
+    logPrintln(FLASH(" pixels"));
   }
-  else
+
+  m_numPixelBytes = m_ledStripLen * LEDS_PER_PIX;
+  m_splitBytes = m_numPixelBytes;
+#ifdef SPLIT_STRIP_PIN
+  splitStripInit();
+#endif
+  if (NULL == m_pStrip)
   {
-    // Configuration parameters appear questionable. Create a default strip.
-    m_pStrip = new Adafruit_NeoPixel( 1, NEO_PIN, NEO_RGB + NEO_KHZ800 );
+    if (m_ledStripLen >= 1)
+    {
+      // Apparently valid configuration parameters
+      m_pStrip = new Adafruit_NeoPixel( m_ledStripLen,
+                                        (uint8_t)m_ledStripCtrlPin,
+                                        (m_ledStripWiring + m_ledStripFreq) );
+    }
+    else
+    {
+      // Configuration parameters appear questionable. Create a default
+      // strip.
+      m_pStrip = new Adafruit_NeoPixel( 1, NEO_PIN, NEO_RGB + NEO_KHZ800 );
+    }
   }
 
-  m_savedLeds = (uint8 *)malloc(m_ledStripLen * LEDS_PER_PIX);
-  
-  // Get the direct pointer to the pixel data.
-  m_pPixels = m_pStrip->getPixels();
-  m_numPixelBytes = m_ledStripLen * LEDS_PER_PIX;
+  // Get the direct pointer to the pixel data. The pixels are drawn in a
+  // buffer of their own if there's room, so that the output stage
+  // (showPixels()) can leave them unchanged.
+  m_pShowPixels = m_pStrip->getPixels();
+  pixelPoolInit();
+  if (SAVE_FULL != m_saveMode)
+  {
+    logPrintln( (SAVE_PALETTE == m_saveMode ?
+                 FLASH("Saved pixels are limited to 16 colours") :
+                 FLASH("***Insufficient RAM to save pixels")) );
+  }
+  freeRam = FreeRam() - RAM_RESERVE;
+  if ( (NULL == m_pPixels) && (freeRam >= (int)m_numPixelBytes) )
+    m_pPixels = (uint8 *)calloc(m_numPixelBytes, 1);
+  if (NULL == m_pPixels)
+    m_pPixels = m_pShowPixels;
+  if (m_pPixels == m_pShowPixels)
+    logPrintln(FLASH("***Insufficient RAM for brightness control"));
   
-  for (int8 i = MAX_TIMINGS; i >= 0; i--)
-    m_timings[i] = 0;
+  for (uint8 i = 0; i < MAX_TIMINGS; i++)
+    tmrReset(i);
     
   m_myRespDelay = (m_myNodeId - CONTROLLERID) * SLAVE_TX_WIND;
   
@@ -3047,7 +6133,7 @@ void setup()
   pinMode(POWER_LED, OUTPUT);
   pinMode(WASP_RX_LED, OUTPUT);
   pinMode(WASP_TX_LED, OUTPUT);
-  m_pStrip->show();
+  showPixels();
 }
 
 
@@ -3101,6 +6187,21 @@ void loop()
     tmrUpdateOmet(TMR_WASP_EXEC);
   }
 
+  // Reply to a telemetry query once it's my turn to transmit
+  if (m_telemPending && ((int32)(millis() - m_telemTxTime) >= 0))
+    sendTelemetry();
+
+  // Report a gap in a multicast stream or pixel upload once it's my turn to
+  // transmit
+  if (m_nackPending && ((int32)(millis() - m_nackTxTime) >= 0))
+  {
+    m_nackPending = false;
+    radioSendBuf(CONTROLLERID, m_nackBuf, m_nackLen);
+  }
+
+  // Execute the scheduled commands that are due
+  schedRun();
+
   // Iterate on a special effect, if enabled.
   if ( !m_pixelShowSuspend &&
        (   ( (true == m_runAnimation) && (millis() >= m_fxResumeTime) )
@@ -3111,14 +6212,16 @@ void loop()
     m_loopRefTime = micros();
 
     // Run an FX iteration
-    (void)(*m_pxFxHdlrs[m_runningFx])();
+    fxNextFrame();
+    (void)(*PX_HDLR(m_pxFxHdlrs, m_runningFx))();
     
     if (!m_fxStep)
     {
-      m_fxResumeTime = millis() + m_fxDelay;
+      m_fxResumeTime = fxResumeTime();
     }
     m_fxStep = false;
     tmrUpdateOmet(TMR_FX_EXEC);
+    radioRxPoll();
   }
   
   // Generate RFM radio response when necessary (not used this way currently)
@@ -3126,9 +6229,10 @@ void loop()
 
   // Update LED strip
   m_loopRefTime = micros();
-  if (m_updatePixels && !m_pixelShowSuspend)
+  brightStep();
+  if (m_updatePixels && !m_pixelShowSuspend && !m_showDefer)
   {
-    m_pStrip->show();
+    showPixels();
     m_updatePixels = false;
   }
   tmrUpdateOmet(TMR_PXL_UPD);
@@ -3139,6 +6243,5 @@ void loop()
     m_loopRefTime = MAXUINT32 - m_loopStartTime + m_loopRefTime;
   else
     m_loopRefTime = m_loopRefTime - m_loopStartTime;
-  if (m_loopRefTime > m_timings[TMR_LOOP])
-    m_timings[TMR_LOOP] = m_loopRefTime;
+  tmrRecord(TMR_LOOP, m_loopRefTime);
 }
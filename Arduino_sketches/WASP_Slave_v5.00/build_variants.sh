@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# build_variants.sh - Build the specialised WASP slave variants.
+#
+# Each variant is the slave sketch built for one board with a fixed colour
+# wiring order (FIXED_WIRING) and, optionally, a shorter strip length bound
+# (STRIP_MAX_LEN). The hex files are written next to the sketch, named
+#     WASP_Slave_v5.00.ino[.with_bootloader].<board>.<variant>.hex
+# e.g. WASP_Slave_v5.00.ino.MoteinoMEGA.GRB.hex, ready for the wireless
+# programming procedure (see "Wirelessly Reprogramming WASP Slave
+# Nodes.txt"). Load a variant only onto a slave whose strip has that wiring
+# order and no more than that many pixels.
+#
+# Requires arduino-cli, with the LowPowerLab Moteino core and the sketch's
+# libraries installed (as for the Arduino IDE).
+#
+# Usage: build_variants.sh [-l] [<board>.<variant> ...]
+#   -l       List the variants.
+#   (none)   Build every variant.
+#
+
+SKETCH_DIR=$(cd "$(dirname "$0")" && pwd)
+SKETCH=$(basename "$SKETCH_DIR").ino
+ARDUINO_CLI=${ARDUINO_CLI:-arduino-cli}
+
+# <board>.<variant>   <FQBN>   <compiler flags, comma separated>
+VARIANTS="
+Moteino.GRB          Moteino:avr:Moteino      -DFIXED_WIRING=WIRING_GRB
+Moteino.RGB          Moteino:avr:Moteino      -DFIXED_WIRING=WIRING_RGB
+Moteino.GRB.60       Moteino:avr:Moteino      -DFIXED_WIRING=WIRING_GRB,-DSTRIP_MAX_LEN=60
+MoteinoMEGA.GRB      Moteino:avr:MoteinoMEGA  -DFIXED_WIRING=WIRING_GRB
+MoteinoMEGA.RGB      Moteino:avr:MoteinoMEGA  -DFIXED_WIRING=WIRING_RGB
+MoteinoMEGA.GRB.150  Moteino:avr:MoteinoMEGA  -DFIXED_WIRING=WIRING_GRB,-DSTRIP_MAX_LEN=150
+"
+
+if [ "$1" = "-l" ]; then
+  echo "$VARIANTS" | awk 'NF { gsub(",", " ", $3); printf "%-20s %s\n", $1, $3 }'
+  exit 0
+fi
+
+BUILD_DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$BUILD_DIR"' EXIT
+status=0
+
+echo "$VARIANTS" | while read -r name fqbn flags; do
+  [ -z "$name" ] && continue
+  if [ $# -ne 0 ]; then
+    case " $* " in
+      *" $name "*) ;;
+      *) continue ;;
+    esac
+  fi
+  flags=$(echo "$flags" | tr ',' ' ')
+  board=${name%%.*}
+  variant=${name#*.}
+
+  echo "=== $name ($flags)"
+  rm -rf "$BUILD_DIR/out"
+  if ! "$ARDUINO_CLI" compile --fqbn "$fqbn" \
+         --build-property "compiler.cpp.extra_flags=$flags" \
+         --output-dir "$BUILD_DIR/out" "$SKETCH_DIR"; then
+    echo "***ERROR: $name failed to build" >&2
+    exit 1
+  fi
+  cp "$BUILD_DIR/out/$SKETCH.hex" \
+     "$SKETCH_DIR/$SKETCH.$board.$variant.hex" || exit 1
+  cp "$BUILD_DIR/out/$SKETCH.with_bootloader.hex" \
+     "$SKETCH_DIR/$SKETCH.with_bootloader.$board.$variant.hex" || exit 1
+done || status=1
+
+exit $status
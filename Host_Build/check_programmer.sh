@@ -0,0 +1,112 @@
+#!/bin/sh
+#
+# check_programmer.sh - Test of a host build of the WASP programming gateway's
+# broadcast upload: send it a hex file, formatted as LowPowerLab's OTA.py
+# sends it (one record per line, then three bundled per line), and check
+# that it accepts every line and then broadcasts the image and its CRC.
+#
+# Usage: check_programmer.sh <wasp_programmer>
+#
+
+if [ $# -ne 1 ]; then
+  echo "usage: $0 <wasp_programmer>" >&2
+  exit 2
+fi
+PROGRAMMER=$1
+TMP=$(mktemp -d) || exit 2
+trap 'rm -rf "$TMP"' EXIT
+status=0
+
+for lines in 1 3; do
+  # The console input: OTA.py's lines for a 216-byte image (13 full data
+  # records and a short one), bundled as its LINESPERPACKET option does.
+  python3 - "$lines" "$TMP/image" > "$TMP/in" <<'EOF'
+import sys
+
+LINESPERPACKET = int(sys.argv[1])
+image = bytes((i * 7 + 3) % 256 for i in range(216))
+open(sys.argv[2], 'wb').write(image)
+
+content = []
+for addr in range(0, len(image), 16):
+    rec = bytes([len(image[addr:addr + 16]), addr >> 8, addr & 255, 0]) + \
+          image[addr:addr + 16]
+    content.append(':' + rec.hex().upper() + '%02X' % (-sum(rec) & 255))
+content.append(':00000001FF')
+
+print('TO:255')
+print('FLX?')
+seq = 0
+packetCounter = 0
+while content[seq] != ':00000001FF':
+    # As in OTA.py
+    currentLine = content[seq]
+    hexDataToSend = currentLine
+    bundledLines = 1
+    if LINESPERPACKET > 1 and currentLine[7:9] == '00':
+        nextLine = content[seq+1]
+        if nextLine != ":00000001FF" and nextLine[7:9] == '00':
+            checksum = int(currentLine[len(currentLine)-2:len(currentLine)], 16) + int(nextLine[len(nextLine)-2:len(nextLine)], 16) + int(nextLine[3:5], 16) + int(nextLine[5:7], 16)
+            addressByte = int(currentLine[1:3], 16) + int(nextLine[1:3], 16)
+            nextLine2 = content[seq+2]
+            if LINESPERPACKET==3 and nextLine2 != ":00000001FF" and nextLine2[7:9] == "00":
+                checksum += int(nextLine2[len(nextLine2)-2:len(nextLine2)], 16) + int(nextLine2[3:5], 16) + int(nextLine2[5:7], 16)
+                addressByte += int(nextLine2[1:3], 16)
+                hexDataToSend = ":" + ('%0*X' % (2,addressByte%256)) + hexDataToSend[3:len(hexDataToSend)-2] + nextLine[9:len(nextLine)-2] + nextLine2[9:len(nextLine)-2] + ('%0*X' % (2,checksum%256))
+                bundledLines=3
+            else:
+                hexDataToSend = ":" + ('%0*X' % (2,addressByte%256)) + hexDataToSend[3:len(hexDataToSend)-2] + nextLine[9:len(nextLine)-2] + ('%0*X' % (2,checksum%256))
+                bundledLines=2
+    print("FLX:" + str(packetCounter) + hexDataToSend)
+    seq += bundledLines
+    packetCounter += 1
+print('FLX?EOF')
+EOF
+
+  HOST_FLASH=1 HOST_TX_VERBOSE=1 "$PROGRAMMER" < "$TMP/in" > "$TMP/out" 2>&1
+
+  # Check the replies, and the OFFER and BLOCK frames of the broadcast.
+  if ! python3 - "$TMP/in" "$TMP/out" "$TMP/image" <<'EOF'
+import re
+import sys
+
+sent = [l for l in open(sys.argv[1]).read().split('\n') if l[:4] == 'FLX:']
+out = open(sys.argv[2], errors='replace').read()
+image = open(sys.argv[3], 'rb').read()
+errors = []
+
+acks = re.findall(r'^FLX:(\d+):OK$', out, re.M)
+if acks != [str(i) for i in range(len(sent))]:
+    errors.append('%d of %d lines accepted' % (len(acks), len(sent)))
+if 'FLX:INV' in out or 'FLX?NOK' in out:
+    errors.append('a line was rejected')
+
+crc = 0xFFFF
+for b in image:
+    crc ^= b << 8
+    for _ in range(8):
+        crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+frames = [list(map(int, f.split()))
+          for f in re.findall(r'^\[TX \d+ dst=255:([ \d]*)\]$', out, re.M)]
+offer = [0xF0, crc & 255, len(image) & 255, len(image) >> 8,
+         crc & 255, crc >> 8]
+if not frames or frames[0] != offer:
+    errors.append('OFFER %s, not %s' % (frames[:1], offer))
+data = b''.join(bytes(f[4:]) for f in frames if f[0] == 0xF1)
+if data != image:
+    errors.append('BLOCKs hold %d bytes, not the %d-byte image'
+                  % (len(data), len(image)))
+
+for e in errors:
+    print('***ERROR: ' + e)
+sys.exit(1 if errors else 0)
+EOF
+  then
+    grep -a -v '^\[TX' "$TMP/out" | tail -n 20
+    echo "***ERROR: $PROGRAMMER failed with $lines record(s) per line" >&2
+    status=1
+  fi
+done
+
+[ 0 -eq "$status" ] && echo "$PROGRAMMER: OK"
+exit $status
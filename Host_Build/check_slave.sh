@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# check_slave.sh - Smoke test of a host build of the WASP slave: configure it
+# as node #2 with an 8-pixel strip, then send it a LINE and a one-second
+# FADE, and check that the whole strip ends up the fade's colour.
+#
+# Usage: check_slave.sh <wasp_slave>
+#
+
+if [ $# -ne 1 ]; then
+  echo "usage: $0 <wasp_slave>" >&2
+  exit 2
+fi
+SLAVE=$1
+TMP=$(mktemp -d) || exit 2
+trap 'rm -rf "$TMP"' EXIT
+
+# A node ID change needs a restart before other settings are taken.
+export HOST_EEPROM="$TMP/eeprom" HOST_IDLE_POLLS=100000
+printf 'nodeid 2\n' | "$SLAVE" > "$TMP/out" 2>&1 &&
+  printf 'led 8,8,2\nsave\n' | "$SLAVE" >> "$TMP/out" 2>&1 || {
+  cat "$TMP/out"
+  echo "***ERROR: $SLAVE failed to configure" >&2
+  exit 1
+}
+
+# <ms> <src> <dst> <WASP command>
+cat > "$TMP/frames" <<EOF
+3000 1 255 4 0 3 255 0 0
+3100 1 255 26 0 0 255 10
+EOF
+
+HOST_RX_FILE="$TMP/frames" HOST_PIXELS_VERBOSE=1 HOST_IDLE_POLLS=1000000 \
+  "$SLAVE" < /dev/null > "$TMP/out" 2>&1
+last=$(grep -a '^\[SHOW' "$TMP/out" | tail -n 1 | cut -d: -f2)
+expect=" 0000FF 0000FF 0000FF 0000FF 0000FF 0000FF 0000FF 0000FF]"
+if [ "$last" != "$expect" ]; then
+  grep -a -v '^\[SHOW' "$TMP/out"
+  echo "***ERROR: $SLAVE strip is [$last, not [$expect" >&2
+  exit 1
+fi
+echo "$SLAVE: OK"
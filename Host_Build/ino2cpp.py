@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# ino2cpp.py - Turn an Arduino sketch into a C++ file for the host build.
+#
+# As the Arduino builder does, this includes <Arduino.h> first, and declares
+# a prototype of each function defined in the sketch just before the first
+# definition, so that functions can be called before they're defined.
+# #line directives keep compiler messages pointing into the sketch.
+#
+# Usage: ino2cpp.py [--mega] <sketch.ino> <out.cpp>
+#   --mega  Build for the Moteino Mega (ATmega1284P) rather than the Moteino.
+#
+
+import re
+import sys
+
+
+def strip_comments(text):
+    """Blank out comments, keeping the line numbering."""
+    text = re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'),
+                  text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+def find_prototypes(text):
+    """Return the function definitions' signatures, and the line # of the
+    first one."""
+    lines = strip_comments(text).split('\n')
+    protos = []
+    first = None
+    i = 0
+    while i < len(lines):
+        line = lines[i]
+        if (re.match(r'^[A-Za-z_][\w\s\*]*\s\**\w+\s*\(', line) and
+                not line.startswith(('typedef', 'return', 'else', 'if',
+                                     '#')) and
+                not line.rstrip().endswith(';')):
+            sig = line
+            j = i
+            while sig.count('(') > sig.count(')') and j + 1 < len(lines):
+                j += 1
+                sig += ' ' + lines[j].strip()
+            k = j + 1
+            while k < len(lines) and lines[k].strip() == '':
+                k += 1
+            if (sig.rstrip().endswith('{') or
+                    (k < len(lines) and lines[k].strip().startswith('{'))):
+                sig = sig.rstrip().rstrip('{').strip()
+                if '=' not in sig.split('(')[0]:
+                    protos.append(sig + ';')
+                    if first is None:
+                        first = i
+            i = j + 1
+            continue
+        i += 1
+    return protos, first
+
+
+def main(argv):
+    mega = '--mega' in argv
+    args = [a for a in argv if a != '--mega']
+    if len(args) != 2:
+        sys.exit('usage: ino2cpp.py [--mega] <sketch.ino> <out.cpp>')
+    src, dst = args
+
+    text = open(src).read()
+    protos, first = find_prototypes(text)
+    lines = text.split('\n')
+    if first is None:
+        first = len(lines)
+
+    with open(dst, 'w') as out:
+        if mega:
+            out.write('#define __AVR_ATmega1284P__\n')
+        out.write('#include <Arduino.h>\n')
+        out.write('#line 1 "%s"\n' % src)
+        out.write('\n'.join(lines[:first]) + '\n')
+        out.write('\n'.join(protos) + '\n')
+        out.write('#line %d "%s"\n' % (first + 1, src))
+        out.write('\n'.join(lines[first:]) + '\n')
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
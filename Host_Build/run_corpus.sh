@@ -0,0 +1,89 @@
+#!/bin/sh
+#
+# run_corpus.sh - Replay WIPE programs through the host build of the WASP
+# controller, and report each one's run statistics (see wipeRunReport()).
+#
+# Each program is entered at the WIPE prompt of a freshly started controller
+# (blank EEPROM, no flash chip) and run for RUN_MS simulated milliseconds,
+# or until it ends. The report gives, per program: the statements executed
+# and their rate, the radio frames and payload bytes sent, and their
+# estimated airtime, all in simulated time; and the wall-clock time the run
+# took on this host.
+#
+# The corpus files hold program listings as the controller's "list" command
+# prints them: only numbered statement lines are entered, and string literals
+# that "list" broke across lines at a "\n" are joined back up.
+#
+# Usage: run_corpus.sh <wasp_controller> <program.txt | directory> ...
+#   RUN_MS  Simulated run time limit (ms) of each program (default 60000).
+#
+# Exits with status 1 if any program reports an error or doesn't run.
+#
+
+if [ $# -lt 2 ]; then
+  echo "usage: $0 <wasp_controller> <program.txt | directory> ..." >&2
+  exit 2
+fi
+CONTROLLER=$1
+shift
+RUN_MS=${RUN_MS:-60000}
+OUT=$(mktemp) || exit 2
+trap 'rm -f "$OUT" "$OUT.failed"' EXIT
+failed=0
+
+# Print the statement lines of a program listing, as they're to be typed.
+statements()
+{
+  tr -d '\r' < "$1" | awk '
+    /^[0-9]+ +([a-z]+( |$)|[A-Z][A-Za-z]*\()/ {
+      if (stmt != "") print stmt
+      stmt = $0
+      next
+    }
+    stmt != "" {
+      copy = stmt
+      if (gsub(/"/, "", copy) % 2) stmt = stmt "\\n" $0
+    }
+    END { if (stmt != "") print stmt }'
+}
+
+printf '%-24s %7s %6s %6s %7s %9s %8s %6s\n' \
+       Program Stmts Stmt/s Frames Bytes "Airtime" "Run ms" "Wall s"
+
+for arg in "$@"; do
+  if [ -d "$arg" ]; then
+    find "$arg" -name '*.txt' | sort
+  else
+    echo "$arg"
+  fi
+done | while read -r prog; do
+  start=$(date +%s%N)
+  { echo program; statements "$prog"; echo run; } |
+    HOST_RUN_MS=$RUN_MS "$CONTROLLER" 1000000000 > "$OUT" 2>&1
+  end=$(date +%s%N)
+  wall=$(( (end - start) / 1000000 ))
+
+  name=$(basename "$prog" .txt)
+  report=$(grep -a '^Run: ' "$OUT" | tail -n 1)
+  errors=$(grep -a -c '^\*\*\*ERROR' "$OUT")
+  if [ -z "$report" ]; then
+    printf '%-24s ***ERROR: Did not run\n' "$name"
+  else
+    # Run: <n> stmts in <ms> ms (<n>/s); Tx: <n> frames, <n> bytes,
+    #   <ms> ms airtime (<pct>%)
+    echo "$report" | tr -c '0-9\n' ' ' |
+      awk -v name="$name" -v wall="$wall" '{
+        printf "%-24s %7s %6s %6s %7s %6s ms %8s %3d.%02d\n", name, $1, $3,
+               $4, $5, $6, $2, wall / 1000, (wall % 1000) / 10 }'
+  fi
+  if [ -z "$report" ] || [ "$errors" -ne 0 ]; then
+    grep -a -B 2 '^\*\*\*ERROR' "$OUT" | sed 's/^/    /'
+    echo 1 > "$OUT.failed"
+  fi
+done
+
+if [ -f "$OUT.failed" ]; then
+  rm -f "$OUT.failed"
+  exit 1
+fi
+exit 0
@@ -0,0 +1,38 @@
+/*
+ * Host build shim: the Adafruit NeoPixel library. The first pixels of the
+ * strip are printed on each show() with HOST_PIXELS_VERBOSE (see
+ * host_stubs.cpp).
+ */
+#pragma once
+#include <Arduino.h>
+
+typedef uint16_t neoPixelType;
+
+#define NEO_RGB     ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_RBG     ((0 << 6) | (0 << 4) | (2 << 2) | (1))
+#define NEO_GRB     ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_GBR     ((2 << 6) | (2 << 4) | (0 << 2) | (1))
+#define NEO_BRG     ((1 << 6) | (1 << 4) | (2 << 2) | (0))
+#define NEO_BGR     ((2 << 6) | (2 << 4) | (1 << 2) | (0))
+#define NEO_KHZ800  0x0000
+#define NEO_KHZ400  0x0100
+
+class Adafruit_NeoPixel
+{
+public:
+  Adafruit_NeoPixel(uint16_t n, uint16_t pin,
+                    neoPixelType type = NEO_GRB + NEO_KHZ800);
+  ~Adafruit_NeoPixel();
+  void     begin(void);
+  void     show(void);
+  void     setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  void     setPixelColor(uint16_t n, uint32_t c);
+  void     setBrightness(uint8_t b);
+  uint8_t *getPixels(void) const;
+  uint16_t numPixels(void) const;
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b);
+
+private:
+  uint16_t numLEDs;
+  uint8_t *pixels;
+};
@@ -0,0 +1,104 @@
+/*
+ * Host build shim: the parts of the Arduino core that the WASP sketches use,
+ * implemented by host_stubs.cpp. Flash-resident data (PROGMEM) is plain
+ * memory on the host.
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+
+// The AVR sizes of the WASP integer types (see WASP_defs.h): a host's int
+// and long are wider.
+#define int8    int8_t
+#define int16   int16_t
+#define int32   int32_t
+#define uint8   uint8_t
+#define uint16  uint16_t
+#define uint32  uint32_t
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define HIGH    1
+#define LOW     0
+#define OUTPUT  1
+#define INPUT   0
+#define RAMEND  0x40FF
+#define DEC     10
+#define HEX     16
+#define LED_BUILTIN 13
+
+#define PROGMEM
+#define PGM_P               const char *
+#define PSTR(s)             (s)
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_word(p)    (*(const uint16_t *)(p))
+#define pgm_read_dword(p)   (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)     (*(void * const *)(p))
+#define memcpy_P            memcpy
+#define strcmp_P            strcmp
+#define strlen_P            strlen
+
+#define noInterrupts()
+#define interrupts()
+#define cli()
+#define sei()
+#define _BV(b)              (1 << (b))
+#define min(a, b)           ((a) < (b) ? (a) : (b))
+#define max(a, b)           ((a) > (b) ? (a) : (b))
+#define constrain(x, a, b)  ((x) < (a) ? (a) : ((x) > (b) ? (b) : (x)))
+#define abs(x)              ((x) > 0 ? (x) : -(x))
+#include "binary.h"
+
+class __FlashStringHelper;
+#define F(s)  ((const __FlashStringHelper *)(s))
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+int  analogRead(uint8_t pin);
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+// The console: input is taken from stdin, a line at a time (see
+// host_stubs.cpp), and output goes to stdout.
+struct HardwareSerial
+{
+  void   begin(long baud);
+  int    available(void);
+  int    read(void);
+  int    peek(void);
+  void   flush(void);
+  size_t print(const __FlashStringHelper *s);
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(unsigned char v, int base = DEC);
+  size_t print(int v, int base = DEC);
+  size_t print(unsigned int v, int base = DEC);
+  size_t print(long v, int base = DEC);
+  size_t print(unsigned long v, int base = DEC);
+  size_t print(double v, int digits = 2);
+  size_t println(void);
+  size_t println(const __FlashStringHelper *s);
+  size_t println(const char *s);
+  size_t println(char c);
+  size_t println(unsigned char v, int base = DEC);
+  size_t println(int v, int base = DEC);
+  size_t println(unsigned int v, int base = DEC);
+  size_t println(long v, int base = DEC);
+  size_t println(unsigned long v, int base = DEC);
+  size_t println(double v, int digits = 2);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *p, size_t n);
+  operator bool();
+};
+extern HardwareSerial Serial;
@@ -0,0 +1,15 @@
+/*
+ * Host build shim: the EEPROM library. The contents are kept in a file if
+ * HOST_EEPROM names one (see host_stubs.cpp).
+ */
+#pragma once
+#include <Arduino.h>
+
+struct EEPROMClass
+{
+  uint8_t  read(int addr);
+  void     write(int addr, uint8_t val);
+  void     update(int addr, uint8_t val);
+  uint16_t length(void);
+};
+extern EEPROMClass EEPROM;
@@ -0,0 +1,49 @@
+/*
+ * Host build shim: the LowPowerLab RFM69 radio library. Frames sent are
+ * counted (and printed with HOST_TX_VERBOSE); frames received are read
+ * from the file named by HOST_RX_FILE (see host_stubs.cpp).
+ */
+#pragma once
+#include <Arduino.h>
+
+#define RF69_MAX_DATA_LEN    61
+#define RF69_433MHZ          43
+#define RF69_868MHZ          86
+#define RF69_915MHZ          91
+#define RF69_BROADCAST_ADDR  255
+
+class RFM69
+{
+public:
+  static volatile uint8_t DATA[RF69_MAX_DATA_LEN + 1];
+  static volatile uint8_t DATALEN;
+  static volatile uint8_t SENDERID;
+  static volatile uint8_t TARGETID;
+  static volatile uint8_t PAYLOADLEN;
+  static volatile uint8_t ACK_REQUESTED;
+  static volatile uint8_t ACK_RECEIVED;
+  static volatile int16_t RSSI;
+
+  RFM69(uint8_t slaveSelectPin = 0, uint8_t interruptPin = 0,
+        bool isRFM69HW = false, uint8_t interruptNum = 0);
+  bool     initialize(uint8_t freqBand, uint16_t id, uint8_t networkID = 1);
+  void     setAddress(uint16_t addr);
+  void     setNetwork(uint8_t networkID);
+  bool     canSend(void);
+  void     send(uint16_t toAddress, const void *buffer, uint8_t bufferSize,
+                bool requestACK = false);
+  bool     sendWithRetry(uint16_t toAddress, const void *buffer,
+                         uint8_t bufferSize, uint8_t retries = 2,
+                         uint8_t retryWaitTime = 40);
+  bool     receiveDone(void);
+  bool     ACKReceived(uint16_t fromNodeID);
+  bool     ACKRequested(void);
+  void     sendACK(const void *buffer = "", uint8_t bufferSize = 0);
+  void     encrypt(const char *key);
+  int16_t  readRSSI(bool forceTrigger = false);
+  void     promiscuous(bool onOff = true);
+  void     setHighPower(bool onOFF = true);
+  void     sleep(void);
+  void     setPowerLevel(uint8_t level);
+  uint32_t getFrequency(void);
+};
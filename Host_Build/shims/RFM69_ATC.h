@@ -0,0 +1,10 @@
+/*
+ * Host build shim: the automatic transmission control (ATC) part of the
+ * RFM69 library, which makes no difference on a host.
+ */
+#pragma once
+#include <RFM69.h>
+
+class RFM69_ATC : public RFM69
+{
+};
@@ -0,0 +1,17 @@
+/*
+ * Host build shim: the over-the-air programming part of the RFM69 library.
+ * A host build never receives a new image; a watchdog reset ends the run.
+ * The serial programming of a single node isn't supported.
+ */
+#pragma once
+#include <RFM69.h>
+#include <SPIFlash.h>
+
+void CheckForWirelessHEX(RFM69 &radio, SPIFlash &flash, uint8_t DEBUG = false,
+                         uint8_t LEDpin = 0);
+void resetUsingWatchdog(uint8_t DEBUG);
+uint8_t CheckForSerialHEX(uint8_t *input, uint8_t inputLen, RFM69 &radio,
+                          uint16_t targetID, uint16_t TIMEOUT = 3000,
+                          uint16_t ACKTIMEOUT = 100, uint8_t DEBUG = false);
+uint8_t readSerialLine(char *input, char endOfLineChar = 10,
+                       uint8_t maxLength = 115, uint16_t timeout = 1000);
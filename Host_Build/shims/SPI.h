@@ -0,0 +1,2 @@
+/* Host build shim: the SPI library (used only through SPIFlash and RFM69). */
+#pragma once
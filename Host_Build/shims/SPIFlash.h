@@ -0,0 +1,26 @@
+/*
+ * Host build shim: the LowPowerLab SPIFlash library. The chip is present
+ * only if HOST_FLASH is set; it's blank (erased) at the start of each run
+ * (see host_stubs.cpp).
+ */
+#pragma once
+#include <Arduino.h>
+
+class SPIFlash
+{
+public:
+  SPIFlash(uint8_t slaveSelectPin, uint16_t jedecID = 0);
+  bool     initialize(void);
+  uint8_t  readByte(uint32_t addr);
+  void     readBytes(uint32_t addr, void *buf, uint16_t len);
+  void     writeByte(uint32_t addr, uint8_t byt);
+  void     writeBytes(uint32_t addr, const void *buf, uint16_t len);
+  void     blockErase4K(uint32_t addr);
+  void     blockErase32K(uint32_t addr);
+  void     blockErase64K(uint32_t addr);
+  void     chipErase(void);
+  bool     busy(void);
+  void     sleep(void);
+  void     wakeup(void);
+  uint16_t readDeviceId(void);
+};
@@ -0,0 +1,3 @@
+/* Host build shim: see Arduino.h for the PROGMEM access macros. */
+#pragma once
+#include <Arduino.h>
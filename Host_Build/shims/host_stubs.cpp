@@ -0,0 +1,542 @@
+/*
+ * Host build of the WASP sketches: the Arduino core and library stubs, and
+ * main(), which runs setup() and then loop() until the sketch goes idle.
+ *
+ * Time is simulated: each call of millis() or micros() advances the clock
+ * by 125 us, and delay() advances it by the time asked for. Runs are
+ * therefore repeatable, and time passes faster the busier the sketch is.
+ *
+ * Environment variables:
+ *   HOST_EEPROM=<file>    Keep the EEPROM contents in <file> (which is
+ *                         created if need be); otherwise it starts blank.
+ *   HOST_FLASH=1          An SPI flash chip is present (blank at start).
+ *   HOST_RX_FILE=<file>   Radio frames to receive, one per line:
+ *                         "<ms> <src> <dst> <byte> ..." in order of <ms>.
+ *   HOST_TX_VERBOSE=1     Print each radio frame sent or received.
+ *   HOST_PIXELS_VERBOSE=1 Print the first pixels of the strip on each
+ *                         show().
+ *   HOST_RUN_MS=<ms>      Once the console input is used up, let the
+ *                         sketch run for <ms> more (simulated) ms, then
+ *                         type 'x' (which stops a running WIPE program).
+ *   HOST_IDLE_POLLS=<n>   Exit after the console has been polled <n> times
+ *                         in a row with no input left (default 3000000).
+ *   HOST_FREE_RAM=<n>     The free RAM (bytes) reported to the sketch.
+ *
+ * Console input (stdin) is fed to the sketch a line at a time, each once
+ * the sketch has stopped reading for a while, as though typed.
+ */
+#include <Arduino.h>
+#include <RFM69.h>
+#include <RFM69_OTA.h>
+#include <EEPROM.h>
+#include <SPIFlash.h>
+#include <Adafruit_NeoPixel.h>
+#undef min
+#undef max
+#include <string>
+#include <iostream>
+#include <sstream>
+
+#define LINE_FEED_POLLS  20000     // Idle polls before the next input line
+#define EEPROM_SIZE      4096
+#define FLASH_SIZE       0x80000UL // 4 Mib (the smallest chip fitted)
+
+void setup(void);
+void loop(void);
+
+static unsigned long g_ticks = 0;   // Simulated time (1/8 ms)
+static int           g_txFrames = 0;
+static int           g_txBytes = 0;
+
+static const char *env(const char *name)
+{
+  return getenv(name);
+}
+
+static void hostExit(const char *why)
+{
+  printf("\n[HOST %s: tx frames=%d bytes=%d ms=%lu]\n",
+         why, g_txFrames, g_txBytes, g_ticks / 8);
+  fflush(stdout);
+  exit(0);
+}
+
+
+/*---------------------------  Time and I/O pins -----------------------------*/
+unsigned long millis(void)             { return g_ticks++ / 8; }
+unsigned long micros(void)             { return g_ticks++ * 125; }
+void delay(unsigned long ms)           { g_ticks += ms * 8; }
+void delayMicroseconds(unsigned int)   { }
+void pinMode(uint8_t, uint8_t)         { }
+void digitalWrite(uint8_t, uint8_t)    { }
+int  digitalRead(uint8_t)              { return LOW; }
+int  analogRead(uint8_t)               { return 0; }
+long random(long howBig)               { return howBig ? rand() % howBig : 0; }
+long random(long lo, long hi)          { return hi > lo ? lo + random(hi - lo)
+                                                        : lo; }
+void randomSeed(unsigned long seed)    { srand(seed); }
+
+// FreeRam() measures from __brkval to its own stack frame (see main()).
+extern "C" { char __bss_end; char *__brkval; char __heap_start; }
+
+
+/*--------------------------------  Console ----------------------------------*/
+HardwareSerial Serial;
+
+static std::string g_in;            // All of stdin (with CR line ends)
+static size_t      g_inPos = 0;     // Next character to read
+static size_t      g_inLimit = 0;   // End of the lines fed so far
+static bool        g_stopSent = false;
+static unsigned long g_stopMs = 0;  // When to type 'x' (see HOST_RUN_MS)
+
+int HardwareSerial::available(void)
+{
+  static long idlePolls = 0;
+  static long idleMax = env("HOST_IDLE_POLLS") ?
+                        atol(env("HOST_IDLE_POLLS")) : 3000000;
+  size_t      eol;
+
+  if (g_inPos < g_inLimit)
+  {
+    idlePolls = 0;
+    return (int)(g_inLimit - g_inPos);
+  }
+
+  if (g_inLimit < g_in.size())
+  {
+    // Feed the next line once the sketch has had time to act on the last.
+    if (++idlePolls > LINE_FEED_POLLS)
+    {
+      idlePolls = 0;
+      eol = g_in.find('\r', g_inPos);
+      g_inLimit = (std::string::npos == eol) ? g_in.size() : eol + 1;
+      if ( (g_inLimit == g_in.size()) && env("HOST_RUN_MS") )
+        g_stopMs = millis() + atol(env("HOST_RUN_MS"));
+    }
+    return 0;
+  }
+
+  if (env("HOST_RUN_MS") && !g_stopSent)
+  {
+    if ((long)(millis() - g_stopMs) >= 0)
+    {
+      g_stopSent = true;
+      g_in += 'x';
+      g_inLimit = g_in.size();
+      return 1;
+    }
+    return 0;
+  }
+
+  if (++idlePolls > idleMax)
+    hostExit("idle");
+  return 0;
+}
+
+int HardwareSerial::read(void)
+{
+  return (g_inPos < g_inLimit) ? (uint8_t)g_in[g_inPos++] : -1;
+}
+
+int HardwareSerial::peek(void)
+{
+  return (g_inPos < g_inLimit) ? (uint8_t)g_in[g_inPos] : -1;
+}
+
+void HardwareSerial::begin(long)    { }
+void HardwareSerial::flush(void)    { }
+HardwareSerial::operator bool()     { return true; }
+
+static size_t printNum(long v, int base)
+{
+  return (HEX == base) ? printf("%lX", v) : printf("%ld", v);
+}
+
+static size_t printUNum(unsigned long v, int base)
+{
+  return (HEX == base) ? printf("%lX", v) : printf("%lu", v);
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *s)
+{
+  return printf("%s", (const char *)s);
+}
+size_t HardwareSerial::print(const char *s)          { return printf("%s", s); }
+size_t HardwareSerial::print(char c)                 { return printf("%c", c); }
+size_t HardwareSerial::print(unsigned char v, int b) { return printUNum(v, b); }
+size_t HardwareSerial::print(int v, int b)           { return printNum(v, b); }
+size_t HardwareSerial::print(unsigned int v, int b)  { return printUNum(v, b); }
+size_t HardwareSerial::print(long v, int b)          { return printNum(v, b); }
+size_t HardwareSerial::print(unsigned long v, int b) { return printUNum(v, b); }
+size_t HardwareSerial::print(double v, int digits)
+{
+  return printf("%.*f", digits, v);
+}
+size_t HardwareSerial::println(void)                 { return printf("\n"); }
+size_t HardwareSerial::println(const __FlashStringHelper *s)
+{
+  return print(s) + println();
+}
+size_t HardwareSerial::println(const char *s)  { return print(s) + println(); }
+size_t HardwareSerial::println(char c)         { return print(c) + println(); }
+size_t HardwareSerial::println(unsigned char v, int b)
+{
+  return print(v, b) + println();
+}
+size_t HardwareSerial::println(int v, int b)
+{
+  return print(v, b) + println();
+}
+size_t HardwareSerial::println(unsigned int v, int b)
+{
+  return print(v, b) + println();
+}
+size_t HardwareSerial::println(long v, int b)
+{
+  return print(v, b) + println();
+}
+size_t HardwareSerial::println(unsigned long v, int b)
+{
+  return print(v, b) + println();
+}
+size_t HardwareSerial::println(double v, int digits)
+{
+  return print(v, digits) + println();
+}
+size_t HardwareSerial::write(uint8_t c)        { return printf("%c", c); }
+size_t HardwareSerial::write(const uint8_t *p, size_t n)
+{
+  return fwrite(p, 1, n, stdout);
+}
+
+
+/*--------------------------------  EEPROM -----------------------------------*/
+EEPROMClass EEPROM;
+static uint8_t g_eeprom[EEPROM_SIZE];
+
+static void eepromLoad(void)
+{
+  static bool loaded = false;
+  FILE       *fp;
+
+  if (loaded)
+    return;
+  loaded = true;
+  memset(g_eeprom, 0xFF, sizeof(g_eeprom));  // Blank
+  fp = env("HOST_EEPROM") ? fopen(env("HOST_EEPROM"), "rb") : NULL;
+  if (fp)
+  {
+    (void)fread(g_eeprom, 1, sizeof(g_eeprom), fp);
+    fclose(fp);
+  }
+}
+
+static void eepromSave(void)
+{
+  FILE *fp = env("HOST_EEPROM") ? fopen(env("HOST_EEPROM"), "wb") : NULL;
+
+  if (fp)
+  {
+    fwrite(g_eeprom, 1, sizeof(g_eeprom), fp);
+    fclose(fp);
+  }
+}
+
+uint8_t EEPROMClass::read(int addr)
+{
+  eepromLoad();
+  return g_eeprom[addr % EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int addr, uint8_t val)
+{
+  eepromLoad();
+  if (g_eeprom[addr % EEPROM_SIZE] == val)
+    return;
+  g_eeprom[addr % EEPROM_SIZE] = val;
+  eepromSave();
+}
+
+void EEPROMClass::update(int addr, uint8_t val)   { write(addr, val); }
+uint16_t EEPROMClass::length(void)                { return EEPROM_SIZE; }
+
+
+/*---------------------------------  Radio -----------------------------------*/
+volatile uint8_t RFM69::DATA[RF69_MAX_DATA_LEN + 1];
+volatile uint8_t RFM69::DATALEN;
+volatile uint8_t RFM69::SENDERID;
+volatile uint8_t RFM69::TARGETID;
+volatile uint8_t RFM69::PAYLOADLEN;
+volatile uint8_t RFM69::ACK_REQUESTED;
+volatile uint8_t RFM69::ACK_RECEIVED;
+volatile int16_t RFM69::RSSI;
+
+// The next frame to receive (see HOST_RX_FILE)
+static FILE         *g_rxFile = NULL;
+static bool          g_rxOpened = false;
+static bool          g_rxHave = false;
+static unsigned long g_rxMs;
+static int           g_rxSrc, g_rxDst, g_rxLen;
+static uint8_t       g_rxBuf[RF69_MAX_DATA_LEN];
+
+static void rxNext(void)
+{
+  char  line[512];
+  char *p, *q;
+  long  v;
+
+  g_rxHave = false;
+  while (g_rxFile && fgets(line, sizeof(line), g_rxFile))
+  {
+    if ( ('#' == line[0]) || ('\n' == line[0]) )
+      continue;
+    p = line;
+    g_rxMs  = strtoul(p, &p, 10);
+    g_rxSrc = strtol(p, &p, 10);
+    g_rxDst = strtol(p, &p, 10);
+    for (g_rxLen = 0; g_rxLen < RF69_MAX_DATA_LEN; g_rxLen++)
+    {
+      v = strtol(p, &q, 10);
+      if (q == p)
+        break;
+      p = q;
+      g_rxBuf[g_rxLen] = (uint8_t)v;
+    }
+    g_rxHave = true;
+    return;
+  }
+}
+
+RFM69::RFM69(uint8_t, uint8_t, bool, uint8_t)        { }
+bool RFM69::initialize(uint8_t, uint16_t, uint8_t)   { return true; }
+void RFM69::setAddress(uint16_t)                     { }
+void RFM69::setNetwork(uint8_t)                      { }
+bool RFM69::canSend(void)                            { return true; }
+
+void RFM69::send(uint16_t dst, const void *buf, uint8_t len, bool)
+{
+  g_txFrames++;
+  g_txBytes += len;
+  if (env("HOST_TX_VERBOSE"))
+  {
+    printf("[TX %lu dst=%u:", g_ticks / 8, dst);
+    for (int i = 0; i < len; i++)
+      printf(" %u", ((const uint8_t *)buf)[i]);
+    printf("]\n");
+  }
+}
+
+bool RFM69::sendWithRetry(uint16_t dst, const void *buf, uint8_t len,
+                          uint8_t, uint8_t)
+{
+  send(dst, buf, len, false);
+  return true;
+}
+
+bool RFM69::receiveDone(void)
+{
+  if (!g_rxOpened)
+  {
+    g_rxOpened = true;
+    if (env("HOST_RX_FILE"))
+      g_rxFile = fopen(env("HOST_RX_FILE"), "r");
+    rxNext();
+  }
+  if (!g_rxHave || (millis() < g_rxMs))
+    return false;
+
+  memcpy((void *)DATA, g_rxBuf, g_rxLen);
+  DATALEN = g_rxLen;
+  SENDERID = g_rxSrc;
+  TARGETID = g_rxDst;
+  ACK_REQUESTED = 0;
+  ACK_RECEIVED = 0;
+  RSSI = -50;
+  if (env("HOST_TX_VERBOSE"))
+    printf("[RX %lu %d->%d len=%d]\n", g_ticks / 8, g_rxSrc, g_rxDst, g_rxLen);
+  rxNext();
+  return true;
+}
+
+bool    RFM69::ACKReceived(uint16_t)          { return true; }
+bool    RFM69::ACKRequested(void)             { return false; }
+void    RFM69::sendACK(const void *, uint8_t) { }
+void    RFM69::encrypt(const char *)          { }
+int16_t RFM69::readRSSI(bool)                 { return -50; }
+void    RFM69::promiscuous(bool)              { }
+void    RFM69::setHighPower(bool)             { }
+void    RFM69::sleep(void)                    { }
+void    RFM69::setPowerLevel(uint8_t)         { }
+uint32_t RFM69::getFrequency(void)            { return 0; }
+
+void CheckForWirelessHEX(RFM69 &, SPIFlash &, uint8_t, uint8_t) { }
+
+uint8_t CheckForSerialHEX(uint8_t *, uint8_t, RFM69 &, uint16_t, uint16_t,
+                          uint16_t, uint8_t)
+{
+  printf("[HOST serial programming of a single node isn't supported]\n");
+  return false;
+}
+
+// A console line ends with a CR (see main()), whatever endOfLineChar is.
+// Input that's fed is read at once; otherwise the timeout passes.
+uint8_t readSerialLine(char *input, char endOfLineChar, uint8_t maxLength,
+                       uint16_t timeout)
+{
+  uint8_t len = 0;
+  int     c;
+
+  for (int i = 0; (0 == Serial.available()) && (i <= LINE_FEED_POLLS); i++)
+    ;
+  if (0 == Serial.available())
+    delay(timeout);
+  while ( (len < maxLength) && Serial.available() )
+  {
+    c = Serial.read();
+    if ( ('\r' == c) || (endOfLineChar == c) )
+      break;
+    input[len++] = (char)c;
+  }
+  input[len] = 0;
+  return len;
+}
+
+void resetUsingWatchdog(uint8_t)
+{
+  hostExit("watchdog reset");
+}
+
+
+/*-------------------------------  SPI flash ---------------------------------*/
+static uint8_t g_flash[FLASH_SIZE];
+
+SPIFlash::SPIFlash(uint8_t, uint16_t)   { }
+
+bool SPIFlash::initialize(void)
+{
+  memset(g_flash, 0xFF, sizeof(g_flash));
+  return (env("HOST_FLASH") != NULL);
+}
+
+uint8_t SPIFlash::readByte(uint32_t addr)
+{
+  return g_flash[addr % FLASH_SIZE];
+}
+
+void SPIFlash::readBytes(uint32_t addr, void *buf, uint16_t len)
+{
+  for (uint16_t i = 0; i < len; i++)
+    ((uint8_t *)buf)[i] = g_flash[(addr + i) % FLASH_SIZE];
+}
+
+void SPIFlash::writeByte(uint32_t addr, uint8_t byt)
+{
+  g_flash[addr % FLASH_SIZE] &= byt;      // Programming only clears bits
+}
+
+void SPIFlash::writeBytes(uint32_t addr, const void *buf, uint16_t len)
+{
+  if ((addr % 256) + len > 256)
+    printf("[HOST flash write crosses a page: %lX (%u bytes)]\n",
+           (unsigned long)addr, len);
+  for (uint16_t i = 0; i < len; i++)
+    g_flash[(addr + i) % FLASH_SIZE] &= ((const uint8_t *)buf)[i];
+}
+
+void SPIFlash::blockErase4K(uint32_t addr)
+{
+  memset(&g_flash[(addr % FLASH_SIZE) & ~0xFFFUL], 0xFF, 0x1000);
+}
+
+void SPIFlash::blockErase32K(uint32_t addr)
+{
+  memset(&g_flash[(addr % FLASH_SIZE) & ~0x7FFFUL], 0xFF, 0x8000);
+}
+
+void SPIFlash::blockErase64K(uint32_t addr)
+{
+  memset(&g_flash[(addr % FLASH_SIZE) & ~0xFFFFUL], 0xFF, 0x10000);
+}
+
+void     SPIFlash::chipErase(void)     { memset(g_flash, 0xFF, FLASH_SIZE); }
+bool     SPIFlash::busy(void)          { return false; }
+void     SPIFlash::sleep(void)         { }
+void     SPIFlash::wakeup(void)        { }
+uint16_t SPIFlash::readDeviceId(void)  { return 0xEF30; }
+
+
+/*------------------------------  Pixel strip --------------------------------*/
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, uint16_t, neoPixelType)
+{
+  numLEDs = n;
+  pixels = (uint8_t *)calloc(n * 3, 1);
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel()
+{
+  free(pixels);
+}
+
+void Adafruit_NeoPixel::begin(void)            { }
+void Adafruit_NeoPixel::setBrightness(uint8_t) { }
+
+void Adafruit_NeoPixel::show(void)
+{
+  if (!env("HOST_PIXELS_VERBOSE"))
+    return;
+  printf("[SHOW %lu:", g_ticks / 8);
+  for (uint16_t i = 0; (i < numLEDs) && (i < 16); i++)
+    printf(" %02X%02X%02X", pixels[i * 3], pixels[i * 3 + 1],
+           pixels[i * 3 + 2]);
+  printf("]\n");
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g,
+                                      uint8_t b)
+{
+  if (n < numLEDs)
+  {
+    pixels[n * 3] = r;
+    pixels[n * 3 + 1] = g;
+    pixels[n * 3 + 2] = b;
+  }
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c)
+{
+  setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+}
+
+uint8_t *Adafruit_NeoPixel::getPixels(void) const  { return pixels; }
+uint16_t Adafruit_NeoPixel::numPixels(void) const  { return numLEDs; }
+
+uint32_t Adafruit_NeoPixel::Color(uint8_t r, uint8_t g, uint8_t b)
+{
+  return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+
+/*---------------------------------  main ------------------------------------*/
+// Usage: <sketch> [<max # of loop() calls>]  < console input
+int main(int argc, char **argv)
+{
+  std::stringstream ss;
+  long              loops = (argc > 1) ? atol(argv[1]) : 2000000;
+  char              top;
+
+  ss << std::cin.rdbuf();
+  g_in = ss.str();
+  for (size_t i = 0; i < g_in.size(); i++)
+  {
+    if ('\n' == g_in[i])
+      g_in[i] = '\r';                     // The console expects CR
+  }
+
+  __brkval = &top - (env("HOST_FREE_RAM") ? atoi(env("HOST_FREE_RAM"))
+                                          : 1200);
+  setup();
+  for (long i = 0; i < loops; i++)
+    loop();
+  hostExit("loop limit");
+  return 0;
+}